@@ -6,6 +6,9 @@
 #include "alpaca_handler.h"
 #include "mqtt_handler.h"
 #include "roof_controller.h"
+#include "control_link.h"
+#include "request_arena.h"
+#include "safety_monitor.h"
 #include "Debug.h"
 #include <ArduinoJson.h>
 #include <ESPmDNS.h>
@@ -15,6 +18,7 @@ WebServer alpacaServer(ALPACA_PORT);
 WiFiUDP udp;
 String uniqueID;
 unsigned int serverTransactionID = 1;
+bool safetyMonitorConnected = true;
 
 // Set up the Alpaca API
 void setupAlpacaAPI() {
@@ -28,11 +32,7 @@ void setupAlpacaAPI() {
     uniqueID += buf;
   }
   
-  // Setup MDNS responder
-  if (MDNS.begin("rolloffroof")) {
-    Serial.println("MDNS responder started");
-    MDNS.addService("http", "tcp", ALPACA_PORT);
-  }
+  // The MDNS responder starts once WiFi connects (see startAlpacaMDNS())
   
   // Initialize UDP for Alpaca discovery
   Serial.print("Starting UDP listener on port ");
@@ -46,8 +46,6 @@ void setupAlpacaAPI() {
   }
   
   // Print network info
-  Serial.print("ESP32 IP address: ");
-  Serial.println(WiFi.localIP());
   Serial.print("Discovery port: ");
   Serial.println(ALPACA_DISCOVERY_PORT);
   Serial.print("Alpaca API port: ");
@@ -61,6 +59,18 @@ void setupAlpacaAPI() {
   Serial.printf("Alpaca server started on port %d\n", ALPACA_PORT);
 }
 
+// Start the MDNS responder (needs a station connection; later calls are no-ops)
+void startAlpacaMDNS() {
+  static bool mdnsStarted = false;
+  if (mdnsStarted) return;
+
+  if (MDNS.begin("rolloffroof")) {
+    Serial.println("MDNS responder started");
+    MDNS.addService("http", "tcp", ALPACA_PORT);
+    mdnsStarted = true;
+  }
+}
+
 // Handle Alpaca discovery requests
 void handleAlpacaDiscovery() {
   int packetSize = udp.parsePacket();
@@ -161,6 +171,19 @@ void setupAlpacaRoutes() {
   alpacaServer.on("/api/v1/dome/0/slewtoaltitude", HTTP_PUT, handleNotImplemented);
   alpacaServer.on("/api/v1/dome/0/slewtoazimuth", HTTP_PUT, handleNotImplemented);
   alpacaServer.on("/api/v1/dome/0/synctoazimuth", HTTP_PUT, handleNotImplemented);
+
+  // SafetyMonitor device 0
+  alpacaServer.on("/setup/v1/safetymonitor/0/setup", HTTP_GET, handleRedirectSetup);
+  alpacaServer.on("/api/v1/safetymonitor/0/connected", HTTP_GET, handleSafetyConnected);
+  alpacaServer.on("/api/v1/safetymonitor/0/connected", HTTP_PUT, handleSetSafetyConnected);
+  alpacaServer.on("/api/v1/safetymonitor/0/description", HTTP_GET, handleSafetyDescription);
+  alpacaServer.on("/api/v1/safetymonitor/0/driverinfo", HTTP_GET, handleDriverInfo);
+  alpacaServer.on("/api/v1/safetymonitor/0/driverversion", HTTP_GET, handleDriverVersion);
+  alpacaServer.on("/api/v1/safetymonitor/0/interfaceversion", HTTP_GET, handleInterfaceVersion);
+  alpacaServer.on("/api/v1/safetymonitor/0/name", HTTP_GET, handleSafetyName);
+  alpacaServer.on("/api/v1/safetymonitor/0/supportedactions", HTTP_GET, handleSafetySupportedActions);
+  alpacaServer.on("/api/v1/safetymonitor/0/action", HTTP_PUT, handleSafetyAction);
+  alpacaServer.on("/api/v1/safetymonitor/0/issafe", HTTP_GET, handleIsSafe);
   
   // Handle not found
   alpacaServer.onNotFound(handleNotFound);
@@ -168,7 +191,7 @@ void setupAlpacaRoutes() {
 
 // Helper function to send a standard JSON response
 void sendAlpacaResponse(int clientID, int clientTransactionID, int errorNumber, String errorMessage, String value) {
-  DynamicJsonDocument doc(1024);
+  RequestJsonDocument doc(1024);
   
   // Common response fields
   doc["ClientTransactionID"] = clientTransactionID;
@@ -182,7 +205,7 @@ void sendAlpacaResponse(int clientID, int clientTransactionID, int errorNumber,
     if ((value.startsWith("{") && value.endsWith("}")) || 
         (value.startsWith("[") && value.endsWith("]"))) {
       // Parse the JSON string into a JsonDocument
-      DynamicJsonDocument valueDoc(512);
+      RequestJsonDocument valueDoc(512);
       DeserializationError error = deserializeJson(valueDoc, value);
       
       if (!error) {
@@ -204,10 +227,19 @@ void sendAlpacaResponse(int clientID, int clientTransactionID, int errorNumber,
     }
   }
   
-  String response;
-  serializeJson(doc, response);
-  
-  alpacaServer.send(200, "application/json", response);
+  sendJsonResponse(alpacaServer, 200, doc);
+}
+
+// Successful response whose Value is a JSON object or array, without a String round trip
+void sendAlpacaJsonValue(int clientID, int clientTransactionID, JsonVariantConst value) {
+  RequestJsonDocument doc(1024);
+  doc["ClientTransactionID"] = clientTransactionID;
+  doc["ServerTransactionID"] = serverTransactionID++;
+  doc["ErrorNumber"] = 0;
+  doc["ErrorMessage"] = "";
+  doc["Value"] = value;
+
+  sendJsonResponse(alpacaServer, 200, doc);
 }
 
 void handleNotFound() {
@@ -229,7 +261,7 @@ void handleApiVersions() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
   
-  DynamicJsonDocument doc(128);
+  RequestJsonDocument doc(128);
   doc["ServerTransactionID"] = serverTransactionID++;
   
   // For Value, we need to create a JSON array
@@ -245,29 +277,24 @@ void handleApiVersions() {
   doc["ErrorNumber"] = 0;
   doc["ErrorMessage"] = "";
   
-  String response;
-  serializeJson(doc, response);
-  
   Serial.print("API Versions response: ");
-  Serial.println(response);
+  serializeJson(doc, Serial);
+  Serial.println();
   
-  alpacaServer.send(200, "application/json", response);
+  sendJsonResponse(alpacaServer, 200, doc);
 }
 
 void handleDescription() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
   
-  DynamicJsonDocument doc(1024);
+  RequestJsonDocument doc(256);
   doc["ServerName"] = DEVICE_NAME;
   doc["Manufacturer"] = DEVICE_MANUFACTURER;
   doc["ManufacturerVersion"] = DEVICE_VERSION;
   doc["Location"] = "Observatory";
   
-  String value;
-  serializeJson(doc, value);
-  
-  sendAlpacaResponse(clientID, clientTransactionID, 0, "", value);
+  sendAlpacaJsonValue(clientID, clientTransactionID, doc.as<JsonVariantConst>());
 }
 
 void handleInterfaceVersion() {
@@ -281,7 +308,7 @@ void handleConfiguredDevices() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
   
-  DynamicJsonDocument arrayDoc(1024);
+  RequestJsonDocument arrayDoc(512);
   JsonArray array = arrayDoc.to<JsonArray>();
   
   JsonObject device = array.createNestedObject();
@@ -289,11 +316,14 @@ void handleConfiguredDevices() {
   device["DeviceType"] = "Dome";
   device["DeviceNumber"] = 0;
   device["UniqueID"] = uniqueID;
+
+  JsonObject monitor = array.createNestedObject();
+  monitor["DeviceName"] = "Roll-Off Roof Safety Monitor";
+  monitor["DeviceType"] = "SafetyMonitor";
+  monitor["DeviceNumber"] = 0;
+  monitor["UniqueID"] = uniqueID + "_SM";
   
-  String value;
-  serializeJson(array, value);
-  
-  sendAlpacaResponse(clientID, clientTransactionID, 0, "", value);
+  sendAlpacaJsonValue(clientID, clientTransactionID, arrayDoc.as<JsonVariantConst>());
 }
 
 // Setup web interface handlers (handleSetup is implemented in web_ui_handler.cpp)
@@ -349,8 +379,8 @@ void handleSetConnected() {
     return;
   }
   
-  // This device is always connected in this implementation
-  isConnected = connected;
+  // A client connecting usually means an open is coming: start the inverter early
+  setAlpacaConnected(connected);
   
   sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
 }
@@ -387,14 +417,13 @@ void handleSupportedActions() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
   
-  DynamicJsonDocument doc(256);
+  RequestJsonDocument doc(128);
   JsonArray array = doc.to<JsonArray>();
   array.add("status");  // Custom action to get status
+  array.add("prewarm"); // Power the inverter up ahead of an open
+  array.add("moveto");  // Part-open position, Parameters = percent (roof encoder)
   
-  String value;
-  serializeJson(doc, value);
-  
-  sendAlpacaResponse(clientID, clientTransactionID, 0, "", value);
+  sendAlpacaJsonValue(clientID, clientTransactionID, doc.as<JsonVariantConst>());
 }
 
 void handleAction() {
@@ -406,6 +435,27 @@ void handleAction() {
   
   if (actionName == "status") {
     sendAlpacaResponse(clientID, clientTransactionID, 0, "", getRoofStatusString());
+  } else if (actionName == "prewarm") {
+    RoofCommandOutcome outcome = runRoofCommand(CMD_PREWARM, SOURCE_ALPACA);
+    if (roofCommandSucceeded(outcome)) {
+      sendAlpacaResponse(clientID, clientTransactionID, 0, "", getRoofCommandOutcomeString(outcome));
+    } else {
+      sendAlpacaResponse(clientID, clientTransactionID, 1035,
+                         String("Cannot pre-warm the inverter (") + getRoofCommandOutcomeString(outcome) + ")", "");
+    }
+  } else if (actionName == "moveto") {
+    uint8_t percent;
+    if (!parseRoofTargetPercent(actionParameters.c_str(), percent)) {
+      sendAlpacaResponse(clientID, clientTransactionID, 1025, "Parameters must be a percentage (0-100)", "");
+      return;
+    }
+    RoofCommandOutcome outcome = runRoofCommand(CMD_MOVE_TO, SOURCE_ALPACA, ROOF_COMMAND_TIMEOUT_MS, percent);
+    if (roofCommandSucceeded(outcome)) {
+      sendAlpacaResponse(clientID, clientTransactionID, 0, "", getRoofCommandOutcomeString(outcome));
+    } else {
+      sendAlpacaResponse(clientID, clientTransactionID, 1035,
+                         String("Cannot move the roof to ") + percent + "% (" + getRoofCommandOutcomeString(outcome) + ")", "");
+    }
   } else {
     sendAlpacaResponse(clientID, clientTransactionID, 1036, "Action not implemented", "");
   }
@@ -450,7 +500,7 @@ void handleAtPark() {
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
   
   // For a roll-off roof, we consider "parked" to be fully closed
-  bool isParked = (roofStatus == ROOF_CLOSED);
+  bool isParked = (getRoofSnapshot().status == ROOF_CLOSED);
   sendAlpacaResponse(clientID, clientTransactionID, 0, "", isParked ? "true" : "false");
 }
 
@@ -543,11 +593,8 @@ void handleShutterStatus() {
   // 3 = shutterClosing
   // 4 = shutterError
   
-  // Make sure our status is correct and up-to-date
-  updateRoofStatus();
-  
-  // Return the status as an integer
-  int status = static_cast<int>(roofStatus);
+  // Return the status as an integer (the control task keeps the snapshot current)
+  int status = static_cast<int>(getRoofSnapshot().status);
   sendAlpacaResponse(clientID, clientTransactionID, 0, "", String(status));
 }
 
@@ -582,88 +629,75 @@ void handleSlewing() {
     return;
   }
 
-  // Make sure our status is up-to-date
-  updateRoofStatus();
+  RoofSnapshot snap = getRoofSnapshot();
 
   // ASCOM Compliance: If the roof is in an error state, reading Slewing must raise an exception
   // with a descriptive error message explaining what went wrong.
   // See: https://ascom-standards.org/newdocs/dome.html
   // "If the shutter becomes jammed... you must raise an exception when the app tries to read Slewing"
-  if (roofStatus == ROOF_ERROR) {
-    String errorMsg = roofErrorReason.length() > 0 ?
-                      roofErrorReason :
-                      "Roof is in error state. Check limit switches and mechanical systems.";
-    // Use error code 0x500 (1280) for DriverException - shutter/roof operation failed
-    Debug.println("Slewing: returning error (ROOF_ERROR state)");
-    Debug.println("  Error message: " + errorMsg);
-    sendAlpacaResponse(clientID, clientTransactionID, 0x500, errorMsg, "");
+  if (snap.status == ROOF_ERROR) {
+    char errorMsg[ROOF_ERROR_REASON_SIZE];
+    if (formatRoofError(snap.error, errorMsg, sizeof(errorMsg)) == 0) {
+      strlcpy(errorMsg, "Roof is in error state. Check limit switches and mechanical systems.", sizeof(errorMsg));
+    }
+    // Driver-specific ErrorNumber per error code (0x500-0x5FF, 0x500 = generic DriverException)
+    int errorNumber = getRoofErrorAlpacaNumber(snap.error.code);
+    Debug.printf("Slewing: returning error 0x%X (%s)\n", errorNumber, getRoofErrorId(snap.error.code));
+    Debug.printf("  Error message: %s\n", errorMsg);
+    sendAlpacaResponse(clientID, clientTransactionID, errorNumber, errorMsg, "");
     return;
   }
 
   // Check if roof is moving (opening or closing)
-  bool isSlewing = (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING);
+  bool isSlewing = (snap.status == ROOF_OPENING || snap.status == ROOF_CLOSING);
   Debug.println("Slewing: returning " + String(isSlewing ? "true" : "false"));
   sendAlpacaResponse(clientID, clientTransactionID, 0, "", isSlewing ? "true" : "false");
 }
 
+// Map the arbiter's decision on an open/close request to an Alpaca response
+static void sendShutterCommandResponse(int clientID, int clientTransactionID,
+                                       RoofCommandOutcome outcome, const char* verb) {
+  switch (outcome) {
+    case COMMAND_ACCEPTED:
+    case COMMAND_COALESCED:
+      sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
+      break;
+    case COMMAND_ALREADY_DONE:
+      sendAlpacaResponse(clientID, clientTransactionID, 0, String("Roof already ") + verb + "d", "");
+      break;
+    case COMMAND_REJECTED_MOVING:
+      sendAlpacaResponse(clientID, clientTransactionID, 1035, "Invalid operation, roof is currently moving", "");
+      break;
+    case COMMAND_REJECTED_UNPARKED:
+      sendAlpacaResponse(clientID, clientTransactionID, 1035,
+                         String("Cannot ") + verb + " roof when telescope is not parked and bypass not enabled", "");
+      break;
+    case COMMAND_REJECTED_RAIN:
+      sendAlpacaResponse(clientID, clientTransactionID, 1035,
+                         String("Cannot ") + verb + " roof during the rain re-open lockout", "");
+      break;
+    default:
+      sendAlpacaResponse(clientID, clientTransactionID, 1035,
+                         String("Failed to start ") + verb + "ing the roof (" + getRoofCommandOutcomeString(outcome) + ")", "");
+      break;
+  }
+}
+
 void handleOpenShutter() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
-  
-  // Check if we're already open
-  if (roofStatus == ROOF_OPEN) {
-    sendAlpacaResponse(clientID, clientTransactionID, 0, "Roof already open", "");
-    return;
-  }
-  
-  // Check if we're currently moving
-  if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Invalid operation, roof is currently moving", "");
-    return;
-  }
-  
-  // Check telescope safety interlock - only if bypass is not enabled
-  if (!bypassParkSensor && !telescopeParked) {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Cannot open roof when telescope is not parked and bypass not enabled", "");
-    return;
-  }
-  
-  // Start opening the roof
-  if (startOpeningRoof()) {
-    sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
-  } else {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Failed to start opening the roof", "");
-  }
+
+  // State and interlock checks are made by the command arbiter
+  RoofCommandOutcome outcome = runRoofCommand(CMD_OPEN, SOURCE_ALPACA);
+  sendShutterCommandResponse(clientID, clientTransactionID, outcome, "open");
 }
 
 void handleCloseShutter() {
   int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
   int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
-  
-  // Check if we're already closed
-  if (roofStatus == ROOF_CLOSED) {
-    sendAlpacaResponse(clientID, clientTransactionID, 0, "Roof already closed", "");
-    return;
-  }
-  
-  // Check if we're currently moving
-  if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Invalid operation, roof is currently moving", "");
-    return;
-  }
-  
-  // Check telescope safety interlock - only if bypass is not enabled
-  if (!bypassParkSensor && !telescopeParked) {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Cannot close roof when telescope is not parked and bypass not enabled", "");
-    return;
-  }
-  
-  // Start closing the roof
-  if (startClosingRoof()) {
-    sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
-  } else {
-    sendAlpacaResponse(clientID, clientTransactionID, 1035, "Failed to start closing the roof", "");
-  }
+
+  RoofCommandOutcome outcome = runRoofCommand(CMD_CLOSE, SOURCE_ALPACA);
+  sendShutterCommandResponse(clientID, clientTransactionID, outcome, "close");
 }
 
 void handleAbortSlew() {
@@ -681,14 +715,16 @@ void handleAbortSlew() {
   
   // If the roof is already fully open or closed, just return success
   // rather than an error message - conformance testing may expect this
-  if (roofStatus == ROOF_OPEN || roofStatus == ROOF_CLOSED) {
+  // (a sequence still powering the inverter up is aborted like a move)
+  RoofSnapshot snap = getRoofSnapshot();
+  if ((snap.status == ROOF_OPEN || snap.status == ROOF_CLOSED) && snap.opState == OP_IDLE) {
     sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
     return;
   }
   
   // The roof is moving - try to stop it
-  if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
-    if (stopRoofMovement()) {
+  if (snap.status == ROOF_OPENING || snap.status == ROOF_CLOSING) {
+    if (roofCommandSucceeded(runRoofCommand(CMD_STOP, SOURCE_ALPACA))) {
       sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
     } else {
       sendAlpacaResponse(clientID, clientTransactionID, 1035, "Failed to stop roof movement", "");
@@ -697,9 +733,88 @@ void handleAbortSlew() {
   }
   
   // For any other status (like ERROR), also try to stop
-  if (stopRoofMovement()) {
+  if (roofCommandSucceeded(runRoofCommand(CMD_STOP, SOURCE_ALPACA))) {
     sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
   } else {
     sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");  // Still return success for conformance testing
   }
-}
\ No newline at end of file
+}
+// SafetyMonitor device 0 (weather, lockout and roof error; see safety_monitor.h)
+void handleSafetyConnected() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  sendAlpacaResponse(clientID, clientTransactionID, 0, "", safetyMonitorConnected ? "true" : "false");
+}
+
+void handleSetSafetyConnected() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  if (!alpacaServer.hasArg("Connected")) {
+    sendAlpacaResponse(clientID, clientTransactionID, 1025, "Invalid value", "");
+    return;
+  }
+  safetyMonitorConnected = alpacaServer.arg("Connected").equalsIgnoreCase("true");
+
+  sendAlpacaResponse(clientID, clientTransactionID, 0, "", "");
+}
+
+void handleSafetyDescription() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  sendAlpacaResponse(clientID, clientTransactionID, 0, "",
+                     "Roll-off roof safety monitor (rain, snow, re-open lockout and roof error)");
+}
+
+void handleSafetyName() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  sendAlpacaResponse(clientID, clientTransactionID, 0, "", "Roll-Off Roof Safety Monitor");
+}
+
+void handleSafetySupportedActions() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  RequestJsonDocument doc(128);
+  JsonArray array = doc.to<JsonArray>();
+  array.add("reasons");  // Comma-separated unsafe reasons, empty when safe
+
+  sendAlpacaJsonValue(clientID, clientTransactionID, doc.as<JsonVariantConst>());
+}
+
+void handleSafetyAction() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  String actionName = alpacaServer.hasArg("Action") ? alpacaServer.arg("Action") : "";
+  if (actionName == "reasons") {
+    char reasons[128];
+    formatSafetyReasons(getSafetyReasons(), reasons, sizeof(reasons));
+    RequestJsonDocument doc(192);
+    doc.set(reasons);
+    sendAlpacaJsonValue(clientID, clientTransactionID, doc.as<JsonVariantConst>());
+  } else {
+    sendAlpacaResponse(clientID, clientTransactionID, 1036, "Action not implemented", "");
+  }
+}
+
+// Polled every few seconds by every automation client: one atomic load, no recompute
+void handleIsSafe() {
+  int clientID = alpacaServer.hasArg("ClientID") ? alpacaServer.arg("ClientID").toInt() : 0;
+  int clientTransactionID = alpacaServer.hasArg("ClientTransactionID") ? alpacaServer.arg("ClientTransactionID").toInt() : 0;
+
+  // ISafetyMonitor: a disconnected monitor reports unsafe
+  bool safe = safetyMonitorConnected && isConditionSafe();
+
+  RequestJsonDocument doc(192);
+  doc["ClientTransactionID"] = clientTransactionID;
+  doc["ServerTransactionID"] = serverTransactionID++;
+  doc["ErrorNumber"] = 0;
+  doc["ErrorMessage"] = "";
+  doc["Value"] = safe;
+  sendJsonResponse(alpacaServer, 200, doc);
+}
@@ -8,6 +8,7 @@
 
 #include <WebServer.h>
 #include <WiFiUdp.h>
+#include <ArduinoJson.h>
 #include "config.h"
 
 // External server instance
@@ -16,12 +17,15 @@ extern WiFiUDP udp;
 extern String uniqueID;
 extern unsigned int serverTransactionID;
 extern bool bypassParkSensor;  // Add bypass park sensor reference
+extern bool safetyMonitorConnected;
 
 // Function prototypes
 void setupAlpacaAPI();
+void startAlpacaMDNS();
 void handleAlpacaDiscovery();
 void setupAlpacaRoutes();
 void sendAlpacaResponse(int clientID, int clientTransactionID, int errorNumber, String errorMessage, String value = "");
+void sendAlpacaJsonValue(int clientID, int clientTransactionID, JsonVariantConst value);
 
 // Management API handlers
 void handleApiVersions();
@@ -71,4 +75,13 @@ void handleOpenShutter();
 void handleCloseShutter();
 void handleAbortSlew();
 
+// SafetyMonitor handlers (driverinfo, driverversion and interfaceversion are shared with the dome)
+void handleSafetyConnected();
+void handleSetSafetyConnected();
+void handleSafetyDescription();
+void handleSafetyName();
+void handleSafetySupportedActions();
+void handleSafetyAction();
+void handleIsSafe();
+
 #endif // ALPACA_HANDLER_H
\ No newline at end of file
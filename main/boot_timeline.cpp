@@ -0,0 +1,56 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Boot Timeline Implementation
+ */
+
+#include "boot_timeline.h"
+#include "Debug.h"
+
+// Written by setup() before the network task starts, then only by the network task
+static BootStageRecord bootStages[BOOT_STAGE_COUNT];
+
+static const char* const BOOT_STAGE_NAMES[BOOT_STAGE_COUNT] = {
+  "diagnostics",
+  "config",
+  "hardware",
+  "control_task",
+  "rtc",
+  "network_services",
+  "gps",
+  "wifi"
+};
+
+void beginBootStage(BootStage stage) {
+  if (stage >= BOOT_STAGE_COUNT || bootStages[stage].started) return;
+  bootStages[stage].started = true;
+  bootStages[stage].startUs = micros();
+}
+
+void endBootStage(BootStage stage) {
+  if (stage >= BOOT_STAGE_COUNT || bootStages[stage].finished) return;
+  uint32_t now = micros();
+  if (!bootStages[stage].started) {
+    bootStages[stage].started = true;
+    bootStages[stage].startUs = now;
+  }
+  bootStages[stage].finished = true;
+  bootStages[stage].endUs = now;
+  Debug.printf("Boot stage %s done at %lu us (%lu us)\n", BOOT_STAGE_NAMES[stage],
+               (unsigned long)now, (unsigned long)(now - bootStages[stage].startUs));
+}
+
+BootStageRecord getBootStageRecord(BootStage stage) {
+  if (stage >= BOOT_STAGE_COUNT) return BootStageRecord{false, false, 0, 0};
+  return bootStages[stage];
+}
+
+const char* getBootStageName(BootStage stage) {
+  return stage < BOOT_STAGE_COUNT ? BOOT_STAGE_NAMES[stage] : "unknown";
+}
+
+bool bootComplete() {
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    if (!bootStages[i].finished) return false;
+  }
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Boot Timeline Header
+ *
+ * Startup runs in stages: setup() brings up the safety-critical hardware and
+ * the control task, then the network task brings up WiFi and the services in
+ * the background. Each stage records when it started and finished (micros()
+ * since reset) so slow boots can be diagnosed from GET /api/boot.
+ */
+
+#ifndef BOOT_TIMELINE_H
+#define BOOT_TIMELINE_H
+
+#include <Arduino.h>
+
+enum BootStage {
+  BOOT_DIAGNOSTICS,       // Reset reason and reboot counter
+  BOOT_CONFIG,            // Preferences loaded
+  BOOT_HARDWARE,          // Relays, limit switches, sensors, position estimate
+  BOOT_CONTROL_TASK,      // Roof control task running - safety inputs are live
+  BOOT_RTC,               // DS3231 probed (network task)
+  BOOT_NETWORK_SERVICES,  // UDP park sensor, MQTT, Alpaca, web UI (network task)
+  BOOT_GPS,               // GPS and NTP server (network task)
+  BOOT_WIFI,              // Station connected, or fell back to AP mode
+  BOOT_STAGE_COUNT
+};
+
+struct BootStageRecord {
+  bool started;
+  bool finished;
+  uint32_t startUs;
+  uint32_t endUs;
+};
+
+void beginBootStage(BootStage stage);
+void endBootStage(BootStage stage);           // Only the first call for a stage counts
+BootStageRecord getBootStageRecord(BootStage stage);
+const char* getBootStageName(BootStage stage);
+bool bootComplete();                          // All stages finished
+
+#endif // BOOT_TIMELINE_H
@@ -32,12 +32,15 @@ const int INVERTER_BUTTON_PIN = 6;          // K3: Inverter soft-power button re
 const int INVERTER_AC_POWER_PIN = 7;        // AC power state detection via optocoupler (NEW in v3)
 const int TELESCOPE_PARKED_PIN = 42;        // Safety interlock on telescope park position
 const int RAIN_SENSOR_PIN = 37;             // RG9 Rain sensor input
+const int RAIN_SENSOR_ACTIVE = LOW;          // RG9 output closes to ground when rain is detected (pulled up)
 
 // Snow Sensor Pins (NEW in v3)
 const int SNOW_SENSOR_DIGITAL_PIN = 38;     // 12V Snow sensor digital input
+const int SNOW_SENSOR_ACTIVE = HIGH;         // Level-shifted 12V output is high when snow is detected
 const int SNOW_SENSOR_RS485_RO = 41;        // RS485 RO (Receiver Output)
 const int SNOW_SENSOR_RS485_RE_DE = 39;     // RS485 RE/DE (Receiver Enable / Driver Enable)
 const int SNOW_SENSOR_RS485_DI = 40;        // RS485 DI (Driver Input)
+const uint8_t SNOW_SENSOR_UART = 2;         // UART2 (UART1 is the GPS)
 
 // GPS Module Pins - configurable via WebUI
 extern int gpsTxPin;                        // GPS TX -> ESP32 RX (receives GPS data)
@@ -62,6 +65,17 @@ extern int LIMIT_SWITCH_CLOSED_PIN;         // Limit switch at roof closed posit
 const int DEFAULT_OPEN_SWITCH_PIN = 35;
 const int DEFAULT_CLOSED_SWITCH_PIN = 36;
 
+// Optional quadrature encoder on the roof drive (read by the PCNT peripheral) - configurable via WebUI
+extern int ENCODER_PIN_A;                   // Encoder channel A (-1 = no encoder)
+extern int ENCODER_PIN_B;                   // Encoder channel B (-1 = no encoder)
+extern long encoderCountsPerTravel;         // Counts from closed to open, signed (0 = learn on the next full open)
+const int DEFAULT_ENCODER_PIN_A = -1;       // Default: no encoder fitted
+const int DEFAULT_ENCODER_PIN_B = -1;
+
+// Optional motor current sensor on the opener supply (sampled by the ADC in continuous mode) - configurable via WebUI
+extern int MOTOR_CURRENT_PIN;               // Current sense output, ADC1 only: GPIO1-10 (-1 = no sensor)
+const int DEFAULT_MOTOR_CURRENT_PIN = -1;   // Default: no sensor fitted
+
 // Pin States
 extern int TRIGGERED;                   // Define whether pin is HIGH or LOW when limit switch is triggered
 extern int TELESCOPE_PARKED;            // Define whether pin is HIGH or LOW when telescope is parked
@@ -71,6 +85,17 @@ const int DEFAULT_PARK_STATE = LOW;     // Default park sensor state (LOW = norm
 // Timing Settings
 const uint32_t DEBOUNCE_DELAY = 100;        // Debounce delay in ms
 const unsigned long SWITCH_STABLE_TIME = 500; // Time in ms a switch must be stable
+const unsigned long RELAY_PRESS_MS = 500;     // How long K2/K3 hold a button pressed
+const unsigned long RELAY_SETTLE_MS = 100;    // Pause after releasing K3 before the next step
+const unsigned long SHUTDOWN_AC_CHECK_MS = 1000; // Wait after K1 off before checking AC power
+
+// Input sampler (every digital input debounced together on an esp_timer)
+const uint32_t INPUT_SAMPLE_PERIOD_US = 1000;   // Sample rate of all inputs
+const uint8_t INPUT_COUNTER_BITS = 12;          // Vertical counter depth: stable times up to 4095 samples
+const uint32_t INPUT_EVENT_QUEUE_SIZE = 32;     // Stable-state changes buffered for the control task (power of 2)
+const uint32_t INPUT_BURST_QUEUE_SIZE = 16;     // Bounce records buffered for the switch health monitor (power of 2)
+const unsigned long RAIN_SENSOR_STABLE_TIME = 2000; // Rain output must hold this long (ms)
+const unsigned long SNOW_SENSOR_STABLE_TIME = 2000; // Snow output must hold this long (ms)
 extern unsigned long movementTimeout;        // Roof movement timeout in ms (configurable)
 const unsigned long DEFAULT_MOVEMENT_TIMEOUT = 90000; // Default: 90 seconds
 extern bool movementTimeoutEnabled;          // Enable/disable movement timeout monitoring (configurable)
@@ -80,15 +105,134 @@ const unsigned long DEFAULT_LIMIT_SWITCH_TIMEOUT = 5000; // Default: 5 seconds
 extern bool limitSwitchTimeoutEnabled;       // Enable/disable limit switch timeout monitoring (configurable)
 const bool DEFAULT_LIMIT_SWITCH_TIMEOUT_ENABLED = true; // Default: enabled
 
+// Movement telemetry and adaptive timeouts
+const uint8_t MOVE_HISTORY_SIZE = 32;            // Moves kept in the NVS history ring
+const uint8_t ADAPTIVE_MIN_SAMPLES = 5;          // Completed moves per direction before timeouts adapt
+const unsigned long ADAPTIVE_TRAVEL_MARGIN_PERCENT = 25;  // Movement timeout = p99 travel + margin
+const unsigned long ADAPTIVE_TRAVEL_MIN_MARGIN = 5000;    // ...but at least this many ms
+const unsigned long ADAPTIVE_LIMIT_MARGIN_PERCENT = 50;   // Limit switch timeout = p99 release + margin
+const unsigned long ADAPTIVE_LIMIT_MIN_MARGIN = 1000;     // ...but at least this many ms
+
+// Limit switch health (bounce and chatter trending, /api/switch_health)
+const uint16_t SWITCH_HEALTH_EPOCH_TRANSITIONS = 50;   // Transitions per switch in one trend epoch
+const uint8_t SWITCH_HEALTH_EPOCHS = 8;                // Epochs kept per switch (the rolling window)
+const uint16_t SWITCH_HEALTH_MIN_TRANSITIONS = 10;     // Current epoch size before bounce growth is judged
+const unsigned long SWITCH_HEALTH_SAVE_INTERVAL_MS = 1800000; // Coalesce NVS writes between epoch ends (30 min)
+const uint32_t SWITCH_CHATTER_ALERT_MIN_BOUNCES = 3;   // Mean bounces per transition before growth can alert...
+const uint32_t SWITCH_CHATTER_ALERT_RATIO = 2;         // ...and it must be this many times the older epochs' mean
+const unsigned long SWITCH_BURST_ALERT_PERCENT = 50;   // A bounce burst this long (percent of the stable time) alerts
+const uint16_t SWITCH_GLITCH_ALERT_COUNT = 3;          // Glitches (chatter without a transition) per epoch that alert
+
+// Roof position estimate (dead reckoning from the travel history)
+const unsigned long DEFAULT_POSITION_PUBLISH_INTERVAL = 200; // MQTT position rate while moving (ms, 0 = on arrival only)
+const unsigned long STALL_WARNING_MARGIN_PERCENT = 15;   // Warn when a move runs this far past its profile
+const unsigned long STALL_WARNING_MIN_MARGIN = 2000;     // ...or at least this many ms past it
+
+// Roof encoder (absolute position, velocity, stall detection and part-open targets)
+const int ENCODER_PCNT_LIMIT = 16384;                  // PCNT counts before the driver folds the count into its accumulator
+const uint32_t ENCODER_GLITCH_FILTER_NS = 1000;        // Pulses shorter than this are ignored by the PCNT filter
+const unsigned long ENCODER_VELOCITY_SAMPLE_MS = 50;   // Count sampled this often for the velocity...
+const uint8_t ENCODER_VELOCITY_SAMPLES = 8;            // ...over a window of this many samples
+const long ENCODER_MIN_SPAN = 100;                     // A learned closed-to-open span smaller than this is rejected
+const long ENCODER_MOTION_COUNTS = 4;                  // Counts that make up real motion (not vibration on one edge)
+const unsigned long ENCODER_STALL_MS = 300;            // A moving roof with no motion for this long has stalled
+const unsigned long ENCODER_START_MS = 2000;           // K2 press to the first motion before a move counts as stalled
+const int ENCODER_TARGET_TOLERANCE = 2;                // Percent: a part-open target this close counts as reached
+
+// Motor current (RMS, inrush profile and the learned obstruction envelope, /api/current)
+const uint32_t MOTOR_CURRENT_SAMPLE_HZ = 4000;         // ADC continuous-mode conversion rate
+const uint32_t MOTOR_CURRENT_FRAME_SAMPLES = 64;       // Conversions per DMA frame (16 ms)
+const uint32_t MOTOR_CURRENT_POOL_FRAMES = 8;          // Frames the driver pool holds between control steps
+const uint16_t MOTOR_CURRENT_RMS_SAMPLES = 160;        // RMS window: 40 ms, two 50 Hz mains cycles
+const uint8_t MOTOR_CURRENT_ZERO_SHIFT = 12;           // Idle zero-offset filter: EWMA weight 1/4096 per sample (~1 s)
+const unsigned long MOTOR_CURRENT_INRUSH_MS = 750;     // Start of a run counted as inrush in the profile
+const unsigned long MOTOR_CURRENT_BIN_MS = 250;        // Profile / envelope resolution
+const uint8_t MOTOR_CURRENT_BINS = 160;                // Bins per run (40 s); a longer run folds into the last bin
+const uint8_t MOTOR_CURRENT_PROFILES = 8;              // Per-move profiles kept in RAM
+const uint8_t MOTOR_CURRENT_MIN_MOVES = 3;             // Completed moves per direction before the envelope trips
+const uint8_t MOTOR_CURRENT_ENVELOPE_DECAY = 8;        // A quieter move pulls the envelope 1/8 of the way down
+const uint16_t MOTOR_CURRENT_MARGIN_PERCENT = 30;      // Trip above the envelope plus this margin...
+const uint16_t MOTOR_CURRENT_MARGIN_COUNTS = 40;       // ...plus this floor (ADC counts, covers noise at low current)
+const unsigned long MOTOR_CURRENT_TRIP_MS = 100;       // RMS must stay over the envelope this long to trip
+
+// Control / network task split
+const int CONTROL_TASK_CORE = 1;                 // Roof, relay and sensor logic
+const int NETWORK_TASK_CORE = 0;                 // WiFi, Alpaca, MQTT, web, GPS, NTP (same core as the WiFi stack)
+const unsigned int CONTROL_TASK_PRIORITY = 10;   // Above the network task and the Arduino loop task
+const unsigned int NETWORK_TASK_PRIORITY = 1;
+const uint32_t CONTROL_TASK_STACK = 8192;
+const uint32_t NETWORK_TASK_STACK = 16384;
+const unsigned long CONTROL_TASK_PERIOD_MS = 5;  // Control step period
+const uint32_t ROOF_COMMAND_QUEUE_SIZE = 8;      // Network -> control commands (power of 2)
+const uint32_t ROOF_EVENT_QUEUE_SIZE = 32;       // Control -> network events (power of 2)
+const unsigned long ROOF_COMMAND_TIMEOUT_MS = 250; // Network side wait for a command result
+const uint32_t ABORT_LATENCY_BOUND_US = 20000;   // STOP request to relay edge, worst case allowed
+const uint8_t ROOF_COMMAND_LOG_SIZE = 16;       // Recent commands kept for /api/commands
+const size_t ROOF_ERROR_REASON_SIZE = 256;       // Buffer for a formatted roof error message
+
+// Loop profiler (per-subsystem cycle-time histograms, /api/perf)
+const uint8_t PERF_HISTOGRAM_BUCKETS = 20;      // Bucket i holds samples in [2^(i-1), 2^i) us; the last is open-ended
+const uint8_t PERF_WORST_COUNT = 3;             // Slowest samples kept per section, with their uptime
+const unsigned long PERF_MQTT_PUBLISH_INTERVAL = 60000; // Profile summary publish rate when enabled (ms)
+
+// Per-request scratch arena for HTTP handlers (JSON documents and response text)
+const size_t REQUEST_ARENA_SIZE = 32768;        // Largest request (/api/perf) needs ~26 KB
+const uint8_t REQUEST_ARENA_HEAP_BLOCKS = 8;    // Heap fallbacks one request may hold at once
+
 // Inverter Timing Settings (NEW in v3)
 extern unsigned long inverterDelay1;         // Delay between K1 relay and K3 soft-power button (ms)
 extern unsigned long inverterDelay2;         // Delay between inverter power-on and K2 roof button (ms)
 const unsigned long DEFAULT_INVERTER_DELAY1 = 750;   // Default: 750ms
 const unsigned long DEFAULT_INVERTER_DELAY2 = 1500;  // Default: 1500ms
+extern bool inverterAcSequencing;            // Advance to K2 as soon as AC power is stable (delays become upper bounds)
+extern unsigned long inverterKeepWarmMinutes; // Leave the inverter on this long after a move (0 = shut down at once)
+const unsigned long MAX_INVERTER_KEEP_WARM_MINUTES = 60;
+extern unsigned long inverterPrewarmMinutes; // Pre-warm window: inverter held ready this long for an open (0 = off)
+extern bool inverterPrewarmOnConnect;        // Pre-warm when an Alpaca client connects
+const unsigned long MAX_INVERTER_PREWARM_MINUTES = 60;
 
 // Safety Settings
 extern bool bypassParkSensor;           // Software bypass state for telescope park sensors
 
+// Rain auto-close (RG9 trip closes the roof from the control task, no network hop)
+extern bool rainAutoCloseEnabled;            // Close on rain and lock out re-opening
+extern unsigned long rainHoldoffMs;          // Rain must persist this long past the debounce before closing (ms)
+extern unsigned long rainReopenLockoutMs;    // Open refused until the sensor has been dry this long (ms)
+const unsigned long DEFAULT_RAIN_HOLDOFF = 0;
+const unsigned long DEFAULT_RAIN_REOPEN_LOCKOUT = 1800000; // Default: 30 minutes
+const unsigned long MAX_RAIN_HOLDOFF = 600000;             // 10 minutes
+const unsigned long MAX_RAIN_REOPEN_LOCKOUT = 86400000;    // 24 hours
+const uint8_t RAIN_TRIP_LOG_SIZE = 8;                      // Recent trips kept for /api/rain
+const unsigned long RAIN_REVERSE_SETTLE_MS = 1000;         // Gap between stopping an opening roof and the close press
+
+// Warm-restart resume (RTC snapshot of the roof operation, mirrored to NVS)
+const unsigned long RESUME_RTC_REFRESH_MS = 100;           // Elapsed-time refresh of the RTC copy while moving
+const unsigned long RESUME_NVS_COALESCE_MS = 500;          // Changes inside this window reach NVS as one write
+const unsigned long RESUME_REVERSE_SETTLE_MS = RAIN_REVERSE_SETTLE_MS;  // Stop-to-press gap when reversing a resumed opener
+const int RESUME_REVERSE_MIN_PERCENT = 5;                  // No reversing resume this close to the departure end
+
+// Trace recorder (/api/trace, replayed by sim/roof_replay)
+const uint32_t TRACE_RING_ENTRIES = 2048;                  // 8 bytes each (power of 2)
+const unsigned long TRACE_SYNC_INTERVAL_MS = 600000;       // Full-state sync entry at least this often (< micros() wrap)
+const uint32_t TRACE_DOWNLOAD_CHUNK = 64;                  // Entries per sendContent() in /api/trace
+
+// RS485 snow sensor (Modbus RTU master on UART2, polled from the control task)
+extern bool snowModbusEnabled;               // Poll the RS485 snow sensor
+extern bool snowAutoCloseEnabled;            // Snow from the RS485 sensor trips the rain auto-close
+const unsigned long SNOW_MODBUS_BAUD = 9600;
+const uint8_t SNOW_MODBUS_ADDRESS = 1;                     // Slave address
+const uint8_t SNOW_MODBUS_FUNCTION = 0x03;                 // Read holding registers
+const uint16_t SNOW_MODBUS_START_REGISTER = 0;
+const uint8_t SNOW_MODBUS_REGISTER_COUNT = 2;              // Snow state, then the sensor's raw reading
+const uint8_t SNOW_MODBUS_STATE_INDEX = 0;                 // Register that is non-zero while snow is detected
+const uint8_t SNOW_MODBUS_VALUE_INDEX = 1;                 // Raw sensor reading, reported as-is
+const unsigned long SNOW_MODBUS_POLL_MS = 1000;            // Request interval
+const unsigned long SNOW_MODBUS_STALE_MS = 5000;           // No good reply for this long = offline
+const uint8_t SNOW_MODBUS_CONFIRM_READS = 3;               // Agreeing reads before the snow state changes
+const unsigned long MODBUS_RESPONSE_TIMEOUT_MS = 100;      // First byte to frame end must fit in here after TX
+const uint8_t MODBUS_RX_TIMEOUT_SYMBOLS = 4;               // UART idle (character times) that ends a reply frame
+const uint8_t MODBUS_MAX_REGISTERS = 16;                   // Largest read the master accepts
+
 // GPS and RTC Settings
 extern bool gpsEnabled;                 // Enable/disable GPS module
 extern bool gpsNtpEnabled;              // Enable/disable NTP server functionality
@@ -146,6 +290,17 @@ inline const char* ALPACA_DISCOVERY_MESSAGE = "alpacadiscovery1";
 #define PREF_TIMEOUT_ENABLED "timeoutEnabled"
 #define PREF_LIMIT_SWITCH_TIMEOUT "limitSwitchTimeout"
 #define PREF_LIMIT_SWITCH_TIMEOUT_ENABLED "limitSwitchTimeoutEn"
+#define PREF_ADAPTIVE_TIMEOUTS "adaptiveTimeout"
+#define PREF_MOVE_HISTORY "moveHistory"
+#define PREF_RESUME_SNAPSHOT "resumeSnap"
+#define PREF_SWITCH_HEALTH "swHealth"
+#define PREF_POSITION_INTERVAL "posInterval"
+#define PREF_ENCODER_PIN_A "encPinA"
+#define PREF_ENCODER_PIN_B "encPinB"
+#define PREF_ENCODER_SPAN "encSpan"
+#define PREF_MOTOR_CURRENT_PIN "curPin"
+#define PREF_MOTOR_CURRENT_ENVELOPE "curEnvelope"
+#define PREF_PERF_MQTT "perfMqtt"
 #define PREF_WIFI_SSID "ssid"
 #define PREF_WIFI_PASSWORD "wifiPassword"
 #define PREF_MQTT_SERVER "mqttServer"
@@ -159,6 +314,15 @@ inline const char* ALPACA_DISCOVERY_MESSAGE = "alpacadiscovery1";
 #define PREF_INVERTER_SOFTPWR_ENABLED "inverterSoftEn"
 #define PREF_INVERTER_DELAY1 "inverterDelay1"
 #define PREF_INVERTER_DELAY2 "inverterDelay2"
+#define PREF_INVERTER_AC_SEQUENCING "invAcSeq"
+#define PREF_INVERTER_KEEP_WARM "invKeepWarm"
+#define PREF_INVERTER_PREWARM "invPrewarm"
+#define PREF_PREWARM_ON_CONNECT "prewarmConn"
+#define PREF_RAIN_AUTO_CLOSE "rainClose"
+#define PREF_RAIN_HOLDOFF "rainHoldoff"
+#define PREF_RAIN_LOCKOUT "rainLockout"
+#define PREF_SNOW_MODBUS "snowModbus"
+#define PREF_SNOW_AUTO_CLOSE "snowClose"
 
 // GPS and RTC Configuration
 #define PREF_GPS_ENABLED "gpsEnabled"
@@ -0,0 +1,657 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Control / Network Link Implementation
+ */
+
+#include "control_link.h"
+#include "control_task.h"
+#include "relay_pulse.h"
+#include "roof_telemetry.h"
+#include "roof_position.h"
+#include "roof_resume.h"
+#include "roof_trace.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
+#include "mqtt_handler.h"
+#include "spsc_queue.h"
+#include "perf_profiler.h"
+#include "Debug.h"
+#include <Arduino.h>
+#include <atomic>
+#include <string.h>
+
+static SpscQueue<RoofCommand, ROOF_COMMAND_QUEUE_SIZE> commandQueue;   // Network -> control
+static SpscQueue<RoofEvent, ROOF_EVENT_QUEUE_SIZE> eventQueue;         // Control -> network
+static std::atomic<bool> eventsDropped(false);  // Event queue overflowed; resync status on next drain
+static std::atomic<uint32_t> abortStopId(0);    // STOP waiting in the abort slot (bypasses the queue)
+static std::atomic<uint8_t> abortStopSource(SOURCE_INTERNAL);
+
+// Seqlock: odd sequence while the control task is writing the snapshot
+static RoofSnapshot snapshot;
+static std::atomic<uint32_t> snapshotSeq(0);
+
+// Network side bookkeeping (network task only)
+static uint32_t nextCommandId = 1;
+static CommandSourceStats sourceStats[SOURCE_COUNT];
+static RoofCommandLogEntry commandLog[ROOF_COMMAND_LOG_SIZE];
+static uint8_t commandLogHead = 0;   // Next slot to write
+static uint8_t commandLogCount = 0;
+static AbortLatencyStats abortStats;
+
+// Control side bookkeeping (control task only)
+static uint32_t relayWatchId = 0;    // Accepted command waiting for its first relay edge
+static uint32_t relayWatchDispatchUs = 0;
+static uint32_t abortFenceId = 0;    // Last STOP taken from the abort slot; queued moves before it are void
+
+// ========== NETWORK SIDE ==========
+
+static RoofCommandLogEntry* findLogEntry(uint32_t id) {
+  for (uint8_t i = 0; i < commandLogCount; i++) {
+    RoofCommandLogEntry& entry = commandLog[(commandLogHead + ROOF_COMMAND_LOG_SIZE - 1 - i) % ROOF_COMMAND_LOG_SIZE];
+    if (entry.id == id) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+static void addLatency(LatencyStats& stats, uint32_t us) {
+  stats.samples++;
+  stats.lastUs = us;
+  stats.totalUs += us;
+  if (us > stats.maxUs) stats.maxUs = us;
+}
+
+// Movement and stop commands are idempotent while queued; manual presses are not
+static bool isCoalescable(RoofCommandType type) {
+  return type == CMD_OPEN || type == CMD_CLOSE || type == CMD_STOP;
+}
+
+uint32_t queueRoofCommand(RoofCommandType type, CommandSource source, uint8_t arg) {
+  CommandSourceStats& stats = sourceStats[source < SOURCE_COUNT ? source : SOURCE_INTERNAL];
+  stats.commands++;
+
+  // A repeat of a command still waiting for dispatch rides on the first one
+  if (isCoalescable(type)) {
+    for (uint8_t i = 0; i < commandLogCount; i++) {
+      const RoofCommandLogEntry& entry = commandLog[(commandLogHead + ROOF_COMMAND_LOG_SIZE - 1 - i) % ROOF_COMMAND_LOG_SIZE];
+      if (entry.type == type && entry.outcome == COMMAND_PENDING &&
+          millis() - entry.enqueueMs < ROOF_COMMAND_TIMEOUT_MS) {
+        stats.coalesced++;
+        return entry.id;
+      }
+    }
+  }
+
+  RoofCommand cmd;
+  cmd.id = nextCommandId++;
+  if (nextCommandId == 0) nextCommandId = 1;
+  cmd.type = type;
+  cmd.source = source < SOURCE_COUNT ? source : SOURCE_INTERNAL;
+  cmd.arg = arg;
+
+  RoofCommandLogEntry& entry = commandLog[commandLogHead];
+  entry.id = cmd.id;
+  entry.type = type;
+  entry.source = source;
+  entry.arg = arg;
+  entry.outcome = COMMAND_PENDING;
+  entry.enqueueMs = millis();
+  entry.enqueueUs = micros();
+  entry.queueUs = COMMAND_LATENCY_UNSET;
+  entry.relayUs = COMMAND_LATENCY_UNSET;
+
+  if (type == CMD_STOP) {
+    // STOP skips the queue: the control task is woken for it at once and
+    // takes it before any queued work, so nothing queued can delay it
+    abortStopSource.store(cmd.source, std::memory_order_relaxed);
+    abortStopId.store(cmd.id, std::memory_order_release);
+    wakeControlTask();
+  } else if (!commandQueue.push(cmd)) {
+    Debug.printf("Roof command queue full - dropped %s from %s\n",
+                 getRoofCommandTypeString(type), getCommandSourceString(source));
+    stats.rejected++;
+    return 0;
+  }
+
+  commandLogHead = (commandLogHead + 1) % ROOF_COMMAND_LOG_SIZE;
+  if (commandLogCount < ROOF_COMMAND_LOG_SIZE) commandLogCount++;
+  return cmd.id;
+}
+
+// Queue a command and wait for the control task to arbitrate it
+RoofCommandOutcome runRoofCommand(RoofCommandType type, CommandSource source, unsigned long timeoutMs,
+                                  uint8_t arg) {
+  uint32_t id = queueRoofCommand(type, source, arg);
+  if (id == 0) {
+    return COMMAND_BUSY;
+  }
+
+  unsigned long start = millis();
+  RoofCommandOutcome outcome = COMMAND_PENDING;
+  while (millis() - start < timeoutMs) {
+    processControlEvents();
+    if (roofCommandFinished(id, outcome)) {
+      return outcome;
+    }
+    delay(1);
+  }
+
+  Debug.printf("Roof command %s timed out waiting for the control task\n", getRoofCommandTypeString(type));
+  return COMMAND_TIMED_OUT;
+}
+
+bool roofCommandSucceeded(RoofCommandOutcome outcome) {
+  return outcome == COMMAND_ACCEPTED || outcome == COMMAND_COALESCED || outcome == COMMAND_ALREADY_DONE;
+}
+
+bool roofCommandFinished(uint32_t id, RoofCommandOutcome& outcome) {
+  const RoofCommandLogEntry* entry = findLogEntry(id);
+  if (entry == nullptr || entry->outcome == COMMAND_PENDING) {
+    return false;
+  }
+  outcome = entry->outcome;
+  return true;
+}
+
+static void recordCommandDone(const RoofEvent& event) {
+  RoofCommandLogEntry* entry = findLogEntry(event.id);
+  if (entry == nullptr) {
+    return;  // Already rotated out of the log
+  }
+
+  entry->outcome = (RoofCommandOutcome)event.value;
+  entry->queueUs = event.timeUs - entry->enqueueUs;
+
+  CommandSourceStats& stats = sourceStats[entry->source];
+  addLatency(stats.queue, entry->queueUs);
+  switch (entry->outcome) {
+    case COMMAND_COALESCED:         stats.coalesced++; break;
+    case COMMAND_PREEMPTED:         stats.preempted++; break;
+    case COMMAND_REJECTED_MOVING:
+    case COMMAND_REJECTED_UNPARKED:
+    case COMMAND_REJECTED_RAIN:
+    case COMMAND_BUSY:
+    case COMMAND_FAILED:            stats.rejected++; break;
+    default:                        break;
+  }
+}
+
+static void recordCommandRelay(const RoofEvent& event) {
+  RoofCommandLogEntry* entry = findLogEntry(event.id);
+  if (entry == nullptr || entry->relayUs != COMMAND_LATENCY_UNSET) {
+    return;
+  }
+
+  entry->relayUs = (uint32_t)event.value;
+  addLatency(sourceStats[entry->source].relay, entry->relayUs);
+
+  // Abort latency runs from the request (parsed just before it was queued)
+  // to the relay edge, across the wake-up and anything the control task was doing
+  if (entry->type == CMD_STOP) {
+    uint32_t abortUs = event.timeUs - entry->enqueueUs;
+    addLatency(abortStats.latency, abortUs);
+    if (abortUs > ABORT_LATENCY_BOUND_US) {
+      abortStats.overBound++;
+      Debug.printf("Abort took %lu us from request to relay (bound %lu us)\n",
+                   (unsigned long)abortUs, (unsigned long)ABORT_LATENCY_BOUND_US);
+    }
+  }
+}
+
+void processControlEvents() {
+  bool publishStatus = eventsDropped.exchange(false);
+  int position = -1;
+
+  RoofEvent event;
+  while (eventQueue.pop(event)) {
+    switch (event.type) {
+      case EVT_COMMAND_DONE:
+        recordCommandDone(event);
+        break;
+      case EVT_COMMAND_RELAY:
+        recordCommandRelay(event);
+        break;
+      case EVT_PUBLISH_STATUS:
+        publishStatus = true;
+        break;
+      case EVT_PUBLISH_POSITION:
+        position = event.value;  // Only the latest position matters
+        break;
+    }
+  }
+
+  if (position >= 0) {
+    publishPositionToMQTT(position);
+  }
+  if (publishStatus) {
+    publishStatusToMQTT();
+  }
+}
+
+const CommandSourceStats& getCommandSourceStats(CommandSource source) {
+  return sourceStats[source < SOURCE_COUNT ? source : SOURCE_INTERNAL];
+}
+
+const AbortLatencyStats& getAbortLatencyStats() {
+  return abortStats;
+}
+
+uint8_t getRoofCommandLogCount() {
+  return commandLogCount;
+}
+
+const RoofCommandLogEntry& getRoofCommandLogEntry(uint8_t index) {
+  return commandLog[(commandLogHead + ROOF_COMMAND_LOG_SIZE - 1 - index) % ROOF_COMMAND_LOG_SIZE];
+}
+
+const char* getRoofCommandTypeString(RoofCommandType type) {
+  switch (type) {
+    case CMD_OPEN:               return "open";
+    case CMD_CLOSE:              return "close";
+    case CMD_STOP:               return "stop";
+    case CMD_ROOF_BUTTON:        return "roof_button";
+    case CMD_INVERTER_BUTTON:    return "inverter_button";
+    case CMD_INVERTER_TOGGLE:    return "inverter_toggle";
+    case CMD_CLEAR_ERROR:        return "clear_error";
+    case CMD_APPLY_PINS:         return "apply_pins";
+    case CMD_CLEAR_MOVE_HISTORY: return "clear_move_history";
+    case CMD_PREWARM:            return "prewarm";
+    case CMD_MOVE_TO:            return "move_to";
+    case CMD_CLEAR_CURRENT_ENVELOPE: return "clear_current_envelope";
+    case CMD_RESET_ENCODER_SPAN: return "reset_encoder_span";
+  }
+  return "unknown";
+}
+
+const char* getCommandSourceString(CommandSource source) {
+  switch (source) {
+    case SOURCE_ALPACA:   return "alpaca";
+    case SOURCE_MQTT:     return "mqtt";
+    case SOURCE_WEB:      return "web";
+    case SOURCE_INTERNAL: return "internal";
+    default:              return "unknown";
+  }
+}
+
+uint32_t setAlpacaConnected(bool connected) {
+  // isConnected starts true, so waiting for a false-to-true change would skip
+  // the first connect after boot; a repeat just extends an open window
+  isConnected = connected;
+  if (connected && inverterPrewarmOnConnect && inverterPrewarmMinutes > 0) {
+    return queueRoofCommand(CMD_PREWARM, SOURCE_ALPACA);
+  }
+  return 0;
+}
+
+bool parseRoofTargetPercent(const char* text, uint8_t& percent) {
+  // toInt() turns junk into 0, which MOVE_TO takes as a full close
+  if (text == nullptr || *text == '\0') {
+    return false;
+  }
+  unsigned value = 0;
+  for (const char* p = text; *p; p++) {
+    if (*p < '0' || *p > '9' || p - text >= 3) {
+      return false;
+    }
+    value = value * 10 + (*p - '0');
+  }
+  if (value > 100) {
+    return false;
+  }
+  percent = (uint8_t)value;
+  return true;
+}
+
+const char* getRoofCommandOutcomeString(RoofCommandOutcome outcome) {
+  switch (outcome) {
+    case COMMAND_PENDING:           return "pending";
+    case COMMAND_ACCEPTED:          return "accepted";
+    case COMMAND_COALESCED:         return "coalesced";
+    case COMMAND_ALREADY_DONE:      return "already_done";
+    case COMMAND_PREEMPTED:         return "preempted";
+    case COMMAND_REJECTED_MOVING:   return "rejected_moving";
+    case COMMAND_REJECTED_UNPARKED: return "rejected_unparked";
+    case COMMAND_REJECTED_RAIN:     return "rejected_rain";
+    case COMMAND_BUSY:              return "busy";
+    case COMMAND_FAILED:            return "failed";
+    case COMMAND_TIMED_OUT:         return "timed_out";
+  }
+  return "unknown";
+}
+
+RoofSnapshot getRoofSnapshot() {
+  RoofSnapshot copy;
+  while (true) {
+    uint32_t before = snapshotSeq.load(std::memory_order_acquire);
+    if ((before & 1) == 0) {
+      memcpy(&copy, &snapshot, sizeof(copy));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (snapshotSeq.load(std::memory_order_relaxed) == before) {
+        return copy;
+      }
+    }
+    // Control task is mid-update; it finishes within microseconds
+  }
+}
+
+// ========== CONTROL SIDE ==========
+
+static void postEvent(const RoofEvent& event) {
+  if (!eventQueue.push(event)) {
+    eventsDropped.store(true);
+  }
+}
+
+void requestStatusPublish() {
+  RoofEvent event = {EVT_PUBLISH_STATUS, 0, 0, 0};
+  postEvent(event);
+}
+
+void requestPositionPublish(int position) {
+  RoofEvent event = {EVT_PUBLISH_POSITION, 0, position, 0};
+  postEvent(event);
+}
+
+static bool isMovementCommand(RoofCommandType type) {
+  return type == CMD_OPEN || type == CMD_CLOSE || type == CMD_ROOF_BUTTON || type == CMD_MOVE_TO;
+}
+
+static bool drivesRelays(RoofCommandType type) {
+  return isMovementCommand(type) || type == CMD_STOP || type == CMD_INVERTER_BUTTON || type == CMD_INVERTER_TOGGLE ||
+         type == CMD_PREWARM;
+}
+
+static bool parkInterlockBlocks() {
+  return !bypassParkSensor && !telescopeParked;
+}
+
+// The single place where open/close requests are checked, whichever client sent them
+static RoofCommandOutcome arbitrateMove(RoofOperationTarget target) {
+  bool opening = (target == TARGET_OPEN);
+  RoofStatus done = opening ? ROOF_OPEN : ROOF_CLOSED;
+  RoofStatus moving = opening ? ROOF_OPENING : ROOF_CLOSING;
+
+  if ((roofOpState != OP_IDLE && roofOpTarget == target) || roofStatus == moving) {
+    return COMMAND_COALESCED;  // Pressing K2 again would stop the roof
+  }
+  if (roofStatus == done && !(opening && isRoofHeldPartOpen())) {
+    return COMMAND_ALREADY_DONE;
+  }
+  // A pre-warm power-up is not a move: the open or close takes it over
+  bool sequenceBusy = roofOpState != OP_IDLE && !isInverterPrewarmRunning();
+  if (sequenceBusy || roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
+    return COMMAND_REJECTED_MOVING;
+  }
+  if (parkInterlockBlocks()) {
+    return COMMAND_REJECTED_UNPARKED;
+  }
+  if (opening && rainReopenLocked()) {
+    noteRainLockoutReject();
+    return COMMAND_REJECTED_RAIN;
+  }
+
+  bool started = opening ? startOpeningRoof() : startClosingRoof();
+  return started ? COMMAND_ACCEPTED : COMMAND_FAILED;
+}
+
+// Part-open moves: the ends are plain opens and closes, the rest needs the encoder
+static RoofCommandOutcome arbitrateMoveTo(uint8_t percent) {
+  if (percent == 0) {
+    return arbitrateMove(TARGET_CLOSE);
+  }
+  if (percent >= 100) {
+    return arbitrateMove(TARGET_OPEN);
+  }
+  if (!isRoofEncoderCalibrated() || roofStatus == ROOF_ERROR) {
+    return COMMAND_FAILED;
+  }
+
+  bool sequenceBusy = roofOpState != OP_IDLE && !isInverterPrewarmRunning();
+  if (sequenceBusy || roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
+    return getRoofEncoderTarget() == percent ? COMMAND_COALESCED : COMMAND_REJECTED_MOVING;
+  }
+  float position = getRoofEncoderPosition();
+  if (position >= percent - ENCODER_TARGET_TOLERANCE && position <= percent + ENCODER_TARGET_TOLERANCE) {
+    return COMMAND_ALREADY_DONE;
+  }
+  if (parkInterlockBlocks()) {
+    return COMMAND_REJECTED_UNPARKED;
+  }
+  if (percent > position && rainReopenLocked()) {
+    noteRainLockoutReject();
+    return COMMAND_REJECTED_RAIN;
+  }
+
+  return startRoofMoveTo(percent) ? COMMAND_ACCEPTED : COMMAND_FAILED;
+}
+
+// Pre-warm only ahead of an open that could actually run
+static RoofCommandOutcome arbitratePrewarm() {
+  if (inverterPrewarmMinutes == 0 || roofStatus == ROOF_ERROR) {
+    return COMMAND_FAILED;
+  }
+  if (extendInverterPrewarm()) {
+    return COMMAND_COALESCED;  // Already warming or warm: the window starts over
+  }
+  if (roofStatus == ROOF_OPEN) {
+    return COMMAND_ALREADY_DONE;
+  }
+  if (roofOpState != OP_IDLE || roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
+    return COMMAND_REJECTED_MOVING;
+  }
+  if (rainReopenLocked()) {
+    return COMMAND_REJECTED_RAIN;
+  }
+  return startInverterPrewarm() ? COMMAND_ACCEPTED : COMMAND_FAILED;
+}
+
+static RoofCommandOutcome arbitrateRoofCommand(RoofCommandType type, uint8_t arg) {
+  switch (type) {
+    case CMD_OPEN:
+      return arbitrateMove(TARGET_OPEN);
+    case CMD_CLOSE:
+      return arbitrateMove(TARGET_CLOSE);
+    case CMD_STOP:
+      if (roofOpState != OP_IDLE && roofOpTarget == TARGET_STOP) {
+        return COMMAND_COALESCED;  // Stop sequence already running
+      }
+      return stopRoofMovement() ? COMMAND_ACCEPTED : COMMAND_FAILED;
+    case CMD_ROOF_BUTTON:
+      if (parkInterlockBlocks()) return COMMAND_REJECTED_UNPARKED;
+      if (rainReopenLocked() && roofStatus != ROOF_OPEN) {
+        // Only a press that starts a close is safe to pass on while it rains
+        noteRainLockoutReject();
+        return COMMAND_REJECTED_RAIN;
+      }
+      return sendButtonPress() ? COMMAND_ACCEPTED : COMMAND_BUSY;
+    case CMD_INVERTER_BUTTON:
+      return sendInverterButtonPress() ? COMMAND_ACCEPTED : COMMAND_BUSY;
+    case CMD_INVERTER_TOGGLE:
+      toggleInverterPower();
+      return COMMAND_ACCEPTED;
+    case CMD_CLEAR_ERROR:
+      clearRoofError();
+      return COMMAND_ACCEPTED;
+    case CMD_APPLY_PINS:
+      applyPinSettings();
+      return COMMAND_ACCEPTED;
+    case CMD_CLEAR_MOVE_HISTORY:
+      clearMoveHistory();
+      return COMMAND_ACCEPTED;
+    case CMD_PREWARM:
+      return arbitratePrewarm();
+    case CMD_MOVE_TO:
+      return arbitrateMoveTo(arg);
+    case CMD_CLEAR_CURRENT_ENVELOPE:
+      clearMotorCurrentEnvelope();
+      return COMMAND_ACCEPTED;
+    case CMD_RESET_ENCODER_SPAN:
+      resetRoofEncoderSpan();
+      return COMMAND_ACCEPTED;
+  }
+  return COMMAND_FAILED;
+}
+
+void noteRelayEdge() {
+  if (relayWatchId != 0) {
+    uint32_t nowUs = micros();
+    RoofEvent event = {EVT_COMMAND_RELAY, relayWatchId, (int32_t)(nowUs - relayWatchDispatchUs), nowUs};
+    postEvent(event);
+    relayWatchId = 0;
+  }
+}
+
+// Ids wrap; a command queued before another has the smaller id modulo 2^32
+static bool queuedBefore(uint32_t id, uint32_t otherId) {
+  return (int32_t)(id - otherId) < 0;
+}
+
+// Take the STOP from the abort slot, if any; moves queued before it are void
+static bool takeAbortStop(RoofCommand& cmd) {
+  uint32_t id = abortStopId.exchange(0, std::memory_order_acquire);
+  if (id == 0) {
+    return false;
+  }
+  cmd.id = id;
+  cmd.type = CMD_STOP;
+  cmd.source = (CommandSource)abortStopSource.load(std::memory_order_relaxed);
+  cmd.arg = 0;
+  abortFenceId = id;
+  return true;
+}
+
+static RoofEvent dispatchRoofCommand(const RoofCommand& cmd) {
+  uint32_t dispatchUs = micros();
+  RoofCommandOutcome outcome;
+  bool voidable = isMovementCommand(cmd.type) || cmd.type == CMD_PREWARM;
+  if (abortFenceId != 0 && voidable && queuedBefore(cmd.id, abortFenceId)) {
+    outcome = COMMAND_PREEMPTED;  // STOP pre-empts every movement request queued ahead of it
+  } else {
+    relayWatchId = drivesRelays(cmd.type) ? cmd.id : 0;
+    relayWatchDispatchUs = dispatchUs;
+    outcome = arbitrateRoofCommand(cmd.type, cmd.arg);
+    if (outcome != COMMAND_ACCEPTED) {
+      relayWatchId = 0;
+    }
+  }
+  traceRecord(TRACE_COMMAND, dispatchUs, (uint8_t)(cmd.type | (cmd.source << 4)), (uint16_t)(outcome | (cmd.arg << 8)));
+  RoofEvent result = {EVT_COMMAND_DONE, cmd.id, (int32_t)outcome, dispatchUs};
+  return result;
+}
+
+void processRoofAbort() {
+  relayWatchId = 0;
+  RoofCommand cmd;
+  if (!takeAbortStop(cmd)) {
+    return;
+  }
+  RoofEvent result = dispatchRoofCommand(cmd);
+  publishRoofSnapshot();
+  postEvent(result);
+}
+
+void processRoofCommands() {
+  // Relay edges are attributed to a command only within the step that dispatched it
+  relayWatchId = 0;
+
+  // A STOP the wake-up missed still goes ahead of the queue
+  RoofCommand batch[ROOF_COMMAND_QUEUE_SIZE + 1];
+  uint32_t count = takeAbortStop(batch[0]) ? 1 : 0;
+
+  RoofCommand cmd;
+  bool drained = false;
+  while (count < ROOF_COMMAND_QUEUE_SIZE + 1) {
+    if (!commandQueue.pop(cmd)) {
+      drained = true;
+      break;
+    }
+    batch[count++] = cmd;
+  }
+  if (count == 0) {
+    abortFenceId = 0;
+    return;
+  }
+
+  RoofEvent results[ROOF_COMMAND_QUEUE_SIZE + 1];
+  for (uint32_t i = 0; i < count; i++) {
+    results[i] = dispatchRoofCommand(batch[i]);
+  }
+  // Everything queued before the last STOP has been seen
+  if (drained) {
+    abortFenceId = 0;
+  }
+
+  // A caller woken by the result must already see the state the command produced
+  publishRoofSnapshot();
+  for (uint32_t i = 0; i < count; i++) {
+    postEvent(results[i]);
+  }
+}
+
+void publishRoofSnapshot() {
+  uint32_t seq = snapshotSeq.load(std::memory_order_relaxed);
+  snapshotSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  snapshot.status = roofStatus;
+  snapshot.opState = roofOpState;
+  snapshot.telescopeParked = telescopeParked;
+  snapshot.limitOpen = lastOpenSwitchState;
+  snapshot.limitClosed = lastClosedSwitchState;
+  snapshot.inverterRelay = inverterRelayState;
+  snapshot.inverterACPower = inverterACPowerState;
+  snapshot.rainDetected = rainDetected;
+  snapshot.snowDetected = snowDetected;
+  snapshot.rainLockout = rainReopenLocked();
+  snapshot.snowSensor = getSnowSensorReading();
+  snapshot.position = getRoofPosition();
+  snapshot.positionEstimated = isRoofPositionEstimated();
+  snapshot.stallWarning = getStallWarning();
+  snapshot.targetPosition = getRoofEncoderTarget();
+  snapshot.heldPartOpen = isRoofHeldPartOpen();
+  snapshot.movementStartTime = movementStartTime;
+  snapshot.updates++;
+  snapshot.error = roofError;
+
+  snapshotSeq.store(seq + 2, std::memory_order_release);
+}
+
+void roofControlStep() {
+  uint32_t stepStart = perfBegin();
+
+  uint32_t t = perfBegin();
+  processRoofCommands();
+  perfRecord(PERF_ROOF_COMMANDS, t);
+
+  t = perfBegin();
+  processRoofOperation();
+  perfRecord(PERF_ROOF_OPERATION, t);
+
+  t = perfBegin();
+  processRelayPulses();
+  perfRecord(PERF_RELAY_PULSES, t);
+
+  t = perfBegin();
+  updateRoofStatus();
+  updateTelescopeStatus();
+  processSnowSensor();
+  processRainAutoClose();
+  updateInverterPowerStatus();
+  perfRecord(PERF_SENSORS, t);
+
+  t = perfBegin();
+  updateRoofEncoder();
+  updateMotorCurrent();
+  checkMovementTimeout();
+  updateRoofPosition();
+  perfRecord(PERF_POSITION, t);
+
+  t = perfBegin();
+  publishRoofSnapshot();
+  updateResumeSnapshot();
+  traceRoofState();
+  perfRecord(PERF_SNAPSHOT, t);
+
+  perfRecord(PERF_CONTROL_STEP, stepStart);
+}
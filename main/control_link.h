@@ -0,0 +1,180 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Control / Network Link Header
+ *
+ * The roof, relay and sensor logic runs in the control task; WiFi, Alpaca,
+ * MQTT and the web UI run in the network task. They never call into each
+ * other directly:
+ *   - network -> control: commands on a lock-free SPSC queue, arbitrated in
+ *     one place (dedupe, STOP pre-emption, interlocks) whatever their source
+ *   - network -> control: STOP in a single abort slot that wakes the control
+ *     task at once and is taken ahead of the queue (AbortSlew, MQTT STOP)
+ *   - control -> network: command results and publish requests on a second queue
+ *   - control -> network: a seqlock-protected snapshot of the roof state
+ * A slow HTTP client or a blocking MQTT connect therefore never delays relay
+ * timing or limit switch handling.
+ */
+
+#ifndef CONTROL_LINK_H
+#define CONTROL_LINK_H
+
+#include "roof_controller.h"
+#include "roof_errors.h"
+#include "snow_sensor.h"
+
+enum RoofCommandType : uint8_t {
+  CMD_OPEN,
+  CMD_CLOSE,
+  CMD_STOP,
+  CMD_ROOF_BUTTON,            // Manual K2 press
+  CMD_INVERTER_BUTTON,        // Manual K3 press
+  CMD_INVERTER_TOGGLE,        // Toggle K1
+  CMD_CLEAR_ERROR,
+  CMD_APPLY_PINS,             // Re-apply pin settings after a configuration change
+  CMD_CLEAR_MOVE_HISTORY,
+  CMD_PREWARM,                // Power the inverter up ahead of an expected open
+  CMD_MOVE_TO,                // Run to the part-open position in arg (percent, needs the encoder)
+  CMD_CLEAR_CURRENT_ENVELOPE, // Forget the learned motor current envelopes
+  CMD_RESET_ENCODER_SPAN      // Forget the encoder span (learned again on the next full open)
+};
+
+// Where a command came from (for per-client latency and spam accounting)
+enum CommandSource : uint8_t {
+  SOURCE_ALPACA,
+  SOURCE_MQTT,
+  SOURCE_WEB,
+  SOURCE_INTERNAL,            // Firmware-initiated (safety logic, simulator)
+  SOURCE_COUNT
+};
+
+// What the arbiter did with a command
+enum RoofCommandOutcome : uint8_t {
+  COMMAND_PENDING,            // Queued, not dispatched yet
+  COMMAND_ACCEPTED,           // Executed
+  COMMAND_COALESCED,          // Same command already queued or in progress - nothing new done
+  COMMAND_ALREADY_DONE,       // Roof already in the requested state
+  COMMAND_PREEMPTED,          // Dropped because a later STOP arrived in the same batch
+  COMMAND_REJECTED_MOVING,    // Roof is moving or another sequence is running
+  COMMAND_REJECTED_UNPARKED,  // Telescope not parked and bypass not enabled
+  COMMAND_REJECTED_RAIN,      // Rain re-open lockout
+  COMMAND_BUSY,               // Queue or relay pulse queue full
+  COMMAND_FAILED,             // Controller refused the command
+  COMMAND_TIMED_OUT           // No result within the wait time (network side only)
+};
+
+struct RoofCommand {
+  uint32_t id;                // Matches the result event (never 0)
+  RoofCommandType type;
+  CommandSource source;       // For the trace recorder
+  uint8_t arg;                // CMD_MOVE_TO: target percent (0 otherwise)
+};
+
+enum RoofEventType : uint8_t {
+  EVT_COMMAND_DONE,           // Command dispatched (id, outcome in value, dispatch time)
+  EVT_COMMAND_RELAY,          // First relay edge caused by a command (id, us since dispatch in value)
+  EVT_PUBLISH_STATUS,         // Status changed - publish to MQTT
+  EVT_PUBLISH_POSITION        // Position changed - publish value to MQTT
+};
+
+struct RoofEvent {
+  RoofEventType type;
+  uint32_t id;
+  int32_t value;
+  uint32_t timeUs;            // micros() on the control side
+};
+
+// Per-source accounting (network task owns it)
+struct LatencyStats {
+  uint32_t samples;
+  uint32_t lastUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+};
+
+struct CommandSourceStats {
+  uint32_t commands;          // Submitted, including coalesced ones
+  uint32_t coalesced;
+  uint32_t rejected;          // Moving, unparked, rain lockout, busy or failed
+  uint32_t preempted;
+  LatencyStats queue;         // Enqueue to dispatch in the control task
+  LatencyStats relay;         // Dispatch to the first relay edge it caused
+};
+
+// Request-to-relay-edge time of every STOP (network task owns it)
+struct AbortLatencyStats {
+  LatencyStats latency;
+  uint32_t overBound;         // Aborts slower than ABORT_LATENCY_BOUND_US
+};
+
+const uint32_t COMMAND_LATENCY_UNSET = 0xFFFFFFFF;
+
+struct RoofCommandLogEntry {
+  uint32_t id;
+  RoofCommandType type;
+  CommandSource source;
+  uint8_t arg;
+  RoofCommandOutcome outcome;
+  unsigned long enqueueMs;    // millis() when submitted
+  uint32_t enqueueUs;
+  uint32_t queueUs;           // COMMAND_LATENCY_UNSET until dispatched
+  uint32_t relayUs;           // COMMAND_LATENCY_UNSET until a relay moves
+};
+
+// Consistent copy of the control state for the network side
+struct RoofSnapshot {
+  RoofStatus status;
+  RoofOperationState opState;
+  bool telescopeParked;
+  bool limitOpen;             // Debounced limit switch states
+  bool limitClosed;
+  bool inverterRelay;
+  bool inverterACPower;
+  bool rainDetected;          // Debounced weather inputs
+  bool snowDetected;
+  bool rainLockout;           // Rain auto-close refuses to open
+  SnowSensorReading snowSensor;  // RS485 snow sensor cache
+  int position;               // 0-100, -1 unknown
+  bool positionEstimated;
+  const char* stallWarning;   // Static string, empty when on profile
+  int targetPosition;         // Part-open target of the move in progress, -1 none
+  bool heldPartOpen;          // Reported OPEN, stopped at a part-open target
+  unsigned long movementStartTime;
+  uint32_t updates;           // Snapshots published since boot
+  RoofError error;            // Format with formatRoofError() at the API boundary
+};
+
+// ---- Network side ----
+// Submit a command; returns its id (an identical command still waiting in the
+// queue is reused), or 0 if the queue is full
+uint32_t queueRoofCommand(RoofCommandType type, CommandSource source, uint8_t arg = 0);
+// Submit and wait for the arbiter's decision
+RoofCommandOutcome runRoofCommand(RoofCommandType type, CommandSource source,
+                                  unsigned long timeoutMs = ROOF_COMMAND_TIMEOUT_MS, uint8_t arg = 0);
+bool roofCommandSucceeded(RoofCommandOutcome outcome);  // Accepted, coalesced or already done
+// Alpaca Connected=true/false; every connect pre-warms when that is enabled.
+// Returns the pre-warm command id, or 0 if none was queued
+uint32_t setAlpacaConnected(bool connected);
+// MOVE_TO argument from text: digits only, 0-100; false for anything else
+bool parseRoofTargetPercent(const char* text, uint8_t& percent);
+bool roofCommandFinished(uint32_t id, RoofCommandOutcome& outcome);
+void processControlEvents();                         // Drain results and publish requests
+RoofSnapshot getRoofSnapshot();
+
+const CommandSourceStats& getCommandSourceStats(CommandSource source);
+const AbortLatencyStats& getAbortLatencyStats();
+uint8_t getRoofCommandLogCount();
+const RoofCommandLogEntry& getRoofCommandLogEntry(uint8_t index);  // 0 = most recent
+const char* getRoofCommandTypeString(RoofCommandType type);
+const char* getCommandSourceString(CommandSource source);
+const char* getRoofCommandOutcomeString(RoofCommandOutcome outcome);
+
+// ---- Control side ----
+void processRoofCommands();                          // Arbitrate and run queued commands
+void processRoofAbort();                             // Run a STOP from the abort slot (between steps)
+void noteRelayEdge();                                // Called by writeRelay() on every relay change
+void requestStatusPublish();
+void requestPositionPublish(int position);
+void publishRoofSnapshot();
+void roofControlStep();                              // One pass of the control path
+
+#endif // CONTROL_LINK_H
@@ -0,0 +1,119 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Control and Network Task Implementation
+ */
+
+#include "control_task.h"
+#include "control_link.h"
+#include "Debug.h"
+#include <atomic>
+
+static std::atomic<uint32_t> controlSteps(0);
+static std::atomic<uint32_t> controlLastStepUs(0);
+static std::atomic<uint32_t> controlMaxStepUs(0);
+static std::atomic<uint32_t> controlMaxJitterUs(0);
+static std::atomic<uint32_t> controlAbortWakes(0);
+static TaskHandle_t controlTaskHandle = nullptr;
+
+// Sleep until the next step is due; a notification runs the abort path
+// in the meantime without moving the step schedule
+static void waitForNextStep(TickType_t& lastWake, TickType_t period) {
+  lastWake += period;
+  for (;;) {
+    TickType_t remaining = lastWake - xTaskGetTickCount();
+    if ((int32_t)remaining <= 0) {
+      return;  // Running late: step at once, like vTaskDelayUntil()
+    }
+    if (ulTaskNotifyTake(pdTRUE, remaining) > 0) {
+      processRoofAbort();
+      controlAbortWakes.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+}
+
+static void controlTask(void* param) {
+  const TickType_t period = pdMS_TO_TICKS(CONTROL_TASK_PERIOD_MS);
+  const int32_t periodUs = (int32_t)(CONTROL_TASK_PERIOD_MS * 1000);
+  TickType_t lastWake = xTaskGetTickCount();
+  uint32_t previousStartUs = micros();
+
+  for (;;) {
+    // Jitter: how far this step's start strayed from one period after the last one
+    uint32_t startUs = micros();
+    int32_t jitterUs = (int32_t)(startUs - previousStartUs) - periodUs;
+    if (jitterUs < 0) jitterUs = -jitterUs;
+    previousStartUs = startUs;
+    if (controlSteps.load(std::memory_order_relaxed) > 0 &&
+        (uint32_t)jitterUs > controlMaxJitterUs.load(std::memory_order_relaxed)) {
+      controlMaxJitterUs.store((uint32_t)jitterUs, std::memory_order_relaxed);
+    }
+
+    roofControlStep();
+
+    uint32_t stepUs = micros() - startUs;
+    controlLastStepUs.store(stepUs, std::memory_order_relaxed);
+    if (stepUs > controlMaxStepUs.load(std::memory_order_relaxed)) {
+      controlMaxStepUs.store(stepUs, std::memory_order_relaxed);
+    }
+    controlSteps.fetch_add(1, std::memory_order_relaxed);
+
+    waitForNextStep(lastWake, period);
+  }
+}
+
+struct NetworkTaskEntry {
+  void (*setup)();
+  void (*loop)();
+};
+static NetworkTaskEntry networkEntry;
+
+static void networkTask(void* param) {
+  NetworkTaskEntry* entry = (NetworkTaskEntry*)param;
+  // Bring-up runs here so slow WiFi/service starts never delay the control task
+  entry->setup();
+  for (;;) {
+    entry->loop();
+  }
+}
+
+void startControlTask() {
+  // Network readers must never see an empty snapshot
+  publishRoofSnapshot();
+
+  BaseType_t ok = xTaskCreatePinnedToCore(controlTask, "roofControl", CONTROL_TASK_STACK, nullptr,
+                                          CONTROL_TASK_PRIORITY, &controlTaskHandle, CONTROL_TASK_CORE);
+  if (ok != pdPASS) {
+    Debug.println("FATAL: could not start the roof control task - restarting");
+    ESP.restart();
+  }
+  Debug.printf("Roof control task started on core %d (period %lu ms, priority %u)\n",
+               CONTROL_TASK_CORE, CONTROL_TASK_PERIOD_MS, CONTROL_TASK_PRIORITY);
+}
+
+void startNetworkTask(void (*networkSetup)(), void (*networkLoop)()) {
+  networkEntry.setup = networkSetup;
+  networkEntry.loop = networkLoop;
+  BaseType_t ok = xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, &networkEntry,
+                                          NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+  if (ok != pdPASS) {
+    Debug.println("FATAL: could not start the network task - restarting");
+    ESP.restart();
+  }
+  Debug.printf("Network task started on core %d\n", NETWORK_TASK_CORE);
+}
+
+void wakeControlTask() {
+  if (controlTaskHandle != nullptr) {
+    xTaskNotifyGive(controlTaskHandle);
+  }
+}
+
+ControlTaskStats getControlTaskStats() {
+  ControlTaskStats stats;
+  stats.steps = controlSteps.load(std::memory_order_relaxed);
+  stats.lastStepUs = controlLastStepUs.load(std::memory_order_relaxed);
+  stats.maxStepUs = controlMaxStepUs.load(std::memory_order_relaxed);
+  stats.maxJitterUs = controlMaxJitterUs.load(std::memory_order_relaxed);
+  stats.abortWakes = controlAbortWakes.load(std::memory_order_relaxed);
+  return stats;
+}
@@ -0,0 +1,33 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Control and Network Task Header
+ *
+ * roofControlStep() runs every CONTROL_TASK_PERIOD_MS in a high-priority task
+ * pinned to CONTROL_TASK_CORE; the network services run in their own task on
+ * NETWORK_TASK_CORE, next to the WiFi stack, and are brought up from that task
+ * so a slow WiFi join never delays the control loop. Between steps the control
+ * task sleeps on its task notification, so wakeControlTask() (a STOP in the
+ * abort slot) runs the abort path at once instead of a period later.
+ */
+
+#ifndef CONTROL_TASK_H
+#define CONTROL_TASK_H
+
+#include <Arduino.h>
+#include "config.h"
+
+struct ControlTaskStats {
+  uint32_t steps;              // Control steps run
+  uint32_t lastStepUs;         // Duration of the most recent step
+  uint32_t maxStepUs;          // Longest step
+  uint32_t maxJitterUs;        // Worst lateness of a step start against its schedule
+  uint32_t abortWakes;         // Abort paths run between steps
+};
+
+void startControlTask();                       // Call once setup has initialised the controller
+void startNetworkTask(void (*networkSetup)(),   // Runs networkSetup() once, then
+                      void (*networkLoop)());   // networkLoop() forever
+void wakeControlTask();                         // Any task: run the abort path now
+ControlTaskStats getControlTaskStats();
+
+#endif // CONTROL_TASK_H
@@ -10,6 +10,7 @@
 #include "config.h"
 #include "mqtt_handler.h"
 #include "roof_controller.h"
+#include "control_link.h"
 #include "park_sensor_udp.h"
 #include "gps_handler.h"
 #include <WiFi.h>
@@ -174,10 +175,24 @@ inline String getControlJS() {
     "    const mqttEnabled = document.getElementById('mqttEnabled').checked ? 'true' : 'false';\n"
     "    const inverterRelay = document.getElementById('inverterRelayToggle').checked ? 'true' : 'false';\n"
     "    const inverterSoftPwr = document.getElementById('inverterSoftPwrToggle').checked ? 'true' : 'false';\n"
+    "    const inverterAcSeq = document.getElementById('inverterAcSeqToggle').checked ? 'true' : 'false';\n"
     "    const limitSwitchTimeoutEnabled = document.getElementById('limitSwitchTimeoutEnabledToggle').checked ? 'true' : 'false';\n"
     "    const timeoutEnabled = document.getElementById('timeoutEnabledToggle').checked ? 'true' : 'false';\n"
     "    const delay1 = document.getElementById('delay1Input').value;\n"
     "    const delay2 = document.getElementById('delay2Input').value;\n"
+    "    const keepWarm = document.getElementById('keepWarmInput').value;\n"
+    "    const prewarm = document.getElementById('prewarmInput').value;\n"
+    "    const prewarmOnConnect = document.getElementById('prewarmConnectToggle').checked ? 'true' : 'false';\n"
+    "    const rainClose = document.getElementById('rainCloseToggle').checked ? 'true' : 'false';\n"
+    "    const snowModbus = document.getElementById('snowModbusToggle').checked ? 'true' : 'false';\n"
+    "    const snowClose = document.getElementById('snowCloseToggle').checked ? 'true' : 'false';\n"
+    "    const rainHoldoff = document.getElementById('rainHoldoffInput').value;\n"
+    "    const rainLockout = document.getElementById('rainLockoutInput').value;\n"
+    "    const encoderPinA = document.getElementById('encoderPinAInput').value;\n"
+    "    const encoderPinB = document.getElementById('encoderPinBInput').value;\n"
+    "    const encoderResetSpan = document.getElementById('encoderResetSpanToggle').checked ? 'true' : 'false';\n"
+    "    const currentPin = document.getElementById('currentPinInput').value;\n"
+    "    const currentResetEnvelope = document.getElementById('currentResetEnvelopeToggle').checked ? 'true' : 'false';\n"
     "    const limitSwitchTimeout = document.getElementById('limitSwitchTimeoutInput').value;\n"
     "    const timeout = document.getElementById('timeoutInput').value;\n"
     "    const parkSwitchType = document.getElementById('parkSwitchType').checked ? 'high' : 'low';\n"
@@ -185,7 +200,7 @@ inline String getControlJS() {
     "    fetch('/set_pins', {\n"
     "      method: 'POST',\n"
     "      headers: { 'Content-Type': 'application/x-www-form-urlencoded' },\n"
-    "      body: 'triggerState=' + triggerState + '&swapSwitches=' + swapSwitches + '&mqttEnabled=' + mqttEnabled + '&inverterRelay=' + inverterRelay + '&inverterSoftPwr=' + inverterSoftPwr + '&limitSwitchTimeoutEnabled=' + limitSwitchTimeoutEnabled + '&timeoutEnabled=' + timeoutEnabled + '&delay1=' + delay1 + '&delay2=' + delay2 + '&limitSwitchTimeout=' + limitSwitchTimeout + '&timeout=' + timeout + '&parkSwitchType=' + parkSwitchType\n"
+    "      body: 'triggerState=' + triggerState + '&swapSwitches=' + swapSwitches + '&mqttEnabled=' + mqttEnabled + '&inverterRelay=' + inverterRelay + '&inverterSoftPwr=' + inverterSoftPwr + '&inverterAcSeq=' + inverterAcSeq + '&limitSwitchTimeoutEnabled=' + limitSwitchTimeoutEnabled + '&timeoutEnabled=' + timeoutEnabled + '&delay1=' + delay1 + '&delay2=' + delay2 + '&keepWarm=' + keepWarm + '&prewarm=' + prewarm + '&prewarmOnConnect=' + prewarmOnConnect + '&rainClose=' + rainClose + '&rainHoldoff=' + rainHoldoff + '&rainLockout=' + rainLockout + '&snowModbus=' + snowModbus + '&snowClose=' + snowClose + '&encoderPinA=' + encoderPinA + '&encoderPinB=' + encoderPinB + '&encoderResetSpan=' + encoderResetSpan + '&currentPin=' + currentPin + '&currentResetEnvelope=' + currentResetEnvelope + '&limitSwitchTimeout=' + limitSwitchTimeout + '&timeout=' + timeout + '&parkSwitchType=' + parkSwitchType\n"
     "    })\n"
     "    .then(response => response.text())\n"
     "    .then(data => {\n"
@@ -521,16 +536,17 @@ inline String getHomePage(RoofStatus status, bool isApMode = false) {
   String statusString = getRoofStatusString(status);
   String statusDisplayString = statusString;
   // Add error reason in parentheses if in error state
-  if (statusString == "Error" && roofErrorReason.length() > 0) {
+  RoofError roofErrorRecord = getRoofSnapshot().error;
+  if (statusString == "Error" && roofErrorRecord.code != ROOF_ERR_NONE) {
     // Check for timeout with no limit switches - show brief message
     bool openSwitchState = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
     bool closedSwitchState = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
-    if (roofErrorReason.indexOf("timed out") >= 0 && !openSwitchState && !closedSwitchState) {
+    if (isRoofTimeoutError(roofErrorRecord.code) && !openSwitchState && !closedSwitchState) {
       statusDisplayString = statusString + " (Timeout: Roof stopped mid-travel. Manually move to fully open or closed, then clear error.)";
     } else {
-      String trimmedReason = roofErrorReason;
-      trimmedReason.trim();
-      statusDisplayString = statusString + " (" + trimmedReason + ")";
+      char errorReason[ROOF_ERROR_REASON_SIZE];
+      formatRoofError(roofErrorRecord, errorReason, sizeof(errorReason));
+      statusDisplayString = statusString + " (" + errorReason + ")";
     }
   }
 
@@ -1145,6 +1161,108 @@ inline String getSwitchConfigCard() {
   html += "</div>";
   html += "</div>"; // End toggle-row
 
+  // Rain auto-close (RG9 on GPIO37)
+  html += "<div class='toggle-row'>";
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='rainCloseToggle'" + String(rainAutoCloseEnabled ? " checked" : "") + " onchange=\"updateToggleLabel('rainCloseToggle', 'rainCloseText', 'ENABLED', 'DISABLED')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Rain Auto-Close <strong id='rainCloseText'>(" + String(rainAutoCloseEnabled ? "ENABLED" : "DISABLED") + ")</strong><br>";
+  html += "<small>Close the roof when the rain sensor trips (stops an opening roof first; still waits for the telescope to park)</small>";
+  html += "</span>";
+  html += "</div>";
+  html += "</div>"; // End toggle-row
+
+  html += "<div class='toggle-row'>";
+  html += "<div style='margin-right: 20px;'>";
+  html += "<label for='rainHoldoffInput' style='display: block; margin-bottom: 5px;'><strong>Rain Hold-Off (seconds):</strong></label>";
+  html += "<input type='number' id='rainHoldoffInput' min='0' max='" + String(MAX_RAIN_HOLDOFF / 1000) + "' value='" + String(rainHoldoffMs / 1000) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "<p style='margin-top: 5px; font-size: 12px; color: #b0b0b0;'>Rain must persist this long before closing (0 = close at once)</p>";
+  html += "</div>";
+  html += "<div>";
+  html += "<label for='rainLockoutInput' style='display: block; margin-bottom: 5px;'><strong>Re-Open Lockout (minutes):</strong></label>";
+  html += "<input type='number' id='rainLockoutInput' min='0' max='" + String(MAX_RAIN_REOPEN_LOCKOUT / 60000) + "' value='" + String(rainReopenLockoutMs / 60000) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "<p style='margin-top: 5px; font-size: 12px; color: #b0b0b0;'>After a trip, opening is refused until the sensor has been dry this long (default: 30)</p>";
+  html += "</div>";
+  html += "</div>"; // End toggle-row
+
+  // RS485 snow sensor (Modbus RTU on UART2)
+  html += "<div class='toggle-row'>";
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='snowModbusToggle'" + String(snowModbusEnabled ? " checked" : "") + " onchange=\"updateToggleLabel('snowModbusToggle', 'snowModbusText', 'ENABLED', 'DISABLED')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "RS485 Snow Sensor <strong id='snowModbusText'>(" + String(snowModbusEnabled ? "ENABLED" : "DISABLED") + ")</strong><br>";
+  html += "<small>Poll the snow sensor over Modbus RTU (slave " + String(SNOW_MODBUS_ADDRESS) + ", " + String(SNOW_MODBUS_BAUD) + " baud)</small>";
+  html += "</span>";
+  html += "</div>";
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='snowCloseToggle'" + String(snowAutoCloseEnabled ? " checked" : "") + " onchange=\"updateToggleLabel('snowCloseToggle', 'snowCloseText', 'ENABLED', 'DISABLED')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Snow Auto-Close <strong id='snowCloseText'>(" + String(snowAutoCloseEnabled ? "ENABLED" : "DISABLED") + ")</strong><br>";
+  html += "<small>Snow from the RS485 sensor closes the roof like rain (same hold-off and lockout)</small>";
+  html += "</span>";
+  html += "</div>";
+  html += "</div>"; // End toggle-row
+
+  // Optional quadrature encoder on the roof drive (PCNT)
+  html += "<div class='toggle-row'>";
+  html += "<div style='margin-right: 20px;'>";
+  html += "<label for='encoderPinAInput' style='display: block; margin-bottom: 5px;'><strong>Encoder Pin A (GPIO):</strong></label>";
+  html += "<input type='number' id='encoderPinAInput' min='-1' max='48' value='" + String(ENCODER_PIN_A) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "</div>";
+  html += "<div style='margin-right: 20px;'>";
+  html += "<label for='encoderPinBInput' style='display: block; margin-bottom: 5px;'><strong>Encoder Pin B (GPIO):</strong></label>";
+  html += "<input type='number' id='encoderPinBInput' min='-1' max='48' value='" + String(ENCODER_PIN_B) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "</div>";
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='encoderResetSpanToggle' onchange=\"updateToggleLabel('encoderResetSpanToggle', 'encoderResetSpanText', 'RESET', 'KEEP')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Encoder Span <strong id='encoderResetSpanText'>KEEP</strong><br>";
+  if (encoderCountsPerTravel != 0) {
+    html += "<small>" + String(encoderCountsPerTravel) + " counts closed to open";
+  } else {
+    html += "<small>Not learned yet";
+  }
+  html += "; learned again on the next full open after a reset or a pin change (-1 = no encoder)</small>";
+  html += "</span>";
+  html += "</div>";
+  html += "</div>"; // End toggle-row
+
+  // Optional motor current sensor on the opener supply (ADC continuous mode)
+  html += "<div class='toggle-row'>";
+  html += "<div style='margin-right: 20px;'>";
+  html += "<label for='currentPinInput' style='display: block; margin-bottom: 5px;'><strong>Motor Current Pin (GPIO):</strong></label>";
+  html += "<input type='number' id='currentPinInput' min='-1' max='10' value='" + String(MOTOR_CURRENT_PIN) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "</div>";
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='currentResetEnvelopeToggle' onchange=\"updateToggleLabel('currentResetEnvelopeToggle', 'currentResetEnvelopeText', 'RESET', 'KEEP')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Current Envelope <strong id='currentResetEnvelopeText'>KEEP</strong><br>";
+  html += "<small>ADC1 pins only (GPIO1-10, -1 = no sensor); obstruction trips start after " + String(MOTOR_CURRENT_MIN_MOVES);
+  html += " completed moves each way. Reset after drive maintenance.</small>";
+  html += "</span>";
+  html += "</div>";
+  html += "</div>"; // End toggle-row
+
   // Add a new section for inverter settings
   html += "<h3>Inverter Settings</h3>";
   html += "<div class='toggle-row'>";
@@ -1177,6 +1295,30 @@ inline String getSwitchConfigCard() {
   html += "</span>";
   html += "</div>";
 
+  // AC-detect sequencing toggle
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='inverterAcSeqToggle'" + String(inverterAcSequencing ? " checked" : "") + " onchange=\"updateToggleLabel('inverterAcSeqToggle', 'inverterAcSeqText', 'ENABLED', 'DISABLED')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Start on AC Detect <strong id='inverterAcSeqText'>(" + String(inverterAcSequencing ? "ENABLED" : "DISABLED") + ")</strong><br>";
+  html += "<small>Press K2 as soon as AC power is stable on GPIO7; Delay 1/2 become upper limits</small>";
+  html += "</span>";
+  html += "</div>";
+
+  // Pre-warm on Alpaca connect toggle
+  html += "<div class='switch-container'>";
+  html += "<label class='switch'>";
+  html += "<input type='checkbox' id='prewarmConnectToggle'" + String(inverterPrewarmOnConnect ? " checked" : "") + " onchange=\"updateToggleLabel('prewarmConnectToggle', 'prewarmConnectText', 'ENABLED', 'DISABLED')\">";
+  html += "<span class='slider'></span>";
+  html += "</label>";
+  html += "<span class='switch-label'>";
+  html += "Pre-Warm on Alpaca Connect <strong id='prewarmConnectText'>(" + String(inverterPrewarmOnConnect ? "ENABLED" : "DISABLED") + ")</strong><br>";
+  html += "<small>Start the inverter when an imaging client connects, ahead of the open it usually sends next</small>";
+  html += "</span>";
+  html += "</div>";
+
   html += "</div>"; // End toggle-row
 
   // Inverter delay settings
@@ -1196,6 +1338,20 @@ inline String getSwitchConfigCard() {
   html += "<p style='margin-top: 5px; font-size: 12px; color: #b0b0b0;'>Time between inverter power-on and K2 roof button (0-10000ms, default: 1500)</p>";
   html += "</div>";
 
+  html += "<div style='margin-left: 20px;'>";
+  html += "<label for='keepWarmInput' style='display: block; margin-bottom: 5px;'><strong>Keep-Warm (minutes):</strong></label>";
+  html += "<input type='number' id='keepWarmInput' min='0' max='" + String(MAX_INVERTER_KEEP_WARM_MINUTES) + "' value='" + String(inverterKeepWarmMinutes) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "<p style='margin-top: 5px; font-size: 12px; color: #b0b0b0;'>Leave the inverter on after a move so the next one starts without a spin-up (0-" + String(MAX_INVERTER_KEEP_WARM_MINUTES) + " min, 0 = off)</p>";
+  html += "</div>";
+
+  html += "<div style='margin-left: 20px;'>";
+  html += "<label for='prewarmInput' style='display: block; margin-bottom: 5px;'><strong>Pre-Warm (minutes):</strong></label>";
+  html += "<input type='number' id='prewarmInput' min='0' max='" + String(MAX_INVERTER_PREWARM_MINUTES) + "' value='" + String(inverterPrewarmMinutes) + "' ";
+  html += "style='width: 120px; padding: 5px; font-size: 16px;' />";
+  html += "<p style='margin-top: 5px; font-size: 12px; color: #b0b0b0;'>How long a pre-warm request keeps the inverter on waiting for the open (0-" + String(MAX_INVERTER_PREWARM_MINUTES) + " min, 0 = off)</p>";
+  html += "</div>";
+
   html += "</div>"; // End toggle-row
   html += "</div>"; // End toggle-group
 
@@ -1255,6 +1411,10 @@ inline String getSwitchConfigCard() {
   html += "Soft-power button (K3): " + String(inverterSoftPwrEnabled ? "Enabled" : "Disabled") + "<br>";
   html += "Inverter Delay 1: " + String(inverterDelay1) + "ms<br>";
   html += "Inverter Delay 2: " + String(inverterDelay2) + "ms<br>";
+  html += "Start on AC detect: " + String(inverterAcSequencing ? "Enabled" : "Disabled") + "<br>";
+  html += "Inverter keep-warm: " + (inverterKeepWarmMinutes ? String(inverterKeepWarmMinutes) + " minutes" : String("Off")) + "<br>";
+  html += "Inverter pre-warm: " + (inverterPrewarmMinutes ? String(inverterPrewarmMinutes) + " minutes" : String("Off")) + "<br>";
+  html += "Pre-warm on Alpaca connect: " + String(inverterPrewarmOnConnect ? "Enabled" : "Disabled") + "<br>";
   html += "Limit switch timeout monitoring: " + String(limitSwitchTimeoutEnabled ? "Enabled" : "Disabled") + "<br>";
   html += "Limit switch timeout: " + String(limitSwitchTimeout / 1000) + " seconds<br>";
   html += "Movement timeout monitoring: " + String(movementTimeoutEnabled ? "Enabled" : "Disabled") + "<br>";
@@ -1661,16 +1821,17 @@ inline String getSetupPage() {
   String statusString = getRoofStatusString();
   String statusDisplayString = statusString;
   // Add error reason in parentheses if in error state
-  if (statusString == "Error" && roofErrorReason.length() > 0) {
+  RoofError roofErrorRecord = getRoofSnapshot().error;
+  if (statusString == "Error" && roofErrorRecord.code != ROOF_ERR_NONE) {
     // Check for timeout with no limit switches - show brief message
     bool openSwitchState = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
     bool closedSwitchState = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
-    if (roofErrorReason.indexOf("timed out") >= 0 && !openSwitchState && !closedSwitchState) {
+    if (isRoofTimeoutError(roofErrorRecord.code) && !openSwitchState && !closedSwitchState) {
       statusDisplayString = statusString + " (Timeout: Roof stopped mid-travel. Manually move to fully open or closed, then clear error.)";
     } else {
-      String trimmedReason = roofErrorReason;
-      trimmedReason.trim();
-      statusDisplayString = statusString + " (" + trimmedReason + ")";
+      char errorReason[ROOF_ERROR_REASON_SIZE];
+      formatRoofError(roofErrorRecord, errorReason, sizeof(errorReason));
+      statusDisplayString = statusString + " (" + errorReason + ")";
     }
   }
   String statusClass = "";
@@ -1841,16 +2002,17 @@ inline String getRoofControlPage() {
   String statusString = getRoofStatusString();
   String statusDisplayString = statusString;
   // Add error reason in parentheses if in error state
-  if (statusString == "Error" && roofErrorReason.length() > 0) {
+  RoofError roofErrorRecord = getRoofSnapshot().error;
+  if (statusString == "Error" && roofErrorRecord.code != ROOF_ERR_NONE) {
     // Check for timeout with no limit switches - show brief message
     bool openSwitchState = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
     bool closedSwitchState = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
-    if (roofErrorReason.indexOf("timed out") >= 0 && !openSwitchState && !closedSwitchState) {
+    if (isRoofTimeoutError(roofErrorRecord.code) && !openSwitchState && !closedSwitchState) {
       statusDisplayString = statusString + " (Timeout: Roof stopped mid-travel. Manually move to fully open or closed, then clear error.)";
     } else {
-      String trimmedReason = roofErrorReason;
-      trimmedReason.trim();
-      statusDisplayString = statusString + " (" + trimmedReason + ")";
+      char errorReason[ROOF_ERROR_REASON_SIZE];
+      formatRoofError(roofErrorRecord, errorReason, sizeof(errorReason));
+      statusDisplayString = statusString + " (" + errorReason + ")";
     }
   }
   String statusClass = "";
@@ -2000,6 +2162,9 @@ inline String getRoofControlPage() {
   html += "<div style='text-align: center; margin: 20px 0;'>\n";
   html += "<button class='btn' onclick='toggleInverterPower()' style='margin: 5px;'>Toggle Power Relay (K1)</button>\n";
   html += "<button class='btn' onclick='sendInverterButton()' style='margin: 5px;'>Press Soft-Power Button (K3)</button>\n";
+  if (inverterPrewarmMinutes > 0) {
+    html += "<button class='btn' onclick='prewarmInverter()' style='margin: 5px;'>Pre-Warm for Open</button>\n";
+  }
   html += "</div>\n";
   html += "</div>\n";
 
@@ -2019,6 +2184,12 @@ inline String getRoofControlPage() {
   html += "    .catch(error => alert('Error: ' + error));\n";
   html += "}\n\n";
 
+  html += "function prewarmInverter() {\n";
+  html += "  fetch('/inverter_prewarm', { method: 'POST' })\n";
+  html += "    .then(response => response.text().then(text => { if (!response.ok) alert(text); updateStatus(); }))\n";
+  html += "    .catch(error => alert('Error: ' + error));\n";
+  html += "}\n\n";
+
   html += "function roofControl(action) {\n";
   html += "  fetch('/roof_control', {\n";
   html += "    method: 'POST',\n";
@@ -0,0 +1,303 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Input Sampler Implementation
+ */
+
+#include "input_sampler.h"
+#include "spsc_queue.h"
+#include "perf_profiler.h"
+#include "Debug.h"
+#include <esp_timer.h>
+#include <atomic>
+
+static_assert(INPUT_CHANNEL_COUNT <= 32, "Input channels must fit in one mask word");
+static_assert(INPUT_COUNTER_BITS >= 1 && INPUT_COUNTER_BITS < 32, "INPUT_COUNTER_BITS out of range");
+
+static const uint32_t INPUT_COUNTER_MAX = (1UL << INPUT_COUNTER_BITS) - 1;
+
+static const char* const INPUT_CHANNEL_NAMES[INPUT_CHANNEL_COUNT] = {
+  "limit_open",
+  "limit_closed",
+  "telescope_park",
+  "ac_power",
+  "rain",
+  "snow"
+};
+
+// Sampler state, touched only by the timer callback after initInputSampler()
+static uint32_t counterPlanes[INPUT_COUNTER_BITS];
+
+// Stable-time thresholds as bit planes, double-buffered so a change never
+// tears a sample: the writer fills the idle copy, then flips the index
+static uint32_t thresholdPlanes[2][INPUT_COUNTER_BITS];
+static std::atomic<uint8_t> activeThresholds(0);
+static uint16_t stableSamples[INPUT_CHANNEL_COUNT];
+
+static std::atomic<uint32_t> stableMask(0);
+static std::atomic<uint32_t> rawMask(0);
+static std::atomic<bool> resyncRequested(false);
+
+static SpscQueue<InputEvent, INPUT_EVENT_QUEUE_SIZE> inputEvents;
+static std::atomic<bool> inputEventOverflow(false);
+
+static std::atomic<uint32_t> sampleCount(0);
+static std::atomic<uint32_t> eventCount(0);
+static std::atomic<uint32_t> overflowCount(0);
+static InputChannelStats channelStats[INPUT_CHANNEL_COUNT];
+
+// Bounce bursts, touched only by the timer callback after initInputSampler().
+// A channel is in burstMask from its first raw edge until the burst ends in a
+// flip or has sat back at the stable state for a whole stable time.
+static uint32_t lastRaw = 0;
+static uint32_t burstMask = 0;
+static uint32_t burstStartUs[INPUT_CHANNEL_COUNT];
+static uint32_t burstLastEdgeUs[INPUT_CHANNEL_COUNT];
+static uint16_t burstEdges[INPUT_CHANNEL_COUNT];
+
+static SpscQueue<InputBurst, INPUT_BURST_QUEUE_SIZE> inputBursts;
+static std::atomic<uint32_t> burstOverflowCount(0);
+
+static esp_timer_handle_t samplerTimer = nullptr;
+
+int getInputPin(InputChannel channel) {
+  switch (channel) {
+    case INPUT_LIMIT_OPEN:     return LIMIT_SWITCH_OPEN_PIN;
+    case INPUT_LIMIT_CLOSED:   return LIMIT_SWITCH_CLOSED_PIN;
+    case INPUT_TELESCOPE_PARK: return TELESCOPE_PARKED_PIN;
+    case INPUT_AC_POWER:       return INVERTER_AC_POWER_PIN;
+    case INPUT_RAIN:           return RAIN_SENSOR_PIN;
+    case INPUT_SNOW:           return SNOW_SENSOR_DIGITAL_PIN;
+    default:                   return -1;
+  }
+}
+
+// Pin level that means "active" (the trigger and park levels are configurable)
+int getInputActiveLevel(InputChannel channel) {
+  switch (channel) {
+    case INPUT_LIMIT_OPEN:
+    case INPUT_LIMIT_CLOSED:   return TRIGGERED;
+    case INPUT_TELESCOPE_PARK: return TELESCOPE_PARKED;
+    case INPUT_AC_POWER:       return LOW;  // Optocoupler pulls the pin low when AC is present
+    case INPUT_RAIN:           return RAIN_SENSOR_ACTIVE;
+    case INPUT_SNOW:           return SNOW_SENSOR_ACTIVE;
+    default:                   return HIGH;
+  }
+}
+
+static uint32_t readInputs() {
+  uint32_t mask = 0;
+  for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+    if (digitalRead(getInputPin((InputChannel)ch)) == getInputActiveLevel((InputChannel)ch)) {
+      mask |= 1UL << ch;
+    }
+  }
+  return mask;
+}
+
+static void publishInputEvent(uint32_t nowUs, uint32_t changed, uint32_t stable) {
+  InputEvent event = {nowUs, changed, stable};
+  if (!inputEvents.push(event)) {
+    inputEventOverflow.store(true, std::memory_order_relaxed);
+    overflowCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  eventCount.fetch_add(1, std::memory_order_relaxed);
+
+  unsigned long nowMs = millis();
+  for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+    if (changed & (1UL << ch)) {
+      channelStats[ch].changes++;
+      channelStats[ch].lastChangeMs = nowMs;
+    }
+  }
+}
+
+static void publishInputBurst(uint8_t ch, uint32_t nowUs, bool flipped, bool active) {
+  InputBurst burst = {nowUs, ch, flipped, active, burstEdges[ch],
+                      burstLastEdgeUs[ch] - burstStartUs[ch], flipped ? nowUs - burstStartUs[ch] : 0};
+  if (!inputBursts.push(burst)) {
+    burstOverflowCount.fetch_add(1, std::memory_order_relaxed);
+  }
+  burstMask &= ~(1UL << ch);
+}
+
+// Count raw edges into their bursts, and close bursts that fell back to the
+// stable state without a flip. Only channels with edges or an open burst cost
+// anything, so a quiet sample skips the loop entirely.
+static void trackBursts(uint32_t nowUs, uint32_t edges, uint32_t differs, uint32_t stable) {
+  for (uint32_t pending = edges | burstMask; pending; pending &= pending - 1) {
+    uint8_t ch = __builtin_ctz(pending);
+    uint32_t bit = 1UL << ch;
+    if (edges & bit) {
+      if (!(burstMask & bit)) {
+        burstMask |= bit;
+        burstStartUs[ch] = nowUs;
+        burstEdges[ch] = 0;
+      }
+      burstLastEdgeUs[ch] = nowUs;
+      if (burstEdges[ch] < UINT16_MAX) burstEdges[ch]++;
+    } else if (!(differs & bit) &&
+               nowUs - burstLastEdgeUs[ch] >= (uint32_t)stableSamples[ch] * INPUT_SAMPLE_PERIOD_US) {
+      channelStats[ch].glitches++;
+      publishInputBurst(ch, nowUs, false, (stable & bit) != 0);
+    }
+  }
+}
+
+// One sample of every input (esp_timer task)
+static void sampleInputs(void* arg) {
+  uint32_t perfStart = perfBegin();
+  uint32_t nowUs = micros();
+  uint32_t raw = readInputs();
+  uint32_t stable = stableMask.load(std::memory_order_relaxed);
+  rawMask.store(raw, std::memory_order_relaxed);
+  sampleCount.fetch_add(1, std::memory_order_relaxed);
+
+  if (resyncRequested.exchange(false)) {
+    // Pin assignment or trigger level changed: the old counts mean nothing
+    for (uint8_t k = 0; k < INPUT_COUNTER_BITS; k++) counterPlanes[k] = 0;
+    lastRaw = raw;
+    burstMask = 0;
+    stableMask.store(raw, std::memory_order_release);
+    if (raw != stable) publishInputEvent(nowUs, raw ^ stable, raw);
+    perfRecord(PERF_INPUT_SAMPLER, perfStart);
+    return;
+  }
+
+  // Channels that agree with their stable state restart from zero; the others
+  // count up by one (ripple-carry add across the planes) and flip when their
+  // count equals their threshold
+  uint32_t differs = raw ^ stable;
+  uint32_t edges = raw ^ lastRaw;
+  lastRaw = raw;
+  if (edges | burstMask) trackBursts(nowUs, edges, differs, stable);
+
+  const uint32_t* threshold = thresholdPlanes[activeThresholds.load(std::memory_order_acquire)];
+  uint32_t carry = differs;
+  uint32_t reached = differs;
+  for (uint8_t k = 0; k < INPUT_COUNTER_BITS; k++) {
+    uint32_t plane = counterPlanes[k] & differs;
+    uint32_t next = plane ^ carry;
+    carry &= plane;
+    counterPlanes[k] = next;
+    reached &= ~(next ^ threshold[k]);
+  }
+
+  if (reached) {
+    for (uint8_t k = 0; k < INPUT_COUNTER_BITS; k++) counterPlanes[k] &= ~reached;
+    stable ^= reached;
+    stableMask.store(stable, std::memory_order_release);
+    publishInputEvent(nowUs, reached, stable);
+    for (uint32_t pending = reached & burstMask; pending; pending &= pending - 1) {
+      uint8_t ch = __builtin_ctz(pending);
+      publishInputBurst(ch, nowUs, true, (stable & (1UL << ch)) != 0);
+    }
+  }
+  perfRecord(PERF_INPUT_SAMPLER, perfStart);
+}
+
+static uint16_t stableTimeToSamples(unsigned long ms) {
+  uint32_t samples = (uint32_t)((ms * 1000UL + INPUT_SAMPLE_PERIOD_US - 1) / INPUT_SAMPLE_PERIOD_US);
+  if (samples < 1) samples = 1;
+  if (samples > INPUT_COUNTER_MAX) samples = INPUT_COUNTER_MAX;
+  return (uint16_t)samples;
+}
+
+// Rebuild the idle threshold copy from stableSamples and make it live
+static void publishThresholds() {
+  uint8_t idle = activeThresholds.load(std::memory_order_relaxed) ^ 1;
+  for (uint8_t k = 0; k < INPUT_COUNTER_BITS; k++) {
+    uint32_t plane = 0;
+    for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+      if (stableSamples[ch] & (1U << k)) plane |= 1UL << ch;
+    }
+    thresholdPlanes[idle][k] = plane;
+  }
+  activeThresholds.store(idle, std::memory_order_release);
+}
+
+void setInputStableTime(InputChannel channel, unsigned long ms) {
+  if (channel >= INPUT_CHANNEL_COUNT) return;
+  stableSamples[channel] = stableTimeToSamples(ms);
+  publishThresholds();
+}
+
+unsigned long getInputStableTime(InputChannel channel) {
+  if (channel >= INPUT_CHANNEL_COUNT) return 0;
+  return (unsigned long)stableSamples[channel] * INPUT_SAMPLE_PERIOD_US / 1000UL;
+}
+
+void initInputSampler() {
+  stableSamples[INPUT_LIMIT_OPEN] = stableTimeToSamples(SWITCH_STABLE_TIME);
+  stableSamples[INPUT_LIMIT_CLOSED] = stableTimeToSamples(SWITCH_STABLE_TIME);
+  stableSamples[INPUT_TELESCOPE_PARK] = stableTimeToSamples(SWITCH_STABLE_TIME);
+  stableSamples[INPUT_AC_POWER] = stableTimeToSamples(SWITCH_STABLE_TIME);
+  stableSamples[INPUT_RAIN] = stableTimeToSamples(RAIN_SENSOR_STABLE_TIME);
+  stableSamples[INPUT_SNOW] = stableTimeToSamples(SNOW_SENSOR_STABLE_TIME);
+  publishThresholds();
+
+  // The levels at boot are taken as stable, like the switch trackers always did
+  uint32_t raw = readInputs();
+  for (uint8_t k = 0; k < INPUT_COUNTER_BITS; k++) counterPlanes[k] = 0;
+  lastRaw = raw;
+  burstMask = 0;
+  rawMask.store(raw);
+  stableMask.store(raw);
+  resyncRequested.store(false);
+
+  if (samplerTimer == nullptr) {
+    esp_timer_create_args_t args = {};
+    args.callback = sampleInputs;
+    args.name = "inputs";
+    if (esp_timer_create(&args, &samplerTimer) != ESP_OK ||
+        esp_timer_start_periodic(samplerTimer, INPUT_SAMPLE_PERIOD_US) != ESP_OK) {
+      Debug.println("FATAL: could not start the input sampler - restarting");
+      ESP.restart();
+    }
+  }
+
+  Debug.printf("Input sampler: %u channels every %lu us, stable mask 0x%02lx\n",
+               (unsigned)INPUT_CHANNEL_COUNT, (unsigned long)INPUT_SAMPLE_PERIOD_US, (unsigned long)raw);
+}
+
+void requestInputResync() {
+  resyncRequested.store(true);
+}
+
+bool popInputEvent(InputEvent& event) {
+  return inputEvents.pop(event);
+}
+
+bool takeInputEventOverflow() {
+  return inputEventOverflow.exchange(false);
+}
+
+bool popInputBurst(InputBurst& burst) {
+  return inputBursts.pop(burst);
+}
+
+uint32_t getInputStableMask() {
+  return stableMask.load(std::memory_order_acquire);
+}
+
+uint32_t getInputRawMask() {
+  return rawMask.load(std::memory_order_relaxed);
+}
+
+const char* getInputChannelName(InputChannel channel) {
+  return channel < INPUT_CHANNEL_COUNT ? INPUT_CHANNEL_NAMES[channel] : "unknown";
+}
+
+InputChannelStats getInputChannelStats(InputChannel channel) {
+  InputChannelStats stats = {0, 0, 0};
+  if (channel < INPUT_CHANNEL_COUNT) stats = channelStats[channel];
+  return stats;
+}
+
+InputSamplerStats getInputSamplerStats() {
+  InputSamplerStats stats;
+  stats.samples = sampleCount.load(std::memory_order_relaxed);
+  stats.events = eventCount.load(std::memory_order_relaxed);
+  stats.overflows = overflowCount.load(std::memory_order_relaxed);
+  stats.burstOverflows = burstOverflowCount.load(std::memory_order_relaxed);
+  return stats;
+}
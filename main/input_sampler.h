@@ -0,0 +1,93 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Input Sampler Header
+ *
+ * Every digital input is read together on a fixed-rate esp_timer and
+ * debounced at once with vertical counters: bit c of counter plane k is bit k
+ * of channel c's count of consecutive samples that disagree with its stable
+ * state. One sample costs the same handful of word operations whatever the
+ * number of channels, and a channel flips exactly when its count reaches its
+ * own stable time. Each flip is published as an InputEvent to the control
+ * task through a single-producer/single-consumer queue.
+ *
+ * The raw edges around a flip are kept too: the sampler times each burst of
+ * contact bounce from its first to its last edge and hands it to the switch
+ * health monitor on a second queue, either with the flip it led to or, when
+ * the input fell back before its stable time, as a glitch.
+ */
+
+#ifndef INPUT_SAMPLER_H
+#define INPUT_SAMPLER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+// Bit positions in the input masks; a set bit means the input is active
+// (limit switch triggered, telescope parked, AC present, rain or snow detected)
+enum InputChannel : uint8_t {
+  INPUT_LIMIT_OPEN,
+  INPUT_LIMIT_CLOSED,
+  INPUT_TELESCOPE_PARK,
+  INPUT_AC_POWER,
+  INPUT_RAIN,
+  INPUT_SNOW,
+  INPUT_CHANNEL_COUNT
+};
+
+inline uint32_t inputBit(InputChannel channel) {
+  return 1UL << channel;
+}
+
+// One or more channels reached a new stable state on the same sample
+struct InputEvent {
+  uint32_t timeUs;            // micros() of the sample that completed the stable time
+  uint32_t changed;           // Channels that flipped
+  uint32_t stable;            // All stable states after the flip
+};
+
+// Raw edge activity around one stable change, or chatter that never became one
+struct InputBurst {
+  uint32_t timeUs;            // micros() of the flip, or of the sample that closed a glitch
+  uint8_t channel;            // InputChannel
+  bool flipped;               // Ended in a stable change (false = glitch)
+  bool active;                // Stable state after the burst
+  uint16_t edges;             // Raw edges in the burst, the real transition included (saturates)
+  uint32_t burstUs;           // First to last raw edge
+  uint32_t settleUs;          // First raw edge to the stable change (0 for a glitch)
+};
+
+struct InputChannelStats {
+  uint32_t changes;           // Stable state changes since boot
+  uint32_t glitches;          // Raw chatter that fell back before its stable time
+  unsigned long lastChangeMs; // millis() of the last change (0 = none)
+};
+
+struct InputSamplerStats {
+  uint32_t samples;
+  uint32_t events;
+  uint32_t overflows;         // Events dropped because the control task fell behind
+  uint32_t burstOverflows;    // Bounce records dropped because the network task fell behind
+};
+
+void initInputSampler();                       // Reads the pins once and starts the timer
+void requestInputResync();                     // Restart from the pins on the next sample (pin settings changed)
+
+// Control task (single consumer)
+bool popInputEvent(InputEvent& event);
+bool takeInputEventOverflow();                 // True once after events were dropped
+
+// Network task (single consumer: the switch health monitor)
+bool popInputBurst(InputBurst& burst);
+
+// Any task
+uint32_t getInputStableMask();
+uint32_t getInputRawMask();                    // Levels at the last sample, before debouncing
+int getInputPin(InputChannel channel);
+int getInputActiveLevel(InputChannel channel);            // Pin level that reads as active
+const char* getInputChannelName(InputChannel channel);
+unsigned long getInputStableTime(InputChannel channel);  // ms, after rounding to whole samples
+void setInputStableTime(InputChannel channel, unsigned long ms);
+InputChannelStats getInputChannelStats(InputChannel channel);
+InputSamplerStats getInputSamplerStats();
+
+#endif // INPUT_SAMPLER_H
@@ -32,11 +32,23 @@
 #include "config.h"
 #include "Debug.h"
 #include "roof_controller.h"
+#include "relay_pulse.h"
+#include "roof_position.h"
+#include "roof_encoder.h"
+#include "control_link.h"
+#include "control_task.h"
+#include "boot_timeline.h"
+#include "perf_profiler.h"
+#include "request_arena.h"
 #include "alpaca_handler.h"
 #include "mqtt_handler.h"
 #include "web_ui_handler.h"
 #include "park_sensor_udp.h"
 #include "gps_handler.h"
+#include "snow_sensor.h"
+#include "roof_resume.h"
+#include "switch_health.h"
+#include "motor_current.h"
 
 // For reset reason detection
 #include "esp_system.h"
@@ -51,6 +63,7 @@ unsigned long apStartTime = 0;
 // Timing variables
 unsigned long lastMqttReconnectAttempt = 0;
 unsigned long lastMqttPublish = 0;
+unsigned long lastPerfPublish = 0;
 unsigned long lastStatusUpdate = 0;
 
 // Reset diagnostics (accessible from web UI)
@@ -75,7 +88,11 @@ String getResetReasonString() {
   }
 }
 
+// Stage 1 (setup, loopTask): hardware and safety inputs, then the control task.
+// Everything that can block on the network is left to networkSetup().
 void setup() {
+  beginBootStage(BOOT_DIAGNOSTICS);
+
   // Initialize debug output
   Debug.begin(115200);
 
@@ -110,19 +127,49 @@ void setup() {
   Debug.println("ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)");
   Debug.println("Version: " + String(DEVICE_VERSION));
   Debug.println("Manufacturer: " + String(DEVICE_MANUFACTURER));
+  endBootStage(BOOT_DIAGNOSTICS);
   
   // Load configuration from preferences
+  beginBootStage(BOOT_CONFIG);
   loadConfiguration();
+  endBootStage(BOOT_CONFIG);
   
   // Initialize roof controller hardware
+  beginBootStage(BOOT_HARDWARE);
   initializeRoofController();
+  initRoofPosition();
+  initSnowSensor();
+  initPerfProfiler();
+  initSwitchHealth();
+  initMotorCurrent();
+  endBootStage(BOOT_HARDWARE);
+
+  // Roof, relay and sensor logic from here on runs in its own task (see roofControlStep())
+  beginBootStage(BOOT_CONTROL_TASK);
+  startControlTask();
+  endBootStage(BOOT_CONTROL_TASK);
+
+  // Network services come up in the background on the other core
+  startNetworkTask(networkSetup, networkLoop);
+
+  Debug.println("Setup complete - roof control running, network starting in background");
+  Debug.printf("Free heap: %d bytes\n", ESP.getFreeHeap());
+}
 
-  // Initialize RTC (DS3231) - do this early to have time available
+// Stage 2 (network task): time, WiFi and services. WiFi joins asynchronously;
+// handleWiFi() finishes the BOOT_WIFI stage once it connects or falls back to AP.
+void networkSetup() {
+  // Initialize RTC (DS3231) - before the services so they have time available
+  beginBootStage(BOOT_RTC);
   initRTC();
+  endBootStage(BOOT_RTC);
 
-  // Initialize WiFi
+  // Start joining WiFi (does not wait for the connection)
+  beginBootStage(BOOT_WIFI);
   initWiFi();
-  
+
+  beginBootStage(BOOT_NETWORK_SERVICES);
+
   // Initialize UDP park sensor listener
   initParkSensorUDP();
   
@@ -138,8 +185,10 @@ void setup() {
 
   // Initialize Web UI
   initWebUI();
+  endBootStage(BOOT_NETWORK_SERVICES);
 
   // Initialize GPS if enabled
+  beginBootStage(BOOT_GPS);
   if (gpsEnabled) {
     initGPS();
   } else {
@@ -150,44 +199,55 @@ void setup() {
   if (gpsNtpEnabled) {
     initNTP();
   }
+  endBootStage(BOOT_GPS);
 
-  Debug.println("Setup complete!");
-  Debug.printf("Free heap: %d bytes\n", ESP.getFreeHeap());
+  Debug.printf("Network services started (free heap: %d bytes)\n", ESP.getFreeHeap());
 }
 
 void loop() {
+  // All work happens in the control and network tasks
+  vTaskDelete(NULL);
+}
+
+// Network task body: everything that talks to the outside world
+void networkLoop() {
   unsigned long currentTime = millis();
+  uint32_t loopStart = perfBegin();
   
   // Handle WiFi connection
+  uint32_t t = perfBegin();
   handleWiFi();
+  perfRecord(PERF_WIFI, t);
   
   // Handle UDP park sensor messages
+  t = perfBegin();
   handleParkSensorUDP();
-
-  // Process non-blocking roof operations (state machine)
-  // This handles relay timing without blocking WiFi/MQTT
-  processRoofOperation();
-
-  // Update roof status
-  updateRoofStatus();
-
-  // Update telescope park status
-  updateTelescopeStatus();
-
-  // Update inverter power status (NEW in v3)
-  updateInverterPowerStatus();
-
-  // Check for movement timeout
-  checkMovementTimeout();
+  perfRecord(PERF_PARK_UDP, t);
+
+  // Command results and MQTT publish requests from the control task
+  t = perfBegin();
+  processControlEvents();
+  flushResumeSnapshot();  // NVS copy of the warm-restart snapshot (coalesced)
+  flushMoveHistory();     // NVS copy of the movement history after a move
+  flushRoofEncoderSpan(); // NVS copy of a learned encoder span
+  flushMotorCurrentEnvelope();  // NVS copy of the motor current envelopes after a fold
+  processSwitchHealth();  // Limit switch bounce records, alerts and their NVS copy
+  perfRecord(PERF_CONTROL_EVENTS, t);
   
   // Handle Alpaca discovery
+  t = perfBegin();
   handleAlpacaDiscovery();
+  perfRecord(PERF_ALPACA_DISCOVERY, t);
 
   // Handle Alpaca endpoint requests
+  t = perfBegin();
   alpacaServer.handleClient();
+  requestArenaReset();  // The response has been sent; drop the handler's scratch memory
+  perfRecord(PERF_ALPACA, t);
   
-  // Handle MQTT
-  if (mqttEnabled) {
+  // Handle MQTT (a connect attempt without WiFi would only block the loop)
+  t = perfBegin();
+  if (mqttEnabled && WiFi.status() == WL_CONNECTED) {
     if (!mqttClient.connected()) {
       if (currentTime - lastMqttReconnectAttempt > 5000) {
         lastMqttReconnectAttempt = currentTime;
@@ -201,19 +261,33 @@ void loop() {
         publishStatusToMQTT();
         lastMqttPublish = currentTime;
       }
+
+      // Loop profile summary, if enabled
+      if (perfMqttEnabled && currentTime - lastPerfPublish > PERF_MQTT_PUBLISH_INTERVAL) {
+        publishPerfToMQTT();
+        lastPerfPublish = currentTime;
+      }
     }
   }
+  perfRecord(PERF_MQTT, t);
   
   // Handle web UI requests
+  t = perfBegin();
   handleWebUI();
+  requestArenaReset();
+  perfRecord(PERF_WEB_UI, t);
 
   // Handle GPS data
   if (gpsEnabled) {
+    t = perfBegin();
     handleGPS();
+    perfRecord(PERF_GPS, t);
   }
 
   // Handle NTP server (independent of GPS - uses GPS or RTC time)
+  t = perfBegin();
   handleNTP();
+  perfRecord(PERF_NTP, t);
 
   // Clear timed out park sensors periodically (every 5 minutes)
   static unsigned long lastSensorCleanup = 0;
@@ -253,11 +327,18 @@ void loop() {
     lastStatusUpdate = currentTime;
   }
   
-  // Small delay to prevent watchdog issues
+  perfRecord(PERF_NETWORK_LOOP, loopStart);
+
+  // Yield so the idle task can feed the watchdog
   delay(10);
 }
 
-// Initialize WiFi connection
+// WiFi connection state (non-blocking)
+bool wifiReconnecting = false;
+unsigned long wifiReconnectStartTime = 0;
+const unsigned long WIFI_RECONNECT_TIMEOUT = 30000;  // 30 seconds max
+
+// Initialize WiFi connection (non-blocking: handleWiFi() watches the join)
 void initWiFi() {
   Debug.println("Initializing WiFi...");
 
@@ -279,24 +360,10 @@ void initWiFi() {
 
     WiFi.begin(ssid, password);
 
-    // Wait up to 30 seconds for connection
-    int attempts = 0;
-    while (WiFi.status() != WL_CONNECTED && attempts < 60) {
-      delay(500);
-      Debug.print(".");
-      attempts++;
-    }
-    Debug.println("");
-
-    if (WiFi.status() == WL_CONNECTED) {
-      Debug.println("WiFi connected successfully!");
-      Debug.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
-      Debug.printf("Signal strength: %d dBm\n", WiFi.RSSI());
-      apMode = false;
-    } else {
-      Debug.printf("Failed to connect to WiFi (status: %d), starting AP mode\n", WiFi.status());
-      startAPMode();
-    }
+    // handleWiFi() falls back to AP mode if this doesn't connect within WIFI_RECONNECT_TIMEOUT
+    apMode = false;
+    wifiReconnecting = true;
+    wifiReconnectStartTime = millis();
   } else {
     Debug.println("No valid WiFi credentials configured, starting AP mode");
     startAPMode();
@@ -320,6 +387,7 @@ void startAPMode() {
     Debug.printf("AP IP address: %s\n", WiFi.softAPIP().toString().c_str());
     apMode = true;
     apStartTime = millis();
+    endBootStage(BOOT_WIFI);
   } else {
     Debug.println("Failed to start AP mode!");
     // Try one more time after a longer delay
@@ -329,17 +397,13 @@ void startAPMode() {
       Debug.printf("AP IP address: %s\n", WiFi.softAPIP().toString().c_str());
       apMode = true;
       apStartTime = millis();
+      endBootStage(BOOT_WIFI);
     } else {
       Debug.println("AP mode failed to start after retry!");
     }
   }
 }
 
-// WiFi reconnection state (non-blocking)
-bool wifiReconnecting = false;
-unsigned long wifiReconnectStartTime = 0;
-const unsigned long WIFI_RECONNECT_TIMEOUT = 30000;  // 30 seconds max
-
 // Handle WiFi connection in main loop (NON-BLOCKING)
 void handleWiFi() {
   if (apMode) {
@@ -368,7 +432,7 @@ void handleWiFi() {
       } else {
         // Already reconnecting - check if we've timed out
         if (millis() - wifiReconnectStartTime > WIFI_RECONNECT_TIMEOUT) {
-          Debug.printf("\nFailed to reconnect after %lu seconds (status: %d), starting AP mode\n",
+          Debug.printf("\nFailed to connect after %lu seconds (status: %d), starting AP mode\n",
                        WIFI_RECONNECT_TIMEOUT / 1000, WiFi.status());
           wifiReconnecting = false;
           startAPMode();
@@ -379,9 +443,12 @@ void handleWiFi() {
     } else {
       // WiFi is connected
       if (wifiReconnecting) {
-        Debug.println("WiFi reconnected successfully!");
+        Debug.println("WiFi connected successfully!");
         Debug.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
+        Debug.printf("Signal strength: %d dBm\n", WiFi.RSSI());
         wifiReconnecting = false;
+        startAlpacaMDNS();
+        endBootStage(BOOT_WIFI);
       }
     }
   }
@@ -0,0 +1,244 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Modbus RTU Master Implementation
+ */
+
+#include "modbus_rtu.h"
+#include "Debug.h"
+#include <atomic>
+
+static const size_t MODBUS_REQUEST_SIZE = 8;
+static const size_t MODBUS_FRAME_MAX = 5 + 2 * MODBUS_MAX_REGISTERS;  // addr, fn, byte count, data, CRC
+static const uint32_t MODBUS_FAST_GAP_US = 1750;  // Fixed T3.5 above 19200 baud
+
+static HardwareSerial* bus = nullptr;
+static uint32_t charUs = 0;           // One 8N1 character (10 bits) at the bus rate
+static uint32_t gapUs = 0;            // T3.5
+
+// Transaction, owned by the polling task
+static bool busy = false;
+static uint8_t expectAddress = 0;
+static uint8_t expectFunction = 0;
+static uint8_t expectCount = 0;
+static uint32_t sentUs = 0;           // When the request was written
+static uint32_t deadlineUs = 0;       // Relative to sentUs: TX time plus the response timeout
+static uint32_t idleFromUs = 0;       // End of the last bus activity (inter-frame gap origin)
+static bool replyReady = false;
+static ModbusReply lastReply;
+static ModbusMasterStats masterStats;
+
+// Set by the UART event task
+static std::atomic<bool> frameEnded(false);
+static std::atomic<uint32_t> frameEndUs(0);
+static std::atomic<bool> uartErrorSeen(false);
+static std::atomic<uint32_t> uartErrorCount(0);
+
+uint16_t modbusCrc16(const uint8_t* data, size_t length) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < length; i++) {
+    crc ^= data[i];
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+    }
+  }
+  return crc;
+}
+
+ModbusResult modbusParseReadReply(const uint8_t* frame, size_t length, uint8_t address,
+                                  uint8_t function, uint8_t count, ModbusReply& reply) {
+  reply.count = 0;
+  reply.exceptionCode = 0;
+  if (length < 5) {
+    return MODBUS_BAD_FRAME;
+  }
+  // CRC is sent low byte first
+  uint16_t crc = (uint16_t)frame[length - 2] | ((uint16_t)frame[length - 1] << 8);
+  if (modbusCrc16(frame, length - 2) != crc) {
+    return MODBUS_CRC_ERROR;
+  }
+  if (frame[0] != address) {
+    return MODBUS_BAD_FRAME;
+  }
+  if (frame[1] == (function | 0x80) && length == 5) {
+    reply.exceptionCode = frame[2];
+    return MODBUS_EXCEPTION;
+  }
+  if (frame[1] != function || count > MODBUS_MAX_REGISTERS ||
+      frame[2] != count * 2 || length != 5 + (size_t)count * 2) {
+    return MODBUS_BAD_FRAME;
+  }
+  for (uint8_t i = 0; i < count; i++) {
+    reply.registers[i] = ((uint16_t)frame[3 + 2 * i] << 8) | frame[4 + 2 * i];  // Big-endian
+  }
+  reply.count = count;
+  return MODBUS_OK;
+}
+
+// UART event task: the line has been idle for MODBUS_RX_TIMEOUT_SYMBOLS after data
+static void onFrameEnd() {
+  frameEndUs.store(micros(), std::memory_order_relaxed);
+  frameEnded.store(true, std::memory_order_release);
+}
+
+static void onUartError(hardwareSerial_error_t error) {
+  uartErrorSeen.store(true, std::memory_order_relaxed);
+  uartErrorCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void modbusBegin(HardwareSerial& serial, unsigned long baud, int rxPin, int txPin, int dePin) {
+  bus = &serial;
+  charUs = (uint32_t)((10UL * 1000000UL + baud - 1) / baud);
+  gapUs = baud > 19200 ? MODBUS_FAST_GAP_US : (charUs * 7 + 1) / 2;
+
+  serial.begin(baud, SERIAL_8N1, rxPin, txPin);
+  serial.setPins(-1, -1, -1, dePin);         // RTS is the RE/DE line
+  serial.setMode(UART_MODE_RS485_HALF_DUPLEX);
+  serial.setRxTimeout(MODBUS_RX_TIMEOUT_SYMBOLS);
+  serial.onReceive(onFrameEnd, true);        // Only on the RX timeout, not per FIFO threshold
+  serial.onReceiveError(onUartError);
+
+  busy = false;
+  replyReady = false;
+  idleFromUs = micros();
+  Debug.printf("Modbus RTU master: %lu baud, char %luus, T3.5 %luus\n",
+               baud, (unsigned long)charUs, (unsigned long)gapUs);
+}
+
+bool modbusStarted() {
+  return bus != nullptr;
+}
+
+static void drainRx() {
+  while (bus->available()) {
+    bus->read();
+  }
+}
+
+bool modbusReadRegisters(uint8_t address, uint8_t function, uint16_t start, uint8_t count) {
+  if (bus == nullptr || busy || count == 0 || count > MODBUS_MAX_REGISTERS) {
+    return false;
+  }
+  uint32_t nowUs = micros();
+  if (nowUs - idleFromUs < gapUs) {
+    return false;
+  }
+
+  uint8_t frame[MODBUS_REQUEST_SIZE];
+  frame[0] = address;
+  frame[1] = function;
+  frame[2] = start >> 8;
+  frame[3] = start & 0xFF;
+  frame[4] = 0;
+  frame[5] = count;
+  uint16_t crc = modbusCrc16(frame, 6);
+  frame[6] = crc & 0xFF;
+  frame[7] = crc >> 8;
+
+  // Anything left in the FIFO is a late reply to an earlier request
+  drainRx();
+  frameEnded.store(false, std::memory_order_relaxed);
+  uartErrorSeen.store(false, std::memory_order_relaxed);
+
+  // 8 bytes always fit the TX FIFO, so this returns at once
+  bus->write(frame, sizeof(frame));
+  busy = true;
+  replyReady = false;
+  expectAddress = address;
+  expectFunction = function;
+  expectCount = count;
+  sentUs = nowUs;
+  deadlineUs = charUs * MODBUS_REQUEST_SIZE + MODBUS_RESPONSE_TIMEOUT_MS * 1000UL;
+  masterStats.requests++;
+  return true;
+}
+
+static void finishTransaction(ModbusResult result, uint32_t endUs) {
+  lastReply.result = result;
+  lastReply.roundTripUs = result == MODBUS_TIMEOUT ? 0 : endUs - sentUs;
+  lastReply.completeUs = endUs;
+  busy = false;
+  replyReady = true;
+  idleFromUs = endUs;
+
+  switch (result) {
+    case MODBUS_OK:
+      masterStats.replies++;
+      masterStats.lastRoundTripUs = lastReply.roundTripUs;
+      if (lastReply.roundTripUs > masterStats.maxRoundTripUs) {
+        masterStats.maxRoundTripUs = lastReply.roundTripUs;
+      }
+      break;
+    case MODBUS_TIMEOUT:    masterStats.timeouts++; break;
+    case MODBUS_CRC_ERROR:  masterStats.crcErrors++; break;
+    case MODBUS_EXCEPTION:  masterStats.exceptions++; break;
+    case MODBUS_BAD_FRAME:  masterStats.badFrames++; break;
+    default:                break;
+  }
+}
+
+void modbusPoll() {
+  if (bus == nullptr || !busy) {
+    return;
+  }
+
+  if (frameEnded.exchange(false, std::memory_order_acquire)) {
+    uint32_t endUs = frameEndUs.load(std::memory_order_relaxed);
+    uint8_t frame[MODBUS_FRAME_MAX];
+    size_t length = 0;
+    bool overflow = false;
+    while (bus->available()) {
+      int c = bus->read();
+      if (length < sizeof(frame)) {
+        frame[length++] = (uint8_t)c;
+      } else {
+        overflow = true;
+      }
+    }
+    if (uartErrorSeen.exchange(false)) {
+      finishTransaction(MODBUS_UART_ERROR, endUs);
+    } else if (overflow) {
+      finishTransaction(MODBUS_BAD_FRAME, endUs);
+    } else {
+      finishTransaction(modbusParseReadReply(frame, length, expectAddress, expectFunction,
+                                             expectCount, lastReply), endUs);
+    }
+    return;
+  }
+
+  uint32_t nowUs = micros();
+  if (nowUs - sentUs >= deadlineUs) {
+    finishTransaction(MODBUS_TIMEOUT, nowUs);
+  }
+}
+
+bool modbusTakeReply(ModbusReply& reply) {
+  if (!replyReady) {
+    return false;
+  }
+  replyReady = false;
+  reply = lastReply;
+  return true;
+}
+
+bool modbusBusy() {
+  return busy;
+}
+
+ModbusMasterStats getModbusMasterStats() {
+  ModbusMasterStats stats = masterStats;
+  stats.uartErrors = uartErrorCount.load(std::memory_order_relaxed);
+  return stats;
+}
+
+const char* getModbusResultString(ModbusResult result) {
+  switch (result) {
+    case MODBUS_PENDING:    return "pending";
+    case MODBUS_OK:         return "ok";
+    case MODBUS_TIMEOUT:    return "timeout";
+    case MODBUS_CRC_ERROR:  return "crc_error";
+    case MODBUS_EXCEPTION:  return "exception";
+    case MODBUS_BAD_FRAME:  return "bad_frame";
+    case MODBUS_UART_ERROR: return "uart_error";
+    default:                return "unknown";
+  }
+}
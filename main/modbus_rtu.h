@@ -0,0 +1,70 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Modbus RTU Master Header
+ *
+ * One request at a time on one RS485 bus, never blocking the caller. The
+ * UART runs in RS485 half-duplex mode so the hardware drives RE/DE around
+ * each transmission, and its RX timeout (a few idle character times) marks
+ * the end of a reply frame. The UART event task only flags that frame end;
+ * modbusPoll() reads, checks and parses the frame from the caller's task and
+ * also times out missing replies. Requests keep the T3.5 inter-frame gap.
+ */
+
+#ifndef MODBUS_RTU_H
+#define MODBUS_RTU_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum ModbusResult : uint8_t {
+  MODBUS_PENDING,
+  MODBUS_OK,
+  MODBUS_TIMEOUT,             // No complete frame within MODBUS_RESPONSE_TIMEOUT_MS
+  MODBUS_CRC_ERROR,
+  MODBUS_EXCEPTION,           // Slave answered with an exception code
+  MODBUS_BAD_FRAME,           // Wrong address, function, length or byte count
+  MODBUS_UART_ERROR           // Framing, parity or overrun error during the reply
+};
+
+struct ModbusReply {
+  ModbusResult result;
+  uint8_t exceptionCode;      // MODBUS_EXCEPTION only
+  uint8_t count;              // Registers in registers[] (MODBUS_OK only)
+  uint16_t registers[MODBUS_MAX_REGISTERS];
+  uint32_t roundTripUs;       // Request write to reply frame end (0 on timeout)
+  uint32_t completeUs;        // micros() when the transaction finished
+};
+
+struct ModbusMasterStats {
+  uint32_t requests;
+  uint32_t replies;           // MODBUS_OK
+  uint32_t timeouts;
+  uint32_t crcErrors;
+  uint32_t exceptions;
+  uint32_t badFrames;
+  uint32_t uartErrors;
+  uint32_t lastRoundTripUs;
+  uint32_t maxRoundTripUs;
+};
+
+uint16_t modbusCrc16(const uint8_t* data, size_t length);
+
+// Check and decode a read-registers reply (functions 0x03/0x04)
+ModbusResult modbusParseReadReply(const uint8_t* frame, size_t length, uint8_t address,
+                                  uint8_t function, uint8_t count, ModbusReply& reply);
+
+// Take the UART and switch it to RS485 half-duplex (dePin driven by the UART)
+void modbusBegin(HardwareSerial& serial, unsigned long baud, int rxPin, int txPin, int dePin);
+bool modbusStarted();
+
+// Send a read request; false while a transaction is running or the bus is
+// still inside the inter-frame gap
+bool modbusReadRegisters(uint8_t address, uint8_t function, uint16_t start, uint8_t count);
+void modbusPoll();                                   // Finish or time out the transaction
+bool modbusTakeReply(ModbusReply& reply);            // True once per finished transaction
+bool modbusBusy();
+
+ModbusMasterStats getModbusMasterStats();
+const char* getModbusResultString(ModbusResult result);
+
+#endif // MODBUS_RTU_H
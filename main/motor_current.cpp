@@ -0,0 +1,510 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Motor Current Implementation
+ */
+
+#include "motor_current.h"
+#include "roof_controller.h"
+#include "roof_errors.h"
+#include "roof_trace.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include <esp_adc/adc_continuous.h>
+#include <atomic>
+#include <string.h>
+
+// Define the global variable declared as extern in config.h
+int MOTOR_CURRENT_PIN = DEFAULT_MOTOR_CURRENT_PIN;
+
+static const uint32_t FRAME_BYTES = MOTOR_CURRENT_FRAME_SAMPLES * SOC_ADC_DIGI_RESULT_BYTES;
+static const uint32_t BIN_SAMPLES = MOTOR_CURRENT_BIN_MS * MOTOR_CURRENT_SAMPLE_HZ / 1000;
+static const uint32_t INRUSH_SAMPLES = MOTOR_CURRENT_INRUSH_MS * MOTOR_CURRENT_SAMPLE_HZ / 1000;
+static const uint32_t TRIP_SAMPLES = MOTOR_CURRENT_TRIP_MS * MOTOR_CURRENT_SAMPLE_HZ / 1000;
+static const uint8_t INRUSH_BINS = (MOTOR_CURRENT_INRUSH_MS + MOTOR_CURRENT_BIN_MS - 1) / MOTOR_CURRENT_BIN_MS;
+static const uint8_t OUTCOME_DISCARDED = 0xFF;
+
+// ADC driver and the pin it was started for (control task)
+static adc_continuous_handle_t adcHandle = nullptr;
+static adc_channel_t adcChannel = ADC_CHANNEL_0;
+static int adcPin = -1;
+static std::atomic<uint32_t> poolOverflows(0);  // Counted from the driver's ISR
+static uint8_t frameBuffer[FRAME_BYTES];
+
+// Zero offset and the RMS window (squares of zero-referenced samples)
+static bool zeroSeeded = false;
+static bool zeroTracking = false;       // Roof at rest: samples may move the zero
+static int32_t zeroScaled = 0;          // Zero << MOTOR_CURRENT_ZERO_SHIFT
+static uint32_t windowSquares[MOTOR_CURRENT_RMS_SAMPLES];
+static uint16_t windowHead = 0;
+static uint16_t windowFill = 0;
+static uint32_t windowSum = 0;
+static uint32_t windowMeanSquare = 0;
+static uint32_t sampleCount = 0;
+
+// Run being profiled
+static bool running = false;
+static MotorCurrentProfile run;
+static unsigned long runMoveBegin = 0;
+static uint8_t runBaseCount = 0;        // Move history as the run started, to find its record
+static uint16_t runBaseSequence = 0;
+static uint32_t runSamples = 0;
+static uint32_t binMaxMeanSquare = 0;
+static uint32_t runMaxMeanSquare = 0;
+static uint64_t runningSquares = 0;     // After the inrush
+static uint32_t runningSamples = 0;
+static bool lastK2 = false;
+
+// Envelope check
+static bool watching = false;
+static uint16_t threshold = 0;
+static uint32_t thresholdSquare = 0;
+static uint8_t thresholdBin = 0xFF;
+static uint32_t overSamples = 0;        // Consecutive samples with the RMS over the threshold
+static uint32_t tripCount = 0;
+static uint16_t lastTripRms = 0;
+static uint16_t lastTripThreshold = 0;
+
+// Finished runs, newest last
+static MotorCurrentProfile profiles[MOTOR_CURRENT_PROFILES];
+static uint8_t profileHead = 0;         // Next slot to write
+static uint8_t profileCount = 0;
+
+// Learned envelopes as stored in NVS
+struct EnvelopeStore {
+  uint16_t binMs;                       // Layout guard: bins learned at another resolution are dropped
+  uint16_t rmsSamples;                  // ...as are RMS values over another window
+  MotorCurrentEnvelope directions[2];   // MOVE_OPEN, MOVE_CLOSE
+};
+static EnvelopeStore store;
+
+// Seqlock over store: odd while the control task folds a run in or clears it.
+// flushMotorCurrentEnvelope() copies it out between changes and writes the
+// copy from the network task, so the control step never waits on flash.
+static std::atomic<uint32_t> storeSeq(0);
+static uint32_t storeSavedSeq = 0;      // Network task: storeSeq at the last NVS write
+static uint32_t envelopeSaves = 0;      // Network task
+
+static uint16_t isqrt32(uint32_t value) {
+  uint32_t root = 0;
+  uint32_t bit = 1UL << 30;
+  while (bit > value) bit >>= 2;
+  while (bit != 0) {
+    if (value >= root + bit) {
+      value -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+  return (uint16_t)root;
+}
+
+static MotorCurrentEnvelope& envelopeFor(uint8_t direction) {
+  return store.directions[direction == MOVE_CLOSE ? 1 : 0];
+}
+
+static void resetStore() {
+  memset(&store, 0, sizeof(store));
+  store.binMs = MOTOR_CURRENT_BIN_MS;
+  store.rmsSamples = MOTOR_CURRENT_RMS_SAMPLES;
+}
+
+static void beginStoreChange() {
+  storeSeq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void endStoreChange() {
+  storeSeq.fetch_add(1, std::memory_order_release);
+}
+
+void flushMotorCurrentEnvelope() {
+  uint32_t seq = storeSeq.load(std::memory_order_acquire);
+  if ((seq & 1) || seq == storeSavedSeq) {
+    return;
+  }
+
+  static EnvelopeStore copy;
+  copy = store;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (storeSeq.load(std::memory_order_relaxed) != seq) {
+    return;  // Folded into while copying; the next pass gets the settled version
+  }
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBytes(PREF_MOTOR_CURRENT_ENVELOPE, &copy, sizeof(copy));
+  prefs.end();
+  storeSavedSeq = seq;
+  envelopeSaves++;
+}
+
+void initMotorCurrent() {
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);  // Read-only
+  resetStore();
+  if (prefs.getBytesLength(PREF_MOTOR_CURRENT_ENVELOPE) == sizeof(store)) {
+    prefs.getBytes(PREF_MOTOR_CURRENT_ENVELOPE, &store, sizeof(store));
+    if (store.binMs != MOTOR_CURRENT_BIN_MS || store.rmsSamples != MOTOR_CURRENT_RMS_SAMPLES ||
+        store.directions[0].bins > MOTOR_CURRENT_BINS || store.directions[1].bins > MOTOR_CURRENT_BINS) {
+      Debug.println("Motor current envelope in NVS does not match this build - discarding");
+      resetStore();
+    }
+  }
+  prefs.end();
+
+  Debug.printf("Motor current envelope: open %u runs, close %u runs\n",
+               store.directions[0].moves, store.directions[1].moves);
+}
+
+void clearMotorCurrentEnvelope() {
+  beginStoreChange();
+  resetStore();
+  endStoreChange();
+  watching = false;
+  Debug.println("Motor current envelope cleared");
+}
+
+static bool IRAM_ATTR onPoolOverflow(adc_continuous_handle_t handle, const adc_continuous_evt_data_t* edata,
+                                     void* userData) {
+  poolOverflows.fetch_add(1, std::memory_order_relaxed);
+  return false;  // No task to wake
+}
+
+static void releaseAdc() {
+  if (adcHandle == nullptr) {
+    return;
+  }
+  adc_continuous_stop(adcHandle);
+  adc_continuous_deinit(adcHandle);
+  adcHandle = nullptr;
+}
+
+// One ADC1 channel converted continuously into the driver pool; ADC2 is
+// shared with the WiFi radio and cannot run in continuous mode alongside it
+static bool buildAdc(int pin) {
+  adc_unit_t unit;
+  if (adc_continuous_io_to_channel(pin, &unit, &adcChannel) != ESP_OK || unit != ADC_UNIT_1) {
+    return false;
+  }
+
+  adc_continuous_handle_cfg_t handleConfig = {};
+  handleConfig.max_store_buf_size = FRAME_BYTES * MOTOR_CURRENT_POOL_FRAMES;
+  handleConfig.conv_frame_size = FRAME_BYTES;
+  if (adc_continuous_new_handle(&handleConfig, &adcHandle) != ESP_OK) {
+    adcHandle = nullptr;
+    return false;
+  }
+
+  adc_digi_pattern_config_t pattern = {};
+  pattern.atten = ADC_ATTEN_DB_12;
+  pattern.channel = adcChannel;
+  pattern.unit = ADC_UNIT_1;
+  pattern.bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+  adc_continuous_config_t config = {};
+  config.pattern_num = 1;
+  config.adc_pattern = &pattern;
+  config.sample_freq_hz = MOTOR_CURRENT_SAMPLE_HZ;
+  config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+  config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+  adc_continuous_evt_cbs_t callbacks = {};
+  callbacks.on_pool_ovf = onPoolOverflow;
+
+  bool ok = adc_continuous_config(adcHandle, &config) == ESP_OK &&
+            adc_continuous_register_event_callbacks(adcHandle, &callbacks, nullptr) == ESP_OK &&
+            adc_continuous_start(adcHandle) == ESP_OK;
+  if (!ok) {
+    releaseAdc();
+  }
+  return ok;
+}
+
+// Forget everything measured on the old pin
+static void resetSamplingState() {
+  zeroSeeded = false;
+  zeroScaled = 0;
+  memset(windowSquares, 0, sizeof(windowSquares));
+  windowHead = 0;
+  windowFill = 0;
+  windowSum = 0;
+  windowMeanSquare = 0;
+  running = false;
+  watching = false;
+  overSamples = 0;
+  poolOverflows.store(0, std::memory_order_relaxed);
+}
+
+void applyMotorCurrentPin() {
+  if (MOTOR_CURRENT_PIN == adcPin && (adcHandle != nullptr || adcPin < 0)) {
+    return;  // Restarting would throw away the zero for nothing
+  }
+
+  releaseAdc();
+  resetSamplingState();
+  adcPin = MOTOR_CURRENT_PIN;
+
+  if (MOTOR_CURRENT_PIN < 0) {
+    Debug.println("Motor current: no sensor");
+    return;
+  }
+  if (!buildAdc(MOTOR_CURRENT_PIN)) {
+    Debug.printf("Motor current: continuous ADC setup failed on GPIO%d (ADC1 pins only)\n", MOTOR_CURRENT_PIN);
+    return;
+  }
+  Debug.printf("Motor current: ADC1 channel %d on GPIO%d at %lu Hz\n", (int)adcChannel, MOTOR_CURRENT_PIN,
+               (unsigned long)MOTOR_CURRENT_SAMPLE_HZ);
+}
+
+bool isMotorCurrentConfigured() {
+  return adcHandle != nullptr;
+}
+
+static bool envelopeArmed(const MotorCurrentEnvelope& envelope) {
+  return envelope.moves >= MOTOR_CURRENT_MIN_MOVES && envelope.bins > 0;
+}
+
+// The envelope around a bin, one bin either side to absorb start-up jitter;
+// a run from mid-travel is lined up with the learned runs only for its inrush
+static uint16_t envelopeReference(const MotorCurrentEnvelope& envelope, uint8_t bin, bool fromLimit) {
+  if (bin >= envelope.bins || (!fromLimit && bin >= INRUSH_BINS)) {
+    return envelope.steadyMax;
+  }
+  uint16_t reference = envelope.rms[bin];
+  if (bin > 0 && envelope.rms[bin - 1] > reference) reference = envelope.rms[bin - 1];
+  if (bin + 1 < envelope.bins && envelope.rms[bin + 1] > reference) reference = envelope.rms[bin + 1];
+  return reference;
+}
+
+static void updateThreshold(uint8_t bin) {
+  uint32_t reference = envelopeReference(envelopeFor(run.direction), bin, run.fromLimit);
+  uint32_t level = reference + reference * MOTOR_CURRENT_MARGIN_PERCENT / 100 + MOTOR_CURRENT_MARGIN_COUNTS;
+  threshold = level > 0xFFFF ? 0xFFFF : (uint16_t)level;
+  thresholdSquare = (uint32_t)threshold * threshold;
+  thresholdBin = bin;
+}
+
+static void trip() {
+  uint16_t rms = isqrt32(windowMeanSquare);
+  uint32_t overMs = overSamples * 1000 / MOTOR_CURRENT_SAMPLE_HZ;
+  tripCount++;
+  lastTripRms = rms;
+  lastTripThreshold = threshold;
+  watching = false;
+  Debug.printf("Motor current: RMS %u over the %s envelope (%u) for %lums\n", rms,
+               run.direction == MOVE_OPEN ? "open" : "close", threshold, (unsigned long)overMs);
+  traceRecord(TRACE_SENSOR_FAULT, micros(), ROOF_ERR_MOTOR_OVERCURRENT, overMs > 0xFFFF ? 0xFFFF : (uint16_t)overMs);
+  faultRoofMovement(ROOF_ERR_MOTOR_OVERCURRENT, overMs, MOVE_OBSTRUCTED);
+}
+
+static void closeBin(uint8_t bin) {
+  run.rms[bin] = isqrt32(binMaxMeanSquare);
+  if (bin + 1 > run.bins) run.bins = bin + 1;
+  binMaxMeanSquare = 0;
+}
+
+static void processSample(int32_t raw) {
+  sampleCount++;
+  if (!zeroSeeded) {
+    if (!zeroTracking) return;  // No zero yet: nothing to measure against
+    zeroScaled = raw << MOTOR_CURRENT_ZERO_SHIFT;
+    zeroSeeded = true;
+  }
+  int32_t zero = zeroScaled >> MOTOR_CURRENT_ZERO_SHIFT;
+  int32_t value = raw - zero;
+  if (zeroTracking && value < (int32_t)MOTOR_CURRENT_MARGIN_COUNTS && value > -(int32_t)MOTOR_CURRENT_MARGIN_COUNTS) {
+    zeroScaled += value;  // EWMA: zero += (raw - zero) / 2^shift
+  }
+
+  uint32_t square = (uint32_t)(value * value);
+  windowSum += square - windowSquares[windowHead];
+  windowSquares[windowHead] = square;
+  windowHead = (windowHead + 1) % MOTOR_CURRENT_RMS_SAMPLES;
+  if (windowFill < MOTOR_CURRENT_RMS_SAMPLES) windowFill++;
+  windowMeanSquare = windowSum / windowFill;
+
+  if (!running) {
+    return;
+  }
+
+  uint32_t index = runSamples++;
+  uint32_t binIndex = index / BIN_SAMPLES;
+  uint8_t bin = binIndex < MOTOR_CURRENT_BINS ? (uint8_t)binIndex : MOTOR_CURRENT_BINS - 1;
+  if (bin != 0 && index % BIN_SAMPLES == 0 && binIndex < MOTOR_CURRENT_BINS) {
+    closeBin(bin - 1);
+  }
+
+  uint32_t magnitude = value < 0 ? -value : value;
+  if (index < INRUSH_SAMPLES) {
+    if (magnitude > run.inrushPeak) {
+      run.inrushPeak = (uint16_t)magnitude;
+      run.inrushPeakMs = (uint16_t)(index * 1000 / MOTOR_CURRENT_SAMPLE_HZ);
+    }
+  } else {
+    runningSquares += square;
+    runningSamples++;
+  }
+  if (windowMeanSquare > binMaxMeanSquare) binMaxMeanSquare = windowMeanSquare;
+  if (windowMeanSquare > runMaxMeanSquare) runMaxMeanSquare = windowMeanSquare;
+
+  if (!watching) {
+    return;
+  }
+  if (bin != thresholdBin) {
+    updateThreshold(bin);
+  }
+  if (windowMeanSquare <= thresholdSquare) {
+    overSamples = 0;
+    return;
+  }
+  if (++overSamples >= TRIP_SAMPLES) {
+    trip();
+  }
+}
+
+// Drain what the DMA collected since the last step (bounded: a pool's worth)
+static void drainPool() {
+  for (uint32_t reads = 0; reads <= MOTOR_CURRENT_POOL_FRAMES; reads++) {
+    uint32_t length = 0;
+    if (adc_continuous_read(adcHandle, frameBuffer, sizeof(frameBuffer), &length, 0) != ESP_OK || length == 0) {
+      return;
+    }
+    for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES) {
+      const adc_digi_output_data_t* result = (const adc_digi_output_data_t*)&frameBuffer[i];
+      if (result->type2.unit == ADC_UNIT_1 && result->type2.channel == adcChannel) {
+        processSample(result->type2.data);
+      }
+    }
+  }
+}
+
+static void startRun(const ActiveMove& move) {
+  memset(&run, 0, sizeof(run));
+  run.direction = move.direction;
+  run.outcome = OUTCOME_DISCARDED;
+  run.fromLimit = (move.direction == MOVE_OPEN) ? lastClosedSwitchState : lastOpenSwitchState;
+  running = true;
+  runMoveBegin = move.beginTime;
+  runBaseCount = getMoveHistoryCount();
+  runBaseSequence = runBaseCount > 0 ? getMoveRecord(runBaseCount - 1).sequence : 0;
+  runSamples = 0;
+  binMaxMeanSquare = 0;
+  runMaxMeanSquare = 0;
+  runningSquares = 0;
+  runningSamples = 0;
+  overSamples = 0;
+  thresholdBin = 0xFF;
+}
+
+// Pull the envelope up to a run at once, and down toward it slowly
+static void foldIntoEnvelope(const MotorCurrentProfile& profile) {
+  MotorCurrentEnvelope& envelope = envelopeFor(profile.direction);
+  beginStoreChange();
+  for (uint8_t b = 0; b < profile.bins; b++) {
+    if (envelope.moves == 0 || b >= envelope.bins || profile.rms[b] >= envelope.rms[b]) {
+      envelope.rms[b] = profile.rms[b];
+    } else {
+      envelope.rms[b] -= (envelope.rms[b] - profile.rms[b]) / MOTOR_CURRENT_ENVELOPE_DECAY;
+    }
+  }
+  if (profile.bins > envelope.bins) envelope.bins = profile.bins;
+  if (envelope.moves < 255) envelope.moves++;
+
+  uint8_t first = envelope.bins > INRUSH_BINS ? INRUSH_BINS : 0;
+  envelope.steadyMax = 0;
+  for (uint8_t b = first; b < envelope.bins; b++) {
+    if (envelope.rms[b] > envelope.steadyMax) envelope.steadyMax = envelope.rms[b];
+  }
+  endStoreChange();
+}
+
+static void finishRun() {
+  running = false;
+  watching = false;
+  if (runSamples == 0) {
+    return;  // Nothing converted (sensor just configured)
+  }
+  uint32_t lastBin = (runSamples - 1) / BIN_SAMPLES;
+  closeBin(lastBin < MOTOR_CURRENT_BINS ? (uint8_t)lastBin : MOTOR_CURRENT_BINS - 1);
+  run.runningRms = runningSamples > 0 ? isqrt32((uint32_t)(runningSquares / runningSamples)) : 0;
+  run.maxRms = isqrt32(runMaxMeanSquare);
+  run.durationMs = runSamples * 1000 / MOTOR_CURRENT_SAMPLE_HZ;
+
+  // The move's record, if it ended with one (a discarded move leaves none)
+  uint8_t count = getMoveHistoryCount();
+  if (count > 0) {
+    const MoveRecord& record = getMoveRecord(count - 1);
+    if (count != runBaseCount || record.sequence != runBaseSequence) {
+      run.sequence = record.sequence;
+      run.outcome = record.outcome;
+    }
+  }
+
+  profiles[profileHead] = run;
+  profileHead = (profileHead + 1) % MOTOR_CURRENT_PROFILES;
+  if (profileCount < MOTOR_CURRENT_PROFILES) profileCount++;
+
+  if (run.outcome == MOVE_COMPLETED && run.fromLimit) {
+    foldIntoEnvelope(run);
+  }
+}
+
+void updateMotorCurrent() {
+  if (adcHandle == nullptr) {
+    return;
+  }
+
+  // Samples already converted belong to the state of the last step
+  drainPool();
+
+  const ActiveMove& move = telemetryActiveMove();
+  if (running && (move.direction == MOVE_NONE || move.beginTime != runMoveBegin)) {
+    finishRun();
+  }
+
+  // Each K2 press during a move starts a run; only the last one of the move is kept
+  bool k2 = isRelayEnergized(RELAY_K2);
+  if (k2 && !lastK2 && move.direction != MOVE_NONE) {
+    startRun(move);
+  }
+  lastK2 = k2;
+
+  zeroTracking = move.direction == MOVE_NONE && roofOpState == OP_IDLE && !k2 &&
+                 (roofStatus == ROOF_OPEN || roofStatus == ROOF_CLOSED);
+  watching = running && envelopeArmed(envelopeFor(run.direction)) && roofOpState == OP_IDLE &&
+             (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING);
+  if (!watching) {
+    overSamples = 0;
+  }
+}
+
+MotorCurrentStats getMotorCurrentStats() {
+  MotorCurrentStats stats;
+  stats.configured = isMotorCurrentConfigured();
+  stats.channel = (uint8_t)adcChannel;
+  stats.zero = (uint16_t)(zeroScaled >> MOTOR_CURRENT_ZERO_SHIFT);
+  stats.rms = isqrt32(windowMeanSquare);
+  stats.threshold = watching ? threshold : 0;
+  stats.monitoring = watching;
+  stats.samples = sampleCount;
+  stats.overflows = poolOverflows.load(std::memory_order_relaxed);
+  stats.trips = tripCount;
+  stats.lastTripRms = lastTripRms;
+  stats.lastTripThreshold = lastTripThreshold;
+  stats.envelopeSaves = envelopeSaves;
+  return stats;
+}
+
+const MotorCurrentEnvelope& getMotorCurrentEnvelope(MoveDirection direction) {
+  return envelopeFor(direction);
+}
+
+uint8_t getMotorCurrentProfileCount() {
+  return profileCount;
+}
+
+const MotorCurrentProfile& getMotorCurrentProfile(uint8_t index) {
+  return profiles[(profileHead + MOTOR_CURRENT_PROFILES - profileCount + index) % MOTOR_CURRENT_PROFILES];
+}
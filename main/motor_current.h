@@ -0,0 +1,79 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Motor Current Header
+ *
+ * Optional current sensor on the opener supply. ADC1 converts it in
+ * continuous mode at MOTOR_CURRENT_SAMPLE_HZ straight into the driver's DMA
+ * pool, and the control step drains the pool each pass. Samples are taken
+ * about a zero offset tracked while the roof is at rest, squared into a
+ * fixed-size ring with a running sum (windowed RMS, integer only), and
+ * folded into a profile of each motor run: inrush peak and its time after
+ * the K2 press, running RMS and the largest windowed RMS per
+ * MOTOR_CURRENT_BIN_MS bin.
+ *
+ * Completed runs from a limit switch teach a per-direction envelope, kept
+ * in NVS (written from the network task). Once a direction has
+ * MOTOR_CURRENT_MIN_MOVES runs behind it, an RMS that stays above the
+ * envelope (plus margin) for MOTOR_CURRENT_TRIP_MS
+ * stops the roof with motor_overcurrent - long before the encoder or the
+ * movement timeout would notice a roof pushing against an obstruction.
+ */
+
+#ifndef MOTOR_CURRENT_H
+#define MOTOR_CURRENT_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "roof_telemetry.h"
+
+// One motor run: from a K2 press during a move to the next press or the move's end
+struct MotorCurrentProfile {
+  uint16_t sequence;                  // Move record sequence (matches /api/telemetry), 0 if not recorded
+  uint8_t direction;                  // MoveDirection
+  uint8_t outcome;                    // MoveOutcome (0xFF: move discarded)
+  bool fromLimit;                     // Started at the departure limit switch
+  uint8_t bins;                       // Bins filled
+  uint16_t inrushPeak;                // Largest |sample| in the first MOTOR_CURRENT_INRUSH_MS (ADC counts)
+  uint16_t inrushPeakMs;              // ...and when it came after the press
+  uint16_t runningRms;                // RMS over the run after the inrush
+  uint16_t maxRms;                    // Largest windowed RMS
+  uint32_t durationMs;
+  uint16_t rms[MOTOR_CURRENT_BINS];   // Largest windowed RMS per bin
+};
+
+// Learned per direction from completed runs that started at a limit switch
+struct MotorCurrentEnvelope {
+  uint8_t moves;                      // Runs folded in (saturates at 255)
+  uint8_t bins;                       // Bins learned
+  uint16_t steadyMax;                 // Largest bin after the inrush (bound for runs from mid-travel)
+  uint16_t rms[MOTOR_CURRENT_BINS];
+};
+
+struct MotorCurrentStats {
+  bool configured;                    // Pin set and the ADC converting
+  uint8_t channel;                    // ADC1 channel of MOTOR_CURRENT_PIN
+  uint16_t zero;                      // Sensor output at no current (ADC counts)
+  uint16_t rms;                       // Latest windowed RMS
+  uint16_t threshold;                 // Trip level in force, 0 when not watching
+  bool monitoring;                    // A run is being checked against the envelope
+  uint32_t samples;                   // Conversions processed
+  uint32_t overflows;                 // DMA frames lost to a full pool
+  uint32_t trips;                     // Moves stopped as obstructed
+  uint16_t lastTripRms;
+  uint16_t lastTripThreshold;
+  uint32_t envelopeSaves;             // NVS writes of the envelope
+};
+
+void initMotorCurrent();                        // Load the learned envelopes from NVS
+void applyMotorCurrentPin();                    // (Re)start continuous conversion on MOTOR_CURRENT_PIN (control task)
+void updateMotorCurrent();                      // Control step: drain the pool, profile the run, check the envelope
+void clearMotorCurrentEnvelope();               // Forget what was learned (control task)
+void flushMotorCurrentEnvelope();               // Network task: NVS copy of the envelopes after a change
+
+bool isMotorCurrentConfigured();
+MotorCurrentStats getMotorCurrentStats();
+const MotorCurrentEnvelope& getMotorCurrentEnvelope(MoveDirection direction);
+uint8_t getMotorCurrentProfileCount();
+const MotorCurrentProfile& getMotorCurrentProfile(uint8_t index);  // 0 = oldest
+
+#endif // MOTOR_CURRENT_H
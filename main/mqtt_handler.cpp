@@ -6,6 +6,10 @@
 #include "mqtt_handler.h"
 #include "roof_controller.h"
 #include "park_sensor_udp.h"
+#include "control_link.h"
+#include "snow_sensor.h"
+#include "safety_monitor.h"
+#include "perf_profiler.h"
 #include "Debug.h"
 #include <Arduino.h>
 
@@ -23,6 +27,9 @@ uint16_t mqttKeepalive = DEFAULT_MQTT_KEEPALIVE;  // Keepalive in seconds (broke
 char mqttTopicStatus[MQTT_TOPIC_SIZE];
 char mqttTopicCommand[MQTT_TOPIC_SIZE];
 char mqttTopicAvailability[MQTT_TOPIC_SIZE];
+char mqttTopicPosition[MQTT_TOPIC_SIZE];
+char mqttTopicPerf[MQTT_TOPIC_SIZE];
+char mqttTopicSwitchHealth[MQTT_TOPIC_SIZE];
 
 // Initialize MQTT client
 WiFiClient espClient;
@@ -89,12 +96,18 @@ void setupMQTT() {
   snprintf(mqttTopicStatus, MQTT_TOPIC_SIZE, "%s/status", mqttTopicPrefix);
   snprintf(mqttTopicCommand, MQTT_TOPIC_SIZE, "%s/command", mqttTopicPrefix);
   snprintf(mqttTopicAvailability, MQTT_TOPIC_SIZE, "%s/availability", mqttTopicPrefix);
+  snprintf(mqttTopicPosition, MQTT_TOPIC_SIZE, "%s/position", mqttTopicPrefix);
+  snprintf(mqttTopicPerf, MQTT_TOPIC_SIZE, "%s/perf", mqttTopicPrefix);
+  snprintf(mqttTopicSwitchHealth, MQTT_TOPIC_SIZE, "%s/switch_health", mqttTopicPrefix);
   
   // Debug print the constructed topics
   Serial.println("MQTT Topics:");
   Serial.printf("  Status: %s\n", mqttTopicStatus);
   Serial.printf("  Command: %s\n", mqttTopicCommand);
   Serial.printf("  Availability: %s\n", mqttTopicAvailability);
+  Serial.printf("  Position: %s\n", mqttTopicPosition);
+  Serial.printf("  Perf: %s\n", mqttTopicPerf);
+  Serial.printf("  Switch health: %s/<switch>\n", mqttTopicSwitchHealth);
   
   mqttClient.setServer(mqttServer, mqttPort);
   mqttClient.setKeepAlive(mqttKeepalive);  // Set keepalive interval
@@ -160,15 +173,28 @@ void mqttCallback(char* topic, byte* payload, unsigned int length) {
   
   // Handle commands
   if (String(topic) == mqttTopicCommand) {
+    // Hand the command to the control task; the result shows up in the next status publish
     if (message == "OPEN") {
-      startOpeningRoof();
+      queueRoofCommand(CMD_OPEN, SOURCE_MQTT);
     } else if (message == "CLOSE") {
-      startClosingRoof();
+      queueRoofCommand(CMD_CLOSE, SOURCE_MQTT);
     } else if (message == "STOP") {
-      stopRoofMovement();
+      queueRoofCommand(CMD_STOP, SOURCE_MQTT);
+    } else if (message == "PREWARM") {
+      queueRoofCommand(CMD_PREWARM, SOURCE_MQTT);
+    } else if (message.startsWith("MOVETO:")) {
+      // Part-open position in percent (needs a calibrated roof encoder)
+      uint8_t percent;
+      if (parseRoofTargetPercent(message.c_str() + 7, percent)) {
+        queueRoofCommand(CMD_MOVE_TO, SOURCE_MQTT, percent);
+      } else {
+        Debug.println("MQTT MOVETO ignored - percent must be 0-100: " + message.substring(7));
+      }
     } else if (message == "DISCOVER") {
       // Special command to force discovery
       forceDiscovery();
+    } else if (message == "PERF_RESET") {
+      resetPerfStats();
     }
   }
 }
@@ -186,16 +212,26 @@ void publishStatusToMQTT() {
   }
   
   // Create JSON document
-  DynamicJsonDocument doc(512);
+  DynamicJsonDocument doc(1024);
   
+  // One consistent view of the control state for the whole payload
+  RoofSnapshot snap = getRoofSnapshot();
+
   // Ensure the status field is present and correctly formatted
-  String statusString = getRoofStatusString();
+  String statusString = getRoofStatusString(snap.status);
   doc["status"] = statusString;
   doc["slaved"] = slaved;
-  doc["telescope_parked"] = telescopeParked;
-  doc["limit_open"] = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
-  doc["limit_closed"] = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
+  doc["telescope_parked"] = snap.telescopeParked;
+  doc["limit_open"] = snap.limitOpen;
+  doc["limit_closed"] = snap.limitClosed;
   doc["bypass_enabled"] = bypassParkSensor;
+  if (snap.position >= 0) {
+    doc["position"] = snap.position;
+  }
+  doc["stall_warning"] = snap.stallWarning;
+  if (snap.error.code != ROOF_ERR_NONE) {
+    doc["error_code"] = getRoofErrorId(snap.error.code);  // Full text via /api/status
+  }
 
   // Add device identification information
   doc["device_id"] = uniqueID;
@@ -209,8 +245,22 @@ void publishStatusToMQTT() {
   doc["closed_switch_pin"] = LIMIT_SWITCH_CLOSED_PIN;
 
   // Add inverter power state information (NEW in v3)
-  doc["inverter_relay_state"] = getInverterRelayState();
-  doc["inverter_ac_power_state"] = getInverterACPowerState();
+  doc["inverter_relay_state"] = snap.inverterRelay;
+  doc["inverter_ac_power_state"] = snap.inverterACPower;
+
+  // Weather inputs
+  doc["rain_detected"] = snap.rainDetected;
+  doc["snow_detected"] = snap.snowDetected;
+  doc["rain_lockout"] = snap.rainLockout;
+  doc["safe"] = isConditionSafe();
+  if (snowModbusEnabled) {
+    doc["snow_sensor_online"] = snap.snowSensor.online;
+    doc["snow_sensor_snow"] = snap.snowSensor.snow;
+    if (snap.snowSensor.lastReplyMs != 0) {
+      doc["snow_sensor_age_ms"] = millis() - snap.snowSensor.lastReplyMs;
+      doc["snow_sensor_value"] = snap.snowSensor.registers[SNOW_MODBUS_VALUE_INDEX];
+    }
+  }
 
   // Add park sensor information
   doc["park_sensor_type"] = static_cast<int>(parkSensorType);
@@ -254,6 +304,74 @@ void publishStatusToMQTT() {
   }
 }
 
+// Publish the roof position (0-100) on its own small topic so it can go out at a high rate while moving
+void publishPositionToMQTT(int position) {
+  if (!mqttEnabled || !mqttClient.connected()) {
+    return;  // Quietly skip - this runs several times a second during motion
+  }
+
+  char payload[8];
+  snprintf(payload, sizeof(payload), "%d", position);
+  mqttClient.publish(mqttTopicPosition, payload, true);
+}
+
+// Publish the loop profile summary (min/avg/p99/max per section, in us)
+void publishPerfToMQTT() {
+  if (!mqttEnabled || !mqttClient.connected()) {
+    return;
+  }
+
+  DynamicJsonDocument doc(2048);
+  doc["window_s"] = perfStatsAgeMs() / 1000;
+
+  for (int i = 0; i < PERF_SECTION_COUNT; i++) {
+    PerfHistogram hist = getPerfHistogram((PerfSection)i);
+    if (hist.count == 0) continue;
+    JsonArray section = doc.createNestedArray(getPerfSectionName((PerfSection)i));
+    section.add(hist.minUs);
+    section.add((uint32_t)(hist.totalUs / hist.count));
+    section.add(getPerfPercentileUs(hist, 99));
+    section.add(hist.maxUs);
+  }
+
+  String payload;
+  serializeJson(doc, payload);
+  if (!mqttClient.publish(mqttTopicPerf, payload.c_str())) {
+    Debug.println("Failed to publish loop profile");
+  }
+}
+
+// Publish a limit switch's health alert state, retained so a dashboard sees a worn switch after it reconnects
+bool publishSwitchHealthToMQTT(LimitSwitchId id) {
+  if (!mqttEnabled || !mqttClient.connected()) {
+    return false;
+  }
+
+  SwitchHealthTrend trend = getSwitchHealthTrend(id);
+  SwitchHealthTotals totals = getSwitchHealthTotals(id);
+  DynamicJsonDocument doc(512);
+  doc["switch"] = getSwitchKey(id);
+  doc["alert"] = trend.alertReasons != 0;
+  JsonArray reasons = doc.createNestedArray("reasons");
+  for (uint8_t bit = 1; bit != 0 && bit <= SWITCH_ALERT_GLITCHES; bit <<= 1) {
+    if (trend.alertReasons & bit) reasons.add(getSwitchAlertReasonName((SwitchAlertReason)bit));
+  }
+  doc["recent_mean_bounces"] = trend.recentMean;
+  doc["baseline_mean_bounces"] = trend.baselineMean;
+  doc["transitions"] = totals.transitions;
+  doc["glitches"] = totals.glitches;
+
+  char topic[MQTT_TOPIC_SIZE + 8];
+  snprintf(topic, sizeof(topic), "%s/%s", mqttTopicSwitchHealth, getSwitchKey(id));
+  String payload;
+  serializeJson(doc, payload);
+  if (!mqttClient.publish(topic, payload.c_str(), true)) {
+    Debug.println("Failed to publish switch health");
+    return false;
+  }
+  return true;
+}
+
 // Simplified publishDiscovery function to add configuration URL without using helper functions
 void publishDiscovery() {
   // If MQTT is disabled or not connected, don't publish discovery
@@ -309,6 +427,11 @@ void publishDiscovery() {
     doc["state_closed"] = "closed";
     doc["state_opening"] = "opening";
     doc["state_closing"] = "closing";
+
+    // Estimated position (0 = closed, 100 = open)
+    doc["position_topic"] = mqttTopicPosition;
+    doc["position_open"] = 100;
+    doc["position_closed"] = 0;
     
     // Custom icons for different states
     doc["icon_open"] = "mdi:garage-open";
@@ -7,6 +7,7 @@
 #define MQTT_HANDLER_H
 
 #include "config.h"
+#include "switch_health.h"
 #include "PubSubClient.h"
 #include <WiFi.h>
 #include <ArduinoJson.h>
@@ -23,6 +24,9 @@ extern uint16_t mqttKeepalive;  // MQTT keepalive interval in seconds
 extern char mqttTopicStatus[MQTT_TOPIC_SIZE];
 extern char mqttTopicCommand[MQTT_TOPIC_SIZE];
 extern char mqttTopicAvailability[MQTT_TOPIC_SIZE];
+extern char mqttTopicPosition[MQTT_TOPIC_SIZE];
+extern char mqttTopicPerf[MQTT_TOPIC_SIZE];
+extern char mqttTopicSwitchHealth[MQTT_TOPIC_SIZE];  // Base; one retained subtopic per limit switch
 
 // External references
 extern WiFiClient espClient;
@@ -39,6 +43,9 @@ void setupMQTT();
 void reconnectMQTT();
 void mqttCallback(char* topic, byte* payload, unsigned int length);
 void publishStatusToMQTT();
+void publishPositionToMQTT(int position);  // Retained, rate-limited by roof_position
+void publishPerfToMQTT();                  // Loop profile summary, when perfMqttEnabled
+bool publishSwitchHealthToMQTT(LimitSwitchId id);  // Retained alert state; false = not sent
 void publishDiscovery();
 void forceDiscovery();
 String getRoofStatusString();
@@ -7,6 +7,7 @@
 #include "Debug.h"
 #include "web_ui_handler.h"
 #include <Preferences.h>
+#include <atomic>
 
 // Global variables
 WiFiUDP parkSensorUdp;
@@ -15,6 +16,9 @@ std::vector<String> enabledSensorUuids;
 ParkSensorType parkSensorType = PARK_SENSOR_PHYSICAL;  // Default to physical sensor
 bool udpParkSensorSystemEnabled = false;
 
+// Verdict of the UDP sensors, recomputed by the network task for the control task
+static std::atomic<bool> udpParkVerdict(true);
+
 // Preferences keys for park sensors
 #define PREF_PARK_SENSOR_TYPE "parkSensorType"
 #define PREF_PARK_SENSOR_COUNT "parkSensorCount"
@@ -40,6 +44,7 @@ void initParkSensorUDP() {
 // Handle incoming UDP park sensor messages
 void handleParkSensorUDP() {
   if (!udpParkSensorSystemEnabled) {
+    refreshUdpParkVerdict();
     return;
   }
   
@@ -62,6 +67,17 @@ void handleParkSensorUDP() {
   
   // Update sensor status (check for timeouts)
   updateParkSensorStatus();
+  refreshUdpParkVerdict();
+}
+
+// The sensor map is owned by the network task; the control task only ever
+// reads this cached verdict
+void refreshUdpParkVerdict() {
+  udpParkVerdict.store(isTelescopeParkedUDP(), std::memory_order_release);
+}
+
+bool getUdpParkVerdict() {
+  return udpParkVerdict.load(std::memory_order_acquire);
 }
 
 // Process a park sensor message - FIXED VERSION
@@ -67,6 +67,8 @@ void handleParkSensorUDP();
 void processParkSensorMessage(const String& message, IPAddress remoteIP);
 void updateParkSensorStatus();
 bool isTelescopeParkedUDP();
+void refreshUdpParkVerdict();          // Network task: cache isTelescopeParkedUDP()
+bool getUdpParkVerdict();              // Control task: last cached verdict
 void addParkSensor(const String& uuid);
 void removeParkSensor(const String& uuid);
 void removeAllParkSensors();
@@ -0,0 +1,143 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Loop Profiler Implementation
+ */
+
+#include "perf_profiler.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include <atomic>
+#include <string.h>
+
+bool perfMqttEnabled = false;
+
+static PerfHistogram perfHistograms[PERF_SECTION_COUNT];
+static std::atomic<uint32_t> perfGeneration(1);
+static std::atomic<unsigned long> perfResetMs(0);
+static uint32_t cyclesPerUs = 0;
+
+static const char* const PERF_SECTION_NAMES[PERF_SECTION_COUNT] = {
+  "network_loop",
+  "wifi",
+  "park_udp",
+  "control_events",
+  "alpaca_discovery",
+  "alpaca",
+  "mqtt",
+  "web_ui",
+  "gps",
+  "ntp",
+  "control_step",
+  "roof_commands",
+  "roof_operation",
+  "relay_pulses",
+  "sensors",
+  "position",
+  "snapshot",
+  "input_sampler"
+};
+
+void initPerfProfiler() {
+  cyclesPerUs = ESP.getCpuFreqMHz();
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);
+  perfMqttEnabled = prefs.getBool(PREF_PERF_MQTT, false);
+  prefs.end();
+
+  Debug.printf("Loop profiler: %lu cycles/us, MQTT publish %s\n",
+               (unsigned long)cyclesPerUs, perfMqttEnabled ? "on" : "off");
+}
+
+void setPerfMqttEnabled(bool enabled) {
+  perfMqttEnabled = enabled;
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBool(PREF_PERF_MQTT, perfMqttEnabled);
+  prefs.end();
+
+  Debug.printf("Loop profile MQTT publishing %s\n", enabled ? "enabled" : "disabled");
+}
+
+void perfRecord(PerfSection section, uint32_t startCycles) {
+  uint32_t cycles = ESP.getCycleCount() - startCycles;
+  if (section >= PERF_SECTION_COUNT || cyclesPerUs == 0) return;
+  uint32_t us = cycles / cyclesPerUs;
+
+  PerfHistogram& hist = perfHistograms[section];
+  uint32_t generation = perfGeneration.load(std::memory_order_relaxed);
+  if (hist.generation != generation) {
+    memset(&hist, 0, sizeof(hist));
+    hist.generation = generation;
+    hist.minUs = UINT32_MAX;
+  }
+
+  hist.count++;
+  hist.totalUs += us;
+  if (us < hist.minUs) hist.minUs = us;
+  if (us > hist.maxUs) hist.maxUs = us;
+
+  uint8_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+  if (bucket >= PERF_HISTOGRAM_BUCKETS) bucket = PERF_HISTOGRAM_BUCKETS - 1;
+  hist.buckets[bucket]++;
+
+  // Keep the slowest samples, slowest first
+  if (us > hist.worst[PERF_WORST_COUNT - 1].us) {
+    int i = PERF_WORST_COUNT - 1;
+    while (i > 0 && hist.worst[i - 1].us < us) {
+      hist.worst[i] = hist.worst[i - 1];
+      i--;
+    }
+    hist.worst[i].us = us;
+    hist.worst[i].atMs = millis();
+  }
+}
+
+PerfHistogram getPerfHistogram(PerfSection section) {
+  PerfHistogram hist;
+  memset(&hist, 0, sizeof(hist));
+  if (section >= PERF_SECTION_COUNT) return hist;
+
+  uint32_t generation = perfGeneration.load(std::memory_order_relaxed);
+  if (perfHistograms[section].generation == generation) {
+    hist = perfHistograms[section];
+  }
+  if (hist.count == 0) hist.minUs = 0;
+  return hist;
+}
+
+uint32_t getPerfPercentileUs(const PerfHistogram& hist, uint8_t percent) {
+  if (hist.count == 0) return 0;
+
+  uint64_t target = ((uint64_t)hist.count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (uint8_t i = 0; i < PERF_HISTOGRAM_BUCKETS; i++) {
+    seen += hist.buckets[i];
+    if (seen >= target) {
+      if (i == PERF_HISTOGRAM_BUCKETS - 1) return hist.maxUs;
+      uint32_t upper = i == 0 ? 1 : (1UL << i);
+      return upper < hist.maxUs ? upper : hist.maxUs;
+    }
+  }
+  return hist.maxUs;
+}
+
+const char* getPerfSectionName(PerfSection section) {
+  return section < PERF_SECTION_COUNT ? PERF_SECTION_NAMES[section] : "unknown";
+}
+
+const char* getPerfSectionTask(PerfSection section) {
+  if (section >= PERF_INPUT_SAMPLER) return "input_timer";
+  return section >= PERF_CONTROL_STEP ? "control" : "network";
+}
+
+void resetPerfStats() {
+  perfGeneration.fetch_add(1, std::memory_order_relaxed);
+  perfResetMs.store(millis(), std::memory_order_relaxed);
+  Debug.println("Loop profile statistics reset");
+}
+
+unsigned long perfStatsAgeMs() {
+  return millis() - perfResetMs.load(std::memory_order_relaxed);
+}
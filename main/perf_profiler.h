@@ -0,0 +1,78 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Loop Profiler Header
+ *
+ * Times each subsystem call in the network loop and the control step (and the
+ * input sampler timer) with the CPU cycle counter and keeps a fixed-bucket histogram per section. Every
+ * section is only ever recorded from one task, so recording takes no locks;
+ * readers copy the histogram and may see it mid-update, which is fine for
+ * diagnostics. Served at GET /api/perf and optionally published over MQTT.
+ */
+
+#ifndef PERF_PROFILER_H
+#define PERF_PROFILER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum PerfSection {
+  // Network task (networkLoop)
+  PERF_NETWORK_LOOP,       // Whole network loop iteration, excluding the yield
+  PERF_WIFI,               // handleWiFi
+  PERF_PARK_UDP,           // handleParkSensorUDP
+  PERF_CONTROL_EVENTS,     // processControlEvents
+  PERF_ALPACA_DISCOVERY,   // handleAlpacaDiscovery
+  PERF_ALPACA,             // alpacaServer.handleClient
+  PERF_MQTT,               // mqttClient.loop / reconnect / periodic publish
+  PERF_WEB_UI,             // handleWebUI
+  PERF_GPS,                // handleGPS
+  PERF_NTP,                // handleNTP
+  // Control task (roofControlStep)
+  PERF_CONTROL_STEP,       // Whole control step
+  PERF_ROOF_COMMANDS,      // processRoofCommands
+  PERF_ROOF_OPERATION,     // processRoofOperation
+  PERF_RELAY_PULSES,       // processRelayPulses
+  PERF_SENSORS,            // Roof, telescope, snow sensor and inverter status updates
+  PERF_POSITION,           // checkMovementTimeout + updateRoofPosition
+  PERF_SNAPSHOT,           // publishRoofSnapshot, updateResumeSnapshot, traceRoofState
+  // Input sampler timer (esp_timer task)
+  PERF_INPUT_SAMPLER,      // One sample and debounce of every input
+  PERF_SECTION_COUNT
+};
+
+struct PerfWorstSample {
+  uint32_t us;
+  unsigned long atMs;      // Uptime when it happened
+};
+
+struct PerfHistogram {
+  uint32_t generation;     // Reset generation this data belongs to
+  uint32_t count;
+  uint32_t minUs;
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t buckets[PERF_HISTOGRAM_BUCKETS];
+  PerfWorstSample worst[PERF_WORST_COUNT];  // Slowest first
+};
+
+// Start a timing; pass the result to perfRecord() when the section ends
+inline uint32_t perfBegin() {
+  return ESP.getCycleCount();
+}
+
+void perfRecord(PerfSection section, uint32_t startCycles);
+
+// Readers (network task)
+PerfHistogram getPerfHistogram(PerfSection section);  // Zeroed if reset since last sample
+uint32_t getPerfPercentileUs(const PerfHistogram& hist, uint8_t percent);  // Bucket upper edge, capped at max
+const char* getPerfSectionName(PerfSection section);
+const char* getPerfSectionTask(PerfSection section);  // "network", "control" or "input_timer"
+void resetPerfStats();                  // Takes effect at each section's next sample
+unsigned long perfStatsAgeMs();         // Time since the last reset (or boot)
+
+// Optional MQTT publishing of the summary (persisted)
+extern bool perfMqttEnabled;
+void initPerfProfiler();
+void setPerfMqttEnabled(bool enabled);
+
+#endif // PERF_PROFILER_H
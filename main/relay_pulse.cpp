@@ -0,0 +1,116 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Relay Pulse Scheduler Implementation
+ */
+
+#include "relay_pulse.h"
+#include "Debug.h"
+#include <Arduino.h>
+
+static const char* const RELAY_NAMES[RELAY_COUNT] = {"K1", "K2", "K3"};
+
+enum PulsePhase : uint8_t {
+  PULSE_IDLE,
+  PULSE_PRESSED,        // Relay energized, waiting holdMs
+  PULSE_SETTLING        // Relay released, waiting settleMs
+};
+
+struct RelayPulse {
+  unsigned long holdMs;
+  unsigned long settleMs;
+};
+
+struct RelayPulseChannel {
+  RelayPulse queue[RELAY_PULSE_QUEUE_DEPTH];
+  uint8_t head;         // Next pulse to run
+  uint8_t count;        // Pulses waiting (excluding the one in progress)
+  PulsePhase phase;
+  RelayPulse current;
+  unsigned long phaseStartTime;
+};
+
+static RelayPulseChannel pulseChannels[RELAY_COUNT];
+
+bool queueRelayPulse(RelayId relay, unsigned long holdMs, unsigned long settleMs) {
+  if (relay >= RELAY_COUNT) {
+    return false;
+  }
+
+  RelayPulseChannel& ch = pulseChannels[relay];
+  if (ch.count >= RELAY_PULSE_QUEUE_DEPTH) {
+    Debug.printf("Relay %s pulse queue full - press dropped\n", RELAY_NAMES[relay]);
+    return false;
+  }
+
+  uint8_t tail = (ch.head + ch.count) % RELAY_PULSE_QUEUE_DEPTH;
+  ch.queue[tail].holdMs = holdMs;
+  ch.queue[tail].settleMs = settleMs;
+  ch.count++;
+
+  Debug.printf("Relay %s pulse queued (%lums, %u pending)\n", RELAY_NAMES[relay], holdMs, ch.count);
+
+  // Start straight away if the relay is free, rather than waiting for the next loop
+  processRelayPulses();
+  return true;
+}
+
+bool isRelayPulseActive(RelayId relay) {
+  if (relay >= RELAY_COUNT) {
+    return false;
+  }
+  const RelayPulseChannel& ch = pulseChannels[relay];
+  return ch.phase != PULSE_IDLE || ch.count > 0;
+}
+
+void cancelRelayPulses(RelayId relay) {
+  if (relay >= RELAY_COUNT) {
+    return;
+  }
+  RelayPulseChannel& ch = pulseChannels[relay];
+  if (ch.phase == PULSE_PRESSED) {
+    writeRelay(relay, LOW);
+  }
+  ch.phase = PULSE_IDLE;
+  ch.count = 0;
+}
+
+void processRelayPulses() {
+  unsigned long currentTime = millis();
+
+  for (uint8_t r = 0; r < RELAY_COUNT; r++) {
+    RelayId relay = (RelayId)r;
+    RelayPulseChannel& ch = pulseChannels[r];
+
+    switch (ch.phase) {
+      case PULSE_PRESSED:
+        if (currentTime - ch.phaseStartTime >= ch.current.holdMs) {
+          writeRelay(relay, LOW);
+          Debug.printf("Relay %s pulse RELEASED\n", RELAY_NAMES[r]);
+          ch.phase = PULSE_SETTLING;
+          ch.phaseStartTime = currentTime;
+        }
+        break;
+
+      case PULSE_SETTLING:
+        if (currentTime - ch.phaseStartTime >= ch.current.settleMs) {
+          ch.phase = PULSE_IDLE;
+        }
+        break;
+
+      default:
+        break;
+    }
+
+    // Start the next pulse once the relay is free. A relay held by the roof
+    // state machine (e.g. K2 during a sequence) is left alone until it releases.
+    if (ch.phase == PULSE_IDLE && ch.count > 0 && !isRelayEnergized(relay)) {
+      ch.current = ch.queue[ch.head];
+      ch.head = (ch.head + 1) % RELAY_PULSE_QUEUE_DEPTH;
+      ch.count--;
+      writeRelay(relay, HIGH);
+      Debug.printf("Relay %s pulse PRESSED (%lums)\n", RELAY_NAMES[r], ch.current.holdMs);
+      ch.phase = PULSE_PRESSED;
+      ch.phaseStartTime = currentTime;
+    }
+  }
+}
@@ -0,0 +1,30 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Relay Pulse Scheduler Header
+ *
+ * Queues timed button presses on K1/K2/K3 and runs them from the main loop,
+ * so manual controls (web UI buttons) return immediately instead of holding
+ * the loop in delay() for the length of the press.
+ */
+
+#ifndef RELAY_PULSE_H
+#define RELAY_PULSE_H
+
+#include "roof_controller.h"
+
+const uint8_t RELAY_PULSE_QUEUE_DEPTH = 4;   // Pending pulses per relay
+
+// Queue a pulse: energize for holdMs, then keep the relay released for settleMs
+// before the next pulse on the same relay. Returns false if the queue is full.
+bool queueRelayPulse(RelayId relay, unsigned long holdMs, unsigned long settleMs = 0);
+
+// True while a pulse is pressed, settling or waiting in the queue
+bool isRelayPulseActive(RelayId relay);
+
+// Drop queued pulses and release any pulse in progress on this relay
+void cancelRelayPulses(RelayId relay);
+
+// Advance all relay pulses - call from the main loop
+void processRelayPulses();
+
+#endif // RELAY_PULSE_H
@@ -0,0 +1,170 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Request Arena Implementation
+ */
+
+#include "request_arena.h"
+#include "Debug.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Every block carries its size so realloc can copy; blocks stay 8-byte aligned
+struct ArenaBlockHeader {
+  size_t size;
+  size_t reserved;
+};
+
+static const size_t ARENA_ALIGN = 8;
+
+alignas(ARENA_ALIGN) static uint8_t arenaBuffer[REQUEST_ARENA_SIZE];
+static size_t arenaUsed = 0;
+static uint8_t* arenaLastBlock = nullptr;   // Most recent block (can be freed/grown in place)
+static uint32_t arenaLiveBlocks = 0;        // Arena blocks only; heap fallbacks are tracked below
+static void* arenaHeapBlocks[REQUEST_ARENA_HEAP_BLOCKS];
+static uint8_t arenaHeapCount = 0;
+
+static RequestArenaStats arenaStats = {REQUEST_ARENA_SIZE, 0, 0, 0, 0, 0, 0};
+
+static inline size_t alignUp(size_t n) {
+  return (n + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+}
+
+static inline bool inArena(const void* ptr) {
+  const uint8_t* p = (const uint8_t*)ptr;
+  return p >= arenaBuffer && p < arenaBuffer + REQUEST_ARENA_SIZE;
+}
+
+static inline ArenaBlockHeader* headerOf(void* ptr) {
+  return (ArenaBlockHeader*)((uint8_t*)ptr - sizeof(ArenaBlockHeader));
+}
+
+static int findHeapBlock(const void* ptr) {
+  for (uint8_t i = 0; i < arenaHeapCount; i++) {
+    if (arenaHeapBlocks[i] == ptr) return i;
+  }
+  return -1;
+}
+
+void* requestArenaAlloc(size_t size) {
+  size_t needed = sizeof(ArenaBlockHeader) + alignUp(size);
+  if (needed > REQUEST_ARENA_SIZE - arenaUsed) {
+    // Too big for what is left: fall back to the heap and count it
+    arenaStats.overflows++;
+    if (size > arenaStats.overflowBytes) arenaStats.overflowBytes = size;
+    if (arenaHeapCount >= REQUEST_ARENA_HEAP_BLOCKS) {
+      Debug.printf("Request arena: no slot for a %lu byte heap fallback\n", (unsigned long)size);
+      return nullptr;
+    }
+    void* ptr = malloc(size);
+    if (ptr) arenaHeapBlocks[arenaHeapCount++] = ptr;
+    return ptr;
+  }
+
+  ArenaBlockHeader* header = (ArenaBlockHeader*)(arenaBuffer + arenaUsed);
+  header->size = size;
+  arenaLastBlock = (uint8_t*)(header + 1);
+  arenaUsed += needed;
+  if (arenaUsed > arenaStats.highWater) arenaStats.highWater = arenaUsed;
+  arenaLiveBlocks++;
+  return arenaLastBlock;
+}
+
+void requestArenaFree(void* ptr) {
+  if (!ptr) return;
+
+  if (!inArena(ptr)) {
+    // A block the last reset already freed is no longer in the table
+    int slot = findHeapBlock(ptr);
+    if (slot < 0) return;
+    free(ptr);
+    arenaHeapBlocks[slot] = arenaHeapBlocks[--arenaHeapCount];
+    return;
+  }
+  if (arenaLiveBlocks > 0) arenaLiveBlocks--;
+
+  // Only the most recent block gives its space back before the reset
+  if (ptr == arenaLastBlock) {
+    arenaUsed = (uint8_t*)headerOf(ptr) - arenaBuffer;
+    arenaLastBlock = nullptr;
+  }
+}
+
+void* requestArenaRealloc(void* ptr, size_t size) {
+  if (!ptr) return requestArenaAlloc(size);
+  if (!inArena(ptr)) {
+    int slot = findHeapBlock(ptr);
+    if (slot < 0) return nullptr;
+    void* moved = realloc(ptr, size);
+    if (moved) arenaHeapBlocks[slot] = moved;
+    return moved;
+  }
+
+  ArenaBlockHeader* header = headerOf(ptr);
+  size_t oldSize = header->size;
+
+  if (ptr == arenaLastBlock) {
+    // Grow or shrink in place
+    size_t start = (uint8_t*)ptr - arenaBuffer;
+    if (alignUp(size) <= REQUEST_ARENA_SIZE - start) {
+      header->size = size;
+      arenaUsed = start + alignUp(size);
+      if (arenaUsed > arenaStats.highWater) arenaStats.highWater = arenaUsed;
+      return ptr;
+    }
+  } else if (size <= oldSize) {
+    header->size = size;  // Shrink (shrinkToFit); the tail is reclaimed at the reset
+    return ptr;
+  }
+
+  void* moved = requestArenaAlloc(size);
+  if (!moved) return nullptr;
+  memcpy(moved, ptr, oldSize < size ? oldSize : size);
+  requestArenaFree(ptr);
+  return moved;
+}
+
+void requestArenaReset() {
+  if (arenaUsed == 0 && arenaLiveBlocks == 0 && arenaHeapCount == 0) return;  // No request used it
+
+  if (arenaLiveBlocks > 0) {
+    // A handler kept a document alive past its response; nothing points into the arena after this
+    arenaStats.leaks += arenaLiveBlocks;
+    Debug.printf("Request arena reset with %lu live blocks\n", (unsigned long)arenaLiveBlocks);
+    arenaLiveBlocks = 0;
+  }
+  if (arenaHeapCount > 0) {
+    // Same for heap fallbacks, which would otherwise never be freed
+    arenaStats.heapLeaks += arenaHeapCount;
+    Debug.printf("Request arena reset freed %u live heap fallbacks\n", arenaHeapCount);
+    while (arenaHeapCount > 0) {
+      free(arenaHeapBlocks[--arenaHeapCount]);
+    }
+  }
+  arenaUsed = 0;
+  arenaLastBlock = nullptr;
+  arenaStats.requests++;
+}
+
+RequestArenaStats getRequestArenaStats() {
+  return arenaStats;
+}
+
+const char* serializeJsonToArena(const JsonDocument& doc, size_t* length) {
+  size_t len = measureJson(doc);
+  char* buffer = (char*)requestArenaAlloc(len + 1);
+  if (!buffer) return nullptr;
+  serializeJson(doc, buffer, len + 1);
+  if (length) *length = len;
+  return buffer;
+}
+
+void sendJsonResponse(WebServer& server, int code, const JsonDocument& doc) {
+  size_t len = 0;
+  const char* body = serializeJsonToArena(doc, &len);
+  if (!body) {
+    server.send(500, "text/plain", "Out of memory");
+    return;
+  }
+  server.send_P(code, "application/json", body, len);
+  requestArenaFree((void*)body);
+}
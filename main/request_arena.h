@@ -0,0 +1,56 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Request Arena Header
+ *
+ * HTTP handlers build their JSON documents and serialized responses in a
+ * fixed bump arena instead of the general heap. Nothing is freed
+ * individually (except the most recent block); the whole arena is reset in
+ * one step after each request, so handler scratch memory can no longer
+ * fragment the heap. When a request needs more than REQUEST_ARENA_SIZE the
+ * allocation falls back to malloc and is counted, so the size can be tuned;
+ * the reset frees any heap fallback the request left behind.
+ *
+ * Network task only: both web servers are serviced from networkLoop().
+ */
+
+#ifndef REQUEST_ARENA_H
+#define REQUEST_ARENA_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WebServer.h>
+#include "config.h"
+
+struct RequestArenaStats {
+  size_t size;
+  size_t highWater;          // Most arena bytes any one request used
+  uint32_t requests;         // Arena resets (one per serviced request)
+  uint32_t overflows;        // Allocations that fell back to the heap
+  size_t overflowBytes;      // Largest single heap fallback
+  uint32_t leaks;            // Arena blocks still live at a reset (should stay 0)
+  uint32_t heapLeaks;        // Heap fallbacks still live at a reset, freed there (should stay 0)
+};
+
+void* requestArenaAlloc(size_t size);
+void* requestArenaRealloc(void* ptr, size_t size);
+void requestArenaFree(void* ptr);
+void requestArenaReset();          // Call once the response has been sent
+RequestArenaStats getRequestArenaStats();
+
+// ArduinoJson allocator backed by the arena
+struct RequestArenaAllocator {
+  void* allocate(size_t size) { return requestArenaAlloc(size); }
+  void deallocate(void* ptr) { requestArenaFree(ptr); }
+  void* reallocate(void* ptr, size_t size) { return requestArenaRealloc(ptr, size); }
+};
+
+typedef BasicJsonDocument<RequestArenaAllocator> RequestJsonDocument;
+
+// Serialize a document into the arena (NUL-terminated); nullptr if out of memory.
+// Release with requestArenaFree() once sent.
+const char* serializeJsonToArena(const JsonDocument& doc, size_t* length = nullptr);
+
+// Serialize into the arena and send it, without building a String
+void sendJsonResponse(WebServer& server, int code, const JsonDocument& doc);
+
+#endif // REQUEST_ARENA_H
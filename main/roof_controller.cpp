@@ -5,9 +5,20 @@
 
 #include "roof_controller.h"
 #include "mqtt_handler.h"
+#include "control_link.h"
 #include "park_sensor_udp.h"
+#include "relay_pulse.h"
+#include "roof_telemetry.h"
+#include "roof_errors.h"
+#include "input_sampler.h"
+#include "safety_monitor.h"
+#include "roof_resume.h"
+#include "roof_trace.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
 #include "Debug.h"
 #include <Arduino.h>
+#include <atomic>
 
 // Define the global variables declared as extern in config.h
 int LIMIT_SWITCH_OPEN_PIN = DEFAULT_OPEN_SWITCH_PIN;    // Default to pin 35
@@ -19,7 +30,15 @@ bool movementTimeoutEnabled = DEFAULT_TIMEOUT_ENABLED;  // Timeout monitoring en
 unsigned long limitSwitchTimeout = DEFAULT_LIMIT_SWITCH_TIMEOUT; // Limit switch change timeout (default: 5 seconds)
 bool limitSwitchTimeoutEnabled = DEFAULT_LIMIT_SWITCH_TIMEOUT_ENABLED; // Limit switch timeout monitoring enabled (default: true)
 unsigned long inverterDelay1 = DEFAULT_INVERTER_DELAY1; // Delay between K1 and K3 (default: 750ms)
+bool inverterAcSequencing = false;              // Advance on stable AC power instead of waiting out the delays
 unsigned long inverterDelay2 = DEFAULT_INVERTER_DELAY2; // Delay between inverter power-on and K2 (default: 1500ms)
+unsigned long inverterKeepWarmMinutes = 0;      // Inverter left on after a move (0 = off)
+unsigned long inverterPrewarmMinutes = 0;       // Inverter held ready for an expected open (0 = off)
+bool inverterPrewarmOnConnect = false;          // Pre-warm when an Alpaca client connects
+bool rainAutoCloseEnabled = false;              // Close the roof when the RG9 trips
+unsigned long rainHoldoffMs = DEFAULT_RAIN_HOLDOFF;
+unsigned long rainReopenLockoutMs = DEFAULT_RAIN_REOPEN_LOCKOUT;
+bool snowAutoCloseEnabled = false;              // Close the roof when the RS485 snow sensor reports snow
 
 // Limit switch states
 bool lastOpenSwitchState = false;
@@ -38,9 +57,6 @@ bool slaved = false;
 bool isConnected = true;                        // Device is always connected in this implementation
 bool swapLimitSwitches = false;                 // Flag for swapping limit switch pins
 
-// Error tracking for ASCOM compliance (error reason for Slewing exception)
-String roofErrorReason = "";
-
 // Timestamps for various operations
 unsigned long lastSwitchTime = 0;
 unsigned long movementStartTime = 0;
@@ -49,27 +65,441 @@ unsigned long movementStartTime = 0;
 RoofOperationState roofOpState = OP_IDLE;
 RoofOperationTarget roofOpTarget = TARGET_NONE;
 unsigned long roofOpStepStartTime = 0;
+static unsigned long roofOpSequenceStartTime = 0;  // K1 on (or first relay) of the current open/close
+static InverterSequenceStats inverterSequenceStats = {0, 0, 0, 0, 0};
+static bool inverterAcUpPending = false;           // Sequence started with AC down: time its rising edge
+static bool inverterKeepWarm = false;              // Keep-warm window open: K1 left on after a move
+static unsigned long inverterKeepWarmStart = 0;
+static InverterKeepWarmStats inverterKeepWarmStats = {0, 0, 0, 0, false, 0};
+static bool inverterPrewarm = false;               // Pre-warm window open: inverter up, waiting for a move
+static unsigned long inverterPrewarmStart = 0;
+static InverterPrewarmStats inverterPrewarmStats = {0, 0, 0, 0, 0, 0, 0, false, false, 0};
 bool roofOpNeedsInverterButton = false;
+static bool resumeReversal = false;                // Resume: stop the opener after its first press and press again
+static unsigned long resumeElapsedMs = 0;          // Resume: travel before the reset, carried into movementStartTime
 
 // Inverter power state variables (NEW in v3)
 bool inverterRelayState = false;                // State of K1 (12V power relay)
 bool inverterACPowerState = false;              // State of AC power (detected via optocoupler)
-bool lastInverterACPowerState = false;          // Last AC power state for change detection
-unsigned long lastInverterACPowerChangeTime = 0;
 bool inverterRelayEnabled = true;               // Enable K1 power relay control for roof movement (default: enabled)
 bool inverterSoftPwrEnabled = true;             // Enable K3 soft-power button control for roof movement (default: enabled)
 
+// ========== SAMPLED INPUTS ==========
+// Every digital input is sampled and debounced together by the input sampler
+// (input_sampler.cpp) on an esp_timer. The control step drains the sampler's
+// stable-state events at the start of updateRoofStatus(), so limit switches,
+// park sensor, AC detect and the weather inputs all change state at the same
+// point of the step. An event is raised once a channel has held its new level
+// for the channel's stable time, so its last real edge was that long before.
+
+// Debounced limit switch state, driven from sampler events
+struct LimitSwitchTracker {
+  bool triggered;       // Stable state, interpreted against TRIGGERED
+  uint32_t lastEdgeUs;  // micros() of the last edge before the stable state
+};
+
+static LimitSwitchTracker openTracker = {false, 0};
+static LimitSwitchTracker closedTracker = {false, 0};
+static bool telescopeParkPin = false;   // Debounced physical park sensor
+static uint32_t appliedInputMask = 0;   // Sampler stable states the control step has applied
+
+// Weather inputs (debounced by the input sampler)
+bool rainDetected = false;
+bool snowDetected = false;
+
+static void noteWeatherChange(WeatherTripSource source, bool active, uint32_t edgeUs);  // Rain auto-close, below
+
+static unsigned long inputEdgeMs(uint32_t edgeUs) {
+  return millis() - (uint32_t)(micros() - edgeUs) / 1000;
+}
+
+static void applyLimitSwitchChange(LimitSwitchTracker& tracker, bool triggered, uint32_t edgeUs,
+                                   const char* name) {
+  tracker.triggered = triggered;
+  tracker.lastEdgeUs = edgeUs;
+  Debug.printf("%s switch state changed to: %s\n", name, triggered ? "TRIGGERED" : "NOT TRIGGERED");
+  telemetryLimitSwitchEdge(&tracker == &openTracker, triggered, inputEdgeMs(edgeUs));
+
+  // Mirror into the legacy globals
+  bool& state = (&tracker == &openTracker) ? lastOpenSwitchState : lastClosedSwitchState;
+  unsigned long& stateTime = (&tracker == &openTracker) ? lastOpenStateTime : lastClosedStateTime;
+  state = triggered;
+  stateTime = inputEdgeMs(edgeUs);
+}
+
+static void applyInputChange(InputChannel channel, bool active, uint32_t edgeUs) {
+  switch (channel) {
+    case INPUT_LIMIT_OPEN:
+      applyLimitSwitchChange(openTracker, active, edgeUs, "Open");
+      break;
+    case INPUT_LIMIT_CLOSED:
+      applyLimitSwitchChange(closedTracker, active, edgeUs, "Closed");
+      break;
+    case INPUT_TELESCOPE_PARK:
+      telescopeParkPin = active;  // updateTelescopeStatus() combines it with the UDP sensors
+      break;
+    case INPUT_AC_POWER:
+      inverterACPowerState = active;
+      Debug.println("AC power state UPDATED to: " + String(active ? "ON" : "OFF"));
+      if (active) {
+        telemetryInverterACDetected(inputEdgeMs(edgeUs));
+        if (inverterAcUpPending && roofOpState != OP_IDLE) {
+          inverterAcUpPending = false;
+          inverterSequenceStats.lastAcUpMs = millis() - roofOpSequenceStartTime;
+        }
+      }
+      requestStatusPublish();
+      break;
+    case INPUT_RAIN:
+      rainDetected = active;
+      Debug.printf("Rain sensor: %s\n", active ? "RAIN" : "DRY");
+      setSafetyReason(SAFETY_RAIN, active);
+      noteWeatherChange(TRIP_RAIN_SENSOR, active, edgeUs);
+      requestStatusPublish();
+      break;
+    case INPUT_SNOW:
+      snowDetected = active;
+      Debug.printf("Snow sensor: %s\n", active ? "SNOW" : "CLEAR");
+      setSafetyReason(SAFETY_SNOW, active);
+      requestStatusPublish();
+      break;
+    default:
+      break;
+  }
+}
+
+// Apply sampler events in order; after dropped events, catch up from the live stable states
+static void processInputEvents() {
+  bool overflowed = takeInputEventOverflow();
+
+  InputEvent event;
+  while (popInputEvent(event)) {
+    traceRecord(TRACE_INPUT, event.timeUs, (uint8_t)event.changed, (uint16_t)event.stable);
+    for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+      InputChannel channel = (InputChannel)ch;
+      if (event.changed & inputBit(channel)) {
+        applyInputChange(channel, (event.stable & inputBit(channel)) != 0,
+                         event.timeUs - getInputStableTime(channel) * 1000UL);
+      }
+    }
+    appliedInputMask = event.stable;
+  }
+
+  if (overflowed) {
+    // Edge times of the dropped events are lost; stamp the changes now
+    Debug.println("Input event queue overflow - resynchronising from the sampler");
+    uint32_t live = getInputStableMask();
+    uint32_t nowUs = micros();
+    traceRecord(TRACE_INPUT, nowUs, (uint8_t)(live ^ appliedInputMask), (uint16_t)live);
+    for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+      InputChannel channel = (InputChannel)ch;
+      if ((live ^ appliedInputMask) & inputBit(channel)) {
+        applyInputChange(channel, (live & inputBit(channel)) != 0, nowUs);
+      }
+    }
+    appliedInputMask = live;
+  }
+}
+
+// Take the sampler's stable states as they are, without change handling (startup)
+static void syncInputStates() {
+  uint32_t stable = getInputStableMask();
+  uint32_t nowUs = micros();
+  unsigned long nowMs = millis();
+  openTracker = {(stable & inputBit(INPUT_LIMIT_OPEN)) != 0, nowUs};
+  closedTracker = {(stable & inputBit(INPUT_LIMIT_CLOSED)) != 0, nowUs};
+  telescopeParkPin = (stable & inputBit(INPUT_TELESCOPE_PARK)) != 0;
+  inverterACPowerState = (stable & inputBit(INPUT_AC_POWER)) != 0;
+  rainDetected = (stable & inputBit(INPUT_RAIN)) != 0;
+  snowDetected = (stable & inputBit(INPUT_SNOW)) != 0;
+  appliedInputMask = stable;
+  setSafetyReason(SAFETY_RAIN, rainDetected);
+  setSafetyReason(SAFETY_SNOW, snowDetected);
+
+  lastOpenSwitchState = openTracker.triggered;
+  lastClosedSwitchState = closedTracker.triggered;
+  lastOpenStateTime = nowMs;
+  lastClosedStateTime = nowMs;
+}
+
+// ========== RAIN AUTO-CLOSE ==========
+// An RG9 trip never leaves the control task: processInputEvents() applies the
+// sampler event and processRainAutoClose(), later in the same control step,
+// starts the close sequence (stopping an opening roof first). No network
+// handler or command queue sits in the path, so edge-to-K2 is the sensor's
+// stable time, at most one control period, any hold-off or interlock wait,
+// and the inverter spin-up. Every trip records that latency.
+// The RS485 snow sensor (snow_sensor.cpp, also in the control task) trips
+// the same path, with the same hold-off and re-open lockout.
+
+struct RainTrip {
+  bool active;                    // Not resolved yet (rainTrips[newest] is its record)
+  bool awaitingK2;                // Close sequence started, K2 not pressed yet
+  bool stopIssued;                // Stop press sent to an opening roof
+  bool interlockCounted;
+  bool holdInverter;              // The next releaseInverterPower() (end of the stop) keeps K1 on
+  bool inverterHeld;              // K1 left on after the stop for the close press
+  WeatherTripSource source;
+  uint32_t edgeUs;                // Last sensor edge before the debounced trip
+  unsigned long tripMs;
+  unsigned long stopMs;
+};
+
+static RainTrip rainTrip = {};
+static bool rainStopping = false;     // stopRoofMovement() called by the rain path
+static RainCloseStats rainCloseStats = {};
+static RainTripRecord rainTrips[RAIN_TRIP_LOG_SIZE];
+static uint8_t rainTripHead = 0;      // Next slot to write
+static uint8_t rainTripCount = 0;
+static bool rainLockoutArmed = false; // A trip happened; cleared once dry for the lockout
+static unsigned long rainDryMs = 0;   // When the last enabled sensor went dry
+static bool modbusSnow = false;       // Confirmed snow state from the RS485 sensor
+
+static bool beginRoofSequence(RoofOperationTarget target, bool afterStop = false);
+static bool isPrewarmSequence(RoofOperationState state);
+
+static RainTripRecord& currentRainTrip() {
+  return rainTrips[(rainTripHead + RAIN_TRIP_LOG_SIZE - 1) % RAIN_TRIP_LOG_SIZE];
+}
+
+static void endRainTrip(RainTripOutcome outcome) {
+  if (!rainTrip.active) {
+    return;
+  }
+  currentRainTrip().outcome = outcome;
+  rainTrip.active = false;
+  rainTrip.awaitingK2 = false;
+  if (outcome == RAIN_TRIP_CLEARED) {
+    rainCloseStats.cleared++;
+  }
+  Debug.printf("Rain auto-close: trip ended (%s)\n", getRainTripOutcomeString(outcome));
+}
+
+static bool weatherTripEnabled(WeatherTripSource source) {
+  return source == TRIP_RAIN_SENSOR ? rainAutoCloseEnabled : snowAutoCloseEnabled;
+}
+
+// Precipitation reported by any sensor that has auto-close enabled
+static bool weatherActive() {
+  return (rainAutoCloseEnabled && rainDetected) || (snowAutoCloseEnabled && modbusSnow);
+}
+
+// Debounced weather change: RG9 from processInputEvents(), snow from the RS485 sensor
+static void noteWeatherChange(WeatherTripSource source, bool active, uint32_t edgeUs) {
+  if (!active) {
+    if (!weatherActive()) {
+      rainDryMs = inputEdgeMs(edgeUs);
+    }
+    return;
+  }
+  if (!weatherTripEnabled(source)) {
+    return;
+  }
+
+  rainLockoutArmed = true;
+  setSafetyReason(SAFETY_WEATHER_LOCKOUT, true);
+  if (rainTrip.active) {
+    return;  // Still acting on an earlier trip
+  }
+
+  rainCloseStats.trips++;
+  rainTrip = {};
+  rainTrip.active = true;
+  rainTrip.source = source;
+  rainTrip.edgeUs = edgeUs;
+  rainTrip.tripMs = millis();
+
+  RainTripRecord& record = rainTrips[rainTripHead];
+  record.tripMs = rainTrip.tripMs;
+  record.source = source;
+  record.edgeToK2Us = RAIN_LATENCY_UNSET;
+  record.waitedMs = 0;
+  record.stoppedOpening = false;
+  record.outcome = RAIN_TRIP_PENDING;
+  rainTripHead = (rainTripHead + 1) % RAIN_TRIP_LOG_SIZE;
+  if (rainTripCount < RAIN_TRIP_LOG_SIZE) rainTripCount++;
+
+  Debug.printf("%s TRIP: auto-close in %lums (roof %s)\n", source == TRIP_RAIN_SENSOR ? "RAIN" : "SNOW",
+               rainHoldoffMs, getRoofStatusString().c_str());
+}
+
+void noteSnowSensorChange(bool snowing, uint32_t replyUs) {
+  modbusSnow = snowing;
+  noteWeatherChange(TRIP_SNOW_SENSOR, snowing, replyUs);
+}
+
+// Close K2 pressed for the trip (from onRoofOpStateEntered)
+static void noteRainCloseK2() {
+  uint32_t latencyUs = micros() - rainTrip.edgeUs;
+  currentRainTrip().edgeToK2Us = latencyUs;
+  rainCloseStats.latencySamples++;
+  rainCloseStats.lastEdgeToK2Us = latencyUs;
+  rainCloseStats.totalEdgeToK2Us += latencyUs;
+  if (latencyUs > rainCloseStats.maxEdgeToK2Us) {
+    rainCloseStats.maxEdgeToK2Us = latencyUs;
+  }
+  Debug.printf("Rain auto-close: K2 pressed %lums after the sensor edge\n", (unsigned long)(latencyUs / 1000));
+  endRainTrip(RAIN_TRIP_CLOSING);
+}
+
+// Let go of K1 if it was held for a close that is not coming
+static void dropRainInverterHold() {
+  if (rainTrip.inverterHeld) {
+    rainTrip.inverterHeld = false;
+    releaseInverterPower();
+  }
+}
+
+void processRainAutoClose() {
+  unsigned long currentTime = millis();
+
+  if (rainLockoutArmed && !weatherActive() && currentTime - rainDryMs >= rainReopenLockoutMs) {
+    rainLockoutArmed = false;
+    setSafetyReason(SAFETY_WEATHER_LOCKOUT, false);
+    Debug.println("Rain re-open lockout ended");
+    requestStatusPublish();
+  }
+
+  if (!rainTrip.active || rainTrip.awaitingK2) {
+    return;
+  }
+  if (!weatherTripEnabled(rainTrip.source)) {
+    dropRainInverterHold();
+    endRainTrip(RAIN_TRIP_STOPPED);
+    return;
+  }
+
+  // Hold-off: a short shower that clears in time does not close the roof
+  if (currentTime - rainTrip.tripMs < rainHoldoffMs) {
+    if (!weatherActive()) {
+      endRainTrip(RAIN_TRIP_CLEARED);
+    }
+    return;
+  }
+
+  if (!rainTrip.stopIssued) {
+    // A pre-warm power-up moves nothing: the roof is where its status says
+    bool opIdle = roofOpState == OP_IDLE || isPrewarmSequence(roofOpState);
+    if ((!opIdle && roofOpTarget == TARGET_CLOSE) || roofStatus == ROOF_CLOSING ||
+        (opIdle && roofStatus == ROOF_CLOSED)) {
+      endRainTrip(RAIN_TRIP_ALREADY_CLOSED);
+      return;
+    }
+    if (roofOpState != OP_IDLE && roofOpTarget == TARGET_OPEN &&
+        (roofOpState == OP_ROOF_BUTTON_PRESS || roofOpState == OP_ROOF_BUTTON_RELEASE)) {
+      return;  // Open K2 already pressed: stop once the roof reports OPENING
+    }
+    if ((!opIdle && roofOpTarget == TARGET_OPEN) ||
+        (opIdle && roofStatus == ROOF_OPENING)) {
+      Debug.println("Rain auto-close: stopping the opening roof");
+      rainTrip.stopIssued = true;
+      rainTrip.holdInverter = true;
+      rainTrip.stopMs = currentTime;
+      currentRainTrip().stoppedOpening = true;
+      rainCloseStats.stoppedOpening++;
+      rainStopping = true;
+      stopRoofMovement();
+      rainStopping = false;
+      return;
+    }
+  } else if (currentTime - rainTrip.stopMs < RELAY_PRESS_MS + RAIN_REVERSE_SETTLE_MS) {
+    return;  // Let the opener see the stop and the close as two presses
+  }
+
+  // A stop, shutdown or other sequence still running (a pre-warm is taken over)
+  if (roofOpState != OP_IDLE && !isPrewarmSequence(roofOpState)) {
+    return;
+  }
+
+  // Errors must be cleared first; the inverter is not held through a long wait
+  if (roofStatus == ROOF_ERROR) {
+    dropRainInverterHold();
+    return;
+  }
+  if (!bypassParkSensor && !telescopeParked) {
+    if (!rainTrip.interlockCounted) {
+      rainTrip.interlockCounted = true;
+      rainCloseStats.interlockWaits++;
+      Debug.println("Rain auto-close: waiting for the telescope to park");
+    }
+    dropRainInverterHold();
+    return;
+  }
+
+  // Rain trip: straight into the close sequence
+  Debug.println("Rain auto-close: starting the close sequence");
+  currentRainTrip().waitedMs = currentTime - rainTrip.tripMs;
+  rainTrip.awaitingK2 = true;
+  if (!beginRoofSequence(TARGET_CLOSE, rainTrip.stopIssued)) {
+    rainTrip.awaitingK2 = false;
+    return;
+  }
+  rainCloseStats.closes++;
+}
+
+bool rainReopenLocked() {
+  return (rainAutoCloseEnabled || snowAutoCloseEnabled) && (weatherActive() || rainLockoutArmed);
+}
+
+void noteRainLockoutReject() {
+  rainCloseStats.lockoutRejects++;
+}
+
+RainCloseStats getRainCloseStats() {
+  RainCloseStats stats = rainCloseStats;
+  stats.pending = rainTrip.active;
+  stats.lockout = rainReopenLocked();
+  stats.lockoutRemainingMs = 0;
+  if (stats.lockout && !weatherActive()) {
+    unsigned long dry = millis() - rainDryMs;
+    stats.lockoutRemainingMs = dry < rainReopenLockoutMs ? rainReopenLockoutMs - dry : 0;
+  }
+  return stats;
+}
+
+uint8_t getRainTripCount() {
+  return rainTripCount;
+}
+
+const RainTripRecord& getRainTrip(uint8_t index) {
+  return rainTrips[(rainTripHead + RAIN_TRIP_LOG_SIZE - 1 - index) % RAIN_TRIP_LOG_SIZE];
+}
+
+const char* getRainTripOutcomeString(RainTripOutcome outcome) {
+  switch (outcome) {
+    case RAIN_TRIP_PENDING:        return "pending";
+    case RAIN_TRIP_CLOSING:        return "closing";
+    case RAIN_TRIP_ALREADY_CLOSED: return "already_closed";
+    case RAIN_TRIP_CLEARED:        return "cleared";
+    case RAIN_TRIP_STOPPED:        return "stopped";
+    default:                       return "unknown";
+  }
+}
+
+const char* getWeatherTripSourceString(WeatherTripSource source) {
+  return source == TRIP_RAIN_SENSOR ? "rain" : "snow";
+}
+
 // Apply pin settings - useful after changing pin assignments or trigger state
 void applyPinSettings() {
   // Configure input pins with internal pull-ups
   pinMode(TELESCOPE_PARKED_PIN, INPUT);
   pinMode(LIMIT_SWITCH_OPEN_PIN, INPUT_PULLUP);
   pinMode(LIMIT_SWITCH_CLOSED_PIN, INPUT_PULLUP);
+  pinMode(RAIN_SENSOR_PIN, INPUT_PULLUP);
+  pinMode(SNOW_SENSOR_DIGITAL_PIN, INPUT);
+
+  // The sampler restarts from the (possibly new) pins and trigger levels
+  requestInputResync();
+  applyRoofEncoderPins();
+  applyMotorCurrentPin();
   
   Debug.println("Pin settings applied:");
   Debug.print("TELESCOPE_PARKED_PIN: "); Debug.println(TELESCOPE_PARKED_PIN);
   Debug.print("LIMIT_SWITCH_OPEN_PIN: "); Debug.println(LIMIT_SWITCH_OPEN_PIN);
   Debug.print("LIMIT_SWITCH_CLOSED_PIN: "); Debug.println(LIMIT_SWITCH_CLOSED_PIN);
+  Debug.print("ENCODER_PIN_A/B: "); Debug.print(ENCODER_PIN_A); Debug.print("/"); Debug.println(ENCODER_PIN_B);
+  Debug.print("MOTOR_CURRENT_PIN: "); Debug.println(MOTOR_CURRENT_PIN);
   Debug.print("TRIGGERED state: "); Debug.println(TRIGGERED == HIGH ? "HIGH" : "LOW");
   Debug.print("TELESCOPE_PARKED state: "); Debug.println(TELESCOPE_PARKED == HIGH ? "HIGH" : "LOW");
   
@@ -81,6 +511,12 @@ void applyPinSettings() {
 }
 
 void initializeRoofController() {
+  // Keep or clear the trace ring before anything is recorded in it
+  initRoofTrace();
+
+  // Load movement history and adaptive timeout setting
+  initRoofTelemetry();
+
   // Initialize GPIO pins
 
   // Configure power inverter relay (K1)
@@ -98,9 +534,6 @@ void initializeRoofController() {
 
   // Configure AC power detection input - NEW in v3
   pinMode(INVERTER_AC_POWER_PIN, INPUT);
-  inverterACPowerState = (digitalRead(INVERTER_AC_POWER_PIN) == LOW);
-  lastInverterACPowerState = inverterACPowerState;
-  lastInverterACPowerChangeTime = millis() - SWITCH_STABLE_TIME - 1;
 
   // Apply pin settings
   applyPinSettings();
@@ -120,11 +553,9 @@ void initializeRoofController() {
   // Allow time for the pull-up resistors to fully settle
   delay(50);
 
-  // Initialize status variables for debouncing
-  lastOpenSwitchState = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
-  lastClosedSwitchState = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
-  lastOpenStateTime = millis() - SWITCH_STABLE_TIME - 1; // Make initial reading valid immediately
-  lastClosedStateTime = millis() - SWITCH_STABLE_TIME - 1;
+  // Start sampling every input; the levels read now are valid immediately
+  initInputSampler();
+  syncInputStates();
 
   // Initialize telescope park state
   lastTelescopeParkedStateTime = millis() - SWITCH_STABLE_TIME - 1; // Make initial reading valid immediately
@@ -132,6 +563,9 @@ void initializeRoofController() {
 
   // Explicitly check initial roof status based on limit switches with extra care
   determineInitialRoofStatus();
+
+  // After a brownout or watchdog reset, finish what the reset interrupted
+  resumeInterruptedOperation();
 }
 
 void determineInitialRoofStatus() {
@@ -154,27 +588,25 @@ void determineInitialRoofStatus() {
   // Determine status based on majority readings
   if (openTriggeredCount >= 3 && closedTriggeredCount >= 3) {
     // Both switches triggered is an error condition
-    roofErrorReason = "Controller startup detected both limit switches triggered. "
-                      "This indicates a hardware fault - check limit switch wiring and mechanical alignment.";
+    recordRoofError(ROOF_ERR_STARTUP_BOTH_LIMITS);
     roofStatus = ROOF_ERROR;
     Debug.println("INITIAL STATUS: ERROR - Both limit switches triggered!");
   }
   else if (openTriggeredCount >= 3) {
     // Roof is open
-    roofErrorReason = "";  // Clear any previous error
+    clearRoofErrorRecord();  // Clear any previous error
     roofStatus = ROOF_OPEN;
     Debug.println("INITIAL STATUS: Roof is OPEN");
   }
   else if (closedTriggeredCount >= 3) {
     // Roof is closed
-    roofErrorReason = "";  // Clear any previous error
+    clearRoofErrorRecord();  // Clear any previous error
     roofStatus = ROOF_CLOSED;
     Debug.println("INITIAL STATUS: Roof is CLOSED");
   }
   else {
     // Roof is in between - assume it's stationary
-    roofErrorReason = "Controller startup detected roof in unknown position (neither limit switch triggered). "
-                      "Manual intervention may be required to move roof to a known position.";
+    recordRoofError(ROOF_ERR_STARTUP_UNKNOWN);
     roofStatus = ROOF_ERROR;  // Use ERROR state for an in-between position that's not moving
     Debug.println("INITIAL STATUS: Roof is IN BETWEEN (not at either limit)");
   }
@@ -183,39 +615,39 @@ void determineInitialRoofStatus() {
   lastPublishedStatus = roofStatus;
   
   // Publish initial status
-  publishStatusToMQTT();
+  requestStatusPublish();
+}
+
+// Direction of the movement currently reported, for per-direction timeouts
+static MoveDirection reportedMoveDirection() {
+  if (roofStatus == ROOF_OPENING) return MOVE_OPEN;
+  if (roofStatus == ROOF_CLOSING) return MOVE_CLOSE;
+  return MOVE_NONE;
+}
+
+// Log the recorded error (formatted on the stack, not the heap)
+static void printRoofError() {
+  char reason[ROOF_ERROR_REASON_SIZE];
+  formatRoofError(roofError, reason, sizeof(reason));
+  Debug.printf("Error reason: %s\n", reason);
 }
 
 // Update roof status based on limit switches
 void updateRoofStatus() {
   unsigned long currentTime = millis();
 
+  // Always drain input events, even while the post-start window below suppresses status changes
+  processInputEvents();
+
   // Check whether we have just started moving the roof.  If so, give it time before we revise the roof state.
-  if (currentTime - movementStartTime < limitSwitchTimeout) {
+  unsigned long switchTimeout = getEffectiveLimitSwitchTimeout(reportedMoveDirection());
+  if (currentTime - movementStartTime < switchTimeout) {
     return;     // Movement started recently.  Let's wait for limit switch state to change!
   }
 
-  // Read current switch states
-  bool currentOpenState = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
-  bool currentClosedState = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
-  
-  // Check if open switch state changed
-  if (currentOpenState != lastOpenSwitchState) {
-    lastOpenSwitchState = currentOpenState;
-    lastOpenStateTime = currentTime;
-    Debug.println("Open switch state changed to: " + String(currentOpenState ? "TRIGGERED" : "NOT TRIGGERED"));
-  }
-  
-  // Check if closed switch state changed
-  if (currentClosedState != lastClosedSwitchState) {
-    lastClosedSwitchState = currentClosedState;
-    lastClosedStateTime = currentTime;
-    Debug.println("Closed switch state changed to: " + String(currentClosedState ? "TRIGGERED" : "NOT TRIGGERED"));
-  }
-  
-  // Only consider a switch triggered if its state has been stable for SWITCH_STABLE_TIME
-  bool isOpenLimitTriggered = currentOpenState && (currentTime - lastOpenStateTime > SWITCH_STABLE_TIME);
-  bool isClosedLimitTriggered = currentClosedState && (currentTime - lastClosedStateTime > SWITCH_STABLE_TIME);
+  // Debounced by the input sampler: stable for SWITCH_STABLE_TIME since the last edge
+  bool isOpenLimitTriggered = openTracker.triggered;
+  bool isClosedLimitTriggered = closedTracker.triggered;
   
   // Save previous status for change detection
   RoofStatus previousStatus = roofStatus;
@@ -224,9 +656,9 @@ void updateRoofStatus() {
   // Handle clear terminal states first
   if (isOpenLimitTriggered && isClosedLimitTriggered) {
     // Both switches triggered is an error condition
-    roofErrorReason = "Both open and closed limit switches are triggered simultaneously. "
-                      "This indicates a hardware fault - check limit switch wiring and mechanical alignment.";
+    recordRoofError(ROOF_ERR_BOTH_LIMITS);
     roofStatus = ROOF_ERROR;
+    telemetryMoveEnd(MOVE_FAULT);
     shutdownInverterPower();
     statusMessage = "ERROR: Both limit switches triggered!";
   }
@@ -235,18 +667,20 @@ void updateRoofStatus() {
     if (roofStatus == ROOF_CLOSING) {
       // We're trying to CLOSE but open switch is still triggered after limitSwitchTimeout.
       // This means the roof failed to START moving - immediate error.
-      roofErrorReason = "Roof failed to start closing. Open limit switch still triggered after " +
-                        String(limitSwitchTimeout / 1000) + " seconds. Check motor, relay, or mechanical obstruction.";
+      recordRoofError(ROOF_ERR_CLOSE_START_FAILED, switchTimeout);
       statusMessage = "ERROR: Roof failed to start closing";
-      Debug.println("Error reason: " + roofErrorReason);
+      printRoofError();
       roofStatus = ROOF_ERROR;
+      telemetryMoveEnd(MOVE_FAILED_TO_START);
       shutdownInverterPower();
     }
     else if (roofStatus == ROOF_OPENING) {
       // We were opening and reached the open position - success!
-      statusMessage = "Roof fully open";
       roofStatus = ROOF_OPEN;
-      shutdownInverterPower();
+      releaseInverterPower();
+      telemetryMoveEnd(MOVE_COMPLETED);
+      statusMessage = "Roof fully open (K1 off " + String((micros() - openTracker.lastEdgeUs) / 1000) +
+                      "ms after last switch edge)";
     }
     else if (roofStatus == ROOF_ERROR) {
       // Stay in ERROR state - don't auto-clear just because limit switch is triggered.
@@ -264,18 +698,20 @@ void updateRoofStatus() {
     if (roofStatus == ROOF_OPENING) {
       // We're trying to OPEN but closed switch is still triggered after limitSwitchTimeout.
       // This means the roof failed to START moving - immediate error.
-      roofErrorReason = "Roof failed to start opening. Closed limit switch still triggered after " +
-                        String(limitSwitchTimeout / 1000) + " seconds. Check motor, relay, or mechanical obstruction.";
+      recordRoofError(ROOF_ERR_OPEN_START_FAILED, switchTimeout);
       statusMessage = "ERROR: Roof failed to start opening";
-      Debug.println("Error reason: " + roofErrorReason);
+      printRoofError();
       roofStatus = ROOF_ERROR;
+      telemetryMoveEnd(MOVE_FAILED_TO_START);
       shutdownInverterPower();
     }
     else if (roofStatus == ROOF_CLOSING) {
       // We were closing and reached the closed position - success!
-      statusMessage = "Roof fully closed";
       roofStatus = ROOF_CLOSED;
-      shutdownInverterPower();
+      releaseInverterPower();
+      telemetryMoveEnd(MOVE_COMPLETED);
+      statusMessage = "Roof fully closed (K1 off " + String((micros() - closedTracker.lastEdgeUs) / 1000) +
+                      "ms after last switch edge)";
     }
     else if (roofStatus == ROOF_ERROR) {
       // Stay in ERROR state - don't auto-clear just because limit switch is triggered.
@@ -293,7 +729,10 @@ void updateRoofStatus() {
     
     // Only transition to moving states if we're not already in a moving state
     // This prevents oscillation between OPENING and CLOSING
-    if (roofStatus == ROOF_OPEN) {
+    if (roofStatus == ROOF_OPEN && isRoofHeldPartOpen()) {
+      // Stopped at a part-open target: OPEN between the switches is expected
+    }
+    else if (roofStatus == ROOF_OPEN) {
       roofStatus = ROOF_CLOSING;
       movementStartTime = currentTime;
       statusMessage = "Roof state changed from OPEN, now CLOSING";
@@ -318,7 +757,7 @@ void updateRoofStatus() {
     Debug.print(" to ");
     Debug.println(getRoofStatusString(roofStatus));
     
-    publishStatusToMQTT();
+    requestStatusPublish();
     lastPublishedStatus = roofStatus;
   }
 }
@@ -331,87 +770,242 @@ void checkMovementTimeout() {
   }
 
   // Check for timeout during roof movement
-  if ((roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) &&
-      (millis() - movementStartTime > movementTimeout)) {
-
-    // Set error reason for ASCOM Slewing exception
-    String operation = (roofStatus == ROOF_OPENING) ? "open" : "close";
-    roofErrorReason = "Roof movement timed out after " + String(movementTimeout / 1000) +
-                      " seconds while trying to " + operation +
-                      ". Limit switch did not trigger. Check mechanical obstruction or motor failure.";
-
-    // IMPORTANT: Set error state BEFORE stopping to avoid race condition.
-    // If we call stopRoofMovement() first, it calls updateRoofStatus() which might
-    // set roofStatus to ROOF_CLOSED (based on limit switches), creating a window
-    // where ASCOM clients polling Slewing would see false instead of an exception.
-    roofStatus = ROOF_ERROR;
-
-    // Stop the roof due to timeout (don't update status - we already set ERROR)
+  MoveDirection direction = reportedMoveDirection();
+  unsigned long timeout = getEffectiveMovementTimeout(direction);
+  if (direction != MOVE_NONE && (millis() - movementStartTime > timeout)) {
     Debug.println("Roof movement timed out!");
-    Debug.println("Error reason: " + roofErrorReason);
-    stopRoofMovement(false);  // Pass false to skip status update
+    faultRoofMovement(direction == MOVE_OPEN ? ROOF_ERR_OPEN_TIMEOUT : ROOF_ERR_CLOSE_TIMEOUT, timeout,
+                      MOVE_TIMED_OUT);
+  }
+}
 
-    // Publish status change due to timeout
-    publishStatusToMQTT();
-    lastPublishedStatus = roofStatus;
+// Fail the move in progress (timeout, encoder stall) and stop the roof
+void faultRoofMovement(RoofErrorCode code, uint32_t param, MoveOutcome outcome) {
+  // Set error reason for ASCOM Slewing exception
+  recordRoofError(code, param);
+
+  // IMPORTANT: Set error state BEFORE stopping to avoid race condition.
+  // If we call stopRoofMovement() first, it calls updateRoofStatus() which might
+  // set roofStatus to ROOF_CLOSED (based on limit switches), creating a window
+  // where ASCOM clients polling Slewing would see false instead of an exception.
+  roofStatus = ROOF_ERROR;
+  telemetryMoveEnd(outcome);
+
+  // Stop the roof (don't update status - we already set ERROR)
+  printRoofError();
+  stopRoofMovement(false);  // Pass false to skip status update
+
+  // Publish status change due to the fault
+  requestStatusPublish();
+  lastPublishedStatus = roofStatus;
+}
+
+// ========== RELAY OUTPUTS ==========
+
+// GPIO for each relay, indexed by RelayId
+static const int RELAY_PINS[RELAY_COUNT] = {
+  INVERTER_PIN,         // RELAY_K1
+  ROOF_CONTROL_PIN,     // RELAY_K2
+  INVERTER_BUTTON_PIN   // RELAY_K3
+};
+
+// Drive a relay (HIGH = energized). K1 also tracks inverterRelayState.
+void writeRelay(RelayId relay, uint8_t level) {
+  if (relay >= RELAY_COUNT) {
+    return;
+  }
+  if (digitalRead(RELAY_PINS[relay]) != level) {
+    noteRelayEdge();  // Latency accounting for the command that caused it
+    traceRecord(TRACE_RELAY, micros(), relay, level);
+  }
+  digitalWrite(RELAY_PINS[relay], level);
+  if (relay == RELAY_K1) {
+    inverterRelayState = (level == HIGH);
   }
 }
 
-// Complete startOpeningRoof() function - NON-BLOCKING version
-// This initiates the roof opening sequence using a state machine.
-// The actual relay operations are performed by processRoofOperation() in the main loop.
-bool startOpeningRoof() {
-  // Check if roof is already open
-  if (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED) {
-    roofStatus = ROOF_OPEN;
-    return true;
+// Whether a relay is currently energized (by a sequence or a manual pulse)
+bool isRelayEnergized(RelayId relay) {
+  if (relay >= RELAY_COUNT) {
+    return false;
+  }
+  return digitalRead(RELAY_PINS[relay]) == HIGH;
+}
+
+// Bookkeeping when the state machine enters a new step
+static void onRoofOpStateEntered(RoofOperationState state) {
+  if (state == OP_RESUME_REVERSE_RUN) {
+    resumeReversal = false;   // The next press on the way to OP_ROOF_BUTTON_PRESS is the real one
+  }
+  if (state == OP_ROOF_BUTTON_PRESS) {
+    // A reversing resume's first press runs the opener away from the target:
+    // the move (position, stall and release timing) starts at the press after it
+    if (!resumeReversal) {
+      telemetryRoofButtonPressed();
+    }
+    if (rainTrip.awaitingK2 && roofOpTarget == TARGET_CLOSE) {
+      noteRainCloseK2();
+    }
+  }
+}
+
+// Enter a state machine step and start its hold timer
+static void enterRoofOpState(RoofOperationState state) {
+  roofOpState = state;
+  roofOpStepStartTime = millis();
+  onRoofOpStateEntered(state);
+}
+
+// Close the keep-warm window and book its on-time
+static void endInverterKeepWarm(unsigned long currentTime) {
+  inverterKeepWarm = false;
+  inverterKeepWarmStats.addedOnMs += currentTime - inverterKeepWarmStart;
+}
+
+static bool isPrewarmSequence(RoofOperationState state) {
+  return state >= OP_PREWARM_POWER_ON && state <= OP_PREWARM_READY;
+}
+
+// Open (or restart) the pre-warm window
+static void openInverterPrewarm(unsigned long currentTime) {
+  if (inverterPrewarm) {
+    inverterPrewarmStats.addedOnMs += currentTime - inverterPrewarmStart;
+  }
+  inverterPrewarm = true;
+  inverterPrewarmStart = currentTime;
+  Debug.printf("Inverter pre-warmed: held ready for %lu minutes\n", inverterPrewarmMinutes);
+}
+
+// Close the pre-warm window and book its on-time
+static void endInverterPrewarm(unsigned long currentTime) {
+  inverterPrewarm = false;
+  inverterPrewarmStats.addedOnMs += currentTime - inverterPrewarmStart;
+}
+
+// Pre-warm ended without a move (stop, manual switch-off, error, shutdown)
+static void cancelInverterPrewarm() {
+  bool running = isPrewarmSequence(roofOpState);
+  if (!running && !inverterPrewarm) {
+    return;
+  }
+  if (running) {
+    writeRelay(RELAY_K3, LOW);
+    roofOpState = OP_IDLE;
+  }
+  if (inverterPrewarm) {
+    endInverterPrewarm(millis());
   }
+  inverterPrewarmStats.cancelled++;
+  Debug.println("Inverter pre-warm cancelled");
+}
+
+// A move requested during the pre-warm power-up carries on from the same
+// step of the open/close sequence, keeping the time already spent in it
+static void joinInverterPrewarm() {
+  switch (roofOpState) {
+    case OP_PREWARM_POWER_ON:       roofOpState = OP_INVERTER_POWER_ON; break;
+    case OP_PREWARM_BUTTON_PRESS:   roofOpState = OP_INVERTER_BUTTON_PRESS; break;
+    case OP_PREWARM_BUTTON_RELEASE: roofOpState = OP_INVERTER_BUTTON_RELEASE; break;
+    default:                        roofOpState = OP_INVERTER_DELAY2; break;
+  }
+  inverterPrewarmStats.hits++;
+  inverterPrewarmStats.joined++;
+  Debug.println("Move requested during the pre-warm - continuing its power-up");
+}
+
+// Shared entry for open and close: interlocks, then the first relay of the sequence.
+// The rest of the sequence is driven from ROOF_OP_STEPS by processRoofOperation().
+// afterStop: the roof was just stopped mid-travel, so an OPENING/CLOSING status is stale.
+static bool beginRoofSequence(RoofOperationTarget target, bool afterStop) {
+  const char* action = (target == TARGET_OPEN) ? "OPENING" : "CLOSING";
 
   // Check if we're currently moving
-  if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
+  if (!afterStop && (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING)) {
     return false; // Already in motion
   }
 
-  // Check if an operation is already in progress
-  if (roofOpState != OP_IDLE) {
+  // Check if an operation is already in progress (a pre-warm power-up is taken over)
+  if (roofOpState == OP_PREWARM_READY) {
+    roofOpState = OP_IDLE;   // Inverter up: open the window now and start warm
+    openInverterPrewarm(millis());
+  }
+  bool joinPrewarm = isPrewarmSequence(roofOpState);
+  if (roofOpState != OP_IDLE && !joinPrewarm) {
     Debug.println("Roof operation already in progress");
     return false;
   }
 
   // Check telescope safety interlock - only if bypass is not enabled
-  Debug.println("=== ROOF OPENING SAFETY CHECK ===");
+  Debug.printf("=== ROOF %s SAFETY CHECK ===\n", action);
   Debug.printf("bypassParkSensor: %s\n", bypassParkSensor ? "TRUE (bypass enabled)" : "FALSE (bypass disabled)");
   Debug.printf("telescopeParked: %s\n", telescopeParked ? "TRUE (parked)" : "FALSE (not parked)");
   Debug.printf("Park sensor type: %d (0=Physical, 1=UDP, 2=Both)\n", parkSensorType);
 
   if (!bypassParkSensor && !telescopeParked) {
     Debug.println("SAFETY CHECK FAILED: Telescope not parked and bypass not enabled");
-    Debug.println("=== ROOF OPENING BLOCKED ===");
+    Debug.printf("=== ROOF %s BLOCKED ===\n", action);
     return false; // Telescope not parked and bypass not enabled
   }
 
-  Debug.println("SAFETY CHECK PASSED: Opening roof (non-blocking)");
+  Debug.printf("SAFETY CHECK PASSED: %s roof (non-blocking)\n", target == TARGET_OPEN ? "Opening" : "Closing");
 
   // Set target direction
-  roofOpTarget = TARGET_OPEN;
+  roofOpTarget = target;
+  telemetryMoveBegin(target == TARGET_OPEN ? MOVE_OPEN : MOVE_CLOSE);
+  setRoofEncoderTarget(-1);  // startRoofMoveTo() sets its target after this
+  // Stopped between the limits, the opener's next press reverses its last
+  // direction: run it the wrong way, stop it and press again (resume steps)
+  resumeReversal = roofEncoderPressReverses(target);
+  if (joinPrewarm) {
+    joinInverterPrewarm();
+    return true;
+  }
+  roofOpSequenceStartTime = millis();
+  bool acPresent = getInverterACPowerState();
+  inverterAcUpPending = !acPresent;
 
   // Determine if we need the soft-power button press
   if (inverterSoftPwrEnabled) {
-    inverterACPowerState = (digitalRead(INVERTER_AC_POWER_PIN) == LOW);
-    roofOpNeedsInverterButton = !inverterACPowerState;
+    roofOpNeedsInverterButton = !acPresent;
+    if (acPresent) {
+      telemetryInverterACDetected(millis());  // Inverter already running: zero spin-up
+    }
     Debug.printf("AC power detected: %s, will %spress K3\n",
-                 inverterACPowerState ? "YES" : "NO",
+                 acPresent ? "YES" : "NO",
                  roofOpNeedsInverterButton ? "" : "NOT ");
   } else {
     roofOpNeedsInverterButton = false;
   }
 
+  // A move inside the keep-warm or pre-warm window (or a rain close right
+  // after a stop) finds the inverter already running
+  bool keptWarm = inverterKeepWarm;
+  bool prewarmed = inverterPrewarm;
+  bool warmStart = (keptWarm || prewarmed || rainTrip.inverterHeld) && inverterRelayState && getInverterACPowerState();
+  if (keptWarm) {
+    endInverterKeepWarm(millis());
+  }
+  if (prewarmed) {
+    endInverterPrewarm(millis());
+    inverterPrewarmStats.hits++;
+  }
+  rainTrip.inverterHeld = false;
+
   // Start the state machine
-  if (inverterRelayEnabled) {
+  if (warmStart) {
+    // K1 is still on and AC is up: no power-on wait, no K3
+    if (keptWarm) {
+      inverterKeepWarmStats.spinUpsAvoided++;
+    }
+    Debug.println(prewarmed ? "Inverter pre-warmed - pressing roof button directly" :
+                              "Inverter kept warm - pressing roof button directly");
+    writeRelay(RELAY_K2, HIGH);
+    Debug.println("Button PRESSED (K2 relay energized)");
+    enterRoofOpState(OP_ROOF_BUTTON_PRESS);
+  } else if (inverterRelayEnabled) {
     // Step 1: Turn on K1 power relay
     Debug.println("Inverter relay enabled - turning on K1 power relay");
-    digitalWrite(INVERTER_PIN, HIGH);
-    inverterRelayState = true;
+    writeRelay(RELAY_K1, HIGH);
     Debug.println("K1 relay turned ON");
 
     // Start waiting for delay
@@ -420,28 +1014,38 @@ bool startOpeningRoof() {
     } else {
       Debug.printf("Waiting %lums (Delay 2: inverter to roof button) - non-blocking\n", inverterDelay2);
     }
-    roofOpState = OP_INVERTER_POWER_ON;
-    roofOpStepStartTime = millis();
+    enterRoofOpState(OP_INVERTER_POWER_ON);
   } else if (inverterSoftPwrEnabled && roofOpNeedsInverterButton) {
     // No inverter relay, but need soft-power button press (K3) before roof button
     Debug.println("Inverter relay disabled - pressing K3 soft-power button first");
-    digitalWrite(INVERTER_BUTTON_PIN, HIGH);
+    writeRelay(RELAY_K3, HIGH);
     Debug.println("Inverter button PRESSED (K3 relay energized)");
-    roofOpState = OP_INVERTER_BUTTON_PRESS;
-    roofOpStepStartTime = millis();
+    enterRoofOpState(OP_INVERTER_BUTTON_PRESS);
   } else {
     // No inverter relay, no K3 needed - go directly to roof button
     Debug.println("Inverter relay disabled - pressing roof button directly");
-    digitalWrite(ROOF_CONTROL_PIN, HIGH);
+    writeRelay(RELAY_K2, HIGH);
     Debug.println("Button PRESSED (K2 relay energized)");
-    roofOpState = OP_ROOF_BUTTON_PRESS;
-    roofOpStepStartTime = millis();
+    enterRoofOpState(OP_ROOF_BUTTON_PRESS);
   }
 
   return true;
 }
 
-// Complete startClosingRoof() function - NON-BLOCKING version
+// Start opening the roof - NON-BLOCKING
+// This initiates the roof opening sequence using a state machine.
+// The actual relay operations are performed by processRoofOperation() in the main loop.
+bool startOpeningRoof() {
+  // Check if roof is already open
+  if (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED) {
+    roofStatus = ROOF_OPEN;
+    return true;
+  }
+
+  return beginRoofSequence(TARGET_OPEN);
+}
+
+// Start closing the roof - NON-BLOCKING
 // This initiates the roof closing sequence using a state machine.
 // The actual relay operations are performed by processRoofOperation() in the main loop.
 bool startClosingRoof() {
@@ -451,77 +1055,23 @@ bool startClosingRoof() {
     return true;
   }
 
-  // Check if we're currently moving
-  if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
-    return false; // Already in motion
-  }
-
-  // Check if an operation is already in progress
-  if (roofOpState != OP_IDLE) {
-    Debug.println("Roof operation already in progress");
-    return false;
-  }
-
-  // Check telescope safety interlock - only if bypass is not enabled
-  Debug.println("=== ROOF CLOSING SAFETY CHECK ===");
-  Debug.printf("bypassParkSensor: %s\n", bypassParkSensor ? "TRUE (bypass enabled)" : "FALSE (bypass disabled)");
-  Debug.printf("telescopeParked: %s\n", telescopeParked ? "TRUE (parked)" : "FALSE (not parked)");
-  Debug.printf("Park sensor type: %d (0=Physical, 1=UDP, 2=Both)\n", parkSensorType);
-
-  if (!bypassParkSensor && !telescopeParked) {
-    Debug.println("SAFETY CHECK FAILED: Telescope not parked and bypass not enabled");
-    Debug.println("=== ROOF CLOSING BLOCKED ===");
-    return false; // Telescope not parked and bypass not enabled
-  }
-
-  Debug.println("SAFETY CHECK PASSED: Closing roof (non-blocking)");
-
-  // Set target direction
-  roofOpTarget = TARGET_CLOSE;
+  return beginRoofSequence(TARGET_CLOSE);
+}
 
-  // Determine if we need the soft-power button press
-  if (inverterSoftPwrEnabled) {
-    inverterACPowerState = (digitalRead(INVERTER_AC_POWER_PIN) == LOW);
-    roofOpNeedsInverterButton = !inverterACPowerState;
-    Debug.printf("AC power detected: %s, will %spress K3\n",
-                 inverterACPowerState ? "YES" : "NO",
-                 roofOpNeedsInverterButton ? "" : "NOT ");
-  } else {
-    roofOpNeedsInverterButton = false;
+// Run toward a part-open position - NON-BLOCKING
+// The encoder stops the roof once it reaches the target (see checkTarget()).
+bool startRoofMoveTo(int percent) {
+  float position = getRoofEncoderPosition();
+  if (position < 0.0f) {
+    return false;  // No calibrated encoder
   }
 
-  // Start the state machine
-  if (inverterRelayEnabled) {
-    // Step 1: Turn on K1 power relay
-    Debug.println("Inverter relay enabled - turning on K1 power relay");
-    digitalWrite(INVERTER_PIN, HIGH);
-    inverterRelayState = true;
-    Debug.println("K1 relay turned ON");
-
-    // Start waiting for delay
-    if (inverterSoftPwrEnabled) {
-      Debug.printf("Waiting %lums (Delay 1: K1 to K3) - non-blocking\n", inverterDelay1);
-    } else {
-      Debug.printf("Waiting %lums (Delay 2: inverter to roof button) - non-blocking\n", inverterDelay2);
-    }
-    roofOpState = OP_INVERTER_POWER_ON;
-    roofOpStepStartTime = millis();
-  } else if (inverterSoftPwrEnabled && roofOpNeedsInverterButton) {
-    // No inverter relay, but need soft-power button press (K3) before roof button
-    Debug.println("Inverter relay disabled - pressing K3 soft-power button first");
-    digitalWrite(INVERTER_BUTTON_PIN, HIGH);
-    Debug.println("Inverter button PRESSED (K3 relay energized)");
-    roofOpState = OP_INVERTER_BUTTON_PRESS;
-    roofOpStepStartTime = millis();
-  } else {
-    // No inverter relay, no K3 needed - go directly to roof button
-    Debug.println("Inverter relay disabled - pressing roof button directly");
-    digitalWrite(ROOF_CONTROL_PIN, HIGH);
-    Debug.println("Button PRESSED (K2 relay energized)");
-    roofOpState = OP_ROOF_BUTTON_PRESS;
-    roofOpStepStartTime = millis();
+  RoofOperationTarget target = (percent > position) ? TARGET_OPEN : TARGET_CLOSE;
+  if (!beginRoofSequence(target)) {
+    return false;
   }
-
+  setRoofEncoderTarget(percent);
+  Debug.printf("Roof moving to %d%% (now %.1f%%)\n", percent, position);
   return true;
 }
 
@@ -529,29 +1079,55 @@ bool startClosingRoof() {
 // updateStatus: if true (default), updates roof status based on limit switches
 //               if false, preserves current status (used during timeout to keep ERROR state)
 bool stopRoofMovement(bool updateStatus) {
-  // If an operation is in progress, we need to abort it and do a stop
-  if (roofOpState != OP_IDLE) {
-    Debug.println("Aborting in-progress operation for stop");
+  // Relays first: the logging and bookkeeping below take longer than the
+  // whole abort budget
+  bool aborted = (roofOpState != OP_IDLE);
+  if (aborted) {
     // Make sure all relays are released first
-    digitalWrite(ROOF_CONTROL_PIN, LOW);
-    digitalWrite(INVERTER_BUTTON_PIN, LOW);
+    writeRelay(RELAY_K2, LOW);
+    writeRelay(RELAY_K3, LOW);
+  }
+
+  // A user stop cancels a rain close that has not pressed K2 yet
+  if (!rainStopping) {
+    rainTrip.holdInverter = false;
+    rainTrip.inverterHeld = false;
+    endRainTrip(RAIN_TRIP_STOPPED);
   }
 
-  // If not currently moving, just shutdown inverter and return
-  if (roofStatus != ROOF_OPENING && roofStatus != ROOF_CLOSING) {
+  // A queued manual press must not re-press the opener after the stop
+  cancelRelayPulses(RELAY_K2);
+  cancelRelayPulses(RELAY_K3);
+  resumeReversal = false;
+  resumeElapsedMs = 0;
+
+  // A resume has already stopped the opener: another press would start it
+  bool resumeStopped = (roofOpState == OP_RESUME_STOP_PRESS || roofOpState == OP_RESUME_STOP_RELEASE);
+  bool moving = !resumeStopped && (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING);
+  if (moving) {
+    // Press the roof button to stop movement (the state machine releases it)
+    roofOpTarget = TARGET_STOP;
+    writeRelay(RELAY_K2, HIGH);
+    enterRoofOpState(OP_STOP_BUTTON_PRESS);
+  } else {
+    // Not moving: just shut the inverter down
+    if (resumeStopped) {
+      roofOpState = OP_IDLE;
+    }
     roofOpTarget = TARGET_NONE;
     shutdownInverterPower();
-    return true;
   }
 
-  // Start stop sequence using state machine
-  roofOpTarget = TARGET_STOP;
+  // A move that is still being recorded ends here (timeouts record their own outcome first)
+  telemetryMoveEnd(MOVE_STOPPED);
 
-  // Press the roof button to stop movement
-  digitalWrite(ROOF_CONTROL_PIN, HIGH);
+  if (aborted) {
+    Debug.println("Aborting in-progress operation for stop");
+  }
+  if (!moving) {
+    return true;
+  }
   Debug.println("Stop: Button PRESSED (K2 relay energized)");
-  roofOpState = OP_STOP_BUTTON_PRESS;
-  roofOpStepStartTime = millis();
 
   // Note: The actual button release and inverter shutdown happens in processRoofOperation()
 
@@ -569,10 +1145,10 @@ bool stopRoofMovement(bool updateStatus) {
 void clearRoofError() {
   if (roofStatus == ROOF_ERROR) {
     Debug.println("Clearing roof error state");
-    Debug.println("Previous error: " + roofErrorReason);
+    Debug.printf("Previous error: %s\n", getRoofErrorId(roofError.code));
 
     // Clear the error reason
-    roofErrorReason = "";
+    clearRoofErrorRecord();
 
     // Re-determine status based on current limit switch states
     determineInitialRoofStatus();
@@ -581,31 +1157,56 @@ void clearRoofError() {
   }
 }
 
-// Send a button press to the roof controller
-void sendButtonPress() {
+// Report a resumed move as travelling again, keeping the time it had already run
+static void restoreMovingStatus(RoofOperationTarget target, unsigned long elapsedMs) {
+  clearRoofErrorRecord();  // The startup "unknown position" error
+  roofStatus = (target == TARGET_OPEN) ? ROOF_OPENING : ROOF_CLOSING;
+  movementStartTime = millis() - elapsedMs;
+  lastSwitchTime = millis();
+  requestStatusPublish();
+  lastPublishedStatus = roofStatus;
+}
+
+// Restart an open/close interrupted by a reset. reverseFirst: the opener lost
+// power mid-travel toward the target, so its next press runs the other way;
+// the sequence stops it again and presses once more (OP_RESUME_* states).
+bool resumeRoofMove(RoofOperationTarget target, bool reverseFirst, unsigned long elapsedMs) {
+  bool midTravel = (roofStatus != ROOF_OPEN && roofStatus != ROOF_CLOSED);
+  if (!beginRoofSequence(target, true)) {
+    return false;
+  }
+  if (midTravel) {
+    telemetryMoveResumed();  // Followed for the position estimate, never recorded
+    restoreMovingStatus(target, elapsedMs);
+  }
+  resumeReversal = reverseFirst;
+  resumeElapsedMs = elapsedMs;
+  return true;
+}
+
+// The opener did not depend on K1 and kept running through the reset
+void trackResumedMove(RoofOperationTarget target, unsigned long elapsedMs) {
+  restoreMovingStatus(target, elapsedMs);
+  Debug.printf("Resume: %s still in progress, %lums in\n", target == TARGET_OPEN ? "open" : "close", elapsedMs);
+}
+
+bool isResumeReversalPending() {
+  return resumeReversal;
+}
+
+// Send a button press to the roof controller (non-blocking, runs from processRelayPulses())
+// Returns false if the press could not be queued.
+bool sendButtonPress() {
   // For a normally open relay:
   // LOW = Relay not energized = Button NOT pressed
   // HIGH = Relay energized = Button pressed
-  
-  // Before button press
-  Debug.print("Button relay before: ");
-  Debug.println(digitalRead(ROOF_CONTROL_PIN) ? "HIGH (pressed)" : "LOW (not pressed)");
-  
-  // Press button (energize relay)
-  digitalWrite(ROOF_CONTROL_PIN, HIGH);
-  Debug.println("Button PRESSED (relay energized)");
-  delay(500); // Hold the button for half a second
-  
-  // Release button (de-energize relay)
-  digitalWrite(ROOF_CONTROL_PIN, LOW);
-  Debug.println("Button RELEASED (relay de-energized)");
-  
-  // After button press
-  Debug.print("Button relay after: ");
-  Debug.println(digitalRead(ROOF_CONTROL_PIN) ? "HIGH (pressed)" : "LOW (not pressed)");
-  
+  if (!queueRelayPulse(RELAY_K2, RELAY_PRESS_MS)) {
+    return false;
+  }
+
   // We need to debounce after a button press
   lastSwitchTime = millis();
+  return true;
 }
 
 // Update telescope park status
@@ -617,25 +1218,17 @@ void updateTelescopeStatus() {
   switch (parkSensorType) {
     case PARK_SENSOR_PHYSICAL:
       // Use only physical park sensor circuit
-      {
-        int parkPinValue = digitalRead(TELESCOPE_PARKED_PIN);
-        currentParkedState = (parkPinValue == TELESCOPE_PARKED);
-      }
+      currentParkedState = telescopeParkPin;
       break;
       
     case PARK_SENSOR_UDP:
       // Use only UDP park sensors
-      currentParkedState = isTelescopeParkedUDP();
+      currentParkedState = getUdpParkVerdict();
       break;
       
     case PARK_SENSOR_BOTH:
       // Use both - both must indicate parked (AND logic)
-      {
-        int parkPinValue = digitalRead(TELESCOPE_PARKED_PIN);
-        bool physicalParked = (parkPinValue == TELESCOPE_PARKED);
-        bool udpParked = isTelescopeParkedUDP();
-        currentParkedState = physicalParked && udpParked;
-      }
+      currentParkedState = telescopeParkPin && getUdpParkVerdict();
       break;
   }
   
@@ -651,7 +1244,7 @@ void updateTelescopeStatus() {
     } else if (parkSensorType == PARK_SENSOR_BOTH) {
       int parkPinValue = digitalRead(TELESCOPE_PARKED_PIN);
       bool physicalParked = (parkPinValue == TELESCOPE_PARKED);
-      bool udpParked = isTelescopeParkedUDP();
+      bool udpParked = getUdpParkVerdict();
       Debug.printf(2, "Physical: %s, UDP: %s, Combined: %s\n", 
                    physicalParked ? "PARKED" : "NOT PARKED",
                    udpParked ? "PARKED" : "NOT PARKED",
@@ -667,13 +1260,15 @@ void updateTelescopeStatus() {
     Debug.println("Telescope park state CHANGED to: " + String(currentParkedState ? "PARKED" : "NOT PARKED"));
   }
   
-  // Only consider the state change valid if it has been stable for SWITCH_STABLE_TIME
-  if (currentTime - lastTelescopeParkedStateTime > SWITCH_STABLE_TIME) {
+  // The pin is already debounced by the input sampler; a verdict that involves the
+  // UDP sensors must still hold for SWITCH_STABLE_TIME
+  if (parkSensorType == PARK_SENSOR_PHYSICAL || currentTime - lastTelescopeParkedStateTime > SWITCH_STABLE_TIME) {
     if (telescopeParked != currentParkedState) {
       telescopeParked = currentParkedState;
+      traceRecord(TRACE_PARK, micros(), telescopeParked, 0);
       Debug.println("Telescope parked status UPDATED to: " + String(telescopeParked ? "PARKED" : "NOT PARKED"));
       // Publish status to MQTT if telescope park state changed
-      publishStatusToMQTT();
+      requestStatusPublish();
     }
   }
 }
@@ -682,35 +1277,26 @@ void updateTelescopeStatus() {
 
 // Toggle K1 inverter power relay (manual control)
 void toggleInverterPower() {
-  inverterRelayState = !inverterRelayState;
-  digitalWrite(INVERTER_PIN, inverterRelayState ? HIGH : LOW);
+  if (inverterRelayState && inverterKeepWarm) {
+    endInverterKeepWarm(millis());  // Switched off by hand: the window is over
+  }
+  if (inverterRelayState) {
+    cancelInverterPrewarm();
+  }
+  writeRelay(RELAY_K1, inverterRelayState ? LOW : HIGH);
 
   Debug.print("Inverter power relay (K1) manually toggled to: ");
   Debug.println(inverterRelayState ? "ON" : "OFF");
 
   // Publish status change to MQTT
-  publishStatusToMQTT();
+  requestStatusPublish();
 }
 
-// Send K3 soft-power button press to inverter
-void sendInverterButtonPress() {
-  // For a normally open relay:
-  // LOW = Relay not energized = Button NOT pressed
-  // HIGH = Relay energized = Button pressed
-
+// Send K3 soft-power button press to inverter (non-blocking, runs from processRelayPulses())
+// The settle time gives the inverter time to process the press before another one.
+bool sendInverterButtonPress() {
   Debug.println("Inverter button (K3) press initiated");
-
-  // Press button (energize relay)
-  digitalWrite(INVERTER_BUTTON_PIN, HIGH);
-  Debug.println("Inverter button PRESSED (K3 relay energized)");
-  delay(500); // Hold the button for half a second
-
-  // Release button (de-energize relay)
-  digitalWrite(INVERTER_BUTTON_PIN, LOW);
-  Debug.println("Inverter button RELEASED (K3 relay de-energized)");
-
-  // Give the inverter time to process the button press
-  delay(100);
+  return queueRelayPulse(RELAY_K3, RELAY_PRESS_MS, RELAY_SETTLE_MS);
 }
 
 // Get state of K1 inverter power relay
@@ -720,232 +1306,339 @@ bool getInverterRelayState() {
 
 // ========== NON-BLOCKING STATE MACHINE ==========
 // This function must be called from the main loop to process roof operations
-// without blocking WiFi/MQTT communication
-
-void processRoofOperation() {
-  // Nothing to do if idle
-  if (roofOpState == OP_IDLE) {
-    return;
-  }
+// without blocking WiFi/MQTT communication.
+//
+// Every relay sequence (open, close, stop, inverter shutdown) is described by
+// ROOF_OP_STEPS below, one row per RoofOperationState. Each row holds its
+// state for a fixed time or a configured delay, then takes one of two
+// transitions (chosen by an optional condition): write one relay, enter the
+// next state, and optionally run a completion action. Adding a sequence means
+// adding states to RoofOperationState and rows to the table.
+
+// Where a step's hold time comes from
+enum StepHold : uint8_t {
+  HOLD_NONE,            // Advance on the next pass
+  HOLD_FIXED,           // holdMs from the table
+  HOLD_POWER_ON,        // inverterDelay1 before K3, or inverterDelay2 when soft-power is disabled
+  HOLD_DELAY2           // inverterDelay2 (inverter to roof button)
+};
+
+// Whether a step may end its hold early
+enum StepEarly : uint8_t {
+  EARLY_NEVER,
+  EARLY_ON_AC_STABLE          // In AC sequencing mode, once AC power is up and stable (hold becomes a timeout)
+};
+
+// Decides between a step's onTrue and onFalse transitions
+enum StepCondition : uint8_t {
+  COND_ALWAYS,                // Always onTrue
+  COND_NEEDS_INVERTER_BUTTON, // Soft-power enabled and AC was not detected at start (nor has come up since, in AC sequencing mode)
+  COND_AC_PRESENT,            // AC power still detected on GPIO7
+  COND_RESUME_REVERSAL        // Resume after a reset: this press ran the opener away from the target
+};
+
+// Side effects beyond the relay write, run after entering the next state
+enum StepAction : uint8_t {
+  ACTION_NONE,
+  ACTION_MOVEMENT_STARTED,    // Roof button released: report OPENING/CLOSING
+  ACTION_STOP_COMPLETE,       // Stop button released: refresh status and shut the inverter down
+  ACTION_PREWARM_READY        // Pre-warm power-up done: open the pre-warm window
+};
+
+struct StepTransition {
+  RelayId relay;              // RELAY_NONE for no relay change
+  uint8_t level;
+  RoofOperationState next;
+  const char* message;        // Logged when the transition is taken (may be nullptr)
+};
+
+struct RoofOpStep {
+  RoofOperationState state;   // Must equal the row index (checked at compile time)
+  StepHold hold;
+  unsigned long holdMs;
+  StepEarly early;
+  StepCondition condition;
+  StepTransition onTrue;
+  StepTransition onFalse;
+  StepAction action;
+};
+
+static constexpr RoofOpStep ROOF_OP_STEPS[] = {
+  // OP_IDLE: nothing to do
+  {OP_IDLE, HOLD_NONE, 0, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  // K1 on, wait for the inverter to power up, then K3 (AC off) or straight to K2.
+  // In AC sequencing mode stable AC ends the wait early and goes straight to K2.
+  {OP_INVERTER_POWER_ON, HOLD_POWER_ON, 0, EARLY_ON_AC_STABLE, COND_NEEDS_INVERTER_BUTTON,
+    {RELAY_K3, HIGH, OP_INVERTER_BUTTON_PRESS, "Inverter button PRESSED (K3 relay energized)"},
+    {RELAY_K2, HIGH, OP_ROOF_BUTTON_PRESS, "Button PRESSED (K2 relay energized)"},
+    ACTION_NONE},
+
+  {OP_INVERTER_BUTTON_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K3, LOW, OP_INVERTER_BUTTON_RELEASE, "Inverter button RELEASED (K3 relay de-energized)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_INVERTER_BUTTON_RELEASE, HOLD_FIXED, RELAY_SETTLE_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_INVERTER_DELAY2, "Waiting for Delay 2 (inverter to roof button)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_INVERTER_DELAY2, HOLD_DELAY2, 0, EARLY_ON_AC_STABLE, COND_ALWAYS,
+    {RELAY_K2, HIGH, OP_ROOF_BUTTON_PRESS, "Delay 2 complete - Button PRESSED (K2 relay energized)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_ROOF_BUTTON_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_RESUME_REVERSAL,
+    {RELAY_K2, LOW, OP_RESUME_REVERSE_RUN, "Resume: Button RELEASED, opener reversing"},
+    {RELAY_K2, LOW, OP_ROOF_BUTTON_RELEASE, "Button RELEASED (K2 relay de-energized)"},
+    ACTION_NONE},
+
+  {OP_ROOF_BUTTON_RELEASE, HOLD_NONE, 0, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_MOVEMENT_STARTED},
+
+  {OP_STOP_BUTTON_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K2, LOW, OP_STOP_BUTTON_RELEASE, "Button RELEASED (K2 relay de-energized)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_STOP_BUTTON_RELEASE, HOLD_NONE, 0, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_IDLE, "Roof movement stopped"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_STOP_COMPLETE},
+
+  // K1 off: if AC is still present after the check delay, toggle soft-power off with K3
+  {OP_SHUTDOWN_K1_WAIT, HOLD_FIXED, SHUTDOWN_AC_CHECK_MS, EARLY_NEVER, COND_AC_PRESENT,
+    {RELAY_K3, HIGH, OP_SHUTDOWN_K3_PRESS, "Shutdown: AC power still on, K3 pressed to toggle soft-power off"},
+    {RELAY_NONE, LOW, OP_IDLE, "Shutdown: AC power off, inverter shutdown complete"},
+    ACTION_NONE},
+
+  {OP_SHUTDOWN_K3_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K3, LOW, OP_SHUTDOWN_K3_RELEASE, "Shutdown: K3 relay de-energized"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_SHUTDOWN_K3_RELEASE, HOLD_FIXED, RELAY_SETTLE_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_IDLE, "Shutdown: Inverter shutdown complete (K3 toggled)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  // Resume reversal: stop the opener that started the wrong way, then the
+  // usual OP_ROOF_BUTTON_PRESS (now without the reversal) toward the target
+  {OP_RESUME_REVERSE_RUN, HOLD_FIXED, RELAY_SETTLE_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K2, HIGH, OP_RESUME_STOP_PRESS, "Resume: Button PRESSED to stop the reversing opener"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_RESUME_STOP_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K2, LOW, OP_RESUME_STOP_RELEASE, "Resume: Button RELEASED (K2 relay de-energized)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_RESUME_STOP_RELEASE, HOLD_FIXED, RESUME_REVERSE_SETTLE_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K2, HIGH, OP_ROOF_BUTTON_PRESS, "Resume: Button PRESSED toward the target"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  // Pre-warm: the power-up rows of the open sequence, step for step, ending
+  // with the inverter running instead of a K2 press (see joinInverterPrewarm)
+  {OP_PREWARM_POWER_ON, HOLD_POWER_ON, 0, EARLY_ON_AC_STABLE, COND_NEEDS_INVERTER_BUTTON,
+    {RELAY_K3, HIGH, OP_PREWARM_BUTTON_PRESS, "Pre-warm: inverter button PRESSED (K3 relay energized)"},
+    {RELAY_NONE, LOW, OP_PREWARM_READY, nullptr},
+    ACTION_NONE},
+
+  {OP_PREWARM_BUTTON_PRESS, HOLD_FIXED, RELAY_PRESS_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_K3, LOW, OP_PREWARM_BUTTON_RELEASE, "Pre-warm: inverter button RELEASED (K3 relay de-energized)"},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_PREWARM_BUTTON_RELEASE, HOLD_FIXED, RELAY_SETTLE_MS, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_PREWARM_DELAY2, nullptr},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_PREWARM_DELAY2, HOLD_DELAY2, 0, EARLY_ON_AC_STABLE, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_PREWARM_READY, nullptr},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_NONE},
+
+  {OP_PREWARM_READY, HOLD_NONE, 0, EARLY_NEVER, COND_ALWAYS,
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    {RELAY_NONE, LOW, OP_IDLE, nullptr},
+    ACTION_PREWARM_READY}
+};
+
+static constexpr size_t ROOF_OP_STEP_COUNT = sizeof(ROOF_OP_STEPS) / sizeof(ROOF_OP_STEPS[0]);
+
+static constexpr bool roofOpStepsIndexed(size_t i) {
+  return i == ROOF_OP_STEP_COUNT ||
+         ((size_t)ROOF_OP_STEPS[i].state == i && roofOpStepsIndexed(i + 1));
+}
 
-  unsigned long currentTime = millis();
-  unsigned long elapsed = currentTime - roofOpStepStartTime;
+static_assert(ROOF_OP_STEP_COUNT == OP_PREWARM_READY + 1, "ROOF_OP_STEPS must have one row per RoofOperationState");
+static_assert(roofOpStepsIndexed(0), "ROOF_OP_STEPS rows must be in RoofOperationState order");
 
-  switch (roofOpState) {
-    case OP_INVERTER_POWER_ON:
-      // K1 was turned on, waiting for delay before next step
-      {
-        unsigned long requiredDelay;
-        if (inverterSoftPwrEnabled) {
-          requiredDelay = inverterDelay1;  // Delay 1: K1 to K3
-        } else {
-          requiredDelay = inverterDelay2;  // Delay 2: K1 to K2
-        }
+static unsigned long stepHoldMs(const RoofOpStep& step) {
+  switch (step.hold) {
+    case HOLD_FIXED:    return step.holdMs;
+    case HOLD_POWER_ON: return inverterSoftPwrEnabled ? inverterDelay1 : inverterDelay2;
+    case HOLD_DELAY2:   return inverterDelay2;
+    default:            return 0;
+  }
+}
 
-        if (elapsed >= requiredDelay) {
-          Debug.printf("Delay complete (%lums)\n", requiredDelay);
-
-          // Move to next step based on configuration
-          if (inverterSoftPwrEnabled && roofOpNeedsInverterButton) {
-            // Need to press K3 soft-power button
-            digitalWrite(INVERTER_BUTTON_PIN, HIGH);
-            Debug.println("Inverter button PRESSED (K3 relay energized)");
-            roofOpState = OP_INVERTER_BUTTON_PRESS;
-            roofOpStepStartTime = currentTime;
-          } else if (inverterSoftPwrEnabled && !roofOpNeedsInverterButton) {
-            // Soft-power enabled but AC already on, skip to roof button
-            digitalWrite(ROOF_CONTROL_PIN, HIGH);
-            Debug.println("Button PRESSED (K2 relay energized)");
-            roofOpState = OP_ROOF_BUTTON_PRESS;
-            roofOpStepStartTime = currentTime;
-          } else {
-            // Soft-power disabled, go directly to roof button
-            digitalWrite(ROOF_CONTROL_PIN, HIGH);
-            Debug.println("Button PRESSED (K2 relay energized)");
-            roofOpState = OP_ROOF_BUTTON_PRESS;
-            roofOpStepStartTime = currentTime;
-          }
-        }
-      }
-      break;
+// AC output up and past the SWITCH_STABLE_TIME debounce
+static bool inverterACStable() {
+  return getInverterACPowerState();
+}
 
-    case OP_INVERTER_BUTTON_PRESS:
-      // K3 is pressed, wait 500ms then release
-      if (elapsed >= 500) {
-        digitalWrite(INVERTER_BUTTON_PIN, LOW);
-        Debug.println("Inverter button RELEASED (K3 relay de-energized)");
-        roofOpState = OP_INVERTER_BUTTON_RELEASE;
-        roofOpStepStartTime = currentTime;
-      }
-      break;
+static bool stepConditionMet(StepCondition condition) {
+  switch (condition) {
+    case COND_NEEDS_INVERTER_BUTTON:
+      // Pressing K3 with AC already up would toggle the inverter back off
+      return inverterSoftPwrEnabled && roofOpNeedsInverterButton && !(inverterAcSequencing && inverterACStable());
+    case COND_AC_PRESENT:            return getInverterACPowerState();
+    case COND_RESUME_REVERSAL:       return resumeReversal;
+    default:                         return true;
+  }
+}
 
-    case OP_INVERTER_BUTTON_RELEASE:
-      // K3 released, wait 100ms then proceed to delay2
-      if (elapsed >= 100) {
-        Debug.printf("Waiting %lums (Delay 2: inverter to roof button)\n", inverterDelay2);
-        roofOpState = OP_INVERTER_DELAY2;
-        roofOpStepStartTime = currentTime;
+static void runStepAction(StepAction action, unsigned long currentTime) {
+  switch (action) {
+    case ACTION_MOVEMENT_STARTED:
+      // K2 released, operation sequence complete
+      clearRoofErrorRecord();  // Clear any previous error
+      if (roofOpTarget == TARGET_OPEN) {
+        roofStatus = ROOF_OPENING;
+        Debug.println("Roof opening started");
+      } else if (roofOpTarget == TARGET_CLOSE) {
+        roofStatus = ROOF_CLOSING;
+        Debug.println("Roof closing started");
       }
-      break;
+      movementStartTime = currentTime - resumeElapsedMs;  // A resumed move keeps its earlier travel
+      resumeElapsedMs = 0;
+      lastSwitchTime = currentTime;  // Debounce after button press
 
-    case OP_INVERTER_DELAY2:
-      // Waiting delay2 after soft-power button
-      if (elapsed >= inverterDelay2) {
-        Debug.println("Delay 2 complete");
-        // Press roof button
-        digitalWrite(ROOF_CONTROL_PIN, HIGH);
-        Debug.println("Button PRESSED (K2 relay energized)");
-        roofOpState = OP_ROOF_BUTTON_PRESS;
-        roofOpStepStartTime = currentTime;
-      }
+      // Publish status change immediately
+      requestStatusPublish();
+      lastPublishedStatus = roofStatus;
       break;
 
-    case OP_ROOF_BUTTON_PRESS:
-      // K2 is pressed, wait 500ms then release
-      if (elapsed >= 500) {
-        digitalWrite(ROOF_CONTROL_PIN, LOW);
-        Debug.println("Button RELEASED (K2 relay de-energized)");
-        roofOpState = OP_ROOF_BUTTON_RELEASE;
-        roofOpStepStartTime = currentTime;
+    case ACTION_STOP_COMPLETE:
+      // Stopped at a part-open target: reported open (ASCOM has no part-open state)
+      if (takeRoofEncoderTargetStop()) {
+        roofStatus = ROOF_OPEN;
       }
-      break;
 
-    case OP_ROOF_BUTTON_RELEASE:
-      // K2 released, operation sequence complete
-      {
-        // Update roof status based on target
-        roofErrorReason = "";  // Clear any previous error
-        if (roofOpTarget == TARGET_OPEN) {
-          roofStatus = ROOF_OPENING;
-          Debug.println("Roof opening started");
-        } else if (roofOpTarget == TARGET_CLOSE) {
-          roofStatus = ROOF_CLOSING;
-          Debug.println("Roof closing started");
-        }
-        movementStartTime = currentTime;
-        lastSwitchTime = currentTime;  // Debounce after button press
+      // Update status based on limit switches
+      updateRoofStatus();
 
-        // Publish status change immediately
-        publishStatusToMQTT();
-        lastPublishedStatus = roofStatus;
+      // Publish status change
+      requestStatusPublish();
+      lastPublishedStatus = roofStatus;
 
-        // Return to idle
-        roofOpState = OP_IDLE;
-        roofOpTarget = TARGET_NONE;
-      }
+      // Shutdown inverter (handles K1 off, AC check, K3 toggle if needed) unless
+      // this was a clean stop and the keep-warm window applies
+      roofOpTarget = TARGET_NONE;
+      releaseInverterPower();
       break;
 
-    case OP_STOP_BUTTON_PRESS:
-      // K2 is pressed for stop, wait 500ms then release
-      if (elapsed >= 500) {
-        digitalWrite(ROOF_CONTROL_PIN, LOW);
-        Debug.println("Button RELEASED (K2 relay de-energized)");
-        roofOpState = OP_STOP_BUTTON_RELEASE;
-        roofOpStepStartTime = currentTime;
-      }
+    case ACTION_PREWARM_READY:
+      openInverterPrewarm(currentTime);
       break;
 
-    case OP_STOP_BUTTON_RELEASE:
-      // K2 released for stop, shutdown inverter and finish
-      {
-        // Update status based on limit switches
-        updateRoofStatus();
-
-        // Publish status change
-        publishStatusToMQTT();
-        lastPublishedStatus = roofStatus;
-
-        Debug.println("Roof movement stopped");
-
-        // Shutdown inverter (handles K1 off, AC check, K3 toggle if needed)
-        roofOpTarget = TARGET_NONE;
-        shutdownInverterPower();
-        // Note: roofOpState is now OP_SHUTDOWN_K1_WAIT (or OP_IDLE if soft-power disabled)
-        if (roofOpState == OP_IDLE) {
-          // shutdownInverterPower didn't start a sequence, we're done
-          roofOpTarget = TARGET_NONE;
-        }
-      }
+    default:
       break;
+  }
+}
 
-    case OP_SHUTDOWN_K1_WAIT:
-      // K1 was turned off, wait ~1 second then check if AC power is still present
-      if (elapsed >= 1000) {
-        bool acStillOn = getInverterACPowerState();
-        Debug.printf("Shutdown: AC power check after K1 off: %s\n", acStillOn ? "STILL ON" : "OFF");
-        if (acStillOn) {
-          // AC power still present - need to toggle K3 to kill soft-power
-          Debug.println("Shutdown: AC power still on, pressing K3 to toggle soft-power off");
-          digitalWrite(INVERTER_BUTTON_PIN, HIGH);
-          Debug.println("Shutdown: K3 relay energized");
-          roofOpState = OP_SHUTDOWN_K3_PRESS;
-          roofOpStepStartTime = currentTime;
-        } else {
-          // AC power is off, shutdown complete
-          Debug.println("Shutdown: AC power off, inverter shutdown complete");
-          roofOpState = OP_IDLE;
-          roofOpTarget = TARGET_NONE;
-        }
-      }
-      break;
+void processRoofOperation() {
+  // Nothing to do if idle
+  if (roofOpState == OP_IDLE) {
+    return;
+  }
 
-    case OP_SHUTDOWN_K3_PRESS:
-      // K3 pressed to toggle soft-power off, hold for 500ms then release
-      if (elapsed >= 500) {
-        digitalWrite(INVERTER_BUTTON_PIN, LOW);
-        Debug.println("Shutdown: K3 relay de-energized");
-        roofOpState = OP_SHUTDOWN_K3_RELEASE;
-        roofOpStepStartTime = currentTime;
-      }
-      break;
+  if ((size_t)roofOpState >= ROOF_OP_STEP_COUNT) {
+    // Unknown state, reset to idle
+    roofOpState = OP_IDLE;
+    roofOpTarget = TARGET_NONE;
+    return;
+  }
 
-    case OP_SHUTDOWN_K3_RELEASE:
-      // K3 released, wait 100ms settling time then done
-      if (elapsed >= 100) {
-        Debug.println("Shutdown: Inverter shutdown complete (K3 toggled)");
-        roofOpState = OP_IDLE;
-        roofOpTarget = TARGET_NONE;
-      }
-      break;
+  const RoofOpStep& step = ROOF_OP_STEPS[roofOpState];
+  unsigned long currentTime = millis();
+  unsigned long holdMs = stepHoldMs(step);
+  unsigned long heldMs = currentTime - roofOpStepStartTime;
+  bool acSequenced = step.early == EARLY_ON_AC_STABLE && inverterAcSequencing;
+  if (heldMs < holdMs) {
+    if (!acSequenced || !inverterACStable()) {
+      return;
+    }
+    // AC is up: skip the rest of the delay
+    inverterSequenceStats.earlyAdvances++;
+    inverterSequenceStats.lastSavedMs = holdMs - heldMs;
+    inverterSequenceStats.totalSavedMs += holdMs - heldMs;
+    Debug.printf("AC power stable %lums after sequence start - advancing %lums early\n",
+                 currentTime - roofOpSequenceStartTime, holdMs - heldMs);
+  }
 
-    default:
-      // Unknown state, reset to idle
-      roofOpState = OP_IDLE;
-      roofOpTarget = TARGET_NONE;
-      break;
+  const StepTransition& t = stepConditionMet(step.condition) ? step.onTrue : step.onFalse;
+  if (acSequenced && heldMs >= holdMs && t.next == OP_ROOF_BUTTON_PRESS && !inverterACStable()) {
+    // The configured delay ran out before AC was seen: K2 fires on the fixed schedule
+    inverterSequenceStats.timeouts++;
+    Debug.printf("AC power not stable after %lums - pressing K2 on the configured delay\n", holdMs);
+  }
+  writeRelay(t.relay, t.level);
+  if (t.message) {
+    Debug.println(t.message);
+  }
+
+  roofOpState = t.next;
+  roofOpStepStartTime = currentTime;
+  onRoofOpStateEntered(roofOpState);
+  runStepAction(step.action, currentTime);
+
+  if (roofOpState == OP_IDLE) {
+    roofOpTarget = TARGET_NONE;
   }
 }
 
-// Get state of AC power (via optocoupler on GPIO7)
+InverterSequenceStats getInverterSequenceStats() {
+  return inverterSequenceStats;
+}
+
+// Get state of AC power (via optocoupler on GPIO7), as debounced by the input sampler
 bool getInverterACPowerState() {
-  // Read the AC power detection pin
-  // When AC power is present, the optocoupler pulls the pin LOW
-  return digitalRead(INVERTER_AC_POWER_PIN) == LOW;
+  return (getInputStableMask() & inputBit(INPUT_AC_POWER)) != 0;
 }
 
-// Update and monitor inverter AC power state (call in main loop)
+// Inverter housekeeping (call in main loop); AC power state changes arrive
+// debounced from the input sampler through processInputEvents()
 void updateInverterPowerStatus() {
   unsigned long currentTime = millis();
 
-  // Read current AC power state
-  bool currentACPowerState = getInverterACPowerState();
-
-  // Check if AC power state changed
-  if (currentACPowerState != lastInverterACPowerState) {
-    lastInverterACPowerState = currentACPowerState;
-    lastInverterACPowerChangeTime = currentTime;
-    Debug.println("AC power state CHANGED to: " + String(currentACPowerState ? "ON" : "OFF"));
+  // Pre-warm window ran out with no move started
+  if (inverterPrewarm && roofOpState == OP_IDLE &&
+      currentTime - inverterPrewarmStart >= inverterPrewarmMinutes * 60000UL) {
+    endInverterPrewarm(currentTime);
+    inverterPrewarmStats.expiries++;
+    Debug.printf("Pre-warm window expired after %lus with no move - shutting inverter down\n",
+                 (currentTime - inverterPrewarmStart) / 1000);
+    shutdownInverterPower();
   }
 
-  // Only consider the state change valid if it has been stable for SWITCH_STABLE_TIME
-  if (currentTime - lastInverterACPowerChangeTime > SWITCH_STABLE_TIME) {
-    if (inverterACPowerState != currentACPowerState) {
-      inverterACPowerState = currentACPowerState;
-      Debug.println("AC power state UPDATED to: " + String(inverterACPowerState ? "ON" : "OFF"));
-
-      // Publish status to MQTT if AC power state changed
-      publishStatusToMQTT();
-    }
+  // Keep-warm window ran out (or was switched off) with no move started
+  if (inverterKeepWarm && roofOpState == OP_IDLE &&
+      currentTime - inverterKeepWarmStart >= inverterKeepWarmMinutes * 60000UL) {
+    inverterKeepWarmStats.expiries++;
+    Debug.printf("Keep-warm window expired after %lus - shutting inverter down\n",
+                 (currentTime - inverterKeepWarmStart) / 1000);
+    shutdownInverterPower();
   }
 
   // Debug output every 30 seconds
@@ -963,9 +1656,14 @@ void updateInverterPowerStatus() {
 // and if so toggles K3 to kill the soft-power.
 // Safe to call even if inverter is already off or K1/K3 are disabled.
 void shutdownInverterPower() {
+  if (inverterKeepWarm) {
+    endInverterKeepWarm(millis());
+  }
+  cancelInverterPrewarm();
+  rainTrip.inverterHeld = false;
+
   // Turn off K1 immediately (always safe to do)
-  digitalWrite(INVERTER_PIN, LOW);
-  inverterRelayState = false;
+  writeRelay(RELAY_K1, LOW);
 
   // If a shutdown sequence is already running, don't restart it
   if (roofOpState == OP_SHUTDOWN_K1_WAIT || roofOpState == OP_SHUTDOWN_K3_PRESS ||
@@ -977,10 +1675,118 @@ void shutdownInverterPower() {
   // If soft-power control is enabled, start the non-blocking check sequence
   if (inverterSoftPwrEnabled) {
     Debug.println("Shutdown: K1 OFF, waiting to check AC power state");
-    roofOpState = OP_SHUTDOWN_K1_WAIT;
-    roofOpStepStartTime = millis();
+    enterRoofOpState(OP_SHUTDOWN_K1_WAIT);
   } else {
     Debug.println("Shutdown: K1 OFF (soft-power control disabled, skipping AC check)");
     // No K3 control, we're done
   }
-}
\ No newline at end of file
+}
+
+// Inverter release after a move that ended cleanly (limit reached or user stop).
+// With a keep-warm window configured K1 stays on, so a move requested inside the
+// window skips the power-on delays and K3; updateInverterPowerStatus() shuts the
+// inverter down through shutdownInverterPower() when the window expires.
+// Errors always shut down at once.
+void releaseInverterPower() {
+  bool rainHold = rainTrip.holdInverter;
+  rainTrip.holdInverter = false;
+  if (rainHold && rainTrip.active && inverterRelayState && roofStatus != ROOF_ERROR) {
+    // The rain close presses K2 right after this stop: keep the inverter up for it
+    rainTrip.inverterHeld = true;
+    Debug.println("Inverter held on for the rain close");
+    return;
+  }
+  if (inverterKeepWarmMinutes == 0 || !inverterRelayState || roofStatus == ROOF_ERROR) {
+    shutdownInverterPower();
+    return;
+  }
+  if (!inverterKeepWarm) {
+    inverterKeepWarm = true;
+    inverterKeepWarmStart = millis();
+    inverterKeepWarmStats.windows++;
+  }
+  Debug.printf("Inverter kept warm for %lu minutes (K1 stays on)\n", inverterKeepWarmMinutes);
+}
+
+// Pre-warm (CMD_PREWARM, after the arbiter's checks): run the power-up half
+// of the open sequence now so the open itself can press K2 at once. An
+// inverter that is already running just gets the window.
+bool startInverterPrewarm() {
+  if (!inverterRelayEnabled && !inverterSoftPwrEnabled) {
+    return false;  // Nothing to power up
+  }
+  unsigned long currentTime = millis();
+  inverterPrewarmStats.requests++;
+
+  bool acPresent = getInverterACPowerState();
+  if (acPresent && (inverterRelayState || !inverterRelayEnabled)) {
+    if (inverterKeepWarm) {
+      endInverterKeepWarm(currentTime);  // The window carries on as a pre-warm
+    }
+    openInverterPrewarm(currentTime);
+    return true;
+  }
+
+  inverterPrewarmStats.spinUps++;
+  roofOpTarget = TARGET_NONE;
+  roofOpSequenceStartTime = currentTime;
+  inverterAcUpPending = !acPresent;
+  if (inverterSoftPwrEnabled) {
+    roofOpNeedsInverterButton = !acPresent;
+  } else {
+    roofOpNeedsInverterButton = false;
+  }
+
+  if (inverterRelayEnabled) {
+    writeRelay(RELAY_K1, HIGH);
+    Debug.println("Pre-warm: K1 relay turned ON");
+    enterRoofOpState(OP_PREWARM_POWER_ON);
+  } else {
+    writeRelay(RELAY_K3, HIGH);
+    Debug.println("Pre-warm: inverter button PRESSED (K3 relay energized)");
+    enterRoofOpState(OP_PREWARM_BUTTON_PRESS);
+  }
+  return true;
+}
+
+bool isInverterPrewarmRunning() {
+  return isPrewarmSequence(roofOpState);
+}
+
+bool extendInverterPrewarm() {
+  if (isPrewarmSequence(roofOpState)) {
+    return true;  // The window opens when the power-up finishes
+  }
+  if (!inverterPrewarm) {
+    return false;
+  }
+  openInverterPrewarm(millis());
+  return true;
+}
+
+InverterPrewarmStats getInverterPrewarmStats() {
+  InverterPrewarmStats stats = inverterPrewarmStats;
+  stats.running = isPrewarmSequence(roofOpState);
+  stats.active = inverterPrewarm;
+  stats.remainingMs = 0;
+  if (stats.active) {
+    unsigned long elapsed = millis() - inverterPrewarmStart;
+    unsigned long windowMs = inverterPrewarmMinutes * 60000UL;
+    stats.addedOnMs += elapsed;
+    stats.remainingMs = elapsed < windowMs ? windowMs - elapsed : 0;
+  }
+  return stats;
+}
+
+InverterKeepWarmStats getInverterKeepWarmStats() {
+  InverterKeepWarmStats stats = inverterKeepWarmStats;
+  stats.active = inverterKeepWarm;
+  stats.remainingMs = 0;
+  if (stats.active) {
+    unsigned long elapsed = millis() - inverterKeepWarmStart;
+    unsigned long windowMs = inverterKeepWarmMinutes * 60000UL;
+    stats.addedOnMs += elapsed;
+    stats.remainingMs = elapsed < windowMs ? windowMs - elapsed : 0;
+  }
+  return stats;
+}
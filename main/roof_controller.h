@@ -7,6 +7,8 @@
 #define ROOF_CONTROLLER_H
 
 #include "config.h"
+#include "roof_errors.h"
+#include "roof_telemetry.h"
 
 // Non-blocking state machine for roof operations
 // This allows the main loop to continue running WiFi/MQTT while relay sequences execute
@@ -22,7 +24,15 @@ enum RoofOperationState {
   OP_STOP_BUTTON_RELEASE,     // K2 released for stop, then shutdown inverter
   OP_SHUTDOWN_K1_WAIT,        // K1 turned off, waiting ~1s before checking AC power
   OP_SHUTDOWN_K3_PRESS,       // AC still on after K1 off, K3 pressed to toggle soft-power off
-  OP_SHUTDOWN_K3_RELEASE      // K3 released, shutdown complete
+  OP_SHUTDOWN_K3_RELEASE,     // K3 released, shutdown complete
+  OP_RESUME_REVERSE_RUN,      // Resume: opener running away from the target after the first press
+  OP_RESUME_STOP_PRESS,       // Resume: K2 pressed to stop it, waiting 500ms
+  OP_RESUME_STOP_RELEASE,     // Resume: K2 released, settling before the press toward the target
+  OP_PREWARM_POWER_ON,        // Pre-warm: K1 turned on, waiting for delay (no K2 at the end)
+  OP_PREWARM_BUTTON_PRESS,    // Pre-warm: K3 pressed, waiting 500ms
+  OP_PREWARM_BUTTON_RELEASE,  // Pre-warm: K3 released, waiting 100ms
+  OP_PREWARM_DELAY2,          // Pre-warm: waiting delay2 after soft-power
+  OP_PREWARM_READY            // Pre-warm: inverter up, the pre-warm window opens
 };
 
 // Target direction for current operation
@@ -33,6 +43,94 @@ enum RoofOperationTarget {
   TARGET_STOP
 };
 
+// Relays driven by the state machine (index into the relay pin table)
+enum RelayId : uint8_t {
+  RELAY_K1,                   // Inverter 12V power
+  RELAY_K2,                   // Roof opener button
+  RELAY_K3,                   // Inverter soft-power button
+  RELAY_COUNT,
+  RELAY_NONE = RELAY_COUNT    // No relay change
+};
+
+// AC sequencing mode: how the inverter waits ended (control task writes, others read)
+struct InverterSequenceStats {
+  uint32_t earlyAdvances;         // Waits ended early by stable AC power
+  uint32_t timeouts;              // Waits that ran the full configured delay without AC
+  unsigned long lastAcUpMs;       // Sequence start to stable AC, last sequence that raised it
+  unsigned long lastSavedMs;      // Delay skipped by the last early advance
+  unsigned long totalSavedMs;
+};
+
+// Keep-warm window: the inverter stays on after a move until the next one or expiry
+struct InverterKeepWarmStats {
+  uint32_t windows;               // Moves that ended with the inverter left running
+  uint32_t spinUpsAvoided;        // Moves started inside a window with AC already up
+  uint32_t expiries;              // Windows that ran out and shut the inverter down
+  unsigned long addedOnMs;        // Inverter on-time spent in windows (including the open one)
+  bool active;
+  unsigned long remainingMs;      // Until the open window expires (0 when none)
+};
+
+// Pre-warm: the inverter is powered up ahead of an expected open and held
+// ready for a window; hits are moves that found it warm (or took over its
+// power-up), misses are windows that expired or were cancelled unused
+struct InverterPrewarmStats {
+  uint32_t requests;              // Pre-warm requests accepted (trigger or explicit)
+  uint32_t spinUps;               // Of those, power-up sequences started (the rest found it running)
+  uint32_t hits;                  // Moves started in a window or during the power-up
+  uint32_t joined;                // Of the hits, moves that took over a running power-up
+  uint32_t expiries;              // Windows that ran out with no move
+  uint32_t cancelled;             // Pre-warms ended by a stop, a manual K1 switch-off or an error
+  unsigned long addedOnMs;        // Inverter on-time spent in windows (including the open one)
+  bool running;                   // Power-up sequence in progress
+  bool active;                    // Window open
+  unsigned long remainingMs;      // Until the open window expires (0 when none)
+};
+
+// How a rain trip ended
+enum RainTripOutcome : uint8_t {
+  RAIN_TRIP_PENDING,              // Hold-off, park interlock, stop of an opening roof or a running sequence
+  RAIN_TRIP_CLOSING,              // Close K2 pressed
+  RAIN_TRIP_ALREADY_CLOSED,       // Roof was closed or already closing
+  RAIN_TRIP_CLEARED,              // Rain stopped before the hold-off ran out
+  RAIN_TRIP_STOPPED               // A user stop cancelled the close before K2
+};
+
+// Sensor that raised a trip
+enum WeatherTripSource : uint8_t {
+  TRIP_RAIN_SENSOR,               // RG9 on GPIO37
+  TRIP_SNOW_SENSOR                // RS485 snow sensor (Modbus)
+};
+
+const uint32_t RAIN_LATENCY_UNSET = 0xFFFFFFFF;
+
+// One rain trip, from the RG9 edge to the close it caused
+struct RainTripRecord {
+  unsigned long tripMs;           // millis() when the debounced trip reached the control task
+  WeatherTripSource source;
+  uint32_t edgeToK2Us;            // Last sensor edge to the close K2 press (RAIN_LATENCY_UNSET when none)
+  unsigned long waitedMs;         // Of that, time held by the hold-off, interlock or a running sequence
+  bool stoppedOpening;            // The roof was opening and had to be stopped first
+  RainTripOutcome outcome;
+};
+
+// Rain auto-close (control task writes, others read)
+struct RainCloseStats {
+  uint32_t trips;                 // Rain or snow reported while its auto-close was enabled
+  uint32_t closes;                // Close sequences started by a trip
+  uint32_t stoppedOpening;        // Trips that stopped an opening roof before closing
+  uint32_t interlockWaits;        // Trips held because the telescope was not parked
+  uint32_t cleared;               // Trips dropped because rain stopped during the hold-off
+  uint32_t lockoutRejects;        // Open requests refused by the re-open lockout
+  uint32_t latencySamples;        // Trips that reached the close K2 press
+  uint32_t lastEdgeToK2Us;
+  uint32_t maxEdgeToK2Us;
+  uint64_t totalEdgeToK2Us;
+  bool pending;                   // A trip is waiting to press K2
+  bool lockout;                   // Opening is refused
+  unsigned long lockoutRemainingMs; // Dry time left before opening is allowed (0 while raining)
+};
+
 // State machine variables (extern declarations)
 extern RoofOperationState roofOpState;
 extern RoofOperationTarget roofOpTarget;
@@ -55,15 +153,12 @@ extern bool bypassParkSensor;
 extern bool lastTelescopeParkedState;
 extern unsigned long lastTelescopeParkedStateTime;
 extern bool telescopeParked;
-
-// Error tracking for ASCOM compliance (error reason for Slewing exception)
-extern String roofErrorReason;
+extern bool rainDetected;            // Debounced rain sensor output
+extern bool snowDetected;            // Debounced snow sensor digital output
 
 // Inverter power state variables (NEW in v3)
 extern bool inverterRelayState;      // State of K1 (12V power relay)
 extern bool inverterACPowerState;    // State of AC power (detected via optocoupler)
-extern bool lastInverterACPowerState; // Last AC power state for change detection
-extern unsigned long lastInverterACPowerChangeTime;
 extern bool inverterRelayEnabled;    // Enable K1 power relay control for roof movement
 extern bool inverterSoftPwrEnabled;  // Enable K3 soft-power button control for roof movement
 
@@ -74,19 +169,46 @@ void checkMovementTimeout();
 bool startOpeningRoof();
 bool startClosingRoof();
 bool stopRoofMovement(bool updateStatus = true);
-void sendButtonPress();
+bool startRoofMoveTo(int percent);  // Run toward a part-open position (needs a calibrated encoder)
+void faultRoofMovement(RoofErrorCode code, uint32_t param, MoveOutcome outcome);  // Fail the move in progress: ERROR, then stop
+bool sendButtonPress();         // Queue a K2 press (non-blocking)
 void applyPinSettings();  // Function to apply pin settings
 void determineInitialRoofStatus();
 void updateTelescopeStatus();  // Function to update telescope park status
 void clearRoofError();         // Clear error state and reason (for recovery)
 void processRoofOperation();   // Non-blocking state machine - call from main loop
+void writeRelay(RelayId relay, uint8_t level);  // Drive K1/K2/K3 (HIGH = energized)
+bool isRelayEnergized(RelayId relay);
+
+// Warm-restart resume (see roof_resume.h)
+bool resumeRoofMove(RoofOperationTarget target, bool reverseFirst, unsigned long elapsedMs);
+void trackResumedMove(RoofOperationTarget target, unsigned long elapsedMs);  // Opener still running
+bool isResumeReversalPending();       // First press of a resume will run the opener the wrong way
 
 // Inverter control functions (NEW in v3)
 void toggleInverterPower();           // Toggle K1 inverter power relay
-void sendInverterButtonPress();       // Send K3 soft-power button press
+bool sendInverterButtonPress();       // Queue a K3 soft-power button press (non-blocking)
 bool getInverterRelayState();         // Get state of K1 relay
 bool getInverterACPowerState();       // Get state of AC power (via optocoupler)
+InverterSequenceStats getInverterSequenceStats();
+InverterKeepWarmStats getInverterKeepWarmStats();
+bool startInverterPrewarm();          // Power up ahead of an open (false: nothing to power up)
+bool extendInverterPrewarm();         // Restart the open window; false when no pre-warm is under way
+bool isInverterPrewarmRunning();      // Pre-warm power-up in progress (an open or close takes it over)
+InverterPrewarmStats getInverterPrewarmStats();
 void updateInverterPowerStatus();     // Update and monitor inverter AC power state
 void shutdownInverterPower();         // Non-blocking inverter shutdown: K1 off, check AC, toggle K3 if needed
+void releaseInverterPower();          // After a clean move: keep the inverter warm, or shut it down
+
+// Rain auto-close
+void processRainAutoClose();          // Act on a pending rain trip (control step, after the sensors)
+bool rainReopenLocked();              // Opening is refused: raining, or not dry for the lockout yet
+void noteSnowSensorChange(bool snowing, uint32_t replyUs);  // Confirmed RS485 snow state change
+void noteRainLockoutReject();
+RainCloseStats getRainCloseStats();
+uint8_t getRainTripCount();
+const RainTripRecord& getRainTrip(uint8_t index);  // 0 = most recent
+const char* getRainTripOutcomeString(RainTripOutcome outcome);
+const char* getWeatherTripSourceString(WeatherTripSource source);
 
 #endif // ROOF_CONTROLLER_H
\ No newline at end of file
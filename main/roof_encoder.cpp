@@ -0,0 +1,452 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Encoder Implementation
+ */
+
+#include "roof_encoder.h"
+#include "roof_telemetry.h"
+#include "roof_errors.h"
+#include "roof_trace.h"
+#include "control_link.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include <driver/pulse_cnt.h>
+#include <atomic>
+
+// Define the global variables declared as extern in config.h
+int ENCODER_PIN_A = DEFAULT_ENCODER_PIN_A;
+int ENCODER_PIN_B = DEFAULT_ENCODER_PIN_B;
+long encoderCountsPerTravel = 0;
+
+// PCNT unit and the pins it was built for (control task)
+static pcnt_unit_handle_t encoderUnit = nullptr;
+static pcnt_channel_handle_t encoderChannels[2] = {nullptr, nullptr};
+static int unitPinA = -1;
+static int unitPinB = -1;
+static std::atomic<uint32_t> encoderWraps(0);   // Counted from the limit interrupt
+
+// Reference and span
+static int32_t encoderCount = 0;
+static bool referenced = false;         // closedCount holds the count at the closed limit
+static bool closedFromLimit = false;    // ...seen at the closed switch (not derived from the span)
+static int32_t closedCount = 0;
+static long savedSpan = 0;              // Span last handed to NVS
+static uint32_t spanUpdates = 0;        // Network task
+
+// Span on its way to NVS: the control task posts it, flushRoofEncoderSpan()
+// writes it from the network task so the control step never waits on flash
+static std::atomic<long> spanToSave(0);
+static std::atomic<uint32_t> spanChangeCount(0);
+static uint32_t spanSavedCount = 0;     // Network task: spanChangeCount at the last NVS write
+
+// Velocity window: the count every ENCODER_VELOCITY_SAMPLE_MS
+static int32_t velocityCounts[ENCODER_VELOCITY_SAMPLES];
+static unsigned long velocityTimes[ENCODER_VELOCITY_SAMPLES];
+static uint8_t velocityHead = 0;        // Next slot to write
+static uint8_t velocitySamples = 0;
+static float countsPerSecond = 0.0f;
+
+// Motion: steps of at least ENCODER_MOTION_COUNTS
+static int32_t motionCount = 0;
+static unsigned long lastMotionMs = 0;
+static int8_t lastMotionSign = 0;       // Sign of the count change, 0 until the first motion
+
+// Stall monitor for the move being recorded
+static bool monitoring = false;
+static unsigned long monitorStartMs = 0;
+static unsigned long monitoredMoveBegin = 0;
+static bool movedThisMove = false;
+static uint32_t stallCount = 0;
+
+// Part-open target
+static int moveTarget = -1;
+static bool targetStopping = false;     // stopRoofMovement() issued at the target
+static bool holding = false;
+static float holdPosition = 0.0f;
+static uint32_t targetStopCount = 0;
+static int lastTargetError = 0;
+
+static bool IRAM_ATTR onEncoderLimit(pcnt_unit_handle_t unit, const pcnt_watch_event_data_t* edata, void* ctx) {
+  encoderWraps.fetch_add(1, std::memory_order_relaxed);
+  return false;  // No task to wake
+}
+
+static void releaseEncoderUnit() {
+  if (encoderUnit == nullptr) {
+    return;
+  }
+  pcnt_unit_stop(encoderUnit);
+  pcnt_unit_disable(encoderUnit);
+  for (pcnt_channel_handle_t& channel : encoderChannels) {
+    if (channel != nullptr) {
+      pcnt_del_channel(channel);
+      channel = nullptr;
+    }
+  }
+  pcnt_unit_remove_watch_point(encoderUnit, ENCODER_PCNT_LIMIT);
+  pcnt_unit_remove_watch_point(encoderUnit, -ENCODER_PCNT_LIMIT);
+  pcnt_del_unit(encoderUnit);
+  encoderUnit = nullptr;
+}
+
+// One PCNT unit decoding both channels in 4x mode: every edge of A and of B
+// counts, up or down by the level of the other channel
+static bool buildEncoderUnit(int pinA, int pinB) {
+  pcnt_unit_config_t unitConfig = {};
+  unitConfig.low_limit = -ENCODER_PCNT_LIMIT;
+  unitConfig.high_limit = ENCODER_PCNT_LIMIT;
+  unitConfig.flags.accum_count = 1;  // Driver folds every limit crossing into the count
+  if (pcnt_new_unit(&unitConfig, &encoderUnit) != ESP_OK) {
+    encoderUnit = nullptr;
+    return false;
+  }
+
+  pcnt_glitch_filter_config_t filter = {};
+  filter.max_glitch_ns = ENCODER_GLITCH_FILTER_NS;
+
+  pcnt_chan_config_t channelA = {};
+  channelA.edge_gpio_num = pinA;
+  channelA.level_gpio_num = pinB;
+  pcnt_chan_config_t channelB = {};
+  channelB.edge_gpio_num = pinB;
+  channelB.level_gpio_num = pinA;
+
+  pcnt_event_callbacks_t callbacks = {};
+  callbacks.on_reach = onEncoderLimit;
+
+  bool ok = pcnt_unit_set_glitch_filter(encoderUnit, &filter) == ESP_OK &&
+            pcnt_new_channel(encoderUnit, &channelA, &encoderChannels[0]) == ESP_OK &&
+            pcnt_new_channel(encoderUnit, &channelB, &encoderChannels[1]) == ESP_OK &&
+            pcnt_channel_set_edge_action(encoderChannels[0], PCNT_CHANNEL_EDGE_ACTION_DECREASE,
+                                         PCNT_CHANNEL_EDGE_ACTION_INCREASE) == ESP_OK &&
+            pcnt_channel_set_level_action(encoderChannels[0], PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                          PCNT_CHANNEL_LEVEL_ACTION_INVERSE) == ESP_OK &&
+            pcnt_channel_set_edge_action(encoderChannels[1], PCNT_CHANNEL_EDGE_ACTION_INCREASE,
+                                         PCNT_CHANNEL_EDGE_ACTION_DECREASE) == ESP_OK &&
+            pcnt_channel_set_level_action(encoderChannels[1], PCNT_CHANNEL_LEVEL_ACTION_KEEP,
+                                          PCNT_CHANNEL_LEVEL_ACTION_INVERSE) == ESP_OK &&
+            pcnt_unit_add_watch_point(encoderUnit, ENCODER_PCNT_LIMIT) == ESP_OK &&
+            pcnt_unit_add_watch_point(encoderUnit, -ENCODER_PCNT_LIMIT) == ESP_OK &&
+            pcnt_unit_register_event_callbacks(encoderUnit, &callbacks, nullptr) == ESP_OK &&
+            pcnt_unit_enable(encoderUnit) == ESP_OK &&
+            pcnt_unit_clear_count(encoderUnit) == ESP_OK &&
+            pcnt_unit_start(encoderUnit) == ESP_OK;
+  if (!ok) {
+    releaseEncoderUnit();
+  }
+  return ok;
+}
+
+// Forget everything measured against the old unit's count
+static void resetEncoderState() {
+  encoderCount = 0;
+  referenced = false;
+  closedFromLimit = false;
+  closedCount = 0;
+  velocityHead = 0;
+  velocitySamples = 0;
+  countsPerSecond = 0.0f;
+  motionCount = 0;
+  lastMotionSign = 0;
+  monitoring = false;
+  moveTarget = -1;
+  targetStopping = false;
+  holding = false;
+  encoderWraps.store(0, std::memory_order_relaxed);
+}
+
+void applyRoofEncoderPins() {
+  if (ENCODER_PIN_A == unitPinA && ENCODER_PIN_B == unitPinB && (encoderUnit != nullptr || unitPinA < 0)) {
+    return;  // Rebuilding would throw away the reference for nothing
+  }
+
+  releaseEncoderUnit();
+  resetEncoderState();
+  unitPinA = ENCODER_PIN_A;
+  unitPinB = ENCODER_PIN_B;
+  savedSpan = encoderCountsPerTravel;
+
+  if (ENCODER_PIN_A < 0 || ENCODER_PIN_B < 0 || ENCODER_PIN_A == ENCODER_PIN_B) {
+    Debug.println("Roof encoder: not configured");
+    return;
+  }
+  if (!buildEncoderUnit(ENCODER_PIN_A, ENCODER_PIN_B)) {
+    Debug.printf("Roof encoder: PCNT setup failed on GPIO%d/GPIO%d\n", ENCODER_PIN_A, ENCODER_PIN_B);
+    return;
+  }
+  Debug.printf("Roof encoder: PCNT on GPIO%d/GPIO%d, span %ld counts%s\n", ENCODER_PIN_A, ENCODER_PIN_B,
+               encoderCountsPerTravel, encoderCountsPerTravel == 0 ? " (learned on the next full open)" : "");
+}
+
+bool isRoofEncoderConfigured() {
+  return encoderUnit != nullptr;
+}
+
+static bool spanKnown() {
+  return encoderCountsPerTravel >= ENCODER_MIN_SPAN || encoderCountsPerTravel <= -ENCODER_MIN_SPAN;
+}
+
+bool isRoofEncoderCalibrated() {
+  return encoderUnit != nullptr && referenced && spanKnown();
+}
+
+float getRoofEncoderPosition() {
+  if (!isRoofEncoderCalibrated()) {
+    return -1.0f;
+  }
+  return (float)(encoderCount - closedCount) * 100.0f / (float)encoderCountsPerTravel;
+}
+
+// +1 when the count runs the way the roof opens
+static int openingSign() {
+  return encoderCountsPerTravel < 0 ? -1 : 1;
+}
+
+static void saveSpan() {
+  savedSpan = encoderCountsPerTravel;
+  spanToSave.store(encoderCountsPerTravel, std::memory_order_relaxed);
+  spanChangeCount.fetch_add(1, std::memory_order_release);
+  Debug.printf("Roof encoder: span %ld counts learned\n", encoderCountsPerTravel);
+}
+
+void flushRoofEncoderSpan() {
+  uint32_t changes = spanChangeCount.load(std::memory_order_acquire);
+  if (changes == spanSavedCount) {
+    return;
+  }
+  long span = spanToSave.load(std::memory_order_relaxed);
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putLong(PREF_ENCODER_SPAN, span);
+  prefs.end();
+  spanSavedCount = changes;
+  spanUpdates++;
+}
+
+void resetRoofEncoderSpan() {
+  if (encoderCountsPerTravel == 0 && savedSpan == 0) {
+    return;
+  }
+  encoderCountsPerTravel = 0;
+  saveSpan();  // 0 in NVS: learn it again after a reboot too
+  if (!closedFromLimit) {
+    referenced = false;  // Derived from the span just dropped
+  }
+  Debug.println("Roof encoder: span cleared, learned again on the next full open");
+}
+
+// Anchor the count at the limit switches once the drive has come to rest
+// there (the status lags the contact by its debounce, so a roof just leaving
+// a limit still reads CLOSED/OPEN); a full open from a known closed count
+// measures the span, which is written out only when it moves by over 1%
+static void updateReference(unsigned long now) {
+  bool atRest = roofOpState == OP_IDLE && telemetryActiveDirection() == MOVE_NONE &&
+                (lastMotionSign == 0 || now - lastMotionMs >= ENCODER_STALL_MS);
+  if (!atRest) {
+    return;
+  }
+  if (roofStatus == ROOF_CLOSED && lastClosedSwitchState) {
+    closedCount = encoderCount;
+    referenced = true;
+    closedFromLimit = true;
+    return;
+  }
+  if (roofStatus != ROOF_OPEN || !lastOpenSwitchState || holding) {
+    return;
+  }
+
+  if (closedFromLimit) {
+    long span = encoderCount - closedCount;
+    if (span >= ENCODER_MIN_SPAN || span <= -ENCODER_MIN_SPAN) {
+      encoderCountsPerTravel = span;
+      long drift = span - savedSpan;
+      if (savedSpan == 0 || (drift < 0 ? -drift : drift) * 100 > (savedSpan < 0 ? -savedSpan : savedSpan)) {
+        saveSpan();
+      }
+    }
+  } else if (spanKnown()) {
+    closedCount = encoderCount - (int32_t)encoderCountsPerTravel;
+    referenced = true;
+  }
+}
+
+static void updateVelocity(unsigned long now) {
+  uint8_t newest = (velocityHead + ENCODER_VELOCITY_SAMPLES - 1) % ENCODER_VELOCITY_SAMPLES;
+  if (velocitySamples > 0 && now - velocityTimes[newest] < ENCODER_VELOCITY_SAMPLE_MS) {
+    return;
+  }
+  velocityCounts[velocityHead] = encoderCount;
+  velocityTimes[velocityHead] = now;
+  velocityHead = (velocityHead + 1) % ENCODER_VELOCITY_SAMPLES;
+  if (velocitySamples < ENCODER_VELOCITY_SAMPLES) velocitySamples++;
+
+  uint8_t oldest = (velocityHead + ENCODER_VELOCITY_SAMPLES - velocitySamples) % ENCODER_VELOCITY_SAMPLES;
+  unsigned long spanMs = now - velocityTimes[oldest];
+  countsPerSecond = spanMs > 0 ? (float)(encoderCount - velocityCounts[oldest]) * 1000.0f / (float)spanMs : 0.0f;
+}
+
+// The roof has arrived when its destination switch closes; the switch is
+// debounced for longer than the stall time, so read the contact itself
+static bool atDestination(MoveDirection direction) {
+  if (direction == MOVE_OPEN) {
+    return lastOpenSwitchState || digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED;
+  }
+  return lastClosedSwitchState || digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED;
+}
+
+// A move is watched from its K2 release (the opener running) until it ends
+static void checkStall(unsigned long now) {
+  const ActiveMove& move = telemetryActiveMove();
+  bool active = (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) && roofOpState == OP_IDLE &&
+                move.direction != MOVE_NONE && move.pressTime != 0;
+  if (!active) {
+    monitoring = false;
+    return;
+  }
+  if (!monitoring || move.beginTime != monitoredMoveBegin) {
+    monitoring = true;
+    monitorStartMs = now;
+    monitoredMoveBegin = move.beginTime;
+    movedThisMove = lastMotionSign != 0 && (long)(lastMotionMs - move.pressTime) >= 0;
+  }
+  if (atDestination(move.direction)) {
+    return;
+  }
+
+  unsigned long stillMs;
+  if (movedThisMove) {
+    unsigned long since = (long)(lastMotionMs - monitorStartMs) > 0 ? lastMotionMs : monitorStartMs;
+    stillMs = now - since;
+    if (stillMs < ENCODER_STALL_MS) return;
+  } else {
+    stillMs = now - move.pressTime;
+    if (stillMs < ENCODER_START_MS) return;
+  }
+
+  stallCount++;
+  monitoring = false;
+  moveTarget = -1;
+  Debug.printf("Roof encoder: no motion for %lums at count %ld\n", stillMs, (long)encoderCount);
+  traceRecord(TRACE_SENSOR_FAULT, micros(), ROOF_ERR_ENCODER_STALL, stillMs > 0xFFFF ? 0xFFFF : (uint16_t)stillMs);
+  faultRoofMovement(ROOF_ERR_ENCODER_STALL, stillMs, MOVE_STALLED);
+}
+
+// Stop a move with a part-open target once it gets there
+static void checkTarget() {
+  if (moveTarget < 0 || targetStopping) {
+    return;
+  }
+  if (telemetryActiveDirection() == MOVE_NONE) {
+    moveTarget = -1;  // Move ended some other way
+    return;
+  }
+  if (roofOpState != OP_IDLE || (roofStatus != ROOF_OPENING && roofStatus != ROOF_CLOSING)) {
+    return;
+  }
+
+  float position = getRoofEncoderPosition();
+  bool reached = (roofStatus == ROOF_OPENING) ? position >= moveTarget : position <= moveTarget;
+  if (!reached) {
+    return;
+  }
+  Debug.printf("Roof encoder: target %d%% reached at %.1f%%\n", moveTarget, position);
+  targetStopping = true;
+  stopRoofMovement();
+}
+
+void updateRoofEncoder() {
+  if (encoderUnit == nullptr) {
+    return;
+  }
+  unsigned long now = millis();
+
+  int count = 0;
+  if (pcnt_unit_get_count(encoderUnit, &count) == ESP_OK) {
+    encoderCount = count;
+  }
+
+  int32_t moved = encoderCount - motionCount;
+  if (moved >= ENCODER_MOTION_COUNTS || moved <= -ENCODER_MOTION_COUNTS) {
+    lastMotionSign = moved > 0 ? 1 : -1;
+    motionCount = encoderCount;
+    lastMotionMs = now;
+    movedThisMove = true;
+  }
+
+  updateVelocity(now);
+  updateReference(now);
+
+  // A held roof that is moved by hand, or reaches a limit, is no longer held
+  if (holding) {
+    float drift = getRoofEncoderPosition() - holdPosition;
+    if (roofStatus != ROOF_OPEN || lastOpenSwitchState || lastClosedSwitchState ||
+        drift > ENCODER_TARGET_TOLERANCE || drift < -ENCODER_TARGET_TOLERANCE) {
+      holding = false;
+      Debug.println("Roof encoder: part-open hold released");
+    }
+  }
+
+  checkStall(now);
+  if (isRoofEncoderCalibrated()) {
+    checkTarget();
+  }
+}
+
+void setRoofEncoderTarget(int percent) {
+  moveTarget = percent;
+  targetStopping = false;
+}
+
+int getRoofEncoderTarget() {
+  return moveTarget;
+}
+
+bool takeRoofEncoderTargetStop() {
+  if (!targetStopping) {
+    return false;
+  }
+  float position = getRoofEncoderPosition();
+  lastTargetError = (int)(position - moveTarget + (position >= moveTarget ? 0.5f : -0.5f));
+  targetStopCount++;
+  targetStopping = false;
+  moveTarget = -1;
+  holding = true;
+  holdPosition = position;
+  return true;
+}
+
+bool isRoofHeldPartOpen() {
+  return holding;
+}
+
+// Like a garage opener, the next press runs opposite to the last motion
+bool roofEncoderPressReverses(RoofOperationTarget target) {
+  if (!isRoofEncoderCalibrated() || lastMotionSign == 0 || lastOpenSwitchState || lastClosedSwitchState) {
+    return false;  // From a limit the opener always leaves it
+  }
+  bool lastOpening = lastMotionSign == openingSign();
+  return lastOpening == (target == TARGET_OPEN);
+}
+
+RoofEncoderStats getRoofEncoderStats() {
+  RoofEncoderStats stats;
+  stats.configured = isRoofEncoderConfigured();
+  stats.referenced = referenced;
+  stats.calibrated = isRoofEncoderCalibrated();
+  stats.count = encoderCount;
+  stats.closedCount = closedCount;
+  stats.span = encoderCountsPerTravel;
+  stats.position = getRoofEncoderPosition();
+  stats.countsPerSecond = countsPerSecond;
+  stats.percentPerSecond = stats.calibrated ? countsPerSecond * 100.0f / (float)encoderCountsPerTravel : 0.0f;
+  stats.lastDirection = spanKnown() ? (int8_t)(lastMotionSign * openingSign()) : 0;
+  stats.wraps = encoderWraps.load(std::memory_order_relaxed);
+  stats.stalls = stallCount;
+  stats.spanUpdates = spanUpdates;
+  stats.target = moveTarget;
+  stats.holding = holding;
+  stats.targetStops = targetStopCount;
+  stats.lastTargetError = lastTargetError;
+  return stats;
+}
@@ -0,0 +1,61 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Encoder Header
+ *
+ * Optional incremental (quadrature) encoder on the roof drive. Both channels
+ * are decoded in hardware by one PCNT unit in 4x mode with its glitch filter
+ * on; the unit wraps at +/-ENCODER_PCNT_LIMIT and the driver folds each wrap
+ * into an accumulator from the limit interrupt, so pulses cost no CPU and
+ * the count never overflows. The control step reads the count once, turns it
+ * into an absolute 0-100% position (anchored at the closed limit, scaled by
+ * the closed-to-open span learned on a full open and kept in NVS) and a
+ * velocity, fails a move as stalled within ENCODER_STALL_MS of the motion
+ * stopping, and stops a move at a part-open target.
+ */
+
+#ifndef ROOF_ENCODER_H
+#define ROOF_ENCODER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "roof_controller.h"
+
+struct RoofEncoderStats {
+  bool configured;                // Pins set and the PCNT unit counting
+  bool referenced;                // Count at the closed limit known since boot
+  bool calibrated;                // Referenced and the span known: position is absolute
+  int32_t count;                  // Accumulated count since the unit was built
+  int32_t closedCount;            // Count at the closed limit (when referenced)
+  long span;                      // Closed-to-open counts, signed (0 = not learned)
+  float position;                 // Percent, -1 when not calibrated
+  float countsPerSecond;          // Over the velocity window, signed
+  float percentPerSecond;         // Positive while opening, 0 when not calibrated
+  int8_t lastDirection;           // Last motion: 1 opening, -1 closing, 0 none seen
+  uint32_t wraps;                 // PCNT limit crossings folded into the count
+  uint32_t stalls;                // Moves failed by the stall check
+  uint32_t spanUpdates;           // Span learned or corrected (each one an NVS write)
+  int target;                     // Part-open target for the current move, -1 none
+  bool holding;                   // Roof stopped at a part-open target
+  uint32_t targetStops;           // Moves stopped at their target
+  int lastTargetError;            // Position at the last target stop minus its target (percent)
+};
+
+void applyRoofEncoderPins();                    // (Re)build the PCNT unit for ENCODER_PIN_A/B (control task)
+void resetRoofEncoderSpan();                    // Forget the span, learn it on the next full open (control task)
+void updateRoofEncoder();                       // Control step: position, velocity, stall and target checks
+void flushRoofEncoderSpan();                    // Network task: NVS copy of a newly learned span
+
+bool isRoofEncoderConfigured();
+bool isRoofEncoderCalibrated();
+float getRoofEncoderPosition();                 // 0-100 (can run slightly past the ends), -1 when not calibrated
+
+// Part-open targets (control task)
+void setRoofEncoderTarget(int percent);         // Stop the next move here (-1 = run to the limit switch)
+int getRoofEncoderTarget();
+bool takeRoofEncoderTargetStop();               // The stop just completed was at the target: hold part-open
+bool isRoofHeldPartOpen();                      // Reported OPEN between the limit switches
+bool roofEncoderPressReverses(RoofOperationTarget target);  // The next K2 press would run away from target
+
+RoofEncoderStats getRoofEncoderStats();
+
+#endif // ROOF_ENCODER_H
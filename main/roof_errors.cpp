@@ -0,0 +1,89 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Error Codes Implementation
+ */
+
+#include "roof_errors.h"
+#include "safety_monitor.h"
+#include <stdio.h>
+
+RoofError roofError = {ROOF_ERR_NONE, 0, 0};
+
+struct RoofErrorInfo {
+  const char* id;
+  int alpacaNumber;
+  const char* format;               // Takes the parameter in seconds as a double
+};
+
+// Indexed by RoofErrorCode; 0x500 is the generic Alpaca DriverException
+static const RoofErrorInfo ROOF_ERROR_TABLE[ROOF_ERR_COUNT] = {
+  {"none", 0x500, ""},
+  {"startup_both_limits", 0x501,
+   "Controller startup detected both limit switches triggered. "
+   "This indicates a hardware fault - check limit switch wiring and mechanical alignment."},
+  {"startup_unknown_position", 0x502,
+   "Controller startup detected roof in unknown position (neither limit switch triggered). "
+   "Manual intervention may be required to move roof to a known position."},
+  {"both_limits", 0x503,
+   "Both open and closed limit switches are triggered simultaneously. "
+   "This indicates a hardware fault - check limit switch wiring and mechanical alignment."},
+  {"open_start_failed", 0x504,
+   "Roof failed to start opening. Closed limit switch still triggered after %.1f seconds. "
+   "Check motor, relay, or mechanical obstruction."},
+  {"close_start_failed", 0x505,
+   "Roof failed to start closing. Open limit switch still triggered after %.1f seconds. "
+   "Check motor, relay, or mechanical obstruction."},
+  {"open_timeout", 0x506,
+   "Roof movement timed out after %.0f seconds while trying to open. "
+   "Limit switch did not trigger. Check mechanical obstruction or motor failure."},
+  {"close_timeout", 0x507,
+   "Roof movement timed out after %.0f seconds while trying to close. "
+   "Limit switch did not trigger. Check mechanical obstruction or motor failure."},
+  {"encoder_stall", 0x508,
+   "Roof stalled: no encoder motion for %.1f seconds while it should have been travelling. "
+   "Check mechanical obstruction or motor failure."},
+  {"motor_overcurrent", 0x509,
+   "Roof stopped: motor current stayed above its learned profile for %.2f seconds. "
+   "Check for an obstruction on the rails or a binding drive."}
+};
+
+void recordRoofError(RoofErrorCode code, uint32_t param) {
+  roofError.code = code < ROOF_ERR_COUNT ? code : ROOF_ERR_NONE;
+  roofError.param = param;
+  roofError.timeMs = millis();
+  setSafetyReason(SAFETY_ROOF_ERROR, roofError.code != ROOF_ERR_NONE);
+}
+
+void clearRoofErrorRecord() {
+  roofError.code = ROOF_ERR_NONE;
+  roofError.param = 0;
+  roofError.timeMs = 0;
+  setSafetyReason(SAFETY_ROOF_ERROR, false);
+}
+
+size_t formatRoofError(const RoofError& error, char* buffer, size_t size) {
+  if (size == 0) return 0;
+  if (error.code == ROOF_ERR_NONE || error.code >= ROOF_ERR_COUNT) {
+    buffer[0] = '\0';
+    return 0;
+  }
+
+  int len = snprintf(buffer, size, ROOF_ERROR_TABLE[error.code].format, error.param / 1000.0);
+  if (len < 0) {
+    buffer[0] = '\0';
+    return 0;
+  }
+  return (size_t)len < size ? (size_t)len : size - 1;
+}
+
+const char* getRoofErrorId(RoofErrorCode code) {
+  return code < ROOF_ERR_COUNT ? ROOF_ERROR_TABLE[code].id : "unknown";
+}
+
+int getRoofErrorAlpacaNumber(RoofErrorCode code) {
+  return code < ROOF_ERR_COUNT ? ROOF_ERROR_TABLE[code].alpacaNumber : 0x500;
+}
+
+bool isRoofTimeoutError(RoofErrorCode code) {
+  return code == ROOF_ERR_OPEN_TIMEOUT || code == ROOF_ERR_CLOSE_TIMEOUT;
+}
@@ -0,0 +1,47 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Error Codes Header
+ *
+ * A roof error is recorded as a code, one numeric parameter and the time it
+ * happened. The human-readable messages live in a constant table and are only
+ * formatted at the API boundary, straight into the caller's buffer, so no
+ * heap Strings are built in the control path.
+ */
+
+#ifndef ROOF_ERRORS_H
+#define ROOF_ERRORS_H
+
+#include <Arduino.h>
+
+enum RoofErrorCode : uint8_t {
+  ROOF_ERR_NONE = 0,
+  ROOF_ERR_STARTUP_BOTH_LIMITS,     // Both limit switches triggered at startup / error clear
+  ROOF_ERR_STARTUP_UNKNOWN,         // Neither limit switch triggered at startup / error clear
+  ROOF_ERR_BOTH_LIMITS,             // Both limit switches triggered during operation
+  ROOF_ERR_OPEN_START_FAILED,       // Closed switch still triggered after the switch timeout (param: ms)
+  ROOF_ERR_CLOSE_START_FAILED,      // Open switch still triggered after the switch timeout (param: ms)
+  ROOF_ERR_OPEN_TIMEOUT,            // Open limit not reached within the movement timeout (param: ms)
+  ROOF_ERR_CLOSE_TIMEOUT,           // Closed limit not reached within the movement timeout (param: ms)
+  ROOF_ERR_ENCODER_STALL,           // Encoder saw no motion while the roof should be travelling (param: ms)
+  ROOF_ERR_MOTOR_OVERCURRENT,       // Motor current over the learned envelope (param: ms over it)
+  ROOF_ERR_COUNT
+};
+
+struct RoofError {
+  RoofErrorCode code;
+  uint32_t param;                   // Meaning depends on the code (see above)
+  unsigned long timeMs;             // millis() when recorded
+};
+
+// Control side
+void recordRoofError(RoofErrorCode code, uint32_t param = 0);
+void clearRoofErrorRecord();
+extern RoofError roofError;
+
+// Formatting (any task)
+size_t formatRoofError(const RoofError& error, char* buffer, size_t size);  // "" for ROOF_ERR_NONE
+const char* getRoofErrorId(RoofErrorCode code);     // Stable short identifier, e.g. "open_timeout"
+int getRoofErrorAlpacaNumber(RoofErrorCode code);   // Driver-specific Alpaca ErrorNumber (0x500-0x5FF)
+bool isRoofTimeoutError(RoofErrorCode code);        // Stopped mid-travel by the movement timeout
+
+#endif // ROOF_ERRORS_H
@@ -0,0 +1,188 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Position Estimator Implementation
+ */
+
+#include "roof_position.h"
+#include "roof_controller.h"
+#include "roof_telemetry.h"
+#include "roof_encoder.h"
+#include "control_link.h"
+#include "Debug.h"
+#include <Preferences.h>
+
+unsigned long positionPublishInterval = DEFAULT_POSITION_PUBLISH_INTERVAL;
+
+// Travel profile captured once per move from the history
+struct MoveProfile {
+  bool valid;                   // At least one completed move in this direction
+  bool warnings;                // Enough samples to judge stalls
+  uint32_t releaseMs;           // Median K2 press to departure switch release
+  uint32_t motionMs;            // Median release to target switch
+  uint32_t releaseLateMs;       // Departure switch overdue after this
+  uint32_t travelLateMs;        // Target switch overdue after this
+};
+
+static float positionPercent = -1.0f;          // Current estimate (-1 = unknown)
+static bool positionEstimated = false;
+static float moveStartPercent = -1.0f;
+static unsigned long trackedMoveBegin = 0;     // beginTime of the move being followed
+static MoveProfile profile = {false, false, 0, 0, 0, 0};
+static const char* stallWarning = "";
+static int lastPublishedPosition = -2;
+static unsigned long lastPositionPublishTime = 0;
+
+void initRoofPosition() {
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);  // Read-only
+  positionPublishInterval = prefs.getULong(PREF_POSITION_INTERVAL, DEFAULT_POSITION_PUBLISH_INTERVAL);
+  prefs.end();
+
+  Debug.printf("Position publish interval: %lu ms\n", positionPublishInterval);
+}
+
+static uint32_t lateAfter(uint32_t expectedMs) {
+  uint32_t margin = expectedMs * STALL_WARNING_MARGIN_PERCENT / 100;
+  return expectedMs + (margin > STALL_WARNING_MIN_MARGIN ? margin : STALL_WARNING_MIN_MARGIN);
+}
+
+static void loadProfile(MoveDirection direction) {
+  MoveMetricStats travel = getMoveStats(direction, METRIC_TRAVEL);
+  MoveMetricStats release = getMoveStats(direction, METRIC_RELEASE);
+
+  profile.valid = travel.samples > 0;
+  profile.warnings = travel.samples >= ADAPTIVE_MIN_SAMPLES && release.samples >= ADAPTIVE_MIN_SAMPLES;
+  profile.releaseMs = release.samples > 0 ? release.p50 : 0;
+  profile.motionMs = (travel.p50 > profile.releaseMs) ? travel.p50 - profile.releaseMs : travel.p50;
+  profile.releaseLateMs = lateAfter(release.p99);
+  profile.travelLateMs = lateAfter(travel.p95);
+}
+
+static void setStallWarning(const char* warning) {
+  if (warning[0] != '\0' && stallWarning[0] == '\0') {
+    Debug.printf("STALL WARNING: %s\n", warning);
+    stallWarning = warning;
+    requestStatusPublish();
+  }
+  stallWarning = warning;
+}
+
+// Advance the estimate for a move the controller started
+static void estimateMovingPosition(const ActiveMove& move, unsigned long now) {
+  if (move.beginTime != trackedMoveBegin) {
+    // New move: remember where it started and which profile applies
+    trackedMoveBegin = move.beginTime;
+    moveStartPercent = positionPercent;
+    loadProfile(move.direction);
+    stallWarning = "";
+  }
+
+  if (move.pressTime == 0 || moveStartPercent < 0.0f || !profile.valid) {
+    return;  // Roof not commanded yet, or nothing to reckon from
+  }
+
+  float sign = (move.direction == MOVE_OPEN) ? 1.0f : -1.0f;
+  bool fromLimit = (move.direction == MOVE_OPEN) ? (moveStartPercent <= 0.0f) : (moveStartPercent >= 100.0f);
+  unsigned long sincePress = now - move.pressTime;
+
+  // Motion starts when the roof leaves the departure switch (seen, or expected from the profile)
+  unsigned long anchor = 0;
+  if (fromLimit) {
+    anchor = (move.releaseMs != MOVE_METRIC_UNSET) ? move.releaseMs : profile.releaseMs;
+  }
+
+  float fraction = 0.0f;
+  if (sincePress > anchor && profile.motionMs > 0) {
+    fraction = (float)(sincePress - anchor) / (float)profile.motionMs;
+  }
+  float estimate = moveStartPercent + sign * fraction * 100.0f;
+
+  // Only the limit switches may report fully open or closed
+  if (estimate < 1.0f) estimate = 1.0f;
+  if (estimate > 99.0f) estimate = 99.0f;
+  positionPercent = estimate;
+  positionEstimated = true;
+
+  if (profile.warnings) {
+    if (fromLimit && move.releaseMs == MOVE_METRIC_UNSET && sincePress > profile.releaseLateMs) {
+      setStallWarning("Roof has not left its limit switch within its usual time");
+    } else if (move.travelMs == MOVE_METRIC_UNSET && sincePress > profile.travelLateMs) {
+      setStallWarning("Roof is behind its usual travel time and may be stalled");
+    }
+  }
+}
+
+void updateRoofPosition() {
+  unsigned long now = millis();
+
+  if (isRoofEncoderCalibrated()) {
+    // Measured, not reckoned: no estimate and no profile to fall behind
+    float measured = getRoofEncoderPosition();
+    if (roofStatus == ROOF_CLOSED) measured = 0.0f;
+    if (roofStatus == ROOF_OPEN && !isRoofHeldPartOpen()) measured = 100.0f;
+    if (measured < 0.0f) measured = 0.0f;
+    if (measured > 100.0f) measured = 100.0f;
+    positionPercent = measured;
+    positionEstimated = false;
+    stallWarning = "";
+  } else if (roofStatus == ROOF_OPEN) {
+    positionPercent = 100.0f;
+    positionEstimated = false;
+    stallWarning = "";
+  } else if (roofStatus == ROOF_CLOSED) {
+    positionPercent = 0.0f;
+    positionEstimated = false;
+    stallWarning = "";
+  } else {
+    const ActiveMove& move = telemetryActiveMove();
+    if (move.direction != MOVE_NONE) {
+      estimateMovingPosition(move, now);
+    }
+    // Otherwise (stopped, error, or moved by hand) hold the last estimate
+  }
+
+  // Publish on change: rate-limited while moving, immediately once at rest
+  int position = getRoofPosition();
+  bool moving = (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING);
+  if (position >= 0 && position != lastPublishedPosition) {
+    bool due = !moving || (positionPublishInterval > 0 && now - lastPositionPublishTime >= positionPublishInterval);
+    if (due) {
+      requestPositionPublish(position);
+      lastPublishedPosition = position;
+      lastPositionPublishTime = now;
+    }
+  }
+}
+
+int getRoofPosition() {
+  return positionPercent < 0.0f ? -1 : (int)(positionPercent + 0.5f);
+}
+
+bool isRoofPositionEstimated() {
+  return positionEstimated;
+}
+
+const char* getStallWarning() {
+  return stallWarning;
+}
+
+void restoreRoofPosition(int percent) {
+  if (percent < 0) {
+    positionPercent = -1.0f;
+    positionEstimated = false;
+    return;
+  }
+  positionPercent = (float)percent;
+  positionEstimated = true;
+}
+
+void setPositionPublishInterval(unsigned long intervalMs) {
+  positionPublishInterval = intervalMs;
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putULong(PREF_POSITION_INTERVAL, positionPublishInterval);
+  prefs.end();
+
+  Debug.printf("Position publish interval set to %lu ms\n", positionPublishInterval);
+}
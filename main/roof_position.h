@@ -0,0 +1,32 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Position Estimator Header
+ *
+ * Dead-reckons a 0-100% roof position between the limit switches from the
+ * travel profile of previous completed moves (median release latency and
+ * travel time, see roof_telemetry.h). The estimate is anchored at the real
+ * departure switch release when it is seen, and snaps to 0/100 whenever the
+ * controller reports CLOSED/OPEN. A move that falls behind its profile raises
+ * a stall warning well before the movement timeout fires. With a calibrated
+ * encoder (roof_encoder.h) the measured position replaces the estimate.
+ */
+
+#ifndef ROOF_POSITION_H
+#define ROOF_POSITION_H
+
+#include <Arduino.h>
+#include "config.h"
+
+extern unsigned long positionPublishInterval;   // MQTT position rate while moving (ms, 0 = arrival only)
+
+void initRoofPosition();                        // Load publish rate from NVS
+void updateRoofPosition();                      // Recompute and publish - call from the main loop
+
+int getRoofPosition();                          // 0-100, or -1 when unknown
+bool isRoofPositionEstimated();                 // True between the limit switches
+const char* getStallWarning();                  // Empty string when the move is on profile
+
+void setPositionPublishInterval(unsigned long intervalMs);
+void restoreRoofPosition(int percent);          // Estimate from before a reset (held until a limit switch, -1 = unknown)
+
+#endif // ROOF_POSITION_H
@@ -0,0 +1,304 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Warm-Restart Resume Implementation
+ */
+
+#include "roof_resume.h"
+#include "roof_controller.h"
+#include "roof_errors.h"
+#include "roof_position.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include "esp_system.h"
+#include <atomic>
+
+static const uint32_t RESUME_SNAPSHOT_MAGIC = 0x52534D31;  // "RSM1"
+
+// Survives brownout and watchdog resets; garbage after power-on (caught by the checksum)
+RTC_NOINIT_ATTR static ResumeSnapshot rtcSnapshot;
+
+// Seqlock over rtcSnapshot: odd while the control task is rewriting it
+static std::atomic<uint32_t> rtcSeq(0);
+static std::atomic<uint32_t> changeCount(0);     // Bumped on every change NVS should see
+static std::atomic<unsigned long> changeMs(0);   // millis() of the first change not yet in NVS
+static std::atomic<uint32_t> nvsChangeSeen(0);   // changeCount at the last NVS write
+static uint32_t rtcWriteCount = 0;
+static uint32_t nvsWriteCount = 0;               // Network task only
+
+static ResumeSnapshot current;                   // Control task's view, without refresh noise
+static unsigned long lastRefreshMs = 0;
+static bool openerStopped = false;               // A stop press since the last move started
+static ResumeOutcome outcome = RESUME_NONE;
+static ResumeSource source = RESUME_SOURCE_NONE;
+static ResumeSnapshot decidedFrom;
+
+// FNV-1a over everything but the checksum
+static uint32_t snapshotChecksum(const ResumeSnapshot& snapshot) {
+  const uint8_t* p = (const uint8_t*)&snapshot;
+  uint32_t hash = 2166136261UL;
+  for (size_t i = 0; i < offsetof(ResumeSnapshot, checksum); i++) {
+    hash = (hash ^ p[i]) * 16777619UL;
+  }
+  return hash;
+}
+
+static bool snapshotValid(const ResumeSnapshot& snapshot) {
+  return snapshot.magic == RESUME_SNAPSHOT_MAGIC && snapshot.checksum == snapshotChecksum(snapshot) &&
+         snapshot.phase <= RESUME_PHASE_MOVING;
+}
+
+static void writeRtcSnapshot(const ResumeSnapshot& snapshot) {
+  uint32_t seq = rtcSeq.load(std::memory_order_relaxed);
+  rtcSeq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  rtcSnapshot = snapshot;
+  rtcSnapshot.checksum = snapshotChecksum(rtcSnapshot);
+  rtcSeq.store(seq + 2, std::memory_order_release);
+  rtcWriteCount++;
+}
+
+static ResumeSnapshot readRtcSnapshot() {
+  ResumeSnapshot copy;
+  uint32_t before, after;
+  do {
+    before = rtcSeq.load(std::memory_order_acquire);
+    copy = rtcSnapshot;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    after = rtcSeq.load(std::memory_order_relaxed);
+  } while ((before & 1) || before != after);
+  return copy;
+}
+
+// Close enough to the end it left that a reversing press could run it back into that switch
+static bool nearDepartureEnd(const ResumeSnapshot& snapshot) {
+  if (snapshot.position < 0) {
+    return false;
+  }
+  if (snapshot.target == TARGET_OPEN) {
+    return snapshot.position < RESUME_REVERSE_MIN_PERCENT;
+  }
+  return snapshot.target == TARGET_CLOSE && snapshot.position > 100 - RESUME_REVERSE_MIN_PERCENT;
+}
+
+// What a reset right now would interrupt
+static void capturePhase(ResumeSnapshot& snapshot) {
+  snapshot.phase = RESUME_PHASE_IDLE;
+  snapshot.target = TARGET_NONE;
+  snapshot.elapsedMs = 0;
+
+  bool sequenceTarget = (roofOpTarget == TARGET_OPEN || roofOpTarget == TARGET_CLOSE);
+  if (roofOpTarget == TARGET_STOP) {
+    openerStopped = true;
+  } else if (sequenceTarget) {
+    openerStopped = false;
+  }
+
+  switch (roofOpState) {
+    case OP_INVERTER_POWER_ON:
+    case OP_INVERTER_BUTTON_PRESS:
+    case OP_INVERTER_BUTTON_RELEASE:
+    case OP_INVERTER_DELAY2:
+    case OP_RESUME_REVERSE_RUN:
+    case OP_RESUME_STOP_PRESS:
+    case OP_RESUME_STOP_RELEASE:
+      // The opener is at rest (or running away from the target on a resume
+      // reversal): after a reset one press still moves it toward the target
+      if (sequenceTarget) {
+        snapshot.phase = RESUME_PHASE_SEQUENCE;
+        snapshot.target = roofOpTarget;
+      }
+      return;
+
+    case OP_ROOF_BUTTON_PRESS:
+    case OP_ROOF_BUTTON_RELEASE:
+      if (sequenceTarget) {
+        snapshot.phase = isResumeReversalPending() ? RESUME_PHASE_SEQUENCE : RESUME_PHASE_MOVING;
+        snapshot.target = roofOpTarget;
+      }
+      return;
+
+    case OP_IDLE:
+      if ((roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) && !openerStopped) {
+        snapshot.phase = RESUME_PHASE_MOVING;
+        snapshot.target = (roofStatus == ROOF_OPENING) ? TARGET_OPEN : TARGET_CLOSE;
+        snapshot.elapsedMs = millis() - movementStartTime;
+      }
+      return;
+
+    default:
+      return;   // Stop and shutdown sequences: nothing to resume
+  }
+}
+
+void updateResumeSnapshot() {
+  ResumeSnapshot next = current;
+  capturePhase(next);
+  next.flags = (inverterRelayState ? RESUME_FLAG_K1 : 0) | (inverterACPowerState ? RESUME_FLAG_AC : 0) |
+               (getInverterKeepWarmStats().active ? RESUME_FLAG_KEEP_WARM : 0);
+  next.position = (int8_t)getRoofPosition();
+
+  // Phase, target, K1 and leaving the departure end decide a resume and go to
+  // NVS too; the rest, like the elapsed time, only refreshes the RTC copy
+  unsigned long now = millis();
+  bool durable = next.phase != current.phase || next.target != current.target ||
+                 ((next.flags ^ current.flags) & RESUME_FLAG_K1) ||
+                 nearDepartureEnd(next) != nearDepartureEnd(current);
+  bool changed = durable || next.flags != current.flags;
+  bool refresh = next.phase == RESUME_PHASE_MOVING && now - lastRefreshMs >= RESUME_RTC_REFRESH_MS;
+  if (!changed && !refresh) {
+    return;
+  }
+
+  next.magic = RESUME_SNAPSHOT_MAGIC;
+  current = next;
+  lastRefreshMs = now;
+  writeRtcSnapshot(next);
+  if (durable) {
+    if (changeCount.load(std::memory_order_relaxed) == nvsChangeSeen.load(std::memory_order_acquire)) {
+      changeMs.store(now, std::memory_order_relaxed);  // Opens the coalescing window
+    }
+    changeCount.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void flushResumeSnapshot() {
+  uint32_t changes = changeCount.load(std::memory_order_acquire);
+  if (changes == nvsChangeSeen.load(std::memory_order_relaxed) ||
+      millis() - changeMs.load(std::memory_order_relaxed) < RESUME_NVS_COALESCE_MS) {
+    return;
+  }
+
+  // Everything that changed inside the window goes out as one write
+  ResumeSnapshot snapshot = readRtcSnapshot();
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBytes(PREF_RESUME_SNAPSHOT, &snapshot, sizeof(snapshot));
+  prefs.end();
+  nvsChangeSeen.store(changes, std::memory_order_release);
+  nvsWriteCount++;
+}
+
+static ResumeSource loadSnapshot(ResumeSnapshot& snapshot) {
+  if (snapshotValid(rtcSnapshot)) {
+    snapshot = rtcSnapshot;
+    return RESUME_SOURCE_RTC;
+  }
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);  // Read-only
+  bool found = prefs.getBytesLength(PREF_RESUME_SNAPSHOT) == sizeof(snapshot) &&
+               prefs.getBytes(PREF_RESUME_SNAPSHOT, &snapshot, sizeof(snapshot)) == sizeof(snapshot);
+  prefs.end();
+  if (found && snapshotValid(snapshot)) {
+    return RESUME_SOURCE_NVS;
+  }
+  memset(&snapshot, 0, sizeof(snapshot));
+  return RESUME_SOURCE_NONE;
+}
+
+static bool warmReset(esp_reset_reason_t reason) {
+  return reason == ESP_RST_BROWNOUT || reason == ESP_RST_TASK_WDT || reason == ESP_RST_INT_WDT ||
+         reason == ESP_RST_WDT;
+}
+
+static ResumeOutcome decide(const ResumeSnapshot& snapshot) {
+  RoofOperationTarget target = (RoofOperationTarget)snapshot.target;
+  if (snapshot.phase == RESUME_PHASE_IDLE || (target != TARGET_OPEN && target != TARGET_CLOSE)) {
+    return RESUME_NOTHING_PENDING;
+  }
+
+  RoofStatus arrived = (target == TARGET_OPEN) ? ROOF_OPEN : ROOF_CLOSED;
+  RoofStatus departed = (target == TARGET_OPEN) ? ROOF_CLOSED : ROOF_OPEN;
+  if (roofStatus == arrived) {
+    return RESUME_AT_TARGET;
+  }
+  if (roofStatus == ROOF_ERROR && roofError.code != ROOF_ERR_STARTUP_UNKNOWN) {
+    return RESUME_REFUSED;  // Both limits triggered
+  }
+
+  bool cutPower = (snapshot.flags & RESUME_FLAG_K1) != 0;
+  if (snapshot.phase == RESUME_PHASE_MOVING && !cutPower) {
+    // The opener never depended on our K1: it is still running
+    trackResumedMove(target, snapshot.elapsedMs);
+    return RESUME_TRACKED;
+  }
+  if (snapshot.phase == RESUME_PHASE_SEQUENCE || roofStatus == departed) {
+    return resumeRoofMove(target, false, 0) ? RESUME_RESTARTED : RESUME_REFUSED;
+  }
+
+  // Stopped mid-travel by the reset: its next press runs the other way
+  if (nearDepartureEnd(snapshot)) {
+    return RESUME_REFUSED;
+  }
+  return resumeRoofMove(target, true, snapshot.elapsedMs) ? RESUME_REVERSED : RESUME_REFUSED;
+}
+
+void resumeInterruptedOperation() {
+  ResumeSnapshot snapshot;
+  source = loadSnapshot(snapshot);
+  decidedFrom = snapshot;
+  current = snapshot;   // The first control step rewrites both copies if the boot state differs
+
+  esp_reset_reason_t reason = esp_reset_reason();
+  if (!warmReset(reason)) {
+    outcome = RESUME_COLD_BOOT;
+  } else if (source == RESUME_SOURCE_NONE) {
+    outcome = RESUME_NO_SNAPSHOT;
+  } else {
+    outcome = decide(snapshot);
+    // The NVS copy's position is only rewritten as the roof leaves its departure
+    // end, so it lags the roof by most of a travel: reckon from the RTC copy only
+    if (roofStatus == ROOF_OPENING || roofStatus == ROOF_CLOSING) {
+      restoreRoofPosition(source == RESUME_SOURCE_RTC ? snapshot.position : -1);
+    }
+  }
+
+  if (source != RESUME_SOURCE_NONE && snapshot.phase != RESUME_PHASE_IDLE) {
+    Debug.printf("Resume: %s %s snapshot from %s (%lums in, position %d, K1 %s) - %s\n",
+                 getResumePhaseString((ResumePhase)snapshot.phase),
+                 snapshot.target == TARGET_OPEN ? "open" : "close", getResumeSourceString(source),
+                 (unsigned long)snapshot.elapsedMs, snapshot.position,
+                 (snapshot.flags & RESUME_FLAG_K1) ? "on" : "off", getResumeOutcomeString(outcome));
+  }
+}
+
+ResumeStats getResumeStats() {
+  ResumeStats stats;
+  stats.outcome = outcome;
+  stats.source = source;
+  stats.snapshot = decidedFrom;
+  stats.rtcWrites = rtcWriteCount;
+  stats.changes = changeCount.load(std::memory_order_relaxed);
+  stats.nvsWrites = nvsWriteCount;
+  return stats;
+}
+
+const char* getResumeOutcomeString(ResumeOutcome value) {
+  switch (value) {
+    case RESUME_COLD_BOOT:       return "cold_boot";
+    case RESUME_NO_SNAPSHOT:     return "no_snapshot";
+    case RESUME_NOTHING_PENDING: return "nothing_pending";
+    case RESUME_AT_TARGET:       return "at_target";
+    case RESUME_RESTARTED:       return "restarted";
+    case RESUME_REVERSED:        return "reversed";
+    case RESUME_TRACKED:         return "tracked";
+    case RESUME_REFUSED:         return "refused";
+    default:                     return "none";
+  }
+}
+
+const char* getResumeSourceString(ResumeSource value) {
+  switch (value) {
+    case RESUME_SOURCE_RTC: return "rtc";
+    case RESUME_SOURCE_NVS: return "nvs";
+    default:                return "none";
+  }
+}
+
+const char* getResumePhaseString(ResumePhase phase) {
+  switch (phase) {
+    case RESUME_PHASE_SEQUENCE: return "sequence";
+    case RESUME_PHASE_MOVING:   return "moving";
+    default:                    return "idle";
+  }
+}
@@ -0,0 +1,76 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Warm-Restart Resume Header
+ *
+ * The control task keeps a compact snapshot of the roof operation (phase,
+ * target, time since the opener started, K1/AC/keep-warm state) in RTC slow
+ * memory, which survives a brownout or watchdog reset, and mirrors it to NVS
+ * from the network task, coalescing bursts of changes into one flash write.
+ * After such a reset resumeInterruptedOperation() finishes the interrupted
+ * open or close instead of latching "unknown position".
+ */
+
+#ifndef ROOF_RESUME_H
+#define ROOF_RESUME_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum ResumePhase : uint8_t {
+  RESUME_PHASE_IDLE,          // At rest, stopped by a client, or in a shutdown sequence
+  RESUME_PHASE_SEQUENCE,      // Relay sequence running; one K2 press moves the roof toward the target
+  RESUME_PHASE_MOVING         // K2 pressed, the opener is driving toward the target
+};
+
+enum ResumeOutcome : uint8_t {
+  RESUME_NONE,                // Not evaluated yet
+  RESUME_COLD_BOOT,           // Not a brownout or watchdog reset: snapshot ignored
+  RESUME_NO_SNAPSHOT,         // Nothing valid in RTC memory or NVS
+  RESUME_NOTHING_PENDING,     // Roof was at rest
+  RESUME_AT_TARGET,           // The roof reached the target limit during the reset
+  RESUME_RESTARTED,           // Sequence restarted from the beginning
+  RESUME_REVERSED,            // Opener lost power mid-travel: reverse-stop-press toward the target
+  RESUME_TRACKED,             // Opener kept its power: status restored, still travelling
+  RESUME_REFUSED              // Interlock, limit fault or too close to the departure end
+};
+
+enum ResumeSource : uint8_t {
+  RESUME_SOURCE_NONE,
+  RESUME_SOURCE_RTC,
+  RESUME_SOURCE_NVS
+};
+
+// Stored in RTC_NOINIT memory and NVS (16 bytes)
+struct ResumeSnapshot {
+  uint32_t magic;
+  uint8_t phase;              // ResumePhase
+  uint8_t target;             // RoofOperationTarget
+  uint8_t flags;              // RESUME_FLAG_*
+  int8_t position;            // 0-100, -1 unknown
+  uint32_t elapsedMs;         // K2 press to the last refresh (RESUME_PHASE_MOVING)
+  uint32_t checksum;
+};
+
+const uint8_t RESUME_FLAG_K1 = 0x01;          // K1 energized: a reset cuts the inverter
+const uint8_t RESUME_FLAG_AC = 0x02;          // AC output detected
+const uint8_t RESUME_FLAG_KEEP_WARM = 0x04;   // Keep-warm window open
+
+struct ResumeStats {
+  ResumeOutcome outcome;
+  ResumeSource source;
+  ResumeSnapshot snapshot;    // What the decision was taken from
+  uint32_t rtcWrites;         // Snapshot rewrites in RTC memory since boot
+  uint32_t changes;           // Phase/target/inverter changes since boot
+  uint32_t nvsWrites;         // Flash writes they were coalesced into
+};
+
+void updateResumeSnapshot();          // Control task, every step: refresh the RTC copy on change
+void flushResumeSnapshot();           // Network task: coalesced NVS write of the latest change
+void resumeInterruptedOperation();    // Boot, after the limit switches are read
+
+ResumeStats getResumeStats();
+const char* getResumeOutcomeString(ResumeOutcome outcome);
+const char* getResumeSourceString(ResumeSource source);
+const char* getResumePhaseString(ResumePhase phase);
+
+#endif // ROOF_RESUME_H
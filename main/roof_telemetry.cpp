@@ -0,0 +1,277 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Movement Telemetry Implementation
+ */
+
+#include "roof_telemetry.h"
+#include "Debug.h"
+#include <Preferences.h>
+#include <atomic>
+
+bool adaptiveTimeoutsEnabled = false;
+
+// Persisted history ring
+struct MoveHistory {
+  uint8_t head;           // Next slot to write
+  uint8_t count;
+  uint16_t sequence;
+  MoveRecord records[MOVE_HISTORY_SIZE];
+};
+
+static MoveHistory history;
+
+// Seqlock over history: odd while the control task rewrites it. The network
+// task copies it out between changes and writes the copy to NVS, so a move's
+// end (and a STOP) never waits on a flash write.
+static std::atomic<uint32_t> historySeq(0);
+static uint32_t historySavedSeq = 0;          // Network task: historySeq at the last NVS write
+
+static ActiveMove activeMove = {MOVE_NONE, 0, 0, MOVE_METRIC_UNSET, MOVE_METRIC_UNSET, MOVE_METRIC_UNSET, false};
+
+static void beginHistoryChange() {
+  historySeq.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+static void endHistoryChange() {
+  historySeq.fetch_add(1, std::memory_order_release);
+}
+
+void flushMoveHistory() {
+  uint32_t seq = historySeq.load(std::memory_order_acquire);
+  if ((seq & 1) || seq == historySavedSeq) {
+    return;
+  }
+
+  static MoveHistory copy;
+  copy = history;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (historySeq.load(std::memory_order_relaxed) != seq) {
+    return;  // Rewritten while copying; the next pass gets the settled version
+  }
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBytes(PREF_MOVE_HISTORY, &copy, sizeof(copy));
+  prefs.end();
+  historySavedSeq = seq;
+}
+
+void initRoofTelemetry() {
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);  // Read-only
+  adaptiveTimeoutsEnabled = prefs.getBool(PREF_ADAPTIVE_TIMEOUTS, false);
+
+  memset(&history, 0, sizeof(history));
+  if (prefs.getBytesLength(PREF_MOVE_HISTORY) == sizeof(history)) {
+    prefs.getBytes(PREF_MOVE_HISTORY, &history, sizeof(history));
+    if (history.head >= MOVE_HISTORY_SIZE || history.count > MOVE_HISTORY_SIZE) {
+      Debug.println("Move history in NVS is corrupt - discarding");
+      memset(&history, 0, sizeof(history));
+    }
+  }
+  prefs.end();
+
+  Debug.printf("Move history: %u records, adaptive timeouts %s\n", history.count,
+               adaptiveTimeoutsEnabled ? "ENABLED" : "DISABLED");
+}
+
+void telemetryMoveBegin(MoveDirection direction) {
+  activeMove.direction = direction;
+  activeMove.beginTime = millis();
+  activeMove.pressTime = 0;
+  activeMove.spinUpMs = MOVE_METRIC_UNSET;
+  activeMove.releaseMs = MOVE_METRIC_UNSET;
+  activeMove.travelMs = MOVE_METRIC_UNSET;
+  activeMove.resumed = false;
+}
+
+void telemetryRoofButtonPressed() {
+  if (activeMove.direction != MOVE_NONE && activeMove.pressTime == 0) {
+    activeMove.pressTime = millis();
+  }
+}
+
+void telemetryInverterACDetected(unsigned long detectedMs) {
+  if (activeMove.direction != MOVE_NONE && activeMove.spinUpMs == MOVE_METRIC_UNSET) {
+    activeMove.spinUpMs = (long)(detectedMs - activeMove.beginTime) > 0 ? detectedMs - activeMove.beginTime : 0;
+  }
+}
+
+void telemetryLimitSwitchEdge(bool openSwitch, bool triggered, unsigned long edgeMs) {
+  if (activeMove.direction == MOVE_NONE || activeMove.pressTime == 0) {
+    return;
+  }
+  // Edges can be stamped slightly before the press was noted by the loop
+  uint32_t sincePress = (long)(edgeMs - activeMove.pressTime) > 0 ? edgeMs - activeMove.pressTime : 0;
+
+  bool departureSwitch = (activeMove.direction == MOVE_OPEN) ? !openSwitch : openSwitch;
+  if (departureSwitch && !triggered && activeMove.releaseMs == MOVE_METRIC_UNSET) {
+    activeMove.releaseMs = sincePress;
+  } else if (!departureSwitch && triggered && activeMove.travelMs == MOVE_METRIC_UNSET) {
+    activeMove.travelMs = sincePress;
+  }
+}
+
+void telemetryMoveEnd(MoveOutcome outcome) {
+  if (activeMove.direction == MOVE_NONE) {
+    return;
+  }
+  if (activeMove.resumed) {
+    activeMove.direction = MOVE_NONE;  // A partial travel time would skew the learned profile
+    return;
+  }
+
+  beginHistoryChange();
+  MoveRecord& rec = history.records[history.head];
+  rec.direction = activeMove.direction;
+  rec.outcome = outcome;
+  rec.sequence = ++history.sequence;
+  rec.spinUpMs = activeMove.spinUpMs;
+  rec.releaseMs = activeMove.releaseMs;
+  rec.travelMs = (outcome == MOVE_COMPLETED) ? activeMove.travelMs : MOVE_METRIC_UNSET;
+
+  history.head = (history.head + 1) % MOVE_HISTORY_SIZE;
+  if (history.count < MOVE_HISTORY_SIZE) {
+    history.count++;
+  }
+  endHistoryChange();
+  activeMove.direction = MOVE_NONE;
+
+  Debug.printf("Move #%u recorded: %s %s, spin-up %ld ms, release %ld ms, travel %ld ms\n",
+               rec.sequence, rec.direction == MOVE_OPEN ? "open" : "close",
+               getMoveOutcomeString(outcome),
+               rec.spinUpMs == MOVE_METRIC_UNSET ? -1L : (long)rec.spinUpMs,
+               rec.releaseMs == MOVE_METRIC_UNSET ? -1L : (long)rec.releaseMs,
+               rec.travelMs == MOVE_METRIC_UNSET ? -1L : (long)rec.travelMs);
+}
+
+void telemetryMoveDiscard() {
+  activeMove.direction = MOVE_NONE;
+}
+
+void telemetryMoveResumed() {
+  activeMove.resumed = true;
+}
+
+MoveDirection telemetryActiveDirection() {
+  return activeMove.direction;
+}
+
+const ActiveMove& telemetryActiveMove() {
+  return activeMove;
+}
+
+uint8_t getMoveHistoryCount() {
+  return history.count;
+}
+
+const MoveRecord& getMoveRecord(uint8_t index) {
+  uint8_t oldest = (history.head + MOVE_HISTORY_SIZE - history.count) % MOVE_HISTORY_SIZE;
+  return history.records[(oldest + index) % MOVE_HISTORY_SIZE];
+}
+
+void clearMoveHistory() {
+  beginHistoryChange();
+  memset(&history, 0, sizeof(history));
+  endHistoryChange();
+  Debug.println("Move history cleared");
+}
+
+const char* getMoveOutcomeString(uint8_t outcome) {
+  switch (outcome) {
+    case MOVE_COMPLETED:       return "completed";
+    case MOVE_FAILED_TO_START: return "failed_to_start";
+    case MOVE_TIMED_OUT:       return "timed_out";
+    case MOVE_STOPPED:         return "stopped";
+    case MOVE_FAULT:           return "fault";
+    case MOVE_STALLED:         return "stalled";
+    case MOVE_OBSTRUCTED:      return "obstructed";
+    default:                   return "unknown";
+  }
+}
+
+static uint32_t metricValue(const MoveRecord& rec, MoveMetric metric) {
+  switch (metric) {
+    case METRIC_SPIN_UP: return rec.spinUpMs;
+    case METRIC_RELEASE: return rec.releaseMs;
+    default:             return rec.travelMs;
+  }
+}
+
+// Nearest-rank percentile of a sorted sample set
+static uint32_t percentileOf(const uint32_t* sorted, uint8_t n, uint8_t pct) {
+  uint32_t rank = ((uint32_t)pct * n + 99) / 100;
+  return sorted[rank > 0 ? rank - 1 : 0];
+}
+
+MoveMetricStats getMoveStats(MoveDirection direction, MoveMetric metric) {
+  MoveMetricStats stats = {0, 0, 0, 0, 0};
+  uint32_t samples[MOVE_HISTORY_SIZE];
+  uint8_t n = 0;
+
+  // Only completed moves describe a healthy roof
+  for (uint8_t i = 0; i < history.count; i++) {
+    const MoveRecord& rec = history.records[i];
+    uint32_t value = metricValue(rec, metric);
+    if (rec.direction == direction && rec.outcome == MOVE_COMPLETED && value != MOVE_METRIC_UNSET) {
+      // Insertion sort - at most MOVE_HISTORY_SIZE entries
+      uint8_t j = n++;
+      while (j > 0 && samples[j - 1] > value) {
+        samples[j] = samples[j - 1];
+        j--;
+      }
+      samples[j] = value;
+    }
+  }
+
+  if (n == 0) {
+    return stats;
+  }
+  stats.samples = n;
+  stats.p50 = percentileOf(samples, n, 50);
+  stats.p95 = percentileOf(samples, n, 95);
+  stats.p99 = percentileOf(samples, n, 99);
+  stats.max = samples[n - 1];
+  return stats;
+}
+
+static unsigned long withMargin(uint32_t value, unsigned long percent, unsigned long minMargin) {
+  unsigned long margin = (unsigned long)value * percent / 100;
+  return value + (margin > minMargin ? margin : minMargin);
+}
+
+unsigned long getEffectiveMovementTimeout(MoveDirection direction) {
+  if (!adaptiveTimeoutsEnabled || direction == MOVE_NONE) {
+    return movementTimeout;
+  }
+  MoveMetricStats travel = getMoveStats(direction, METRIC_TRAVEL);
+  if (travel.samples < ADAPTIVE_MIN_SAMPLES) {
+    return movementTimeout;
+  }
+  unsigned long learned = withMargin(travel.p99, ADAPTIVE_TRAVEL_MARGIN_PERCENT, ADAPTIVE_TRAVEL_MIN_MARGIN);
+  return learned < movementTimeout ? learned : movementTimeout;
+}
+
+unsigned long getEffectiveLimitSwitchTimeout(MoveDirection direction) {
+  if (!adaptiveTimeoutsEnabled || direction == MOVE_NONE) {
+    return limitSwitchTimeout;
+  }
+  MoveMetricStats release = getMoveStats(direction, METRIC_RELEASE);
+  if (release.samples < ADAPTIVE_MIN_SAMPLES) {
+    return limitSwitchTimeout;
+  }
+  unsigned long learned = withMargin(release.p99, ADAPTIVE_LIMIT_MARGIN_PERCENT, ADAPTIVE_LIMIT_MIN_MARGIN);
+  return learned < limitSwitchTimeout ? learned : limitSwitchTimeout;
+}
+
+void setAdaptiveTimeoutsEnabled(bool enabled) {
+  adaptiveTimeoutsEnabled = enabled;
+
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBool(PREF_ADAPTIVE_TIMEOUTS, adaptiveTimeoutsEnabled);
+  prefs.end();
+
+  Debug.printf("Adaptive timeouts %s\n", enabled ? "ENABLED" : "DISABLED");
+}
@@ -0,0 +1,100 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Roof Movement Telemetry Header
+ *
+ * Records every open/close the controller starts in a fixed-size ring kept in
+ * NVS: direction, inverter spin-up time, departure limit switch release
+ * latency, total travel time and outcome. Completed moves give per-direction
+ * p50/p95/p99/max statistics, and in adaptive mode the movement and limit
+ * switch timeouts are derived from them (p99 + margin, never looser than the
+ * configured values).
+ */
+
+#ifndef ROOF_TELEMETRY_H
+#define ROOF_TELEMETRY_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum MoveDirection : uint8_t {
+  MOVE_NONE = 0,
+  MOVE_OPEN = 1,
+  MOVE_CLOSE = 2
+};
+
+enum MoveOutcome : uint8_t {
+  MOVE_COMPLETED = 0,     // Reached the target limit switch
+  MOVE_FAILED_TO_START,   // Departure switch never released
+  MOVE_TIMED_OUT,         // Target switch not reached within the movement timeout
+  MOVE_STOPPED,           // Stopped by a user or client before arriving
+  MOVE_FAULT,             // Both limit switches triggered
+  MOVE_STALLED,           // Encoder saw the roof stop (or never start) mid-travel
+  MOVE_OBSTRUCTED         // Motor current rose over its learned envelope
+};
+
+enum MoveMetric : uint8_t {
+  METRIC_SPIN_UP,         // Sequence start (K1) to AC power detected
+  METRIC_RELEASE,         // K2 press to departure limit switch release
+  METRIC_TRAVEL           // K2 press to target limit switch trigger
+};
+
+const uint32_t MOVE_METRIC_UNSET = 0xFFFFFFFF;
+
+// One move, as stored in NVS (16 bytes)
+struct MoveRecord {
+  uint8_t direction;      // MoveDirection
+  uint8_t outcome;        // MoveOutcome
+  uint16_t sequence;      // Running move counter (wraps)
+  uint32_t spinUpMs;
+  uint32_t releaseMs;
+  uint32_t travelMs;
+};
+
+struct MoveMetricStats {
+  uint8_t samples;
+  uint32_t p50;
+  uint32_t p95;
+  uint32_t p99;
+  uint32_t max;
+};
+
+// Move currently being recorded (direction MOVE_NONE when idle)
+struct ActiveMove {
+  MoveDirection direction;
+  unsigned long beginTime;      // millis() at the first relay of the sequence
+  unsigned long pressTime;      // millis() when K2 was pressed (0 = not yet)
+  uint32_t spinUpMs;
+  uint32_t releaseMs;           // Departure switch release after the press
+  uint32_t travelMs;            // Target switch trigger after the press
+  bool resumed;                 // Restarted mid-travel after a reset: followed, but not recorded
+};
+
+extern bool adaptiveTimeoutsEnabled;
+
+void initRoofTelemetry();                       // Load history and settings from NVS
+
+// Move lifecycle hooks (called by the roof controller)
+void telemetryMoveBegin(MoveDirection direction);
+void telemetryRoofButtonPressed();
+void telemetryInverterACDetected(unsigned long detectedMs);
+void telemetryLimitSwitchEdge(bool openSwitch, bool triggered, unsigned long edgeMs);
+void telemetryMoveEnd(MoveOutcome outcome);
+void telemetryMoveDiscard();                    // Drop the move being recorded without a record
+void telemetryMoveResumed();                    // Keep following the move, but end it without a record
+MoveDirection telemetryActiveDirection();       // MOVE_NONE when no move is being recorded
+const ActiveMove& telemetryActiveMove();
+
+// History and statistics
+uint8_t getMoveHistoryCount();
+const MoveRecord& getMoveRecord(uint8_t index); // 0 = oldest
+MoveMetricStats getMoveStats(MoveDirection direction, MoveMetric metric);
+void clearMoveHistory();
+void flushMoveHistory();                        // Network task: NVS copy of the history after a change
+const char* getMoveOutcomeString(uint8_t outcome);
+
+// Timeouts in force for a direction (configured values unless adaptive mode has enough samples)
+unsigned long getEffectiveMovementTimeout(MoveDirection direction);
+unsigned long getEffectiveLimitSwitchTimeout(MoveDirection direction);
+void setAdaptiveTimeoutsEnabled(bool enabled);
+
+#endif // ROOF_TELEMETRY_H
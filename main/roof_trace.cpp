@@ -0,0 +1,197 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Trace Recorder Implementation
+ */
+
+#include "roof_trace.h"
+#include "roof_controller.h"
+#include "roof_errors.h"
+#include "roof_telemetry.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
+#include "input_sampler.h"
+#include "snow_sensor.h"
+#include "park_sensor_udp.h"
+#include "Debug.h"
+#include "esp_system.h"
+#include <atomic>
+#include <string.h>
+
+static_assert((TRACE_RING_ENTRIES & (TRACE_RING_ENTRIES - 1)) == 0, "TRACE_RING_ENTRIES must be a power of 2");
+static_assert(INPUT_CHANNEL_COUNT <= 8 && RELAY_COUNT <= 4, "Sync entry fields too narrow");
+
+static const uint32_t TRACE_RING_MAGIC = 0x52545243 ^ TRACE_RING_ENTRIES;
+
+static const char* const TRACE_TYPE_NAMES[TRACE_TYPE_COUNT] = {
+  "none", "boot", "last_step", "sync", "input", "command", "relay", "op_state", "status", "park", "snow_sensor",
+  "sensor_fault"
+};
+
+// Not cleared by a warm reset; trusted only when the magic matches
+struct TraceRing {
+  uint32_t magic;
+  uint32_t written;           // Sequence number of the next entry
+  uint32_t lastStepUs;        // micros() of the latest control step
+  uint8_t boots;
+  RoofTraceEntry entries[TRACE_RING_ENTRIES];
+};
+__NOINIT_ATTR static TraceRing ring;
+
+// Published copy of ring.written for readers in other tasks
+static std::atomic<uint32_t> traceEnd(0);
+static std::atomic<bool> clearRequested(false);
+
+// Control task: last traced state
+static bool baselineDue = true;
+static unsigned long lastSyncMs = 0;
+static RoofOperationState tracedOpState = OP_IDLE;
+static RoofOperationTarget tracedTarget = TARGET_NONE;
+static RoofStatus tracedStatus = ROOF_CLOSED;
+static RoofErrorCode tracedError = ROOF_ERR_NONE;
+
+void initRoofTrace() {
+  esp_reset_reason_t reason = esp_reset_reason();
+  bool kept = ring.magic == TRACE_RING_MAGIC && reason != ESP_RST_POWERON && reason != ESP_RST_UNKNOWN;
+  if (kept) {
+    if (ring.boots < 255) ring.boots++;
+    // Still on the old micros() clock; none if the reset came before a step
+    if (ring.lastStepUs != 0) traceRecord(TRACE_LAST_STEP, ring.lastStepUs, 0, 0);
+  } else {
+    ring.magic = TRACE_RING_MAGIC;
+    ring.written = 0;
+    ring.boots = 0;
+  }
+  ring.lastStepUs = 0;
+  traceEnd.store(ring.written, std::memory_order_release);
+  baselineDue = true;
+
+  traceRecord(TRACE_BOOT, micros(), (uint8_t)reason, ring.boots);
+  Debug.printf("Trace recorder: %lu entries %s\n", (unsigned long)ring.written,
+               kept ? "kept across the reset" : "(cleared)");
+}
+
+void traceRecord(RoofTraceType type, uint32_t timeUs, uint8_t a, uint16_t b) {
+  uint32_t index = ring.written;
+  RoofTraceEntry& entry = ring.entries[index & (TRACE_RING_ENTRIES - 1)];
+  entry.timeUs = timeUs;
+  entry.type = type;
+  entry.a = a;
+  entry.b = b;
+  ring.written = index + 1;
+  traceEnd.store(index + 1, std::memory_order_release);
+}
+
+static uint16_t syncFields() {
+  uint16_t relays = 0;
+  for (uint8_t r = 0; r < RELAY_COUNT; r++) {
+    if (isRelayEnergized((RelayId)r)) relays |= 1U << r;
+  }
+  return (uint16_t)((getInputStableMask() & TRACE_SYNC_INPUT_MASK) | (relays << TRACE_SYNC_RELAY_SHIFT) |
+                    ((uint16_t)roofStatus << TRACE_SYNC_STATUS_SHIFT));
+}
+
+void traceRoofState() {
+  if (clearRequested.exchange(false)) {
+    ring.written = 0;
+    ring.boots = 0;
+    traceEnd.store(0, std::memory_order_release);
+    baselineDue = true;
+  }
+
+  uint32_t nowUs = micros();
+  unsigned long nowMs = millis();
+  ring.lastStepUs = nowUs;
+  // First step after boot or a clear: the sync entry carries the starting state
+  bool sync = baselineDue || nowMs - lastSyncMs >= TRACE_SYNC_INTERVAL_MS;
+  if (!baselineDue) {
+    if (roofOpState != tracedOpState || roofOpTarget != tracedTarget) {
+      traceRecord(TRACE_OP_STATE, nowUs, roofOpState, roofOpTarget);
+    }
+    if (roofStatus != tracedStatus || roofError.code != tracedError) {
+      traceRecord(TRACE_STATUS, nowUs, roofStatus, roofError.code);
+    }
+  }
+  baselineDue = false;
+  tracedOpState = roofOpState;
+  tracedTarget = roofOpTarget;
+  tracedStatus = roofStatus;
+  tracedError = roofError.code;
+
+  if (sync) {
+    lastSyncMs = nowMs;
+    traceRecord(TRACE_SYNC, nowUs, roofOpState, syncFields());
+  }
+}
+
+void fillRoofTraceHeader(RoofTraceHeader& header, uint32_t firstIndex) {
+  memset(&header, 0, sizeof(header));
+  header.magic = TRACE_FILE_MAGIC;
+  header.version = TRACE_FILE_VERSION;
+  header.entrySize = sizeof(RoofTraceEntry);
+  header.firstIndex = firstIndex;
+  header.nowUs = micros();
+  header.movementTimeout = movementTimeout;
+  header.limitSwitchTimeout = limitSwitchTimeout;
+  header.inverterDelay1 = inverterDelay1;
+  header.inverterDelay2 = inverterDelay2;
+  header.keepWarmMinutes = inverterKeepWarmMinutes;
+  header.prewarmMinutes = (uint8_t)inverterPrewarmMinutes;
+  header.rainHoldoffMs = rainHoldoffMs;
+  header.rainReopenLockoutMs = rainReopenLockoutMs;
+  for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+    header.stableMs[ch] = (uint16_t)getInputStableTime((InputChannel)ch);
+  }
+  header.flags = (movementTimeoutEnabled ? TRACE_FLAG_MOVEMENT_TIMEOUT : 0) |
+                 (limitSwitchTimeoutEnabled ? TRACE_FLAG_LIMIT_TIMEOUT : 0) |
+                 (inverterAcSequencing ? TRACE_FLAG_AC_SEQUENCING : 0) |
+                 (rainAutoCloseEnabled ? TRACE_FLAG_RAIN_AUTO_CLOSE : 0) |
+                 (snowAutoCloseEnabled ? TRACE_FLAG_SNOW_AUTO_CLOSE : 0) |
+                 (snowModbusEnabled ? TRACE_FLAG_SNOW_MODBUS : 0) |
+                 (bypassParkSensor ? TRACE_FLAG_BYPASS_PARK : 0) |
+                 (adaptiveTimeoutsEnabled ? TRACE_FLAG_ADAPTIVE : 0);
+  header.flags2 = (isRoofEncoderConfigured() ? TRACE_FLAG2_ENCODER : 0) |
+                  (isMotorCurrentConfigured() ? TRACE_FLAG2_MOTOR_CURRENT : 0);
+  header.parkSensorType = (uint8_t)parkSensorType;
+}
+
+uint32_t getRoofTraceEnd() {
+  return traceEnd.load(std::memory_order_acquire);
+}
+
+uint32_t getRoofTraceStart() {
+  // The slot of the entry being written next is not safe to read
+  uint32_t end = getRoofTraceEnd();
+  return end >= TRACE_RING_ENTRIES ? end - (TRACE_RING_ENTRIES - 1) : 0;
+}
+
+uint32_t copyRoofTraceEntries(uint32_t first, RoofTraceEntry* out, uint32_t count) {
+  uint32_t end = getRoofTraceEnd();
+  if ((int32_t)(end - first) <= 0) return 0;
+  if (end - first < count) count = end - first;
+
+  for (uint32_t i = 0; i < count; i++) {
+    out[i] = ring.entries[(first + i) & (TRACE_RING_ENTRIES - 1)];
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  // The writer reuses the slot of entry n while writing n + TRACE_RING_ENTRIES;
+  // the oldest copied entry is the first to go
+  uint32_t after = traceEnd.load(std::memory_order_relaxed);
+  return after - first < TRACE_RING_ENTRIES ? count : 0;
+}
+
+RoofTraceStats getRoofTraceStats() {
+  RoofTraceStats stats;
+  stats.written = getRoofTraceEnd();
+  stats.retained = stats.written - getRoofTraceStart();
+  stats.boots = ring.boots;
+  return stats;
+}
+
+void requestRoofTraceClear() {
+  clearRequested.store(true);
+}
+
+const char* getRoofTraceTypeName(RoofTraceType type) {
+  return type < TRACE_TYPE_COUNT ? TRACE_TYPE_NAMES[type] : "unknown";
+}
@@ -0,0 +1,118 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Trace Recorder Header
+ *
+ * The control task appends one 8-byte entry (micros() timestamp, type, two
+ * small payload fields) to a ring for every debounced input change, command
+ * dispatch (with its source and outcome), relay edge, operation state and
+ * roof status change, park verdict, RS485 snow reading change and move failed
+ * on encoder or motor current data (which are not traced themselves). A sync
+ * entry with the full input, relay and state picture is written after boot
+ * and every TRACE_SYNC_INTERVAL_MS, so a reader can start from any of them
+ * and unwrap the 32-bit timestamps. The ring lives in memory that is not
+ * cleared by a watchdog, brownout or software reset, so the run-up to a
+ * reset can still be downloaded afterwards.
+ *
+ * GET /api/trace returns a RoofTraceHeader followed by the entries, oldest
+ * first; sim/roof_replay feeds such a file back through the controller on
+ * virtual time and compares what it does with what was recorded.
+ */
+
+#ifndef ROOF_TRACE_H
+#define ROOF_TRACE_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum RoofTraceType : uint8_t {
+  TRACE_NONE,
+  TRACE_BOOT,                 // a: esp_reset_reason_t, b: boots kept in the ring
+  TRACE_LAST_STEP,            // Logged at boot: time of the last control step before the reset
+  TRACE_SYNC,                 // a: RoofOperationState, b: TRACE_SYNC_* fields
+  TRACE_INPUT,                // Sampler event (time of the sample): a: changed mask, b: stable mask
+  TRACE_COMMAND,              // Dispatch: a: RoofCommandType | CommandSource << 4, b: RoofCommandOutcome | arg << 8
+  TRACE_RELAY,                // Relay edge: a: RelayId, b: level
+  TRACE_OP_STATE,             // a: RoofOperationState, b: RoofOperationTarget
+  TRACE_STATUS,               // a: RoofStatus, b: RoofErrorCode
+  TRACE_PARK,                 // Park verdict (pin and/or UDP): a: parked
+  TRACE_SNOW_SENSOR,          // RS485 reading (time of the reply): a: snow, b: online
+  TRACE_SENSOR_FAULT,         // Move failed on encoder or motor current data: a: RoofErrorCode, b: param
+  TRACE_TYPE_COUNT
+};
+
+struct RoofTraceEntry {
+  uint32_t timeUs;            // micros(); restarts after each TRACE_BOOT
+  uint8_t type;               // RoofTraceType
+  uint8_t a;
+  uint16_t b;
+};
+
+static_assert(sizeof(RoofTraceEntry) == 8, "Trace entries are 8 bytes on the wire");
+
+// TRACE_SYNC b field
+const uint16_t TRACE_SYNC_INPUT_MASK = 0x00FF;   // Stable input mask (InputChannel bits)
+const uint8_t TRACE_SYNC_RELAY_SHIFT = 8;        // Energized relays (RelayId bits)
+const uint8_t TRACE_SYNC_STATUS_SHIFT = 12;      // RoofStatus
+
+// Settings in force when the trace was downloaded (RoofTraceHeader::flags)
+const uint8_t TRACE_FLAG_MOVEMENT_TIMEOUT = 0x01;
+const uint8_t TRACE_FLAG_LIMIT_TIMEOUT = 0x02;
+const uint8_t TRACE_FLAG_AC_SEQUENCING = 0x04;
+const uint8_t TRACE_FLAG_RAIN_AUTO_CLOSE = 0x08;
+const uint8_t TRACE_FLAG_SNOW_AUTO_CLOSE = 0x10;
+const uint8_t TRACE_FLAG_SNOW_MODBUS = 0x20;
+const uint8_t TRACE_FLAG_BYPASS_PARK = 0x40;
+const uint8_t TRACE_FLAG_ADAPTIVE = 0x80;
+// RoofTraceHeader::flags2
+const uint8_t TRACE_FLAG2_ENCODER = 0x01;     // Roof encoder fitted (its counts are not in the trace, its stalls are)
+const uint8_t TRACE_FLAG2_MOTOR_CURRENT = 0x02;  // Motor current sensor fitted (its samples are not in the trace, its trips are)
+
+const uint32_t TRACE_FILE_MAGIC = 0x43525452;    // "RTRC"
+const uint16_t TRACE_FILE_VERSION = 1;
+
+// File header (64 bytes, little endian)
+struct RoofTraceHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t entrySize;
+  uint32_t firstIndex;        // Sequence number of the first entry (entries lost to wrap-around)
+  uint32_t nowUs;             // micros() at the download
+  uint32_t movementTimeout;
+  uint32_t limitSwitchTimeout;
+  uint32_t inverterDelay1;
+  uint32_t inverterDelay2;
+  uint32_t keepWarmMinutes;
+  uint32_t rainHoldoffMs;
+  uint32_t rainReopenLockoutMs;
+  uint16_t stableMs[8];       // Input stable times, by InputChannel
+  uint8_t flags;              // TRACE_FLAG_*
+  uint8_t parkSensorType;
+  uint8_t prewarmMinutes;
+  uint8_t flags2;             // TRACE_FLAG2_*
+};
+
+static_assert(sizeof(RoofTraceHeader) == 64, "Trace header is 64 bytes on the wire");
+
+struct RoofTraceStats {
+  uint32_t written;           // Entries since the ring was last cleared
+  uint32_t retained;          // Entries still in the ring
+  uint8_t boots;              // Resets the ring has survived
+};
+
+void initRoofTrace();         // Boot: keep the ring across a warm reset, then log TRACE_BOOT
+
+// Control task
+void traceRecord(RoofTraceType type, uint32_t timeUs, uint8_t a, uint16_t b);
+void traceRoofState();        // Once per step: op state / status changes and the periodic sync
+
+// Any task
+void fillRoofTraceHeader(RoofTraceHeader& header, uint32_t firstIndex);
+uint32_t getRoofTraceEnd();                       // Sequence number of the next entry
+uint32_t getRoofTraceStart();                     // Oldest entry still in the ring
+// Copy entries from sequence number first; returns how many are intact (0 once overwritten)
+uint32_t copyRoofTraceEntries(uint32_t first, RoofTraceEntry* out, uint32_t count);
+RoofTraceStats getRoofTraceStats();
+void requestRoofTraceClear();                     // Emptied by the control task on its next step
+const char* getRoofTraceTypeName(RoofTraceType type);
+
+#endif // ROOF_TRACE_H
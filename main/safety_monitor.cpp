@@ -0,0 +1,75 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Safety Monitor Implementation
+ */
+
+#include "safety_monitor.h"
+#include "Debug.h"
+#include <atomic>
+
+static const char* const SAFETY_REASON_NAMES[SAFETY_REASON_COUNT] = {
+  "rain",
+  "snow",
+  "rs485_snow",
+  "snow_sensor_offline",
+  "weather_lockout",
+  "roof_error"
+};
+
+static std::atomic<uint32_t> unsafeReasons(0);
+static std::atomic<uint32_t> reasonChangeCount(0);
+static std::atomic<uint32_t> verdictChangeCount(0);
+static std::atomic<unsigned long> verdictChangeMs(0);
+
+void setSafetyReason(SafetyReason reason, bool active) {
+  uint32_t previous = active ? unsafeReasons.fetch_or(reason, std::memory_order_release)
+                             : unsafeReasons.fetch_and(~(uint32_t)reason, std::memory_order_release);
+  if (((previous & reason) != 0) == active) {
+    return;
+  }
+  reasonChangeCount.fetch_add(1, std::memory_order_relaxed);
+
+  uint32_t now = active ? previous | reason : previous & ~(uint32_t)reason;
+  if ((previous == 0) != (now == 0)) {
+    verdictChangeCount.fetch_add(1, std::memory_order_relaxed);
+    verdictChangeMs.store(millis(), std::memory_order_relaxed);
+    Debug.printf("Safety monitor: %s (%s %s)\n", now == 0 ? "SAFE" : "UNSAFE",
+                 getSafetyReasonString(reason), active ? "set" : "cleared");
+  }
+}
+
+bool isConditionSafe() {
+  return unsafeReasons.load(std::memory_order_acquire) == 0;
+}
+
+uint32_t getSafetyReasons() {
+  return unsafeReasons.load(std::memory_order_acquire);
+}
+
+SafetyMonitorStats getSafetyMonitorStats() {
+  SafetyMonitorStats stats;
+  stats.reasonChanges = reasonChangeCount.load(std::memory_order_relaxed);
+  stats.verdictChanges = verdictChangeCount.load(std::memory_order_relaxed);
+  stats.verdictSinceMs = verdictChangeMs.load(std::memory_order_relaxed);
+  return stats;
+}
+
+const char* getSafetyReasonString(SafetyReason reason) {
+  for (uint8_t i = 0; i < SAFETY_REASON_COUNT; i++) {
+    if (reason == (1UL << i)) return SAFETY_REASON_NAMES[i];
+  }
+  return "unknown";
+}
+
+size_t formatSafetyReasons(uint32_t reasons, char* buffer, size_t size) {
+  if (size == 0) return 0;
+  size_t length = 0;
+  buffer[0] = '\0';
+  for (uint8_t i = 0; i < SAFETY_REASON_COUNT; i++) {
+    if (!(reasons & (1UL << i))) continue;
+    int n = snprintf(buffer + length, size - length, "%s%s", length ? "," : "", SAFETY_REASON_NAMES[i]);
+    if (n < 0 || (size_t)n >= size - length) break;
+    length += n;
+  }
+  return length;
+}
@@ -0,0 +1,44 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Safety Monitor Header
+ *
+ * The Alpaca SafetyMonitor verdict is kept as a mask of unsafe reasons, one
+ * bit per contributing input. Each contributor sets or clears its own bit
+ * at the moment its state changes (a debounced weather edge, a confirmed
+ * RS485 reading, the re-open lockout, a roof error), so the verdict is never
+ * recomputed and IsSafe is a single atomic load however often it is polled.
+ */
+
+#ifndef SAFETY_MONITOR_H
+#define SAFETY_MONITOR_H
+
+#include <Arduino.h>
+
+enum SafetyReason : uint32_t {
+  SAFETY_RAIN = 1UL << 0,                 // RG9 reports rain
+  SAFETY_SNOW = 1UL << 1,                 // Digital snow sensor output
+  SAFETY_RS485_SNOW = 1UL << 2,           // Confirmed snow from the RS485 sensor
+  SAFETY_SNOW_SENSOR_OFFLINE = 1UL << 3,  // RS485 sensor enabled but not answering
+  SAFETY_WEATHER_LOCKOUT = 1UL << 4,      // Rain/snow re-open lockout still running
+  SAFETY_ROOF_ERROR = 1UL << 5            // Roof in a latched error state
+};
+
+const uint8_t SAFETY_REASON_COUNT = 6;
+
+struct SafetyMonitorStats {
+  uint32_t reasonChanges;     // Contributor bits flipped
+  uint32_t verdictChanges;    // Safe <-> unsafe transitions
+  unsigned long verdictSinceMs;  // millis() of the last transition (0 = verdict unchanged since boot)
+};
+
+// Contributors (control task): call on every change of the input, not every step
+void setSafetyReason(SafetyReason reason, bool active);
+
+// Any task, constant time
+bool isConditionSafe();
+uint32_t getSafetyReasons();
+SafetyMonitorStats getSafetyMonitorStats();
+const char* getSafetyReasonString(SafetyReason reason);
+size_t formatSafetyReasons(uint32_t reasons, char* buffer, size_t size);  // Comma-separated, "" when safe
+
+#endif // SAFETY_MONITOR_H
@@ -0,0 +1,142 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * RS485 Snow Sensor Implementation
+ */
+
+#include "snow_sensor.h"
+#include "roof_controller.h"
+#include "safety_monitor.h"
+#include "roof_trace.h"
+#include "Debug.h"
+
+HardwareSerial SnowSerial(SNOW_SENSOR_UART);
+
+bool snowModbusEnabled = false;
+
+static SnowSensorReading reading;
+static SnowSensorStats sensorStats;
+static bool polling = false;          // Enabled and started
+static unsigned long lastPollMs = 0;
+static bool candidateSnow = false;    // State the last reads agree on
+static uint8_t candidateReads = 0;
+
+static void startSnowSensor() {
+  polling = true;
+  if (!reading.online) {
+    setSafetyReason(SAFETY_SNOW_SENSOR_OFFLINE, true);  // Unknown until the first reply
+  }
+  if (!modbusStarted()) {
+    modbusBegin(SnowSerial, SNOW_MODBUS_BAUD, SNOW_SENSOR_RS485_RO, SNOW_SENSOR_RS485_DI,
+                SNOW_SENSOR_RS485_RE_DE);
+  }
+  lastPollMs = millis() - SNOW_MODBUS_POLL_MS;
+  Debug.printf("RS485 snow sensor: slave %u, %u registers from %u every %lums\n",
+               SNOW_MODBUS_ADDRESS, SNOW_MODBUS_REGISTER_COUNT, SNOW_MODBUS_START_REGISTER,
+               SNOW_MODBUS_POLL_MS);
+}
+
+void initSnowSensor() {
+  if (!snowModbusEnabled) {
+    Debug.println("RS485 snow sensor is disabled");
+    return;
+  }
+  startSnowSensor();
+}
+
+static void setSnow(bool snowing, uint32_t replyUs) {
+  if (reading.snow == snowing) {
+    return;
+  }
+  reading.snow = snowing;
+  sensorStats.snowChanges++;
+  traceRecord(TRACE_SNOW_SENSOR, replyUs, snowing, reading.online);
+  setSafetyReason(SAFETY_RS485_SNOW, snowing);
+  Debug.printf("RS485 snow sensor: snow %s\n", snowing ? "DETECTED" : "cleared");
+  noteSnowSensorChange(snowing, replyUs);
+}
+
+static void setOffline(const char* reason) {
+  if (!reading.online) {
+    return;
+  }
+  reading.online = false;
+  sensorStats.offlineEvents++;
+  traceRecord(TRACE_SNOW_SENSOR, micros(), reading.snow, false);
+  candidateReads = 0;
+  setSafetyReason(SAFETY_SNOW_SENSOR_OFFLINE, polling);
+  Debug.printf("RS485 snow sensor offline (%s)\n", reason);
+  // An unknown state must not hold the re-open lockout forever; the lockout
+  // still runs its full dry time from here
+  setSnow(false, micros());
+}
+
+static void handleReply(const ModbusReply& reply) {
+  sensorStats.lastResult = reply.result;
+  if (reply.result != MODBUS_OK) {
+    sensorStats.failures++;
+    return;
+  }
+
+  sensorStats.reads++;
+  memcpy(reading.registers, reply.registers, sizeof(reading.registers));
+  reading.lastReplyMs = millis();
+  if (!reading.online) {
+    reading.online = true;
+    traceRecord(TRACE_SNOW_SENSOR, reply.completeUs, reading.snow, true);
+    setSafetyReason(SAFETY_SNOW_SENSOR_OFFLINE, false);
+    Debug.println("RS485 snow sensor online");
+  }
+
+  bool snowing = reply.registers[SNOW_MODBUS_STATE_INDEX] != 0;
+  if (snowing == reading.snow) {
+    candidateReads = 0;
+    return;
+  }
+  if (candidateReads == 0 || candidateSnow != snowing) {
+    candidateSnow = snowing;
+    candidateReads = 0;
+  }
+  if (++candidateReads >= SNOW_MODBUS_CONFIRM_READS) {
+    candidateReads = 0;
+    setSnow(snowing, reply.completeUs);
+  }
+}
+
+void processSnowSensor() {
+  if (!snowModbusEnabled) {
+    if (polling) {
+      polling = false;
+      setOffline("disabled");
+      setSafetyReason(SAFETY_SNOW_SENSOR_OFFLINE, false);
+    }
+    return;
+  }
+  if (!polling) {
+    startSnowSensor();    // Also when enabled from the web UI after boot
+  }
+
+  modbusPoll();
+  ModbusReply reply;
+  if (modbusTakeReply(reply)) {
+    handleReply(reply);
+  }
+
+  unsigned long currentTime = millis();
+  if (reading.online && currentTime - reading.lastReplyMs >= SNOW_MODBUS_STALE_MS) {
+    setOffline(getModbusResultString(sensorStats.lastResult));
+  }
+
+  if (!modbusBusy() && currentTime - lastPollMs >= SNOW_MODBUS_POLL_MS &&
+      modbusReadRegisters(SNOW_MODBUS_ADDRESS, SNOW_MODBUS_FUNCTION, SNOW_MODBUS_START_REGISTER,
+                          SNOW_MODBUS_REGISTER_COUNT)) {
+    lastPollMs = currentTime;
+  }
+}
+
+SnowSensorReading getSnowSensorReading() {
+  return reading;
+}
+
+SnowSensorStats getSnowSensorStats() {
+  return sensorStats;
+}
@@ -0,0 +1,41 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * RS485 Snow Sensor Header
+ *
+ * Polls the snow sensor's holding registers over Modbus RTU from the control
+ * task and caches the latest reading. A change of the snow register must be
+ * read SNOW_MODBUS_CONFIRM_READS times in a row before it reaches the rain
+ * auto-close; a sensor with no good reply for SNOW_MODBUS_STALE_MS is offline.
+ */
+
+#ifndef SNOW_SENSOR_H
+#define SNOW_SENSOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "modbus_rtu.h"
+
+struct SnowSensorReading {
+  bool online;                // Good reply within SNOW_MODBUS_STALE_MS
+  bool snow;                  // Confirmed snow state
+  uint16_t registers[SNOW_MODBUS_REGISTER_COUNT];
+  unsigned long lastReplyMs;  // millis() of the last good reply (0 = none)
+};
+
+struct SnowSensorStats {
+  uint32_t reads;             // Good replies
+  uint32_t failures;          // Timeouts, CRC errors, exceptions and bad frames
+  uint32_t offlineEvents;
+  uint32_t snowChanges;       // Confirmed snow state changes
+  ModbusResult lastResult;
+};
+
+extern HardwareSerial SnowSerial;      // UART2, RS485 half-duplex
+
+void initSnowSensor();                // Starts the Modbus master if the sensor is enabled
+void processSnowSensor();             // Control task: poll, cache and confirm
+
+SnowSensorReading getSnowSensorReading();
+SnowSensorStats getSnowSensorStats();
+
+#endif // SNOW_SENSOR_H
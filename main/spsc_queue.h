@@ -0,0 +1,55 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Single-Producer / Single-Consumer Queue
+ *
+ * Lock-free ring buffer for passing small values between exactly one writer
+ * and one reader (task to task, or ISR to task). The producer only writes
+ * head and the consumer only writes tail, so neither side ever blocks.
+ */
+
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+template <typename T, uint32_t Size>
+class SpscQueue {
+  static_assert(Size >= 2 && (Size & (Size - 1)) == 0, "SpscQueue size must be a power of 2");
+
+public:
+  // Producer side: false when full (the item is not queued)
+  bool push(const T& item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    uint32_t next = (head + 1) & MASK;
+    if (next == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    items_[head] = item;
+    head_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side: false when empty
+  bool pop(T& item) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = items_[tail];
+    tail_.store((tail + 1) & MASK, std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const {
+    return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire);
+  }
+
+private:
+  static const uint32_t MASK = Size - 1;
+  T items_[Size];
+  std::atomic<uint32_t> head_{0};   // Written by the producer only
+  std::atomic<uint32_t> tail_{0};   // Written by the consumer only
+};
+
+#endif // SPSC_QUEUE_H
@@ -0,0 +1,315 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Limit Switch Health Implementation
+ */
+
+#include "switch_health.h"
+#include "input_sampler.h"
+#include "mqtt_handler.h"
+#include "Debug.h"
+#include <Preferences.h>
+
+static const uint16_t SWITCH_HEALTH_VERSION = 1;
+
+// Bucket upper bounds (inclusive); anything above the last goes in the open-ended bucket
+static const uint16_t BOUNCE_BUCKET_MAX[SWITCH_BOUNCE_BUCKETS - 1] = {0, 1, 2, 3, 5, 9};
+static const uint32_t BURST_BUCKET_BELOW_US[SWITCH_BURST_BUCKETS - 2] = {1000, 2000, 5000, 10000, 20000, 50000};
+
+static const char* const BOUNCE_BUCKET_LABELS[SWITCH_BOUNCE_BUCKETS] = {
+  "0", "1", "2", "3", "4-5", "6-9", "10+"
+};
+static const char* const BURST_BUCKET_LABELS[SWITCH_BURST_BUCKETS] = {
+  "clean", "<1ms", "<2ms", "<5ms", "<10ms", "<20ms", "<50ms", "50ms+"
+};
+
+// One switch's rolling window; head is the epoch being filled
+struct SwitchHealthHistory {
+  SwitchHealthTotals totals;
+  uint8_t head;
+  uint8_t count;                  // Epochs in use, the current one included
+  uint8_t reserved[2];
+  SwitchHealthEpoch epochs[SWITCH_HEALTH_EPOCHS];
+};
+
+// Persisted blob
+struct SwitchHealthStore {
+  uint16_t version;
+  uint16_t reserved;
+  SwitchHealthHistory switches[SWITCH_COUNT];
+};
+
+static SwitchHealthStore store;
+static SwitchBounceRecord lastBounce[SWITCH_COUNT];
+static uint8_t alertReasons[SWITCH_COUNT];
+static uint8_t publishedReasons[SWITCH_COUNT];
+static bool dirty = false;
+static bool saveRequested = false;   // An epoch closed: write without waiting for the interval
+static SwitchHealthStats stats = {0, 0, 0};
+
+static void resetStore() {
+  memset(&store, 0, sizeof(store));
+  store.version = SWITCH_HEALTH_VERSION;
+  for (uint8_t i = 0; i < SWITCH_COUNT; i++) {
+    store.switches[i].count = 1;
+  }
+}
+
+static bool storeValid() {
+  if (store.version != SWITCH_HEALTH_VERSION) return false;
+  for (uint8_t i = 0; i < SWITCH_COUNT; i++) {
+    const SwitchHealthHistory& h = store.switches[i];
+    if (h.head >= SWITCH_HEALTH_EPOCHS || h.count == 0 || h.count > SWITCH_HEALTH_EPOCHS) return false;
+  }
+  return true;
+}
+
+static void saveSwitchHealth() {
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, false);
+  prefs.putBytes(PREF_SWITCH_HEALTH, &store, sizeof(store));
+  prefs.end();
+  dirty = false;
+  saveRequested = false;
+  stats.saves++;
+  stats.lastSaveMs = millis();
+}
+
+static uint8_t bounceBucket(uint16_t bounces) {
+  uint8_t b = 0;
+  while (b < SWITCH_BOUNCE_BUCKETS - 1 && bounces > BOUNCE_BUCKET_MAX[b]) b++;
+  return b;
+}
+
+static uint8_t burstBucket(uint16_t edges, uint32_t burstUs) {
+  if (edges <= 1) return 0;
+  uint8_t b = 0;
+  while (b < SWITCH_BURST_BUCKETS - 2 && burstUs >= BURST_BUCKET_BELOW_US[b]) b++;
+  return b + 1;
+}
+
+// Epoch index counted back from the current one (0 = current)
+static const SwitchHealthEpoch& epochBack(const SwitchHealthHistory& h, uint8_t back) {
+  return h.epochs[(h.head + SWITCH_HEALTH_EPOCHS - back) % SWITCH_HEALTH_EPOCHS];
+}
+
+// The current epoch, topped up with the previous one while it is still small,
+// against everything older in the window
+static void splitWindow(const SwitchHealthHistory& h, SwitchHealthEpoch& recent, SwitchHealthTotals& baseline) {
+  const SwitchHealthEpoch& current = epochBack(h, 0);
+  uint8_t recentEpochs = (current.transitions < SWITCH_HEALTH_MIN_TRANSITIONS && h.count > 1) ? 2 : 1;
+
+  memset(&recent, 0, sizeof(recent));
+  baseline = {0, 0, 0};
+  for (uint8_t back = 0; back < h.count; back++) {
+    const SwitchHealthEpoch& e = epochBack(h, back);
+    if (back < recentEpochs) {
+      recent.transitions += e.transitions;
+      recent.glitches += e.glitches;
+      recent.bounces += e.bounces;
+      recent.burstUs += e.burstUs;
+      if (e.maxBurstUs > recent.maxBurstUs) recent.maxBurstUs = e.maxBurstUs;
+    } else {
+      baseline.transitions += e.transitions;
+      baseline.bounces += e.bounces;
+      baseline.glitches += e.glitches;
+    }
+  }
+}
+
+static uint8_t evaluateAlert(LimitSwitchId id) {
+  SwitchHealthEpoch recent;
+  SwitchHealthTotals baseline;
+  splitWindow(store.switches[id], recent, baseline);
+
+  uint8_t reasons = 0;
+  if (recent.transitions >= SWITCH_HEALTH_MIN_TRANSITIONS &&
+      recent.bounces >= (uint64_t)SWITCH_CHATTER_ALERT_MIN_BOUNCES * recent.transitions &&
+      (baseline.transitions == 0 ||
+       (uint64_t)recent.bounces * baseline.transitions >=
+           (uint64_t)SWITCH_CHATTER_ALERT_RATIO * baseline.bounces * recent.transitions)) {
+    reasons |= SWITCH_ALERT_CHATTER_GROWTH;
+  }
+
+  InputChannel channel = (id == SWITCH_OPEN) ? INPUT_LIMIT_OPEN : INPUT_LIMIT_CLOSED;
+  uint32_t burstLimitUs = getInputStableTime(channel) * 1000UL * SWITCH_BURST_ALERT_PERCENT / 100;
+  if (recent.maxBurstUs >= burstLimitUs) {
+    reasons |= SWITCH_ALERT_LONG_BURST;
+  }
+  if (recent.glitches >= SWITCH_GLITCH_ALERT_COUNT) {
+    reasons |= SWITCH_ALERT_GLITCHES;
+  }
+  return reasons;
+}
+
+static void recordBurst(LimitSwitchId id, const InputBurst& burst) {
+  SwitchHealthHistory& h = store.switches[id];
+  SwitchHealthEpoch& epoch = h.epochs[h.head];
+  uint16_t bounces = burst.edges / 2;   // A bounce is a release and a re-make
+
+  SwitchBounceRecord& last = lastBounce[id];
+  last.valid = true;
+  last.flipped = burst.flipped;
+  last.active = burst.active;
+  last.edges = burst.edges;
+  last.bounces = bounces;
+  last.burstUs = burst.burstUs;
+  last.settleUs = burst.settleUs;
+  last.receivedMs = millis();
+
+  if (!burst.flipped) {
+    if (epoch.glitches < UINT16_MAX) epoch.glitches++;
+    h.totals.glitches++;
+    Debug.printf("%s switch glitch: %u edges over %lu us while %s\n", getSwitchName(id), burst.edges,
+                 (unsigned long)burst.burstUs, burst.active ? "TRIGGERED" : "NOT TRIGGERED");
+  } else {
+    epoch.transitions++;
+    epoch.bounces += bounces;
+    epoch.burstUs += burst.burstUs;
+    if (burst.burstUs > epoch.maxBurstUs) epoch.maxBurstUs = burst.burstUs;
+    uint16_t& bounceCount = epoch.bounceHistogram[bounceBucket(bounces)];
+    if (bounceCount < UINT16_MAX) bounceCount++;
+    uint16_t& burstCount = epoch.burstHistogram[burstBucket(burst.edges, burst.burstUs)];
+    if (burstCount < UINT16_MAX) burstCount++;
+    h.totals.transitions++;
+    h.totals.bounces += bounces;
+    Debug.printf("%s switch %s: %u bounces over %lu us, stable after %lu ms\n", getSwitchName(id),
+                 burst.active ? "made" : "released", bounces, (unsigned long)burst.burstUs,
+                 (unsigned long)(burst.settleUs / 1000));
+
+    if (epoch.transitions >= SWITCH_HEALTH_EPOCH_TRANSITIONS) {
+      h.head = (h.head + 1) % SWITCH_HEALTH_EPOCHS;
+      if (h.count < SWITCH_HEALTH_EPOCHS) h.count++;
+      memset(&h.epochs[h.head], 0, sizeof(SwitchHealthEpoch));
+      saveRequested = true;
+    }
+  }
+  dirty = true;
+
+  uint8_t reasons = evaluateAlert(id);
+  if (reasons != alertReasons[id]) {
+    Debug.printf("%s switch health alert %s (reasons 0x%02x)\n", getSwitchName(id),
+                 reasons ? "RAISED" : "CLEARED", reasons);
+    alertReasons[id] = reasons;
+  }
+}
+
+void initSwitchHealth() {
+  Preferences prefs;
+  prefs.begin(PREFERENCES_NAMESPACE, true);  // Read-only
+  resetStore();
+  if (prefs.getBytesLength(PREF_SWITCH_HEALTH) == sizeof(store)) {
+    prefs.getBytes(PREF_SWITCH_HEALTH, &store, sizeof(store));
+    if (!storeValid()) {
+      Debug.println("Switch health history in NVS is corrupt - discarding");
+      resetStore();
+    }
+  }
+  prefs.end();
+
+  memset(lastBounce, 0, sizeof(lastBounce));
+  memset(publishedReasons, 0, sizeof(publishedReasons));
+  for (uint8_t i = 0; i < SWITCH_COUNT; i++) {
+    alertReasons[i] = evaluateAlert((LimitSwitchId)i);  // Republished once MQTT is up
+  }
+  dirty = false;
+  saveRequested = false;
+  stats.lastSaveMs = millis();
+
+  Debug.printf("Switch health: open %lu transitions, closed %lu transitions\n",
+               (unsigned long)store.switches[SWITCH_OPEN].totals.transitions,
+               (unsigned long)store.switches[SWITCH_CLOSED].totals.transitions);
+}
+
+void processSwitchHealth() {
+  InputBurst burst;
+  while (popInputBurst(burst)) {
+    stats.records++;
+    if (burst.channel == INPUT_LIMIT_OPEN) {
+      recordBurst(SWITCH_OPEN, burst);
+    } else if (burst.channel == INPUT_LIMIT_CLOSED) {
+      recordBurst(SWITCH_CLOSED, burst);
+    }
+  }
+
+  for (uint8_t i = 0; i < SWITCH_COUNT; i++) {
+    if (alertReasons[i] != publishedReasons[i] && publishSwitchHealthToMQTT((LimitSwitchId)i)) {
+      publishedReasons[i] = alertReasons[i];
+    }
+  }
+
+  if (dirty && (saveRequested || millis() - stats.lastSaveMs >= SWITCH_HEALTH_SAVE_INTERVAL_MS)) {
+    saveSwitchHealth();
+  }
+}
+
+void clearSwitchHealth() {
+  resetStore();
+  memset(lastBounce, 0, sizeof(lastBounce));
+  memset(alertReasons, 0, sizeof(alertReasons));
+  saveSwitchHealth();
+  Debug.println("Switch health history cleared");
+}
+
+const char* getSwitchName(LimitSwitchId id) {
+  return id == SWITCH_OPEN ? "Open" : "Closed";
+}
+
+const char* getSwitchKey(LimitSwitchId id) {
+  return id == SWITCH_OPEN ? "open" : "closed";
+}
+
+uint8_t getSwitchHealthEpochCount(LimitSwitchId id) {
+  return id < SWITCH_COUNT ? store.switches[id].count : 0;
+}
+
+const SwitchHealthEpoch& getSwitchHealthEpoch(LimitSwitchId id, uint8_t index) {
+  const SwitchHealthHistory& h = store.switches[id < SWITCH_COUNT ? id : 0];
+  return epochBack(h, h.count - 1 - index % h.count);
+}
+
+SwitchHealthTotals getSwitchHealthTotals(LimitSwitchId id) {
+  SwitchHealthTotals totals = {0, 0, 0};
+  if (id < SWITCH_COUNT) totals = store.switches[id].totals;
+  return totals;
+}
+
+SwitchHealthTrend getSwitchHealthTrend(LimitSwitchId id) {
+  SwitchHealthTrend trend = {0, 0, 0, 0, 0, 0};
+  if (id >= SWITCH_COUNT) return trend;
+
+  SwitchHealthEpoch recent;
+  SwitchHealthTotals baseline;
+  splitWindow(store.switches[id], recent, baseline);
+  trend.recentTransitions = recent.transitions;
+  trend.recentGlitches = recent.glitches;
+  trend.recentMean = recent.transitions ? (float)recent.bounces / recent.transitions : 0;
+  trend.baselineTransitions = baseline.transitions;
+  trend.baselineMean = baseline.transitions ? (float)baseline.bounces / baseline.transitions : 0;
+  trend.alertReasons = alertReasons[id];
+  return trend;
+}
+
+const SwitchBounceRecord& getLastSwitchBounce(LimitSwitchId id) {
+  return lastBounce[id < SWITCH_COUNT ? id : 0];
+}
+
+SwitchHealthStats getSwitchHealthStats() {
+  return stats;
+}
+
+const char* getSwitchBounceBucketLabel(uint8_t bucket) {
+  return bucket < SWITCH_BOUNCE_BUCKETS ? BOUNCE_BUCKET_LABELS[bucket] : "";
+}
+
+const char* getSwitchBurstBucketLabel(uint8_t bucket) {
+  return bucket < SWITCH_BURST_BUCKETS ? BURST_BUCKET_LABELS[bucket] : "";
+}
+
+const char* getSwitchAlertReasonName(SwitchAlertReason reason) {
+  switch (reason) {
+    case SWITCH_ALERT_CHATTER_GROWTH: return "chatter_growth";
+    case SWITCH_ALERT_LONG_BURST:     return "long_burst";
+    case SWITCH_ALERT_GLITCHES:       return "glitches";
+    default:                          return "unknown";
+  }
+}
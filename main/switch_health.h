@@ -0,0 +1,99 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Limit Switch Health Header
+ *
+ * Wear trending for the two limit switches, fed on the network task by the
+ * input sampler's bounce records. Every transition is binned by its bounce
+ * count and burst length into the current epoch; an epoch closes after
+ * SWITCH_HEALTH_EPOCH_TRANSITIONS transitions, and the last
+ * SWITCH_HEALTH_EPOCHS epochs form a rolling window in which a switch whose
+ * bounce count climbs stands out against its own history. The window is kept
+ * in NVS, written when an epoch closes and otherwise at most once per
+ * SWITCH_HEALTH_SAVE_INTERVAL_MS. An alert goes out over MQTT when bounces
+ * grow, a burst gets close to the debounce time, or a switch glitches.
+ */
+
+#ifndef SWITCH_HEALTH_H
+#define SWITCH_HEALTH_H
+
+#include <Arduino.h>
+#include "config.h"
+
+enum LimitSwitchId : uint8_t {
+  SWITCH_OPEN,
+  SWITCH_CLOSED,
+  SWITCH_COUNT
+};
+
+enum SwitchAlertReason : uint8_t {
+  SWITCH_ALERT_CHATTER_GROWTH = 1 << 0,   // Mean bounces well above the older epochs
+  SWITCH_ALERT_LONG_BURST = 1 << 1,       // A burst used up a large part of the stable time
+  SWITCH_ALERT_GLITCHES = 1 << 2          // Chatter on a switch that was not moving
+};
+
+const uint8_t SWITCH_BOUNCE_BUCKETS = 7;  // 0, 1, 2, 3, 4-5, 6-9, 10+ bounces
+const uint8_t SWITCH_BURST_BUCKETS = 8;   // Clean, <1, <2, <5, <10, <20, <50, 50+ ms
+
+// Transitions and glitches of one switch over one epoch, as stored in NVS
+struct SwitchHealthEpoch {
+  uint16_t transitions;
+  uint16_t glitches;
+  uint32_t bounces;               // Sum over the transitions
+  uint32_t burstUs;               // Sum of the transition burst lengths
+  uint32_t maxBurstUs;
+  uint16_t bounceHistogram[SWITCH_BOUNCE_BUCKETS];
+  uint16_t burstHistogram[SWITCH_BURST_BUCKETS];
+};
+
+struct SwitchHealthTotals {
+  uint32_t transitions;           // Since the history was last cleared
+  uint32_t bounces;
+  uint32_t glitches;
+};
+
+// The most recent burst on a switch (not persisted)
+struct SwitchBounceRecord {
+  bool valid;
+  bool flipped;                   // false = glitch
+  bool active;                    // Stable state after the burst
+  uint16_t edges;
+  uint16_t bounces;
+  uint32_t burstUs;
+  uint32_t settleUs;              // First edge to the stable change
+  unsigned long receivedMs;
+};
+
+// Recent = the current epoch, plus the previous one until the current epoch
+// has SWITCH_HEALTH_MIN_TRANSITIONS; baseline = the older epochs in the window
+struct SwitchHealthTrend {
+  uint32_t recentTransitions;
+  uint32_t recentGlitches;
+  float recentMean;               // Mean bounces per transition
+  uint32_t baselineTransitions;   // 0 = no older epoch yet
+  float baselineMean;
+  uint8_t alertReasons;           // SwitchAlertReason bits
+};
+
+struct SwitchHealthStats {
+  uint32_t records;               // Bursts taken from the sampler since boot
+  uint32_t saves;                 // NVS writes since boot
+  unsigned long lastSaveMs;
+};
+
+void initSwitchHealth();                        // Load the window from NVS
+void processSwitchHealth();                     // Network task: drain the sampler, alert and save
+void clearSwitchHealth();
+
+const char* getSwitchName(LimitSwitchId id);          // "Open" / "Closed", for logs
+const char* getSwitchKey(LimitSwitchId id);           // "open" / "closed", for JSON and topics
+uint8_t getSwitchHealthEpochCount(LimitSwitchId id);
+const SwitchHealthEpoch& getSwitchHealthEpoch(LimitSwitchId id, uint8_t index);  // 0 = oldest, last = current
+SwitchHealthTotals getSwitchHealthTotals(LimitSwitchId id);
+SwitchHealthTrend getSwitchHealthTrend(LimitSwitchId id);
+const SwitchBounceRecord& getLastSwitchBounce(LimitSwitchId id);
+SwitchHealthStats getSwitchHealthStats();
+const char* getSwitchBounceBucketLabel(uint8_t bucket);
+const char* getSwitchBurstBucketLabel(uint8_t bucket);
+const char* getSwitchAlertReasonName(SwitchAlertReason reason);
+
+#endif // SWITCH_HEALTH_H
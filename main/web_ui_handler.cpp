@@ -7,6 +7,21 @@
 #include "html_templates.h"
 #include "mqtt_handler.h"
 #include "roof_controller.h"
+#include "roof_telemetry.h"
+#include "roof_position.h"
+#include "control_link.h"
+#include "snow_sensor.h"
+#include "safety_monitor.h"
+#include "control_task.h"
+#include "boot_timeline.h"
+#include "roof_resume.h"
+#include "roof_trace.h"
+#include "perf_profiler.h"
+#include "input_sampler.h"
+#include "switch_health.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
+#include "request_arena.h"
 #include "park_sensor_udp.h"
 #include "gps_handler.h"
 #include "Debug.h"
@@ -143,6 +158,43 @@ void loadConfiguration() {
     inverterSoftPwrEnabled = preferences.getBool(PREF_INVERTER_SOFTPWR_ENABLED, true);  // Default to true
   }
 
+  // Load AC-detect sequencing setting
+  if (preferences.isKey(PREF_INVERTER_AC_SEQUENCING)) {
+    inverterAcSequencing = preferences.getBool(PREF_INVERTER_AC_SEQUENCING, false);
+  }
+
+  // Load inverter keep-warm window
+  if (preferences.isKey(PREF_INVERTER_KEEP_WARM)) {
+    inverterKeepWarmMinutes = preferences.getULong(PREF_INVERTER_KEEP_WARM, 0);
+  }
+
+  // Load inverter pre-warm settings
+  if (preferences.isKey(PREF_INVERTER_PREWARM)) {
+    inverterPrewarmMinutes = preferences.getULong(PREF_INVERTER_PREWARM, 0);
+  }
+  if (preferences.isKey(PREF_PREWARM_ON_CONNECT)) {
+    inverterPrewarmOnConnect = preferences.getBool(PREF_PREWARM_ON_CONNECT, false);
+  }
+
+  // Load rain auto-close settings
+  if (preferences.isKey(PREF_RAIN_AUTO_CLOSE)) {
+    rainAutoCloseEnabled = preferences.getBool(PREF_RAIN_AUTO_CLOSE, false);
+  }
+  if (preferences.isKey(PREF_RAIN_HOLDOFF)) {
+    rainHoldoffMs = preferences.getULong(PREF_RAIN_HOLDOFF, DEFAULT_RAIN_HOLDOFF);
+  }
+  if (preferences.isKey(PREF_RAIN_LOCKOUT)) {
+    rainReopenLockoutMs = preferences.getULong(PREF_RAIN_LOCKOUT, DEFAULT_RAIN_REOPEN_LOCKOUT);
+  }
+
+  // Load RS485 snow sensor settings
+  if (preferences.isKey(PREF_SNOW_MODBUS)) {
+    snowModbusEnabled = preferences.getBool(PREF_SNOW_MODBUS, false);
+  }
+  if (preferences.isKey(PREF_SNOW_AUTO_CLOSE)) {
+    snowAutoCloseEnabled = preferences.getBool(PREF_SNOW_AUTO_CLOSE, false);
+  }
+
   // Load inverter delay settings
   if (preferences.isKey(PREF_INVERTER_DELAY1)) {
     inverterDelay1 = preferences.getULong(PREF_INVERTER_DELAY1, DEFAULT_INVERTER_DELAY1);
@@ -170,6 +222,22 @@ void loadConfiguration() {
     gpsPpsPin = preferences.getInt(PREF_GPS_PPS_PIN, DEFAULT_GPS_PPS_PIN);
   }
 
+  // Load roof encoder pins and the learned closed-to-open span
+  if (preferences.isKey(PREF_ENCODER_PIN_A)) {
+    ENCODER_PIN_A = preferences.getInt(PREF_ENCODER_PIN_A, DEFAULT_ENCODER_PIN_A);
+  }
+  if (preferences.isKey(PREF_ENCODER_PIN_B)) {
+    ENCODER_PIN_B = preferences.getInt(PREF_ENCODER_PIN_B, DEFAULT_ENCODER_PIN_B);
+  }
+  if (preferences.isKey(PREF_ENCODER_SPAN)) {
+    encoderCountsPerTravel = preferences.getLong(PREF_ENCODER_SPAN, 0);
+  }
+
+  // Load the motor current sensor pin
+  if (preferences.isKey(PREF_MOTOR_CURRENT_PIN)) {
+    MOTOR_CURRENT_PIN = preferences.getInt(PREF_MOTOR_CURRENT_PIN, DEFAULT_MOTOR_CURRENT_PIN);
+  }
+
   // Load timezone settings
   if (preferences.isKey(PREF_TIMEZONE_OFFSET)) {
     timezoneOffset = preferences.getShort(PREF_TIMEZONE_OFFSET, DEFAULT_TIMEZONE_OFFSET);
@@ -182,9 +250,18 @@ void loadConfiguration() {
 
   Debug.println("Configuration loaded from preferences");
   Debug.printf("Movement timeout: %lu ms (%lu seconds)\n", movementTimeout, movementTimeout / 1000);
-  Debug.printf("Inverter Delay 1: %lu ms, Delay 2: %lu ms\n", inverterDelay1, inverterDelay2);
+  Debug.printf("Inverter Delay 1: %lu ms, Delay 2: %lu ms, start on AC detect: %s, keep-warm: %lu min\n",
+               inverterDelay1, inverterDelay2, inverterAcSequencing ? "on" : "off", inverterKeepWarmMinutes);
+  Debug.printf("Inverter pre-warm: %lu min, on Alpaca connect: %s\n",
+               inverterPrewarmMinutes, inverterPrewarmOnConnect ? "on" : "off");
+  Debug.printf("Rain auto-close: %s, hold-off %lu ms, re-open lockout %lu ms\n",
+               rainAutoCloseEnabled ? "on" : "off", rainHoldoffMs, rainReopenLockoutMs);
+  Debug.printf("RS485 snow sensor: %s, snow auto-close: %s\n",
+               snowModbusEnabled ? "on" : "off", snowAutoCloseEnabled ? "on" : "off");
   Debug.printf("GPS: %s, NTP Server: %s\n", gpsEnabled ? "Enabled" : "Disabled", gpsNtpEnabled ? "Enabled" : "Disabled");
   Debug.printf("GPS Pins: TX=%d, RX=%d, PPS=%d\n", gpsTxPin, gpsRxPin, gpsPpsPin);
+  Debug.printf("Roof encoder: A=%d, B=%d, span %ld counts\n", ENCODER_PIN_A, ENCODER_PIN_B, encoderCountsPerTravel);
+  Debug.printf("Motor current sensor: GPIO%d\n", MOTOR_CURRENT_PIN);
   Debug.printf("Timezone: %+d minutes, DST: %s\n", timezoneOffset, dstEnabled ? "Enabled" : "Disabled");
 }
 
@@ -223,6 +300,25 @@ void saveConfiguration() {
   // Save inverter soft-power enabled setting
   preferences.putBool(PREF_INVERTER_SOFTPWR_ENABLED, inverterSoftPwrEnabled);
 
+  // Save AC-detect sequencing setting
+  preferences.putBool(PREF_INVERTER_AC_SEQUENCING, inverterAcSequencing);
+
+  // Save inverter keep-warm window
+  preferences.putULong(PREF_INVERTER_KEEP_WARM, inverterKeepWarmMinutes);
+
+  // Save inverter pre-warm settings
+  preferences.putULong(PREF_INVERTER_PREWARM, inverterPrewarmMinutes);
+  preferences.putBool(PREF_PREWARM_ON_CONNECT, inverterPrewarmOnConnect);
+
+  // Save rain auto-close settings
+  preferences.putBool(PREF_RAIN_AUTO_CLOSE, rainAutoCloseEnabled);
+  preferences.putULong(PREF_RAIN_HOLDOFF, rainHoldoffMs);
+  preferences.putULong(PREF_RAIN_LOCKOUT, rainReopenLockoutMs);
+
+  // Save RS485 snow sensor settings
+  preferences.putBool(PREF_SNOW_MODBUS, snowModbusEnabled);
+  preferences.putBool(PREF_SNOW_AUTO_CLOSE, snowAutoCloseEnabled);
+
   // Save inverter delay settings
   preferences.putULong(PREF_INVERTER_DELAY1, inverterDelay1);
   preferences.putULong(PREF_INVERTER_DELAY2, inverterDelay2);
@@ -441,6 +537,23 @@ void handleSetPins() {
     }
   }
 
+  // Check for AC-detect sequencing parameter
+  if (webUiServer.hasArg("inverterAcSeq")) {
+    bool newInverterAcSequencing = webUiServer.arg("inverterAcSeq").equals("true");
+    if (newInverterAcSequencing != inverterAcSequencing) {
+      inverterAcSequencing = newInverterAcSequencing;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putBool(PREF_INVERTER_AC_SEQUENCING, inverterAcSequencing);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Start on AC detect " + String(inverterAcSequencing ? "enabled" : "disabled") + ". ";
+      Debug.printf("Start on AC detect %s\n", inverterAcSequencing ? "enabled" : "disabled");
+    }
+  }
+
   // Check for inverter delay 1 parameter
   if (webUiServer.hasArg("delay1")) {
     unsigned long newDelay1 = webUiServer.arg("delay1").toInt(); // In milliseconds
@@ -485,12 +598,229 @@ void handleSetPins() {
     }
   }
 
+  // Check for inverter keep-warm parameter
+  if (webUiServer.hasArg("keepWarm")) {
+    long newKeepWarm = webUiServer.arg("keepWarm").toInt(); // In minutes
+    if (newKeepWarm >= 0 && newKeepWarm <= (long)MAX_INVERTER_KEEP_WARM_MINUTES) {
+      if ((unsigned long)newKeepWarm != inverterKeepWarmMinutes) {
+        inverterKeepWarmMinutes = newKeepWarm;
+
+        // Save the setting
+        preferences.begin(PREFERENCES_NAMESPACE, false);
+        preferences.putULong(PREF_INVERTER_KEEP_WARM, inverterKeepWarmMinutes);
+        preferences.end();
+
+        settingsChanged = true;
+        message += "Inverter keep-warm set to " + String(inverterKeepWarmMinutes) + " minutes. ";
+        Debug.printf("Inverter keep-warm set to %lu minutes\n", inverterKeepWarmMinutes);
+      }
+    } else {
+      message += "Invalid keep-warm value (must be 0-" + String(MAX_INVERTER_KEEP_WARM_MINUTES) + " minutes). ";
+      Debug.println("Invalid keep-warm value received");
+    }
+  }
+
+  // Check for inverter pre-warm parameters
+  if (webUiServer.hasArg("prewarm")) {
+    long newPrewarm = webUiServer.arg("prewarm").toInt(); // In minutes
+    if (newPrewarm >= 0 && newPrewarm <= (long)MAX_INVERTER_PREWARM_MINUTES) {
+      if ((unsigned long)newPrewarm != inverterPrewarmMinutes) {
+        inverterPrewarmMinutes = newPrewarm;
+
+        // Save the setting
+        preferences.begin(PREFERENCES_NAMESPACE, false);
+        preferences.putULong(PREF_INVERTER_PREWARM, inverterPrewarmMinutes);
+        preferences.end();
+
+        settingsChanged = true;
+        message += "Inverter pre-warm set to " + String(inverterPrewarmMinutes) + " minutes. ";
+        Debug.printf("Inverter pre-warm set to %lu minutes\n", inverterPrewarmMinutes);
+      }
+    } else {
+      message += "Invalid pre-warm value (must be 0-" + String(MAX_INVERTER_PREWARM_MINUTES) + " minutes). ";
+      Debug.println("Invalid pre-warm value received");
+    }
+  }
+
+  if (webUiServer.hasArg("prewarmOnConnect")) {
+    bool newPrewarmOnConnect = webUiServer.arg("prewarmOnConnect").equals("true");
+    if (newPrewarmOnConnect != inverterPrewarmOnConnect) {
+      inverterPrewarmOnConnect = newPrewarmOnConnect;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putBool(PREF_PREWARM_ON_CONNECT, inverterPrewarmOnConnect);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Pre-warm on Alpaca connect " + String(inverterPrewarmOnConnect ? "enabled" : "disabled") + ". ";
+      Debug.printf("Pre-warm on Alpaca connect %s\n", inverterPrewarmOnConnect ? "enabled" : "disabled");
+    }
+  }
+
+  // Check for rain auto-close parameters
+  if (webUiServer.hasArg("rainClose")) {
+    bool newRainAutoClose = webUiServer.arg("rainClose").equals("true");
+    if (newRainAutoClose != rainAutoCloseEnabled) {
+      rainAutoCloseEnabled = newRainAutoClose;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putBool(PREF_RAIN_AUTO_CLOSE, rainAutoCloseEnabled);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Rain auto-close " + String(rainAutoCloseEnabled ? "enabled" : "disabled") + ". ";
+      Debug.printf("Rain auto-close %s\n", rainAutoCloseEnabled ? "enabled" : "disabled");
+    }
+  }
+
+  if (webUiServer.hasArg("rainHoldoff")) {
+    long newHoldoff = webUiServer.arg("rainHoldoff").toInt(); // In seconds
+    if (newHoldoff >= 0 && (unsigned long)newHoldoff * 1000UL <= MAX_RAIN_HOLDOFF) {
+      if ((unsigned long)newHoldoff * 1000UL != rainHoldoffMs) {
+        rainHoldoffMs = (unsigned long)newHoldoff * 1000UL;
+
+        // Save the setting
+        preferences.begin(PREFERENCES_NAMESPACE, false);
+        preferences.putULong(PREF_RAIN_HOLDOFF, rainHoldoffMs);
+        preferences.end();
+
+        settingsChanged = true;
+        message += "Rain hold-off set to " + String(rainHoldoffMs / 1000) + " seconds. ";
+        Debug.printf("Rain hold-off set to %lums\n", rainHoldoffMs);
+      }
+    } else {
+      message += "Invalid rain hold-off value (must be 0-" + String(MAX_RAIN_HOLDOFF / 1000) + " seconds). ";
+      Debug.println("Invalid rain hold-off value received");
+    }
+  }
+
+  if (webUiServer.hasArg("rainLockout")) {
+    long newLockout = webUiServer.arg("rainLockout").toInt(); // In minutes
+    if (newLockout >= 0 && (unsigned long)newLockout * 60000UL <= MAX_RAIN_REOPEN_LOCKOUT) {
+      if ((unsigned long)newLockout * 60000UL != rainReopenLockoutMs) {
+        rainReopenLockoutMs = (unsigned long)newLockout * 60000UL;
+
+        // Save the setting
+        preferences.begin(PREFERENCES_NAMESPACE, false);
+        preferences.putULong(PREF_RAIN_LOCKOUT, rainReopenLockoutMs);
+        preferences.end();
+
+        settingsChanged = true;
+        message += "Rain re-open lockout set to " + String(rainReopenLockoutMs / 60000) + " minutes. ";
+        Debug.printf("Rain re-open lockout set to %lums\n", rainReopenLockoutMs);
+      }
+    } else {
+      message += "Invalid rain lockout value (must be 0-" + String(MAX_RAIN_REOPEN_LOCKOUT / 60000) + " minutes). ";
+      Debug.println("Invalid rain lockout value received");
+    }
+  }
+
+  // Check for RS485 snow sensor parameters
+  if (webUiServer.hasArg("snowModbus")) {
+    bool newSnowModbus = webUiServer.arg("snowModbus").equals("true");
+    if (newSnowModbus != snowModbusEnabled) {
+      snowModbusEnabled = newSnowModbus;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putBool(PREF_SNOW_MODBUS, snowModbusEnabled);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "RS485 snow sensor " + String(snowModbusEnabled ? "enabled" : "disabled") + ". ";
+      Debug.printf("RS485 snow sensor %s\n", snowModbusEnabled ? "enabled" : "disabled");
+    }
+  }
+
+  if (webUiServer.hasArg("snowClose")) {
+    bool newSnowAutoClose = webUiServer.arg("snowClose").equals("true");
+    if (newSnowAutoClose != snowAutoCloseEnabled) {
+      snowAutoCloseEnabled = newSnowAutoClose;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putBool(PREF_SNOW_AUTO_CLOSE, snowAutoCloseEnabled);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Snow auto-close " + String(snowAutoCloseEnabled ? "enabled" : "disabled") + ". ";
+      Debug.printf("Snow auto-close %s\n", snowAutoCloseEnabled ? "enabled" : "disabled");
+    }
+  }
+
+  // Check for roof encoder parameters (-1 = no encoder)
+  if (webUiServer.hasArg("encoderPinA") && webUiServer.hasArg("encoderPinB")) {
+    int newPinA = webUiServer.arg("encoderPinA").toInt();
+    int newPinB = webUiServer.arg("encoderPinB").toInt();
+    if (newPinA < -1 || newPinA > 48 || newPinB < -1 || newPinB > 48 || (newPinA >= 0 && newPinA == newPinB)) {
+      message += "Invalid encoder pins (each -1 or 0-48, and not the same pin). ";
+      Debug.println("Invalid encoder pins received");
+    } else if (newPinA != ENCODER_PIN_A || newPinB != ENCODER_PIN_B) {
+      ENCODER_PIN_A = newPinA;
+      ENCODER_PIN_B = newPinB;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putInt(PREF_ENCODER_PIN_A, ENCODER_PIN_A);
+      preferences.putInt(PREF_ENCODER_PIN_B, ENCODER_PIN_B);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Encoder pins set to A=" + String(ENCODER_PIN_A) + ", B=" + String(ENCODER_PIN_B) + ". ";
+      Debug.printf("Encoder pins set to A=%d, B=%d\n", ENCODER_PIN_A, ENCODER_PIN_B);
+    }
+  }
+
+  // A new encoder (or a re-mounted one) needs its span learned again
+  // (the control task owns the span: it reads it every step and learns it at the open limit)
+  bool spanRequested = webUiServer.hasArg("encoderResetSpan") && webUiServer.arg("encoderResetSpan").equals("true");
+  if (spanRequested) {
+    if (roofCommandSucceeded(runRoofCommand(CMD_RESET_ENCODER_SPAN, SOURCE_WEB))) {
+      message += "Encoder span reset (learned on the next full open). ";
+    } else {
+      message += "Encoder span not reset - controller busy. ";
+    }
+  }
+
+  // Check for the motor current sensor pin (-1 = no sensor; continuous mode needs ADC1)
+  if (webUiServer.hasArg("currentPin")) {
+    int newPin = webUiServer.arg("currentPin").toInt();
+    if (newPin != -1 && (newPin < 1 || newPin > 10)) {
+      message += "Invalid motor current pin (-1, or an ADC1 pin GPIO1-10). ";
+      Debug.println("Invalid motor current pin received");
+    } else if (newPin != MOTOR_CURRENT_PIN) {
+      MOTOR_CURRENT_PIN = newPin;
+
+      // Save the setting
+      preferences.begin(PREFERENCES_NAMESPACE, false);
+      preferences.putInt(PREF_MOTOR_CURRENT_PIN, MOTOR_CURRENT_PIN);
+      preferences.end();
+
+      settingsChanged = true;
+      message += "Motor current pin set to " + String(MOTOR_CURRENT_PIN) + ". ";
+      Debug.printf("Motor current pin set to %d\n", MOTOR_CURRENT_PIN);
+    }
+  }
+
+  // A re-geared or serviced drive draws a different current: learn it again
+  bool envelopeRequested = webUiServer.hasArg("currentResetEnvelope") &&
+                           webUiServer.arg("currentResetEnvelope").equals("true");
+  if (envelopeRequested) {
+    if (roofCommandSucceeded(runRoofCommand(CMD_CLEAR_CURRENT_ENVELOPE, SOURCE_WEB))) {
+      message += "Motor current envelope cleared (learned again from the next moves). ";
+    } else {
+      message += "Motor current envelope not cleared - controller busy. ";
+    }
+  }
+
   if (settingsChanged) {
-    // Apply new pin settings
-    applyPinSettings();
+    // Apply new pin settings (in the control task, which owns the pins)
+    runRoofCommand(CMD_APPLY_PINS, SOURCE_WEB);
     message += "Settings applied. Restarting may be required for stable operation.";
     Debug.println("Pin settings applied");
-  } else {
+  } else if (!spanRequested && !envelopeRequested) {
     message = "No changes were made.";
     Debug.println("No pin setting changes made");
   }
@@ -553,17 +883,42 @@ void initWebUI() {
   // Inverter control endpoints (NEW in v3)
   webUiServer.on("/inverter_toggle", HTTP_POST, handleInverterToggle);
   webUiServer.on("/inverter_button", HTTP_POST, handleInverterButton);
+  webUiServer.on("/inverter_prewarm", HTTP_POST, handleInverterPrewarm);
   webUiServer.on("/inverter_status", HTTP_GET, handleInverterStatus);
 
   // Roof control endpoint
   webUiServer.on("/roof_control", HTTP_POST, handleRoofControl);
   webUiServer.on("/roof_button", HTTP_POST, handleRoofButton);
   webUiServer.on("/roof_openclose", HTTP_POST, handleRoofOpenClose);
+  webUiServer.on("/roof_target", HTTP_POST, handleRoofTarget);
   webUiServer.on("/clear_error", HTTP_POST, handleClearError);
 
   // API endpoint for real-time status
   webUiServer.on("/api/status", HTTP_GET, handleApiStatus);
 
+  // Movement telemetry and adaptive timeouts
+  webUiServer.on("/api/telemetry", HTTP_GET, handleApiTelemetry);
+  webUiServer.on("/telemetry_adaptive", HTTP_POST, handleTelemetryAdaptive);
+  webUiServer.on("/telemetry_reset", HTTP_POST, handleTelemetryReset);
+  webUiServer.on("/position_rate", HTTP_POST, handlePositionRate);
+  webUiServer.on("/api/commands", HTTP_GET, handleApiCommands);
+  webUiServer.on("/api/boot", HTTP_GET, handleApiBoot);
+  webUiServer.on("/api/inputs", HTTP_GET, handleApiInputs);
+  webUiServer.on("/api/switch_health", HTTP_GET, handleApiSwitchHealth);
+  webUiServer.on("/switch_health_reset", HTTP_POST, handleSwitchHealthReset);
+  webUiServer.on("/api/rain", HTTP_GET, handleApiRain);
+  webUiServer.on("/api/encoder", HTTP_GET, handleApiEncoder);
+  webUiServer.on("/api/current", HTTP_GET, handleApiCurrent);
+
+  // Loop profiler
+  webUiServer.on("/api/perf", HTTP_GET, handleApiPerf);
+  webUiServer.on("/perf_reset", HTTP_POST, handlePerfReset);
+  webUiServer.on("/perf_mqtt", HTTP_POST, handlePerfMqtt);
+
+  // Trace recorder
+  webUiServer.on("/api/trace", HTTP_GET, handleApiTrace);
+  webUiServer.on("/trace_clear", HTTP_POST, handleTraceClear);
+
   // GPS control endpoints
   webUiServer.on("/gps_enabled", HTTP_POST, handleGPSEnabled);
   webUiServer.on("/gps_ntp_enabled", HTTP_POST, handleGPSNtpEnabled);
@@ -593,7 +948,7 @@ void handleWebUI() {
 
 // Handle the root page - shows a simple status page
 void handleRoot() {
-  String html = getHomePage(roofStatus, apMode);
+  String html = getHomePage(getRoofSnapshot().status, apMode);
   webUiServer.send(200, "text/html", html);
 }
 
@@ -911,9 +1266,12 @@ void handleParkSensorType() {
 
 // Handler for toggling K1 inverter power relay
 void handleInverterToggle() {
-  toggleInverterPower();
+  if (!roofCommandSucceeded(runRoofCommand(CMD_INVERTER_TOGGLE, SOURCE_WEB))) {
+    webUiServer.send(503, "text/plain", "Roof controller busy - try again");
+    return;
+  }
 
-  bool state = getInverterRelayState();
+  bool state = getRoofSnapshot().inverterRelay;
   String stateStr = state ? "ON" : "OFF";
 
   Debug.printf("Inverter power relay toggled via web interface to: %s\n", stateStr.c_str());
@@ -922,7 +1280,10 @@ void handleInverterToggle() {
 
 // Handler for sending K3 soft-power button press
 void handleInverterButton() {
-  sendInverterButtonPress();
+  if (!roofCommandSucceeded(runRoofCommand(CMD_INVERTER_BUTTON, SOURCE_WEB))) {
+    webUiServer.send(503, "text/plain", "Inverter button busy - try again");
+    return;
+  }
 
   Debug.println("Inverter button press sent via web interface");
   webUiServer.send(200, "text/plain", "Inverter button pressed");
@@ -930,16 +1291,47 @@ void handleInverterButton() {
 
 // Handler for getting inverter power states
 void handleInverterStatus() {
-  bool relayState = getInverterRelayState();
-  bool acPowerState = getInverterACPowerState();
+  RoofSnapshot snap = getRoofSnapshot();
+  bool relayState = snap.inverterRelay;
+  bool acPowerState = snap.inverterACPower;
 
-  // Create JSON response
-  String json = "{";
-  json += "\"relay_state\":" + String(relayState ? "true" : "false") + ",";
-  json += "\"ac_power_state\":" + String(acPowerState ? "true" : "false");
-  json += "}";
+  InverterSequenceStats seq = getInverterSequenceStats();
+  InverterKeepWarmStats warm = getInverterKeepWarmStats();
+  InverterPrewarmStats prewarm = getInverterPrewarmStats();
 
-  webUiServer.send(200, "application/json", json);
+  // Create JSON response
+  RequestJsonDocument doc(1024);
+  doc["relay_state"] = relayState;
+  doc["ac_power_state"] = acPowerState;
+  doc["ac_sequencing"] = inverterAcSequencing;
+  doc["ac_early_advances"] = seq.earlyAdvances;
+  doc["ac_delay_timeouts"] = seq.timeouts;
+  doc["ac_last_up_ms"] = seq.lastAcUpMs;
+  doc["ac_last_saved_ms"] = seq.lastSavedMs;
+  doc["ac_total_saved_ms"] = seq.totalSavedMs;
+  doc["keep_warm_minutes"] = inverterKeepWarmMinutes;
+  doc["keep_warm_active"] = warm.active;
+  doc["keep_warm_remaining_ms"] = warm.remainingMs;
+  doc["keep_warm_windows"] = warm.windows;
+  doc["keep_warm_expiries"] = warm.expiries;
+  doc["spin_ups_avoided"] = warm.spinUpsAvoided;
+  doc["keep_warm_on_ms"] = warm.addedOnMs;
+  doc["prewarm_minutes"] = inverterPrewarmMinutes;
+  doc["prewarm_on_connect"] = inverterPrewarmOnConnect;
+  doc["prewarm_running"] = prewarm.running;
+  doc["prewarm_active"] = prewarm.active;
+  doc["prewarm_remaining_ms"] = prewarm.remainingMs;
+  doc["prewarm_requests"] = prewarm.requests;
+  doc["prewarm_spin_ups"] = prewarm.spinUps;
+  doc["prewarm_hits"] = prewarm.hits;
+  doc["prewarm_joined"] = prewarm.joined;
+  doc["prewarm_expiries"] = prewarm.expiries;
+  doc["prewarm_cancelled"] = prewarm.cancelled;
+  doc["prewarm_on_ms"] = prewarm.addedOnMs;
+  unsigned long prewarmOutcomes = prewarm.hits + prewarm.expiries + prewarm.cancelled;
+  doc["prewarm_hit_ratio"] = prewarmOutcomes > 0 ? (float)prewarm.hits / prewarmOutcomes : 0.0f;
+
+  sendJsonResponse(webUiServer, 200, doc);
 }
 
 // Handler for roof control page
@@ -948,33 +1340,46 @@ void handleControl() {
   webUiServer.send(200, "text/html", html);
 }
 
+// Reply to a roof command with the arbiter's decision
+static void sendRoofCommandResult(RoofCommandOutcome outcome, const String& successMessage) {
+  Debug.printf("Web roof command: %s\n", getRoofCommandOutcomeString(outcome));
+
+  switch (outcome) {
+    case COMMAND_ACCEPTED:
+    case COMMAND_COALESCED:
+    case COMMAND_ALREADY_DONE:
+      webUiServer.send(200, "text/plain", successMessage);
+      break;
+    case COMMAND_REJECTED_UNPARKED:
+      webUiServer.send(400, "text/plain", "Cannot control roof - telescope not parked. Enable bypass to override.");
+      break;
+    case COMMAND_REJECTED_RAIN:
+      webUiServer.send(400, "text/plain", "Cannot open roof - rain detected or re-open lockout still running");
+      break;
+    case COMMAND_REJECTED_MOVING:
+      webUiServer.send(400, "text/plain", "Cannot control roof - roof is moving or a sequence is running");
+      break;
+    case COMMAND_BUSY:
+    case COMMAND_TIMED_OUT:
+      webUiServer.send(503, "text/plain", "Roof controller busy - try again");
+      break;
+    default:
+      webUiServer.send(400, "text/plain", String("Roof command failed (") + getRoofCommandOutcomeString(outcome) + ")");
+      break;
+  }
+}
+
 // Handler for roof control commands
 void handleRoofControl() {
   if (webUiServer.hasArg("action")) {
     String action = webUiServer.arg("action");
 
     if (action == "open") {
-      bool success = startOpeningRoof();
-      if (success) {
-        Debug.println("Roof opening command sent via web interface");
-        webUiServer.send(200, "text/plain", "Roof opening");
-      } else {
-        Debug.println("Roof opening command failed - check safety interlocks");
-        webUiServer.send(400, "text/plain", "Cannot open roof - check telescope park status");
-      }
+      sendRoofCommandResult(runRoofCommand(CMD_OPEN, SOURCE_WEB), "Roof opening");
     } else if (action == "close") {
-      bool success = startClosingRoof();
-      if (success) {
-        Debug.println("Roof closing command sent via web interface");
-        webUiServer.send(200, "text/plain", "Roof closing");
-      } else {
-        Debug.println("Roof closing command failed - check safety interlocks");
-        webUiServer.send(400, "text/plain", "Cannot close roof - check telescope park status");
-      }
+      sendRoofCommandResult(runRoofCommand(CMD_CLOSE, SOURCE_WEB), "Roof closing");
     } else if (action == "stop") {
-      stopRoofMovement();
-      Debug.println("Roof stop command sent via web interface");
-      webUiServer.send(200, "text/plain", "Roof stopped");
+      sendRoofCommandResult(runRoofCommand(CMD_STOP, SOURCE_WEB), "Roof stopped");
     } else {
       webUiServer.send(400, "text/plain", "Invalid action");
       Debug.println("Roof control error: Invalid action");
@@ -989,92 +1394,163 @@ void handleRoofControl() {
 void handleRoofButton() {
   Debug.println("Roof button pressed via web interface");
 
-  // Check telescope safety interlock - only if bypass is not enabled
-  if (!bypassParkSensor && !telescopeParked) {
-    Debug.println("Cannot control roof: Telescope not parked and bypass not enabled");
-    webUiServer.send(400, "text/plain", "Cannot control roof - telescope not parked. Enable bypass to override.");
-    return;
-  }
-
   // Just send a button press - exactly like the physical button
   // The roof controller hardware will handle the logic
-  sendButtonPress();
+  sendRoofCommandResult(runRoofCommand(CMD_ROOF_BUTTON, SOURCE_WEB), "Button press sent");
+}
+
+// Power the inverter up ahead of an expected open (for external schedulers)
+void handleInverterPrewarm() {
+  if (inverterPrewarmMinutes == 0) {
+    webUiServer.send(400, "text/plain", "Inverter pre-warm is disabled - set a pre-warm window first");
+    return;
+  }
 
-  Debug.println("Roof button press sent");
-  webUiServer.send(200, "text/plain", "Button press sent");
+  Debug.println("Inverter pre-warm requested via web interface");
+  sendRoofCommandResult(runRoofCommand(CMD_PREWARM, SOURCE_WEB), "Inverter pre-warming");
 }
 
 // Handle intelligent open/close command (replicates ASCOM/MQTT logic)
 void handleRoofOpenClose() {
   Debug.println("Intelligent roof control via web interface");
 
-  // Check telescope safety interlock - only if bypass is not enabled
-  if (!bypassParkSensor && !telescopeParked) {
-    Debug.println("Cannot control roof: Telescope not parked and bypass not enabled");
-    webUiServer.send(400, "text/plain", "Cannot control roof - telescope not parked. Enable bypass to override.");
-    return;
-  }
+  RoofSnapshot snap = getRoofSnapshot();
 
   // Determine action based on current roof state
-  bool success = false;
-  String action = "";
-
-  if (roofStatus == ROOF_CLOSED || roofStatus == ROOF_CLOSING) {
+  if (snap.status == ROOF_CLOSED || snap.status == ROOF_CLOSING) {
     // Roof is closed or closing, so open it
-    action = "Opening";
-    success = startOpeningRoof();
-  } else if (roofStatus == ROOF_OPEN || roofStatus == ROOF_OPENING) {
+    sendRoofCommandResult(runRoofCommand(CMD_OPEN, SOURCE_WEB), "Opening roof");
+  } else if (snap.status == ROOF_OPEN || snap.status == ROOF_OPENING) {
     // Roof is open or opening, so close it
-    action = "Closing";
-    success = startClosingRoof();
+    sendRoofCommandResult(runRoofCommand(CMD_CLOSE, SOURCE_WEB), "Closing roof");
   } else {
     // Unknown state - return error
     Debug.println("Cannot determine roof action - unknown state");
     webUiServer.send(400, "text/plain", "Cannot control roof - unknown state");
+  }
+}
+
+// Run the roof to a part-open position (needs a calibrated encoder)
+void handleRoofTarget() {
+  if (!webUiServer.hasArg("percent")) {
+    webUiServer.send(400, "text/plain", "Missing percent parameter");
+    return;
+  }
+  uint8_t percent;
+  if (!parseRoofTargetPercent(webUiServer.arg("percent").c_str(), percent)) {
+    webUiServer.send(400, "text/plain", "Invalid percent (must be 0-100)");
     return;
   }
+  Debug.printf("Roof target %d%% via web interface\n", percent);
 
-  if (success) {
-    Debug.printf("Intelligent roof control: %s roof\n", action.c_str());
-    webUiServer.send(200, "text/plain", action + " roof");
-  } else {
-    Debug.printf("Intelligent roof control failed: Cannot %s roof\n", action.c_str());
-    webUiServer.send(400, "text/plain", "Cannot " + action + " roof - check safety interlocks");
+  RoofCommandOutcome outcome = runRoofCommand(CMD_MOVE_TO, SOURCE_WEB, ROOF_COMMAND_TIMEOUT_MS, percent);
+  if (outcome == COMMAND_FAILED && !getRoofEncoderStats().calibrated) {
+    webUiServer.send(400, "text/plain", "Cannot move to a position - encoder not fitted or not calibrated (open fully once)");
+    return;
   }
+  sendRoofCommandResult(outcome, "Moving roof to " + String(percent) + "%");
 }
 
 // Handle clear error request
 void handleClearError() {
   Debug.println("Clear error request via web interface");
 
-  if (roofStatus != ROOF_ERROR) {
+  if (getRoofSnapshot().status != ROOF_ERROR) {
     webUiServer.send(200, "text/plain", "No error to clear");
     return;
   }
 
   // Clear the error state
-  clearRoofError();
+  if (!roofCommandSucceeded(runRoofCommand(CMD_CLEAR_ERROR, SOURCE_WEB))) {
+    webUiServer.send(503, "text/plain", "Roof controller busy - try again");
+    return;
+  }
 
-  webUiServer.send(200, "text/plain", "Error cleared - status: " + getRoofStatusString());
+  webUiServer.send(200, "text/plain", "Error cleared - status: " + getRoofStatusString(getRoofSnapshot().status));
 }
 
 // API endpoint for real-time status updates (returns JSON)
 void handleApiStatus() {
-  DynamicJsonDocument doc(2048);
+  RequestJsonDocument doc(2048);
+
+  RoofSnapshot snap = getRoofSnapshot();
 
   // Roof status
-  doc["status"] = getRoofStatusString();
-  doc["error_reason"] = roofErrorReason;
-  doc["telescope_parked"] = telescopeParked;
+  doc["status"] = getRoofStatusString(snap.status);
+  char errorReason[ROOF_ERROR_REASON_SIZE];
+  formatRoofError(snap.error, errorReason, sizeof(errorReason));
+  doc["error_reason"] = errorReason;
+  if (snap.error.code != ROOF_ERR_NONE) {
+    doc["error_code"] = getRoofErrorId(snap.error.code);
+    doc["error_age_ms"] = millis() - snap.error.timeMs;
+  }
+  doc["telescope_parked"] = snap.telescopeParked;
   doc["bypass_enabled"] = bypassParkSensor;
 
+  // Estimated position (omitted until the roof has reached a limit switch once)
+  if (snap.position >= 0) {
+    doc["position"] = snap.position;
+    doc["position_estimated"] = snap.positionEstimated;
+  }
+  if (snap.targetPosition >= 0) doc["target_position"] = snap.targetPosition;
+  doc["held_part_open"] = snap.heldPartOpen;
+  doc["stall_warning"] = snap.stallWarning;
+  doc["position_interval_ms"] = positionPublishInterval;
+
   // Limit switch states
-  doc["limit_open"] = (digitalRead(LIMIT_SWITCH_OPEN_PIN) == TRIGGERED);
-  doc["limit_closed"] = (digitalRead(LIMIT_SWITCH_CLOSED_PIN) == TRIGGERED);
+  doc["limit_open"] = snap.limitOpen;
+  doc["limit_closed"] = snap.limitClosed;
 
   // Inverter states
-  doc["inverter_relay"] = getInverterRelayState();
-  doc["inverter_ac_power"] = getInverterACPowerState();
+  doc["inverter_relay"] = snap.inverterRelay;
+  doc["inverter_ac_power"] = snap.inverterACPower;
+
+  // Weather inputs
+  doc["rain_detected"] = snap.rainDetected;
+  doc["snow_detected"] = snap.snowDetected;
+  doc["rain_lockout"] = snap.rainLockout;
+
+  // Alpaca SafetyMonitor verdict
+  uint32_t unsafeReasons = getSafetyReasons();
+  char reasons[128];
+  formatSafetyReasons(unsafeReasons, reasons, sizeof(reasons));
+  doc["safe"] = unsafeReasons == 0;
+  doc["unsafe_reasons"] = reasons;
+
+  // RS485 snow sensor (Modbus)
+  JsonObject snowSensor = doc.createNestedObject("snow_sensor");
+  snowSensor["enabled"] = snowModbusEnabled;
+  snowSensor["auto_close"] = snowAutoCloseEnabled;
+  snowSensor["online"] = snap.snowSensor.online;
+  snowSensor["snow"] = snap.snowSensor.snow;
+  if (snap.snowSensor.lastReplyMs != 0) {
+    snowSensor["age_ms"] = millis() - snap.snowSensor.lastReplyMs;
+    JsonArray registers = snowSensor.createNestedArray("registers");
+    for (uint8_t i = 0; i < SNOW_MODBUS_REGISTER_COUNT; i++) {
+      registers.add(snap.snowSensor.registers[i]);
+    }
+  }
+  ModbusMasterStats modbus = getModbusMasterStats();
+  SnowSensorStats snowStats = getSnowSensorStats();
+  snowSensor["last_result"] = getModbusResultString(snowStats.lastResult);
+  snowSensor["requests"] = modbus.requests;
+  snowSensor["replies"] = modbus.replies;
+  snowSensor["timeouts"] = modbus.timeouts;
+  snowSensor["crc_errors"] = modbus.crcErrors;
+  snowSensor["exceptions"] = modbus.exceptions;
+  snowSensor["bad_frames"] = modbus.badFrames;
+  snowSensor["uart_errors"] = modbus.uartErrors;
+  snowSensor["offline_events"] = snowStats.offlineEvents;
+  snowSensor["round_trip_us"] = modbus.lastRoundTripUs;
+  snowSensor["round_trip_max_us"] = modbus.maxRoundTripUs;
+
+  // Control task timing
+  ControlTaskStats control = getControlTaskStats();
+  doc["control_steps"] = control.steps;
+  doc["control_step_us"] = control.lastStepUs;
+  doc["control_step_max_us"] = control.maxStepUs;
+  doc["control_jitter_max_us"] = control.maxJitterUs;
+  doc["control_abort_wakes"] = control.abortWakes;
 
   // Park sensor type
   doc["park_sensor_type"] = static_cast<int>(parkSensorType);
@@ -1119,10 +1595,552 @@ void handleApiStatus() {
     doc["gps_altitude"] = gpsStatusData.altitude;
   }
 
-  String jsonResponse;
-  serializeJson(doc, jsonResponse);
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// ========== MOVEMENT TELEMETRY HANDLERS ==========
+
+static void addMetricStats(JsonObject parent, const char* name, MoveDirection direction, MoveMetric metric) {
+  MoveMetricStats stats = getMoveStats(direction, metric);
+  JsonObject obj = parent.createNestedObject(name);
+  obj["samples"] = stats.samples;
+  obj["p50_ms"] = stats.p50;
+  obj["p95_ms"] = stats.p95;
+  obj["p99_ms"] = stats.p99;
+  obj["max_ms"] = stats.max;
+}
+
+static void addDirectionStats(JsonObject root, const char* name, MoveDirection direction) {
+  JsonObject dir = root.createNestedObject(name);
+  addMetricStats(dir, "spin_up", direction, METRIC_SPIN_UP);
+  addMetricStats(dir, "release", direction, METRIC_RELEASE);
+  addMetricStats(dir, "travel", direction, METRIC_TRAVEL);
+  dir["movement_timeout_ms"] = getEffectiveMovementTimeout(direction);
+  dir["limit_switch_timeout_ms"] = getEffectiveLimitSwitchTimeout(direction);
+}
+
+// Movement history, per-direction statistics and the timeouts currently in force
+void handleApiTelemetry() {
+  RequestJsonDocument doc(6144);
+
+  doc["adaptive_timeouts"] = adaptiveTimeoutsEnabled;
+  doc["adaptive_min_samples"] = ADAPTIVE_MIN_SAMPLES;
+  doc["configured_movement_timeout_ms"] = movementTimeout;
+  doc["configured_limit_switch_timeout_ms"] = limitSwitchTimeout;
+
+  JsonObject root = doc.as<JsonObject>();
+  addDirectionStats(root, "open", MOVE_OPEN);
+  addDirectionStats(root, "close", MOVE_CLOSE);
+
+  // Oldest first; unmeasured values are omitted
+  JsonArray moves = doc.createNestedArray("moves");
+  for (uint8_t i = 0; i < getMoveHistoryCount(); i++) {
+    const MoveRecord& rec = getMoveRecord(i);
+    JsonObject m = moves.createNestedObject();
+    m["seq"] = rec.sequence;
+    m["direction"] = rec.direction == MOVE_OPEN ? "open" : "close";
+    m["outcome"] = getMoveOutcomeString(rec.outcome);
+    if (rec.spinUpMs != MOVE_METRIC_UNSET) m["spin_up_ms"] = rec.spinUpMs;
+    if (rec.releaseMs != MOVE_METRIC_UNSET) m["release_ms"] = rec.releaseMs;
+    if (rec.travelMs != MOVE_METRIC_UNSET) m["travel_ms"] = rec.travelMs;
+  }
 
-  webUiServer.send(200, "application/json", jsonResponse);
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Enable/disable timeouts learned from the movement history
+void handleTelemetryAdaptive() {
+  if (!webUiServer.hasArg("enabled")) {
+    webUiServer.send(400, "text/plain", "Missing enabled parameter");
+    return;
+  }
+
+  bool enabled = webUiServer.arg("enabled").equals("true");
+  setAdaptiveTimeoutsEnabled(enabled);
+  webUiServer.send(200, "text/plain", String("Adaptive timeouts ") + (enabled ? "enabled" : "disabled"));
+}
+
+// Discard the recorded movement history (e.g. after mechanical changes to the roof)
+void handleTelemetryReset() {
+  if (!roofCommandSucceeded(runRoofCommand(CMD_CLEAR_MOVE_HISTORY, SOURCE_WEB))) {
+    webUiServer.send(503, "text/plain", "Roof controller busy - try again");
+    return;
+  }
+  webUiServer.send(200, "text/plain", "Movement history cleared");
+}
+
+static void addLatencyStats(JsonObject obj, const LatencyStats& stats) {
+  obj["samples"] = stats.samples;
+  if (stats.samples > 0) {
+    obj["last"] = stats.lastUs;
+    obj["mean"] = (uint32_t)(stats.totalUs / stats.samples);
+    obj["max"] = stats.maxUs;
+  }
+}
+
+// Per-source command counts and latencies plus the most recent commands (JSON)
+void handleApiCommands() {
+  RequestJsonDocument doc(6144);
+
+  JsonArray sources = doc.createNestedArray("sources");
+  for (int i = 0; i < SOURCE_COUNT; i++) {
+    const CommandSourceStats& stats = getCommandSourceStats((CommandSource)i);
+    JsonObject src = sources.createNestedObject();
+    src["source"] = getCommandSourceString((CommandSource)i);
+    src["commands"] = stats.commands;
+    src["coalesced"] = stats.coalesced;
+    src["rejected"] = stats.rejected;
+    src["preempted"] = stats.preempted;
+    addLatencyStats(src.createNestedObject("queue_us"), stats.queue);
+    addLatencyStats(src.createNestedObject("relay_us"), stats.relay);
+  }
+
+  // STOP from request to relay edge, over every source
+  const AbortLatencyStats& aborts = getAbortLatencyStats();
+  JsonObject abort = doc.createNestedObject("abort_us");
+  addLatencyStats(abort, aborts.latency);
+  abort["bound"] = ABORT_LATENCY_BOUND_US;
+  abort["over_bound"] = aborts.overBound;
+
+  unsigned long now = millis();
+  JsonArray recent = doc.createNestedArray("recent");
+  for (uint8_t i = 0; i < getRoofCommandLogCount(); i++) {
+    const RoofCommandLogEntry& entry = getRoofCommandLogEntry(i);
+    JsonObject cmd = recent.createNestedObject();
+    cmd["id"] = entry.id;
+    cmd["command"] = getRoofCommandTypeString(entry.type);
+    cmd["source"] = getCommandSourceString(entry.source);
+    if (entry.type == CMD_MOVE_TO) cmd["percent"] = entry.arg;
+    cmd["outcome"] = getRoofCommandOutcomeString(entry.outcome);
+    cmd["age_ms"] = now - entry.enqueueMs;
+    if (entry.queueUs != COMMAND_LATENCY_UNSET) cmd["queue_us"] = entry.queueUs;
+    if (entry.relayUs != COMMAND_LATENCY_UNSET) cmd["relay_us"] = entry.relayUs;
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Boot timeline: when each startup stage began and finished, in us since reset (JSON)
+void handleApiBoot() {
+  RequestJsonDocument doc(2048);
+
+  doc["reset_reason"] = lastResetReason;
+  doc["reboot_count"] = rebootCount;
+  doc["complete"] = bootComplete();
+
+  BootStageRecord control = getBootStageRecord(BOOT_CONTROL_TASK);
+  if (control.finished) doc["safety_live_us"] = control.endUs;
+
+  ResumeStats resumeStats = getResumeStats();
+  JsonObject resume = doc.createNestedObject("resume");
+  resume["outcome"] = getResumeOutcomeString(resumeStats.outcome);
+  resume["source"] = getResumeSourceString(resumeStats.source);
+  if (resumeStats.source != RESUME_SOURCE_NONE) {
+    resume["phase"] = getResumePhaseString((ResumePhase)resumeStats.snapshot.phase);
+    resume["target"] = resumeStats.snapshot.target == TARGET_OPEN ? "open" :
+                       resumeStats.snapshot.target == TARGET_CLOSE ? "close" : "none";
+    resume["elapsed_ms"] = resumeStats.snapshot.elapsedMs;
+    resume["position"] = resumeStats.snapshot.position;
+    resume["k1"] = (resumeStats.snapshot.flags & RESUME_FLAG_K1) != 0;
+  }
+  resume["rtc_writes"] = resumeStats.rtcWrites;
+  resume["changes"] = resumeStats.changes;
+  resume["nvs_writes"] = resumeStats.nvsWrites;
+
+  RoofTraceStats traceStats = getRoofTraceStats();
+  JsonObject trace = doc.createNestedObject("trace");
+  trace["entries"] = traceStats.written;
+  trace["retained"] = traceStats.retained;
+  trace["resets_kept"] = traceStats.boots;
+
+  JsonArray stages = doc.createNestedArray("stages");
+  for (int i = 0; i < BOOT_STAGE_COUNT; i++) {
+    BootStageRecord record = getBootStageRecord((BootStage)i);
+    JsonObject stage = stages.createNestedObject();
+    stage["name"] = getBootStageName((BootStage)i);
+    stage["done"] = record.finished;
+    if (record.started) stage["start_us"] = record.startUs;
+    if (record.finished) {
+      stage["end_us"] = record.endUs;
+      stage["duration_us"] = record.endUs - record.startUs;
+    }
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Input sampler: per-channel raw and debounced levels, stable times and change counts (JSON)
+void handleApiInputs() {
+  RequestJsonDocument doc(2048);
+
+  InputSamplerStats sampler = getInputSamplerStats();
+  doc["sample_period_us"] = INPUT_SAMPLE_PERIOD_US;
+  doc["samples"] = sampler.samples;
+  doc["events"] = sampler.events;
+  doc["overflows"] = sampler.overflows;
+  doc["burst_overflows"] = sampler.burstOverflows;
+
+  uint32_t raw = getInputRawMask();
+  uint32_t stable = getInputStableMask();
+  unsigned long now = millis();
+  JsonArray channels = doc.createNestedArray("channels");
+  for (int i = 0; i < INPUT_CHANNEL_COUNT; i++) {
+    InputChannel channel = (InputChannel)i;
+    InputChannelStats stats = getInputChannelStats(channel);
+    JsonObject ch = channels.createNestedObject();
+    ch["name"] = getInputChannelName(channel);
+    ch["pin"] = getInputPin(channel);
+    ch["raw"] = (raw & inputBit(channel)) != 0;
+    ch["active"] = (stable & inputBit(channel)) != 0;
+    ch["stable_ms"] = getInputStableTime(channel);
+    ch["changes"] = stats.changes;
+    ch["glitches"] = stats.glitches;
+    if (stats.changes > 0) ch["last_change_age_ms"] = now - stats.lastChangeMs;
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+static void addSwitchEpoch(JsonObject obj, const SwitchHealthEpoch& epoch) {
+  obj["transitions"] = epoch.transitions;
+  obj["glitches"] = epoch.glitches;
+  obj["mean_bounces"] = epoch.transitions ? (float)epoch.bounces / epoch.transitions : 0;
+  obj["mean_burst_us"] = epoch.transitions ? epoch.burstUs / epoch.transitions : 0;
+  obj["max_burst_us"] = epoch.maxBurstUs;
+}
+
+// Limit switch health: last burst, rolling histograms, per-epoch trend and alert state (JSON)
+void handleApiSwitchHealth() {
+  RequestJsonDocument doc(6144);
+
+  SwitchHealthStats stats = getSwitchHealthStats();
+  doc["epoch_transitions"] = SWITCH_HEALTH_EPOCH_TRANSITIONS;
+  doc["records"] = stats.records;
+  doc["saves"] = stats.saves;
+  doc["last_save_age_ms"] = millis() - stats.lastSaveMs;
+  doc["burst_overflows"] = getInputSamplerStats().burstOverflows;
+
+  JsonArray bounceLabels = doc.createNestedArray("bounce_buckets");
+  for (uint8_t b = 0; b < SWITCH_BOUNCE_BUCKETS; b++) bounceLabels.add(getSwitchBounceBucketLabel(b));
+  JsonArray burstLabels = doc.createNestedArray("burst_buckets");
+  for (uint8_t b = 0; b < SWITCH_BURST_BUCKETS; b++) burstLabels.add(getSwitchBurstBucketLabel(b));
+
+  JsonArray switches = doc.createNestedArray("switches");
+  for (uint8_t i = 0; i < SWITCH_COUNT; i++) {
+    LimitSwitchId id = (LimitSwitchId)i;
+    JsonObject sw = switches.createNestedObject();
+    sw["name"] = getSwitchKey(id);
+    sw["stable_ms"] = getInputStableTime(id == SWITCH_OPEN ? INPUT_LIMIT_OPEN : INPUT_LIMIT_CLOSED);
+
+    SwitchHealthTotals totals = getSwitchHealthTotals(id);
+    sw["transitions"] = totals.transitions;
+    sw["bounces"] = totals.bounces;
+    sw["glitches"] = totals.glitches;
+
+    SwitchHealthTrend trend = getSwitchHealthTrend(id);
+    sw["alert"] = trend.alertReasons != 0;
+    JsonArray reasons = sw.createNestedArray("reasons");
+    for (uint8_t bit = 1; bit != 0 && bit <= SWITCH_ALERT_GLITCHES; bit <<= 1) {
+      if (trend.alertReasons & bit) reasons.add(getSwitchAlertReasonName((SwitchAlertReason)bit));
+    }
+    JsonObject trendObj = sw.createNestedObject("trend");
+    trendObj["recent_transitions"] = trend.recentTransitions;
+    trendObj["recent_glitches"] = trend.recentGlitches;
+    trendObj["recent_mean_bounces"] = trend.recentMean;
+    trendObj["baseline_transitions"] = trend.baselineTransitions;
+    trendObj["baseline_mean_bounces"] = trend.baselineMean;
+
+    const SwitchBounceRecord& last = getLastSwitchBounce(id);
+    if (last.valid) {
+      JsonObject lastObj = sw.createNestedObject("last");
+      lastObj["kind"] = !last.flipped ? "glitch" : (last.active ? "make" : "release");
+      lastObj["edges"] = last.edges;
+      lastObj["bounces"] = last.bounces;
+      lastObj["burst_us"] = last.burstUs;
+      if (last.flipped) lastObj["settle_us"] = last.settleUs;
+      lastObj["age_ms"] = millis() - last.receivedMs;
+    }
+
+    // Histograms summed over the window; the epochs oldest first for the trend
+    uint32_t bounceHist[SWITCH_BOUNCE_BUCKETS] = {0};
+    uint32_t burstHist[SWITCH_BURST_BUCKETS] = {0};
+    JsonArray epochs = sw.createNestedArray("epochs");
+    for (uint8_t e = 0; e < getSwitchHealthEpochCount(id); e++) {
+      const SwitchHealthEpoch& epoch = getSwitchHealthEpoch(id, e);
+      for (uint8_t b = 0; b < SWITCH_BOUNCE_BUCKETS; b++) bounceHist[b] += epoch.bounceHistogram[b];
+      for (uint8_t b = 0; b < SWITCH_BURST_BUCKETS; b++) burstHist[b] += epoch.burstHistogram[b];
+      addSwitchEpoch(epochs.createNestedObject(), epoch);
+    }
+    JsonArray bounceArr = sw.createNestedArray("bounce_histogram");
+    for (uint8_t b = 0; b < SWITCH_BOUNCE_BUCKETS; b++) bounceArr.add(bounceHist[b]);
+    JsonArray burstArr = sw.createNestedArray("burst_histogram");
+    for (uint8_t b = 0; b < SWITCH_BURST_BUCKETS; b++) burstArr.add(burstHist[b]);
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+void handleSwitchHealthReset() {
+  clearSwitchHealth();
+  webUiServer.send(200, "text/plain", "Switch health history cleared");
+}
+
+// Rain auto-close: settings, lockout, counters and edge-to-K2 latency of recent trips (JSON)
+void handleApiRain() {
+  RequestJsonDocument doc(2048);
+
+  RainCloseStats stats = getRainCloseStats();
+  doc["enabled"] = rainAutoCloseEnabled;
+  doc["snow_enabled"] = snowAutoCloseEnabled;
+  doc["holdoff_ms"] = rainHoldoffMs;
+  doc["lockout_ms"] = rainReopenLockoutMs;
+  doc["sensor_stable_ms"] = getInputStableTime(INPUT_RAIN);
+  doc["rain_detected"] = getRoofSnapshot().rainDetected;
+  doc["pending"] = stats.pending;
+  doc["lockout"] = stats.lockout;
+  doc["lockout_remaining_ms"] = stats.lockoutRemainingMs;
+  doc["trips"] = stats.trips;
+  doc["closes"] = stats.closes;
+  doc["stopped_opening"] = stats.stoppedOpening;
+  doc["interlock_waits"] = stats.interlockWaits;
+  doc["cleared"] = stats.cleared;
+  doc["lockout_rejects"] = stats.lockoutRejects;
+
+  JsonObject latency = doc.createNestedObject("edge_to_k2_us");
+  latency["count"] = stats.latencySamples;
+  if (stats.latencySamples > 0) {
+    latency["last"] = stats.lastEdgeToK2Us;
+    latency["max"] = stats.maxEdgeToK2Us;
+    latency["mean"] = (uint32_t)(stats.totalEdgeToK2Us / stats.latencySamples);
+  }
+
+  unsigned long now = millis();
+  JsonArray trips = doc.createNestedArray("recent");
+  for (uint8_t i = 0; i < getRainTripCount(); i++) {
+    const RainTripRecord& record = getRainTrip(i);
+    JsonObject trip = trips.createNestedObject();
+    trip["age_ms"] = now - record.tripMs;
+    trip["source"] = getWeatherTripSourceString(record.source);
+    trip["outcome"] = getRainTripOutcomeString(record.outcome);
+    trip["stopped_opening"] = record.stoppedOpening;
+    if (record.edgeToK2Us != RAIN_LATENCY_UNSET) {
+      trip["edge_to_k2_us"] = record.edgeToK2Us;
+      trip["waited_ms"] = record.waitedMs;
+    }
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Roof encoder position, velocity, calibration and part-open target (JSON)
+void handleApiEncoder() {
+  RequestJsonDocument doc(1024);
+
+  RoofEncoderStats stats = getRoofEncoderStats();
+  doc["pin_a"] = ENCODER_PIN_A;
+  doc["pin_b"] = ENCODER_PIN_B;
+  doc["configured"] = stats.configured;
+  doc["referenced"] = stats.referenced;
+  doc["calibrated"] = stats.calibrated;
+  doc["count"] = stats.count;
+  if (stats.referenced) doc["closed_count"] = stats.closedCount;
+  doc["span"] = stats.span;
+  doc["span_updates"] = stats.spanUpdates;
+  doc["wraps"] = stats.wraps;
+  if (stats.calibrated) {
+    doc["position"] = stats.position;
+    doc["percent_per_second"] = stats.percentPerSecond;
+  }
+  doc["counts_per_second"] = stats.countsPerSecond;
+  doc["last_direction"] = stats.lastDirection > 0 ? "opening" : (stats.lastDirection < 0 ? "closing" : "none");
+  doc["stalls"] = stats.stalls;
+  doc["stall_ms"] = ENCODER_STALL_MS;
+
+  JsonObject target = doc.createNestedObject("target");
+  if (stats.target >= 0) target["percent"] = stats.target;
+  target["holding"] = stats.holding;
+  target["stops"] = stats.targetStops;
+  target["last_error"] = stats.lastTargetError;
+  target["tolerance"] = ENCODER_TARGET_TOLERANCE;
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+static void addCurrentBins(JsonArray bins, const uint16_t* rms, uint8_t count) {
+  for (uint8_t b = 0; b < count; b++) {
+    bins.add(rms[b]);
+  }
+}
+
+// Motor current: live RMS, the learned envelopes and recent run profiles (JSON, ADC counts)
+void handleApiCurrent() {
+  RequestJsonDocument doc(16384);
+
+  MotorCurrentStats stats = getMotorCurrentStats();
+  doc["pin"] = MOTOR_CURRENT_PIN;
+  doc["configured"] = stats.configured;
+  doc["sample_hz"] = MOTOR_CURRENT_SAMPLE_HZ;
+  doc["bin_ms"] = MOTOR_CURRENT_BIN_MS;
+  doc["zero"] = stats.zero;
+  doc["rms"] = stats.rms;
+  doc["monitoring"] = stats.monitoring;
+  if (stats.monitoring) doc["threshold"] = stats.threshold;
+  doc["samples"] = stats.samples;
+  doc["pool_overflows"] = stats.overflows;
+  doc["trips"] = stats.trips;
+  if (stats.trips > 0) {
+    doc["last_trip_rms"] = stats.lastTripRms;
+    doc["last_trip_threshold"] = stats.lastTripThreshold;
+  }
+  doc["envelope_saves"] = stats.envelopeSaves;
+
+  JsonObject envelopes = doc.createNestedObject("envelopes");
+  static const MoveDirection dirs[] = {MOVE_OPEN, MOVE_CLOSE};
+  for (MoveDirection d : dirs) {
+    const MotorCurrentEnvelope& envelope = getMotorCurrentEnvelope(d);
+    JsonObject obj = envelopes.createNestedObject(d == MOVE_OPEN ? "open" : "close");
+    obj["moves"] = envelope.moves;
+    obj["armed"] = envelope.moves >= MOTOR_CURRENT_MIN_MOVES;
+    obj["steady_max"] = envelope.steadyMax;
+    addCurrentBins(obj.createNestedArray("rms"), envelope.rms, envelope.bins);
+  }
+
+  // Newest first; bins only with ?bins=1 (a full run is 160 numbers)
+  bool withBins = webUiServer.hasArg("bins") && webUiServer.arg("bins").equals("1");
+  JsonArray profiles = doc.createNestedArray("profiles");
+  for (int i = getMotorCurrentProfileCount() - 1; i >= 0; i--) {
+    const MotorCurrentProfile& profile = getMotorCurrentProfile((uint8_t)i);
+    JsonObject obj = profiles.createNestedObject();
+    if (profile.sequence != 0) obj["sequence"] = profile.sequence;
+    obj["direction"] = profile.direction == MOVE_OPEN ? "open" : "close";
+    obj["outcome"] = profile.outcome == 0xFF ? "discarded" : getMoveOutcomeString(profile.outcome);
+    obj["from_limit"] = profile.fromLimit;
+    obj["duration_ms"] = profile.durationMs;
+    obj["inrush_peak"] = profile.inrushPeak;
+    obj["inrush_peak_ms"] = profile.inrushPeakMs;
+    obj["running_rms"] = profile.runningRms;
+    obj["max_rms"] = profile.maxRms;
+    if (withBins) addCurrentBins(obj.createNestedArray("rms"), profile.rms, profile.bins);
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Per-subsystem cycle-time histograms for the network loop and control step (JSON)
+void handleApiPerf() {
+  RequestJsonDocument doc(16384);
+
+  doc["cpu_mhz"] = ESP.getCpuFreqMHz();
+  doc["window_ms"] = perfStatsAgeMs();
+  doc["mqtt_publish"] = perfMqttEnabled;
+
+  RequestArenaStats arena = getRequestArenaStats();
+  JsonObject arenaObj = doc.createNestedObject("request_arena");
+  arenaObj["size"] = arena.size;
+  arenaObj["high_water"] = arena.highWater;
+  arenaObj["requests"] = arena.requests;
+  arenaObj["overflows"] = arena.overflows;
+  arenaObj["overflow_max_bytes"] = arena.overflowBytes;
+  arenaObj["leaks"] = arena.leaks;
+  arenaObj["heap_leaks"] = arena.heapLeaks;
+
+  unsigned long now = millis();
+  JsonArray sections = doc.createNestedArray("sections");
+  for (int i = 0; i < PERF_SECTION_COUNT; i++) {
+    PerfHistogram hist = getPerfHistogram((PerfSection)i);
+    JsonObject section = sections.createNestedObject();
+    section["name"] = getPerfSectionName((PerfSection)i);
+    section["task"] = getPerfSectionTask((PerfSection)i);
+    section["count"] = hist.count;
+    if (hist.count == 0) continue;
+
+    section["min_us"] = hist.minUs;
+    section["avg_us"] = (uint32_t)(hist.totalUs / hist.count);
+    section["p99_us"] = getPerfPercentileUs(hist, 99);
+    section["max_us"] = hist.maxUs;
+
+    // Bucket i counts samples in [2^(i-1), 2^i) us
+    JsonArray buckets = section.createNestedArray("buckets");
+    for (uint8_t b = 0; b < PERF_HISTOGRAM_BUCKETS; b++) {
+      buckets.add(hist.buckets[b]);
+    }
+
+    JsonArray worst = section.createNestedArray("worst");
+    for (uint8_t w = 0; w < PERF_WORST_COUNT && hist.worst[w].us > 0; w++) {
+      JsonObject sample = worst.createNestedObject();
+      sample["us"] = hist.worst[w].us;
+      sample["uptime_ms"] = hist.worst[w].atMs;
+      sample["age_ms"] = now - hist.worst[w].atMs;
+    }
+  }
+
+  sendJsonResponse(webUiServer, 200, doc);
+}
+
+// Trace recorder download: RoofTraceHeader, then the entries oldest first.
+// Entries added during the download are left for the next one; if the
+// control task overwrites an entry before it is sent, the file ends there
+// instead of skipping over the gap.
+void handleApiTrace() {
+  uint32_t next = getRoofTraceStart();
+  uint32_t end = getRoofTraceEnd();
+  RoofTraceHeader header;
+  fillRoofTraceHeader(header, next);
+
+  webUiServer.setContentLength(CONTENT_LENGTH_UNKNOWN);
+  webUiServer.sendHeader("Content-Disposition", "attachment; filename=\"roof_trace.bin\"");
+  webUiServer.send(200, "application/octet-stream", "");
+  webUiServer.sendContent((const char*)&header, sizeof(header));
+
+  RoofTraceEntry chunk[TRACE_DOWNLOAD_CHUNK];
+  while (next != end) {
+    uint32_t count = end - next < TRACE_DOWNLOAD_CHUNK ? end - next : TRACE_DOWNLOAD_CHUNK;
+    count = copyRoofTraceEntries(next, chunk, count);
+    if (count == 0) break;
+    webUiServer.sendContent((const char*)chunk, count * sizeof(RoofTraceEntry));
+    next += count;
+  }
+  webUiServer.sendContent("");
+}
+
+void handleTraceClear() {
+  requestRoofTraceClear();
+  webUiServer.send(200, "text/plain", "Trace cleared");
+}
+
+// Clear the loop profiler histograms
+void handlePerfReset() {
+  resetPerfStats();
+  webUiServer.send(200, "text/plain", "Loop profile reset");
+}
+
+// Enable/disable publishing the loop profile summary to MQTT
+void handlePerfMqtt() {
+  if (!webUiServer.hasArg("enabled")) {
+    webUiServer.send(400, "text/plain", "Missing enabled parameter");
+    return;
+  }
+
+  bool enabled = webUiServer.arg("enabled").equals("true");
+  setPerfMqttEnabled(enabled);
+  webUiServer.send(200, "text/plain", "Loop profile MQTT publishing " + String(enabled ? "enabled" : "disabled"));
+}
+
+// Set how often the position is published to MQTT while the roof is moving
+void handlePositionRate() {
+  if (!webUiServer.hasArg("interval_ms")) {
+    webUiServer.send(400, "text/plain", "Missing interval_ms parameter");
+    return;
+  }
+
+  long intervalMs = webUiServer.arg("interval_ms").toInt();
+  if (intervalMs < 0 || intervalMs > 10000) {
+    webUiServer.send(400, "text/plain", "interval_ms must be 0-10000");
+    return;
+  }
+
+  setPositionPublishInterval((unsigned long)intervalMs);
+  webUiServer.send(200, "text/plain", "Position publish interval set to " + String(intervalMs) + " ms");
 }
 
 // ========== GPS CONTROL HANDLERS ==========
@@ -1162,7 +2180,7 @@ void handleGPSStatus() {
   GPSStatus status = getGPSStatus();
   TimeSource ts = getTimeSource();
 
-  DynamicJsonDocument doc(1024);
+  RequestJsonDocument doc(1024);
 
   // Time status
   doc["time_synced"] = timeSynced;
@@ -1199,10 +2217,7 @@ void handleGPSStatus() {
   doc["pps_count"] = getPPSCount();
   doc["pps_pin"] = gpsPpsPin;
 
-  String jsonResponse;
-  serializeJson(doc, jsonResponse);
-
-  webUiServer.send(200, "application/json", jsonResponse);
+  sendJsonResponse(webUiServer, 200, doc);
 }
 
 // Handler for setting timezone offset
@@ -54,17 +54,38 @@ void handleParkSensorType();
 // Inverter control handlers (NEW in v3)
 void handleInverterToggle();         // Toggle K1 inverter power relay
 void handleInverterButton();         // Send K3 soft-power button press
+void handleInverterPrewarm();        // Pre-warm the inverter ahead of an open
 void handleInverterStatus();         // Get inverter power states (JSON)
 
 // Roof control handlers
 void handleRoofControl();            // Handle roof open/close/stop commands
 void handleRoofButton();             // Handle single roof button press (mimics physical button)
 void handleRoofOpenClose();          // Handle intelligent open/close (replicates ASCOM/MQTT logic)
+void handleRoofTarget();             // Run the roof to a part-open position (encoder)
 void handleClearError();             // Clear error state and re-check limit switches
 
 // API endpoint for real-time status updates
 void handleApiStatus();              // Return JSON status for AJAX polling
 
+// Movement telemetry handlers
+void handleApiTelemetry();           // Movement history and statistics (JSON)
+void handleTelemetryAdaptive();      // Enable/disable adaptive timeouts
+void handleTelemetryReset();         // Clear movement history
+void handlePositionRate();           // Set MQTT position publish interval
+void handleApiCommands();            // Command arbitration counts and latencies (JSON)
+void handleApiBoot();                // Boot stage timeline (JSON)
+void handleApiInputs();              // Input sampler channel states (JSON)
+void handleApiSwitchHealth();        // Limit switch bounce histograms and wear trend (JSON)
+void handleSwitchHealthReset();      // Clear the limit switch health history
+void handleApiRain();                // Rain auto-close state and trip latencies (JSON)
+void handleApiEncoder();             // Roof encoder position, calibration and target (JSON)
+void handleApiCurrent();             // Motor current, learned envelopes and run profiles (JSON)
+void handleApiPerf();                // Loop profiler histograms (JSON)
+void handlePerfReset();              // Clear loop profiler histograms
+void handlePerfMqtt();               // Toggle loop profile MQTT publishing
+void handleApiTrace();               // Trace recorder download (binary, see roof_trace.h)
+void handleTraceClear();             // Empty the trace recorder
+
 // GPS control handlers
 void handleGPSEnabled();             // Enable/disable GPS module
 void handleGPSNtpEnabled();          // Enable/disable NTP server
@@ -0,0 +1,219 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Minimal Arduino API for Linux builds
+ *
+ * Only the subset of the Arduino core used by the roof control path is
+ * provided. GPIO and time are virtual and driven by sim_hal.cpp.
+ */
+
+#ifndef SIM_ARDUINO_H
+#define SIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT          0x01
+#define OUTPUT         0x03
+#define INPUT_PULLUP   0x05
+#define INPUT_PULLDOWN 0x09
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define HEX 16
+#define DEC 10
+
+#define IRAM_ATTR
+// RTC slow memory: kept in its own section so the sim can lose it (simLoseRtcMemory())
+#define RTC_NOINIT_ATTR __attribute__((section("sim_rtc_noinit")))
+// Main RAM kept across resets: a simulated reset never clears memory anyway
+#define __NOINIT_ATTR
+#define F(s) (s)
+
+#define digitalPinToInterrupt(p) (p)
+
+// ---------------------------------------------------------------------------
+// Virtual GPIO and time (implemented in sim_hal.cpp)
+// ---------------------------------------------------------------------------
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+unsigned long millis();
+unsigned long micros();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode);
+void detachInterrupt(uint8_t pin);
+
+// ESP: the cycle counter runs on the host clock (scaled to 240 MHz) so the
+// loop profiler measures real host execution time, not simulated time
+class EspClass {
+public:
+  uint32_t getCycleCount();
+  uint32_t getCpuFreqMHz() { return 240; }
+  [[noreturn]] void restart() { abort(); }
+};
+extern EspClass ESP;
+
+// ---------------------------------------------------------------------------
+// String - thin wrapper over std::string with the Arduino method names
+// ---------------------------------------------------------------------------
+class String {
+public:
+  String() {}
+  String(const char* s) : s_(s ? s : "") {}
+  String(const std::string& s) : s_(s) {}
+  String(char c) : s_(1, c) {}
+  String(bool b) : s_(b ? "1" : "0") {}
+  String(int v, int base = DEC) { fromLong(v, base); }
+  String(unsigned int v, int base = DEC) { fromULong(v, base); }
+  String(long v, int base = DEC) { fromLong(v, base); }
+  String(unsigned long v, int base = DEC) { fromULong(v, base); }
+  String(float v, int decimals = 2) { fromDouble(v, decimals); }
+  String(double v, int decimals = 2) { fromDouble(v, decimals); }
+
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  const char* c_str() const { return s_.c_str(); }
+  int indexOf(const char* needle) const {
+    size_t p = s_.find(needle);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  int indexOf(const String& needle) const { return indexOf(needle.c_str()); }
+  int indexOf(char c) const {
+    size_t p = s_.find(c);
+    return p == std::string::npos ? -1 : (int)p;
+  }
+  bool startsWith(const String& p) const { return s_.compare(0, p.s_.size(), p.s_) == 0; }
+  bool endsWith(const String& p) const {
+    return s_.size() >= p.s_.size() && s_.compare(s_.size() - p.s_.size(), p.s_.size(), p.s_) == 0;
+  }
+  String substring(unsigned int from) const { return from < s_.size() ? String(s_.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const {
+    if (from >= s_.size() || to <= from) return String();
+    return String(s_.substr(from, to - from));
+  }
+  bool equals(const String& o) const { return s_ == o.s_; }
+  bool equalsIgnoreCase(const String& o) const { return strcasecmp(s_.c_str(), o.s_.c_str()) == 0; }
+  long toInt() const { return strtol(s_.c_str(), nullptr, 10); }
+  void trim() {
+    size_t b = s_.find_first_not_of(" \t\r\n");
+    size_t e = s_.find_last_not_of(" \t\r\n");
+    s_ = (b == std::string::npos) ? std::string() : s_.substr(b, e - b + 1);
+  }
+  void toCharArray(char* buf, unsigned int size) const {
+    if (size == 0) return;
+    strncpy(buf, s_.c_str(), size - 1);
+    buf[size - 1] = '\0';
+  }
+
+  String& operator+=(const String& o) { s_ += o.s_; return *this; }
+  String& operator+=(const char* o) { s_ += o; return *this; }
+  String& operator+=(char c) { s_ += c; return *this; }
+  bool operator==(const String& o) const { return s_ == o.s_; }
+  bool operator==(const char* o) const { return s_ == o; }
+  bool operator!=(const String& o) const { return s_ != o.s_; }
+  bool operator<(const String& o) const { return s_ < o.s_; }
+
+  friend String operator+(const String& a, const String& b) { return String(a.s_ + b.s_); }
+  friend String operator+(const String& a, const char* b) { return String(a.s_ + b); }
+  friend String operator+(const char* a, const String& b) { return String(a + b.s_); }
+
+private:
+  std::string s_;
+
+  void fromLong(long v, int base) {
+    if (base == DEC) { s_ = std::to_string(v); return; }
+    fromULong((unsigned long)v, base);
+  }
+  void fromULong(unsigned long v, int base) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", v);
+    s_ = buf;
+  }
+  void fromDouble(double v, int decimals) {
+    char buf[48];
+    snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    s_ = buf;
+  }
+};
+
+// ---------------------------------------------------------------------------
+// Print / Serial - output is discarded unless the simulator enables echo
+// ---------------------------------------------------------------------------
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t* buffer, size_t size) {
+    size_t n = 0;
+    while (size--) n += write(*buffer++);
+    return n;
+  }
+};
+
+class SimSerial : public Print {
+public:
+  bool echo = false;
+
+  void begin(unsigned long) {}
+  explicit operator bool() const { return true; }
+
+  size_t write(uint8_t c) override {
+    if (echo) fputc(c, stdout);
+    return 1;
+  }
+
+  size_t print(const String& s) { return out(s.c_str()); }
+  size_t print(const char* s) { return out(s); }
+  size_t print(char c) { char b[2] = {c, 0}; return out(b); }
+  size_t print(int v) { return outf("%d", v); }
+  size_t print(unsigned int v) { return outf("%u", v); }
+  size_t print(long v) { return outf("%ld", v); }
+  size_t print(unsigned long v) { return outf("%lu", v); }
+  size_t print(double v) { return outf("%.2f", v); }
+
+  template <typename T>
+  size_t println(T v) { size_t n = print(v); return n + out("\n"); }
+  size_t println() { return out("\n"); }
+
+  size_t printf(const char* fmt, ...) {
+    if (!echo) return 0;
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n > 0 ? (size_t)n : 0;
+  }
+
+private:
+  size_t out(const char* s) {
+    if (echo) fputs(s, stdout);
+    return strlen(s);
+  }
+  size_t outf(const char* fmt, ...) {
+    if (!echo) return 0;
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n > 0 ? (size_t)n : 0;
+  }
+};
+
+extern SimSerial Serial;
+
+#include "HardwareSerial.h"
+
+#endif // SIM_ARDUINO_H
@@ -0,0 +1,12 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - ArduinoJson placeholder
+ *
+ * JSON is only built at the network boundary, which the simulator does not
+ * compile. This header exists so shared headers can be included unchanged.
+ */
+
+#ifndef SIM_ARDUINOJSON_H
+#define SIM_ARDUINOJSON_H
+
+#endif // SIM_ARDUINOJSON_H
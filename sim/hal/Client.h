@@ -0,0 +1,20 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Client placeholder
+ */
+
+#ifndef SIM_CLIENT_H
+#define SIM_CLIENT_H
+
+#include "Stream.h"
+#include "IPAddress.h"
+
+class Client : public Stream {
+public:
+  virtual int connect(IPAddress ip, uint16_t port) = 0;
+  virtual int connect(const char* host, uint16_t port) = 0;
+  virtual void stop() = 0;
+  virtual uint8_t connected() = 0;
+};
+
+#endif // SIM_CLIENT_H
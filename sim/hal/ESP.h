@@ -0,0 +1,11 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - ESP placeholder
+ */
+
+#ifndef SIM_ESP_H
+#define SIM_ESP_H
+
+#include <Arduino.h>
+
+#endif // SIM_ESP_H
@@ -0,0 +1,81 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - HardwareSerial on the virtual clock
+ *
+ * Bytes take one character time each on the wire. Written bytes reach the
+ * attached peer (see sim_hal.h) as they finish; bytes the peer sends land in
+ * the RX FIFO as they finish, and the onReceive callback fires once the line
+ * has been idle for the configured RX timeout, as the ESP32 UART does. In
+ * RS485 half-duplex mode the RTS pin is driven high while transmitting.
+ */
+
+#ifndef SIM_HARDWARE_SERIAL_H
+#define SIM_HARDWARE_SERIAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <functional>
+
+#define SERIAL_8N1 0x800001c
+
+typedef enum {
+  UART_MODE_UART,
+  UART_MODE_RS485_HALF_DUPLEX
+} SerialMode;
+
+typedef enum {
+  UART_NO_ERROR,
+  UART_BREAK_ERROR,
+  UART_BUFFER_FULL_ERROR,
+  UART_FIFO_OVF_ERROR,
+  UART_FRAME_ERROR,
+  UART_PARITY_ERROR
+} hardwareSerial_error_t;
+
+typedef std::function<void(void)> OnReceiveCb;
+typedef std::function<void(hardwareSerial_error_t)> OnReceiveErrorCb;
+
+class HardwareSerial {
+public:
+  explicit HardwareSerial(uint8_t uartNum) : uartNum_(uartNum) {}
+
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1, int8_t rxPin = -1, int8_t txPin = -1);
+  void end();
+  bool setPins(int8_t rxPin, int8_t txPin, int8_t ctsPin = -1, int8_t rtsPin = -1);
+  bool setMode(SerialMode mode);
+  bool setRxTimeout(uint8_t symbols);
+  void onReceive(OnReceiveCb function, bool onlyOnTimeout = false);
+  void onReceiveError(OnReceiveErrorCb function);
+
+  int available();
+  int read();
+  size_t read(uint8_t* buffer, size_t size);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t* buffer, size_t size);
+
+  // ---- Simulator side (sim_hal.cpp) ----
+  struct TimedByte {
+    uint64_t doneUs;          // When the last bit is on the wire
+    uint8_t value;
+  };
+
+  uint8_t uartNum_;
+  bool started_ = false;
+  unsigned long baud_ = 0;
+  uint64_t charUs_ = 0;
+  SerialMode mode_ = UART_MODE_UART;
+  int rtsPin_ = -1;
+  uint8_t rxTimeoutSymbols_ = 2;
+  OnReceiveCb onReceive_;
+  OnReceiveErrorCb onReceiveError_;
+
+  std::deque<TimedByte> tx_;  // Host to peer, still on the wire
+  std::deque<TimedByte> rx_;  // Peer to host, still on the wire
+  std::deque<uint8_t> rxFifo_;
+  uint64_t txBusyUntilUs_ = 0;
+  uint64_t rxBusyUntilUs_ = 0;
+  uint64_t rxIdleEventUs_ = 0; // RX timeout due (0 = none armed)
+};
+
+#endif // SIM_HARDWARE_SERIAL_H
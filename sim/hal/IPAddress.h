@@ -0,0 +1,27 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - IPAddress placeholder
+ */
+
+#ifndef SIM_IPADDRESS_H
+#define SIM_IPADDRESS_H
+
+#include <Arduino.h>
+
+class IPAddress {
+public:
+  IPAddress() : addr_(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d)
+    : addr_((uint32_t)a | ((uint32_t)b << 8) | ((uint32_t)c << 16) | ((uint32_t)d << 24)) {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", addr_ & 0xFF, (addr_ >> 8) & 0xFF,
+             (addr_ >> 16) & 0xFF, (addr_ >> 24) & 0xFF);
+    return String(buf);
+  }
+
+private:
+  uint32_t addr_;
+};
+
+#endif // SIM_IPADDRESS_H
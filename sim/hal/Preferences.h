@@ -0,0 +1,109 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - In-memory NVS Preferences
+ *
+ * Same API shape as the ESP32 Preferences library for the calls the firmware
+ * uses. Values live in a process-wide map keyed by namespace and key, so they
+ * survive a simulated reboot within one run.
+ */
+
+#ifndef SIM_PREFERENCES_H
+#define SIM_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences {
+public:
+  bool begin(const char* name, bool readOnly = false) {
+    ns_ = name ? name : "";
+    readOnly_ = readOnly;
+    open_ = true;
+    return true;
+  }
+  void end() { open_ = false; }
+
+  bool isKey(const char* key) { return store().count(fullKey(key)) != 0; }
+  bool remove(const char* key) { return !readOnly_ && store().erase(fullKey(key)) != 0; }
+  bool clear() {
+    if (readOnly_) return false;
+    std::string prefix = ns_ + "/";
+    for (auto it = store().begin(); it != store().end();) {
+      if (it->first.compare(0, prefix.size(), prefix) == 0) it = store().erase(it);
+      else ++it;
+    }
+    return true;
+  }
+
+  size_t putBool(const char* key, bool v) { return putValue(key, v); }
+  size_t putInt(const char* key, int32_t v) { return putValue(key, v); }
+  size_t putUInt(const char* key, uint32_t v) { return putValue(key, v); }
+  size_t putShort(const char* key, int16_t v) { return putValue(key, v); }
+  size_t putUShort(const char* key, uint16_t v) { return putValue(key, v); }
+  size_t putULong(const char* key, unsigned long v) { return putValue(key, (uint32_t)v); }
+  size_t putLong(const char* key, long v) { return putValue(key, (int32_t)v); }
+  size_t putString(const char* key, const String& v) { return putBytes(key, v.c_str(), v.length() + 1); }
+  size_t putBytes(const char* key, const void* data, size_t len) {
+    if (!open_ || readOnly_) return 0;
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    store()[fullKey(key)] = std::vector<uint8_t>(p, p + len);
+    writes()++;
+    return len;
+  }
+
+  bool getBool(const char* key, bool def = false) { return getValue(key, def); }
+  int32_t getInt(const char* key, int32_t def = 0) { return getValue(key, def); }
+  uint32_t getUInt(const char* key, uint32_t def = 0) { return getValue(key, def); }
+  int16_t getShort(const char* key, int16_t def = 0) { return getValue(key, def); }
+  uint16_t getUShort(const char* key, uint16_t def = 0) { return getValue(key, def); }
+  unsigned long getULong(const char* key, unsigned long def = 0) { return getValue(key, (uint32_t)def); }
+  long getLong(const char* key, long def = 0) { return getValue(key, (int32_t)def); }
+  String getString(const char* key, const String& def = String()) {
+    auto it = store().find(fullKey(key));
+    if (it == store().end() || it->second.empty()) return def;
+    return String(reinterpret_cast<const char*>(it->second.data()));
+  }
+  size_t getBytesLength(const char* key) {
+    auto it = store().find(fullKey(key));
+    return it == store().end() ? 0 : it->second.size();
+  }
+  size_t getBytes(const char* key, void* buf, size_t maxLen) {
+    auto it = store().find(fullKey(key));
+    if (it == store().end() || it->second.size() > maxLen) return 0;
+    memcpy(buf, it->second.data(), it->second.size());
+    return it->second.size();
+  }
+
+  // Total number of put operations across all instances (flash write proxy)
+  static unsigned long& writes() {
+    static unsigned long count = 0;
+    return count;
+  }
+
+private:
+  std::string ns_;
+  bool readOnly_ = false;
+  bool open_ = false;
+
+  static std::map<std::string, std::vector<uint8_t>>& store() {
+    static std::map<std::string, std::vector<uint8_t>> s;
+    return s;
+  }
+  std::string fullKey(const char* key) const { return ns_ + "/" + (key ? key : ""); }
+
+  template <typename T>
+  size_t putValue(const char* key, T v) { return putBytes(key, &v, sizeof(v)); }
+
+  template <typename T>
+  T getValue(const char* key, T def) {
+    auto it = store().find(fullKey(key));
+    if (it == store().end() || it->second.size() != sizeof(T)) return def;
+    T v;
+    memcpy(&v, it->second.data(), sizeof(T));
+    return v;
+  }
+};
+
+#endif // SIM_PREFERENCES_H
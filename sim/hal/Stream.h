@@ -0,0 +1,18 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Stream placeholder
+ */
+
+#ifndef SIM_STREAM_H
+#define SIM_STREAM_H
+
+#include <Arduino.h>
+
+class Stream : public Print {
+public:
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+};
+
+#endif // SIM_STREAM_H
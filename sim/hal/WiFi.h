@@ -0,0 +1,13 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - WiFi placeholder (declarations only, never linked)
+ */
+
+#ifndef SIM_WIFI_H
+#define SIM_WIFI_H
+
+#include "Client.h"
+
+class WiFiClient;
+
+#endif // SIM_WIFI_H
@@ -0,0 +1,13 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - WiFiUDP placeholder (declarations only, never linked)
+ */
+
+#ifndef SIM_WIFIUDP_H
+#define SIM_WIFIUDP_H
+
+#include "IPAddress.h"
+
+class WiFiUDP;
+
+#endif // SIM_WIFIUDP_H
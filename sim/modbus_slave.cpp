@@ -0,0 +1,119 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Modbus RTU slave Implementation
+ */
+
+#include "modbus_slave.h"
+#include "modbus_rtu.h"
+
+static const size_t REQUEST_SIZE = 8;
+
+SimModbusSlave::SimModbusSlave(HardwareSerial& serial, uint8_t address)
+    : serial_(serial), address_(address), turnaroundUs_(5000), fault_(MODBUS_FAULT_NONE),
+      faultCount_(0), online_(true), length_(0), lastByteUs_(0), busIdleFromUs_(0), stats_{} {
+  memset(registers_, 0, sizeof(registers_));
+  simUartAttachPeer(serial, this);
+}
+
+void SimModbusSlave::setRegister(uint16_t index, uint16_t value) {
+  if (index < REGISTER_COUNT) registers_[index] = value;
+}
+
+uint16_t SimModbusSlave::getRegister(uint16_t index) const {
+  return index < REGISTER_COUNT ? registers_[index] : 0;
+}
+
+void SimModbusSlave::setFault(SimModbusFault fault, uint32_t count) {
+  fault_ = fault;
+  faultCount_ = count;
+}
+
+void SimModbusSlave::onHostByte(uint8_t value, uint64_t doneUs) {
+  uint64_t charUs = serial_.charUs_;
+  uint64_t gapUs = serial_.baud_ > 19200 ? 1750 : (charUs * 7 + 1) / 2;
+
+  if (length_ == 0) {
+    // First character: its start bit must come T3.5 after the last activity
+    uint64_t startUs = doneUs - charUs;
+    if (busIdleFromUs_ != 0 && startUs < busIdleFromUs_ + gapUs) {
+      stats_.gapViolations++;
+    }
+  } else if (doneUs - lastByteUs_ > charUs + (charUs * 3 + 1) / 2) {
+    stats_.charGapViolations++;
+  }
+
+  if (length_ < FRAME_MAX) frame_[length_++] = value;
+  lastByteUs_ = doneUs;
+  busIdleFromUs_ = doneUs;
+
+  // Only fixed-length read requests are spoken here, so a frame ends at 8 bytes
+  if (length_ >= REQUEST_SIZE) {
+    handleFrame(doneUs);
+    length_ = 0;
+  }
+}
+
+void SimModbusSlave::handleFrame(uint64_t doneUs) {
+  stats_.lastRequestUs = doneUs;
+  uint16_t crc = (uint16_t)frame_[6] | ((uint16_t)frame_[7] << 8);
+  if (modbusCrc16(frame_, 6) != crc) {
+    stats_.badRequests++;
+    return;
+  }
+  if (frame_[0] != address_ || !online_) {
+    return;
+  }
+  if (frame_[1] != 0x03 && frame_[1] != 0x04) {
+    stats_.badRequests++;
+    return;
+  }
+  stats_.requests++;
+
+  SimModbusFault fault = fault_;
+  if (fault != MODBUS_FAULT_NONE && faultCount_ > 0 && --faultCount_ == 0) {
+    fault_ = MODBUS_FAULT_NONE;
+  }
+  if (fault == MODBUS_FAULT_SILENT) {
+    return;
+  }
+
+  uint64_t startUs = doneUs + turnaroundUs_;
+  uint8_t out[FRAME_MAX];
+  size_t length;
+  if (fault == MODBUS_FAULT_EXCEPTION) {
+    out[0] = address_;
+    out[1] = frame_[1] | 0x80;
+    out[2] = 0x04;
+    length = 3;
+  } else {
+    uint16_t start = ((uint16_t)frame_[2] << 8) | frame_[3];
+    uint16_t count = ((uint16_t)frame_[4] << 8) | frame_[5];
+    if (count == 0 || count > (FRAME_MAX - 5) / 2) {
+      stats_.badRequests++;
+      return;
+    }
+    out[0] = address_;
+    out[1] = frame_[1];
+    out[2] = (uint8_t)(count * 2);
+    for (uint16_t i = 0; i < count; i++) {
+      uint16_t value = getRegister(start + i);
+      out[3 + 2 * i] = value >> 8;
+      out[4 + 2 * i] = value & 0xFF;
+    }
+    length = 3 + count * 2;
+  }
+  uint16_t replyCrc = modbusCrc16(out, length);
+  if (fault == MODBUS_FAULT_BAD_CRC) replyCrc ^= 0x5A5A;
+  out[length++] = replyCrc & 0xFF;
+  out[length++] = replyCrc >> 8;
+  reply(out, length, startUs);
+  if (fault == MODBUS_FAULT_LINE_ERROR) {
+    simUartRaiseError(serial_, UART_FRAME_ERROR);
+  }
+}
+
+void SimModbusSlave::reply(const uint8_t* frame, size_t length, uint64_t startUs) {
+  simUartSend(serial_, frame, length, startUs);
+  busIdleFromUs_ = startUs + length * serial_.charUs_;
+  stats_.replies++;
+}
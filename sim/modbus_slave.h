@@ -0,0 +1,68 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Modbus RTU slave (RS485 snow sensor)
+ *
+ * Sits on the far end of a simulated UART and answers read-holding-register
+ * requests after a turnaround delay. It checks the master's framing the way
+ * a strict slave would: a frame must start at least T3.5 after the previous
+ * bus activity and its characters must not be more than T1.5 apart. Faults
+ * can be injected per reply.
+ */
+
+#ifndef MODBUS_SLAVE_H
+#define MODBUS_SLAVE_H
+
+#include "sim_hal.h"
+
+enum SimModbusFault : uint8_t {
+  MODBUS_FAULT_NONE,
+  MODBUS_FAULT_SILENT,        // No reply
+  MODBUS_FAULT_BAD_CRC,       // Reply with a corrupted CRC
+  MODBUS_FAULT_EXCEPTION,     // Exception 0x04 (slave device failure)
+  MODBUS_FAULT_LINE_ERROR     // Reply, plus a framing error reported to the host
+};
+
+struct SimModbusSlaveStats {
+  uint32_t requests;          // Well-formed requests addressed to this slave
+  uint32_t replies;
+  uint32_t badRequests;       // Wrong CRC, length or function
+  uint32_t gapViolations;     // Frame started inside T3.5 of the previous activity
+  uint32_t charGapViolations; // Characters more than T1.5 apart inside a frame
+  uint64_t lastRequestUs;     // When the last request finished on the wire
+};
+
+class SimModbusSlave : public SimUartPeer {
+public:
+  SimModbusSlave(HardwareSerial& serial, uint8_t address);
+
+  void setRegister(uint16_t index, uint16_t value);
+  uint16_t getRegister(uint16_t index) const;
+  void setTurnaroundUs(uint32_t us) { turnaroundUs_ = us; }
+  void setFault(SimModbusFault fault, uint32_t count = 1);  // Next count replies (0 = until cleared)
+  void setOnline(bool online) { online_ = online; }
+  const SimModbusSlaveStats& stats() const { return stats_; }
+
+  void onHostByte(uint8_t value, uint64_t doneUs) override;
+
+private:
+  static const uint16_t REGISTER_COUNT = 32;
+  static const size_t FRAME_MAX = 64;
+
+  void handleFrame(uint64_t doneUs);
+  void reply(const uint8_t* frame, size_t length, uint64_t startUs);
+
+  HardwareSerial& serial_;
+  uint8_t address_;
+  uint16_t registers_[REGISTER_COUNT];
+  uint32_t turnaroundUs_;
+  SimModbusFault fault_;
+  uint32_t faultCount_;
+  bool online_;
+  uint8_t frame_[FRAME_MAX];
+  size_t length_;
+  uint64_t lastByteUs_;
+  uint64_t busIdleFromUs_;    // End of the previous frame on the bus (either direction)
+  SimModbusSlaveStats stats_;
+};
+
+#endif // MODBUS_SLAVE_H
@@ -0,0 +1,199 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Roof and Inverter Plant Model Implementation
+ */
+
+#include "roof_plant.h"
+#include "sim_hal.h"
+#include "config.h"
+#include <math.h>
+
+RoofPlant::RoofPlant(const RoofPlantConfig& config) : config_(config) {}
+
+void RoofPlant::reset(double position) {
+  position_ = position < 0.0 ? 0.0 : (position > 1.0 ? 1.0 : position);
+  direction_ = 0;
+  lastDirection_ = (position_ >= 0.5) ? 1 : -1;
+  fault_ = PLANT_FAULT_NONE;
+  blocked_ = false;
+  openSwitch_ = SwitchModel();
+  closedSwitch_ = SwitchModel();
+  lastStepUs_ = simNowMicros();
+  driveInputs(lastStepUs_);
+}
+
+void RoofPlant::onOutputWrite(uint8_t pin, int level, uint64_t nowUs) {
+  if (pin == INVERTER_PIN) {
+    dcOn_ = (level == HIGH);
+    if (!dcOn_) {
+      // Losing DC drops the inverter back to its off state
+      softPowerOn_ = false;
+      acOn_ = false;
+    }
+  } else if (pin == INVERTER_BUTTON_PIN) {
+    // Soft-power button acts on press, and only while DC is present
+    if (level == HIGH && dcOn_) {
+      softPowerOn_ = !softPowerOn_;
+      softPowerOnUs_ = nowUs;
+      if (!softPowerOn_) acOn_ = false;
+    }
+  } else if (pin == ROOF_CONTROL_PIN) {
+    if (level == HIGH) {
+      buttonPresses_++;
+      if (acOn_) pressRoofButton(nowUs);
+    }
+  }
+}
+
+void RoofPlant::pressRoofButton(uint64_t nowUs) {
+  if (fault_ == PLANT_FAULT_JAMMED) {
+    return;
+  }
+
+  if (direction_ != 0) {
+    // Moving: a press stops the opener
+    lastDirection_ = direction_;
+    direction_ = 0;
+    blocked_ = false;
+    return;
+  }
+
+  // Stopped: a press reverses the last direction, never into an end stop
+  int next = -lastDirection_;
+  if (position_ >= 1.0) next = -1;
+  if (position_ <= 0.0) next = 1;
+  if (fault_ == PLANT_FAULT_STALL_MIDWAY && position_ == 0.5) {
+    return;
+  }
+  direction_ = next;
+  motorStartUs_ = nowUs;
+}
+
+void RoofPlant::step(uint64_t nowUs) {
+  uint64_t dtUs = nowUs - lastStepUs_;
+  lastStepUs_ = nowUs;
+
+  // Inverter output follows soft-power state after its spin-up time
+  acOn_ = dcOn_ && softPowerOn_ && (nowUs - softPowerOnUs_ >= (uint64_t)config_.inverterSpinUpMs * 1000);
+
+  if (direction_ != 0) {
+    if (!acOn_) {
+      // Opener loses power mid-travel
+      lastDirection_ = direction_;
+      direction_ = 0;
+      blocked_ = false;
+    } else if (!blocked_) {
+      double previous = position_;
+      position_ += direction_ * (double)dtUs / ((double)config_.travelMs * 1000.0);
+
+      if (fault_ == PLANT_FAULT_STALL_MIDWAY &&
+          ((previous < 0.5 && position_ >= 0.5) || (previous > 0.5 && position_ <= 0.5))) {
+        position_ = 0.5;
+        lastDirection_ = direction_;
+        direction_ = 0;
+      } else if (fault_ == PLANT_FAULT_OBSTRUCTED && direction_ > 0 && previous <= 0.5 && position_ >= 0.5) {
+        position_ = 0.5;
+        blocked_ = true;   // Still energized: only a press or losing AC stops it
+      } else if (position_ >= 1.0) {
+        position_ = 1.0;
+        lastDirection_ = 1;
+        direction_ = 0;
+      } else if (position_ <= 0.0) {
+        position_ = 0.0;
+        lastDirection_ = -1;
+        direction_ = 0;
+      }
+    }
+  }
+
+  driveInputs(nowUs);
+}
+
+void RoofPlant::driveSwitch(SwitchModel& sw, int pin, bool contact, uint64_t nowUs) {
+  int triggered = TRIGGERED;
+  int released = (TRIGGERED == HIGH) ? LOW : HIGH;
+
+  if (sw.pinLevel < 0) {
+    // First drive after reset: settle immediately
+    sw.contact = contact;
+    sw.pinLevel = contact ? triggered : released;
+    sw.bouncesLeft = 0;
+    simSetInputLevel(pin, sw.pinLevel);
+    return;
+  }
+
+  if (contact != sw.contact) {
+    sw.contact = contact;
+    sw.pinLevel = contact ? triggered : released;
+    sw.bouncesLeft = config_.bounceCount * 2;
+    sw.nextBounceUs = nowUs + config_.bounceIntervalUs;
+    simSetInputLevel(pin, sw.pinLevel);
+    return;
+  }
+
+  if (sw.bouncesLeft > 0 && nowUs >= sw.nextBounceUs) {
+    sw.pinLevel = (sw.pinLevel == HIGH) ? LOW : HIGH;
+    sw.bouncesLeft--;
+    sw.nextBounceUs = nowUs + config_.bounceIntervalUs;
+    simSetInputLevel(pin, sw.pinLevel);
+  }
+}
+
+// Step the A/B outputs one count at a time to the count for the position
+// (Gray order 11, 01, 00, 10 while the count rises: count 0 is both pins
+// high, the level of an idle input)
+void RoofPlant::driveEncoder() {
+  if (config_.encoderCountsPerTravel == 0 || ENCODER_PIN_A < 0 || ENCODER_PIN_B < 0) {
+    return;
+  }
+  static const uint8_t PHASE_A[4] = {HIGH, LOW, LOW, HIGH};
+  static const uint8_t PHASE_B[4] = {HIGH, HIGH, LOW, LOW};
+
+  double exact = position_ * config_.encoderCountsPerTravel;
+  int32_t target = (int32_t)(exact < 0 ? exact - 0.5 : exact + 0.5);
+  while (encoderCount_ != target) {
+    encoderCount_ += (target > encoderCount_) ? 1 : -1;
+    uint8_t phase = (uint8_t)(encoderCount_ & 3);
+    simSetInputLevel(ENCODER_PIN_A, PHASE_A[phase]);
+    simSetInputLevel(ENCODER_PIN_B, PHASE_B[phase]);
+  }
+}
+
+void RoofPlant::driveInputs(uint64_t nowUs) {
+  driveEncoder();
+
+  double zone = config_.switchZonePercent / 100.0;
+  driveSwitch(openSwitch_, LIMIT_SWITCH_OPEN_PIN, position_ >= 1.0 - zone, nowUs);
+  driveSwitch(closedSwitch_, LIMIT_SWITCH_CLOSED_PIN, position_ <= zone, nowUs);
+
+  // Optocoupler pulls the AC detect pin LOW while the inverter output is live
+  simSetInputLevel(INVERTER_AC_POWER_PIN, acOn_ ? LOW : HIGH);
+
+  int notParked = (TELESCOPE_PARKED == HIGH) ? LOW : HIGH;
+  simSetInputLevel(TELESCOPE_PARKED_PIN, telescopeParked_ ? TELESCOPE_PARKED : notParked);
+}
+
+// Mains-frequency current through the opener, as an AC current sensor
+// biased to mid-scale reports it: inrush decaying into the running load
+// (heavier mid-travel), or the locked-rotor current while blocked
+int RoofPlant::currentSensorLevel(uint64_t nowUs) {
+  noiseState_ ^= noiseState_ << 13;
+  noiseState_ ^= noiseState_ >> 17;
+  noiseState_ ^= noiseState_ << 5;
+  int noise = (int)(noiseState_ % 7) - 3;
+  if (config_.currentRunningCounts == 0) {
+    return config_.currentZeroCounts + noise;
+  }
+
+  double load = 0.0;  // Multiples of the running current
+  if (direction_ != 0 && acOn_) {
+    if (blocked_) {
+      load = 4.0;
+    } else {
+      double sinceStartMs = nowUs > motorStartUs_ ? (nowUs - motorStartUs_) / 1000.0 : 0.0;
+      load = (1.0 + 3.0 * exp(-sinceStartMs / config_.currentInrushMs)) * (1.0 + 0.1 * sin(M_PI * position_));
+    }
+  }
+  double phase = 2.0 * M_PI * config_.mainsHz * (nowUs % 1000000ULL) / 1e6;
+  return config_.currentZeroCounts + (int)lround(load * config_.currentRunningCounts * M_SQRT2 * sin(phase)) + noise;
+}
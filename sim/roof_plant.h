@@ -0,0 +1,103 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Roof and Inverter Plant Model
+ *
+ * Models the equipment on the other side of the relays:
+ *   - K1 feeds 12V DC to the inverter
+ *   - K3 is the inverter soft-power button (toggles AC output while DC is present)
+ *   - K2 is the roof opener button (start / stop / reverse, like a garage opener)
+ *   - The opener only runs while the inverter is producing AC
+ *   - Limit switches are driven from the simulated roof position, with bounce
+ *   - An optional quadrature encoder on the drive outputs A/B edges as it moves
+ *   - An optional current sensor on the opener supply sees mains-frequency
+ *     current: an inrush on each start, the running load, and the
+ *     locked-rotor current while the motor pushes against an obstruction
+ */
+
+#ifndef ROOF_PLANT_H
+#define ROOF_PLANT_H
+
+#include <stdint.h>
+
+struct RoofPlantConfig {
+  uint32_t travelMs = 30000;           // Full closed-to-open travel time
+  uint32_t inverterSpinUpMs = 600;     // Soft-power press to AC output present
+  uint32_t switchZonePercent = 1;      // Travel (percent) over which a limit switch stays triggered
+  uint32_t bounceCount = 2;            // Extra contact bounces on every limit switch transition
+  uint32_t bounceIntervalUs = 1000;    // Time between bounces
+  int32_t encoderCountsPerTravel = 0;  // Quadrature counts closed to open (0 = no encoder)
+  int32_t currentRunningCounts = 0;    // Running RMS current in ADC counts (0 = no current sensor)
+  int32_t currentZeroCounts = 1985;    // Sensor output with no current
+  uint32_t currentInrushMs = 120;      // Inrush decay time constant
+  uint32_t mainsHz = 50;
+};
+
+enum PlantFault {
+  PLANT_FAULT_NONE,
+  PLANT_FAULT_JAMMED,                  // Opener ignores the button (motor or relay failure)
+  PLANT_FAULT_STALL_MIDWAY,            // Motor stops at 50% travel and stays there
+  PLANT_FAULT_OBSTRUCTED               // Opening roof blocked at 50% travel, the motor still pushing
+};
+
+class RoofPlant {
+public:
+  explicit RoofPlant(const RoofPlantConfig& config);
+
+  // Place the roof at rest at a position (0.0 = closed, 1.0 = open)
+  void reset(double position);
+
+  // Advance the model to the current virtual time and drive the input pins
+  void step(uint64_t nowUs);
+
+  // Notified by the HAL output hook on every relay write
+  void onOutputWrite(uint8_t pin, int level, uint64_t nowUs);
+
+  void setFault(PlantFault fault) { fault_ = fault; }
+  void setTelescopeParked(bool parked) { telescopeParked_ = parked; }
+
+  double position() const { return position_; }
+  bool moving() const { return direction_ != 0; }
+  bool acPresent() const { return acOn_; }
+  uint32_t buttonPresses() const { return buttonPresses_; }
+  int32_t encoderCount() const { return encoderCount_; }
+  bool blocked() const { return blocked_; }
+
+  // Current sensor output (ADC counts) at a time: call from the HAL's analog source
+  int currentSensorLevel(uint64_t nowUs);
+
+private:
+  RoofPlantConfig config_;
+  PlantFault fault_ = PLANT_FAULT_NONE;
+  double position_ = 0.0;
+  int direction_ = 0;                  // +1 opening, -1 closing, 0 stopped
+  int lastDirection_ = -1;
+  bool dcOn_ = false;
+  bool softPowerOn_ = false;
+  bool acOn_ = false;
+  uint64_t softPowerOnUs_ = 0;
+  uint64_t lastStepUs_ = 0;
+  bool telescopeParked_ = true;
+  uint32_t buttonPresses_ = 0;
+
+  // Per-switch bounce generators
+  struct SwitchModel {
+    bool contact = false;              // Debounced physical contact state
+    int pinLevel = -1;                 // Level currently driven on the pin
+    uint32_t bouncesLeft = 0;
+    uint64_t nextBounceUs = 0;
+  };
+  SwitchModel openSwitch_;
+  SwitchModel closedSwitch_;
+
+  int32_t encoderCount_ = 0;           // Quadrature state: count modulo 4 is the A/B phase
+  bool blocked_ = false;               // Motor energized against an obstruction
+  uint64_t motorStartUs_ = 0;
+  uint32_t noiseState_ = 0x2545F491;   // Sensor noise (xorshift, deterministic per run)
+
+  void pressRoofButton(uint64_t nowUs);
+  void driveEncoder();
+  void driveSwitch(SwitchModel& sw, int pin, bool contact, uint64_t nowUs);
+  void driveInputs(uint64_t nowUs);
+};
+
+#endif // ROOF_PLANT_H
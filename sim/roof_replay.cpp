@@ -0,0 +1,557 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Trace Replay
+ *
+ * Feeds a trace downloaded from GET /api/trace (or written by roof_sim
+ * --record) back through the unmodified control path on virtual time.
+ * Replay starts at the first sync entry that finds the roof at rest with
+ * every relay off. From there the recorded input edges are driven
+ * onto the input pins one stable time ahead of the sample that reported
+ * them, commands are queued for the control step that dispatched them (a
+ * STOP at its own time, through the abort path), RS485
+ * snow readings are handed to the weather close path, moves failed on encoder
+ * or motor current data are failed again at the same time, and resets are repeated
+ * with their recorded reason. What the controller does in response (command
+ * outcomes, relay edges, operation state and status changes, park verdicts,
+ * debounced inputs) is recorded by the firmware's own trace recorder and
+ * compared with the file entry by entry, within a time tolerance.
+ *
+ * The comparison stops at the first divergence, but the replay runs on to
+ * the end of the trace and reports dispatch-to-relay and input-to-relay
+ * latencies for both runs, so the effect of a code change on a recorded
+ * night can be measured.
+ *
+ * Usage: roof_replay FILE [--tick-ms N] [--tolerance-ms N] [--verbose]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "sim_hal.h"
+#include "roof_controller.h"
+#include "relay_pulse.h"
+#include "roof_telemetry.h"
+#include "roof_position.h"
+#include "control_link.h"
+#include "mqtt_handler.h"
+#include "input_sampler.h"
+#include "snow_sensor.h"
+#include "roof_resume.h"
+#include "roof_trace.h"
+#include "switch_health.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
+#include "park_sensor_udp.h"
+
+extern bool simControlWakePending;
+
+// ============== Options ==============
+
+struct ReplayOptions {
+  const char* path = nullptr;
+  uint32_t tickMs = CONTROL_TASK_PERIOD_MS;   // Control step period of the recording
+  uint32_t toleranceMs = 50;                  // Allowed timing difference per entry
+  bool verbose = false;
+};
+
+static ReplayOptions opts;
+
+// ============== Trace File ==============
+
+// A trace entry on one continuous clock: 32-bit timestamps unwrapped and
+// each boot joined onto the end of the one before
+struct TimedEntry {
+  uint64_t timeUs;
+  RoofTraceEntry entry;
+};
+
+static RoofTraceHeader header;
+static std::vector<TimedEntry> recorded;
+
+static bool loadTrace(const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    fprintf(stderr, "Cannot open %s\n", path);
+    return false;
+  }
+  bool ok = fread(&header, sizeof(header), 1, file) == 1 && header.magic == TRACE_FILE_MAGIC &&
+            header.version == TRACE_FILE_VERSION && header.entrySize == sizeof(RoofTraceEntry);
+  if (!ok) {
+    fprintf(stderr, "%s is not a roof trace (version %u)\n", path, (unsigned)TRACE_FILE_VERSION);
+    fclose(file);
+    return false;
+  }
+
+  uint64_t clock = 1ULL << 32;   // Room for the small negative steps of input entries
+  uint32_t lastRaw = 0;
+  RoofTraceEntry entry;
+  while (fread(&entry, sizeof(entry), 1, file) == 1) {
+    // micros() restarts at a boot: the clock carries on from the entry before
+    // it, the last control step when the ring survived the reset
+    if (!recorded.empty() && entry.type != TRACE_BOOT) {
+      clock += (int64_t)(int32_t)(entry.timeUs - lastRaw);
+    }
+    lastRaw = entry.timeUs;
+    recorded.push_back({clock, entry});
+  }
+  fclose(file);
+  return true;
+}
+
+// Entries the controller produces, as opposed to what is fed into it
+static bool isCompared(uint8_t type) {
+  return type == TRACE_INPUT || type == TRACE_COMMAND || type == TRACE_RELAY ||
+         type == TRACE_OP_STATE || type == TRACE_STATUS || type == TRACE_PARK;
+}
+
+static bool isRestStart(const RoofTraceEntry& e) {
+  RoofStatus status = (RoofStatus)(e.b >> TRACE_SYNC_STATUS_SHIFT);
+  uint16_t relays = (e.b >> TRACE_SYNC_RELAY_SHIFT) & 0xF;
+  // A roof travelling on its own (a resumed move) cannot be rebuilt from the pins
+  return e.type == TRACE_SYNC && e.a == OP_IDLE && relays == 0 &&
+         status != ROOF_OPENING && status != ROOF_CLOSING;
+}
+
+static void describe(const RoofTraceEntry& e, char* buffer, size_t size) {
+  switch (e.type) {
+    case TRACE_COMMAND:
+      snprintf(buffer, size, "command %s from %s: %s", getRoofCommandTypeString((RoofCommandType)(e.a & 0xF)),
+               getCommandSourceString((CommandSource)(e.a >> 4)),
+               getRoofCommandOutcomeString((RoofCommandOutcome)(e.b & 0xFF)));
+      break;
+    case TRACE_RELAY:
+      snprintf(buffer, size, "relay K%u %s", e.a + 1, e.b ? "on" : "off");
+      break;
+    case TRACE_STATUS:
+      snprintf(buffer, size, "status %s (error %u)", getRoofStatusString((RoofStatus)e.a).c_str(), e.b);
+      break;
+    default:
+      snprintf(buffer, size, "%s a=%u b=0x%04x", getRoofTraceTypeName((RoofTraceType)e.type), e.a, e.b);
+      break;
+  }
+}
+
+// ============== Replay ==============
+
+enum ActionKind { ACT_PIN, ACT_COMMAND, ACT_SNOW, ACT_SENSOR_FAULT, ACT_RESET };
+
+struct Action {
+  uint64_t atUs;              // Recorded clock
+  ActionKind kind;
+  uint8_t a;
+  uint16_t b;                 // ACT_COMMAND: 1 = queue at atUs instead of with a step
+  uint8_t arg;                // ACT_COMMAND: the command argument
+};
+
+static std::vector<Action> actions;
+static uint64_t recordedStartUs = 0;
+static uint64_t replayStartUs = 0;
+
+static uint64_t toReplayClock(uint64_t recordedUs) {
+  return recordedUs - recordedStartUs + replayStartUs;
+}
+
+static void setInputActive(InputChannel channel, bool active) {
+  int level = getInputActiveLevel(channel);
+  simSetInputLevel(getInputPin(channel), active ? level : !level);
+}
+
+static void applySettings() {
+  movementTimeout = header.movementTimeout;
+  limitSwitchTimeout = header.limitSwitchTimeout;
+  inverterDelay1 = header.inverterDelay1;
+  inverterDelay2 = header.inverterDelay2;
+  inverterKeepWarmMinutes = header.keepWarmMinutes;
+  inverterPrewarmMinutes = header.prewarmMinutes;
+  rainHoldoffMs = header.rainHoldoffMs;
+  rainReopenLockoutMs = header.rainReopenLockoutMs;
+  movementTimeoutEnabled = header.flags & TRACE_FLAG_MOVEMENT_TIMEOUT;
+  limitSwitchTimeoutEnabled = header.flags & TRACE_FLAG_LIMIT_TIMEOUT;
+  inverterAcSequencing = header.flags & TRACE_FLAG_AC_SEQUENCING;
+  rainAutoCloseEnabled = header.flags & TRACE_FLAG_RAIN_AUTO_CLOSE;
+  snowAutoCloseEnabled = header.flags & TRACE_FLAG_SNOW_AUTO_CLOSE;
+  bypassParkSensor = header.flags & TRACE_FLAG_BYPASS_PARK;
+  adaptiveTimeoutsEnabled = false;     // The learned history is not in the trace
+  snowModbusEnabled = false;           // Readings come from the trace
+  parkSensorType = PARK_SENSOR_PHYSICAL;  // Verdicts are driven onto the park pin
+  for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+    if (header.stableMs[ch]) setInputStableTime((InputChannel)ch, header.stableMs[ch]);
+  }
+}
+
+// Schedule everything after the start entry that the controller takes as input
+static void buildActions(size_t start) {
+  bool parkFromVerdict = header.parkSensorType != PARK_SENSOR_PHYSICAL;
+  uint64_t bootUs = recorded[start].timeUs;
+  // The sampler reports a change on the sample that completes its stable
+  // time; an edge is never moved back past the boot it came after
+  auto edgeTime = [&](uint64_t reportedUs, uint8_t ch) {
+    uint64_t leadUs = (uint64_t)header.stableMs[ch] * 1000 - INPUT_SAMPLE_PERIOD_US / 2;
+    return std::max(reportedUs - leadUs, bootUs);
+  };
+  size_t lastStop = SIZE_MAX;   // Action index of the latest STOP
+  for (size_t i = start + 1; i < recorded.size(); i++) {
+    const TimedEntry& t = recorded[i];
+    const RoofTraceEntry& e = t.entry;
+    switch (e.type) {
+      case TRACE_INPUT:
+        for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+          if (!(e.a & (1U << ch))) continue;
+          if (ch == INPUT_TELESCOPE_PARK && parkFromVerdict) continue;
+          actions.push_back({edgeTime(t.timeUs, ch), ACT_PIN, ch, (uint16_t)((e.b >> ch) & 1)});
+        }
+        break;
+      case TRACE_PARK:
+        if (parkFromVerdict) {
+          actions.push_back({edgeTime(t.timeUs, INPUT_TELESCOPE_PARK), ACT_PIN, INPUT_TELESCOPE_PARK, e.a});
+        }
+        break;
+      case TRACE_COMMAND:
+        if ((e.b & 0xFF) == COMMAND_PREEMPTED && lastStop != SIZE_MAX) {
+          // Voided by the STOP that overtook it, so it was queued before that STOP
+          actions.insert(actions.begin() + lastStop, {actions[lastStop].atUs, ACT_COMMAND, e.a, 1, (uint8_t)(e.b >> 8)});
+          lastStop++;
+        } else {
+          if ((e.a & 0xF) == CMD_STOP) lastStop = actions.size();
+          actions.push_back({t.timeUs, ACT_COMMAND, e.a, 0, (uint8_t)(e.b >> 8)});
+        }
+        break;
+      case TRACE_SNOW_SENSOR:
+        actions.push_back({t.timeUs, ACT_SNOW, e.a, e.b});
+        break;
+      case TRACE_SENSOR_FAULT:
+        actions.push_back({t.timeUs, ACT_SENSOR_FAULT, e.a, e.b});
+        break;
+      case TRACE_BOOT: {
+        uint16_t inputs = 0;
+        for (size_t j = i + 1; j < recorded.size(); j++) {
+          if (recorded[j].entry.type == TRACE_SYNC) {
+            inputs = recorded[j].entry.b & TRACE_SYNC_INPUT_MASK;
+            break;
+          }
+        }
+        bootUs = t.timeUs;
+        actions.push_back({t.timeUs, ACT_RESET, e.a, inputs});
+        break;
+      }
+      default:
+        break;
+    }
+  }
+  std::stable_sort(actions.begin(), actions.end(),
+                   [](const Action& x, const Action& y) { return x.atUs < y.atUs; });
+}
+
+static void setInputs(uint16_t mask) {
+  for (uint8_t ch = 0; ch < INPUT_CHANNEL_COUNT; ch++) {
+    setInputActive((InputChannel)ch, (mask & (1U << ch)) != 0);
+  }
+}
+
+// What a reset clears, then the firmware's own boot path with the inputs it
+// found (the sync entry written on the first step after the boot)
+static void replayReset(esp_reset_reason_t reason, uint16_t inputs) {
+  static const uint8_t relayPins[] = {INVERTER_PIN, ROOF_CONTROL_PIN, INVERTER_BUTTON_PIN};
+  for (uint8_t pin : relayPins) digitalWrite(pin, LOW);
+  roofOpState = OP_IDLE;
+  roofOpTarget = TARGET_NONE;
+  cancelRelayPulses(RELAY_K2);
+  cancelRelayPulses(RELAY_K3);
+  telemetryMoveDiscard();
+  InputEvent event;
+  while (popInputEvent(event)) {}
+  takeInputEventOverflow();
+  setInputs(inputs);
+
+  simSetResetReason(reason);
+  initializeRoofController();
+  simSetResetReason(ESP_RST_POWERON);
+  applySettings();
+  publishRoofSnapshot();
+}
+
+static bool lastSnow = false;
+
+static void applyAction(const Action& action) {
+  switch (action.kind) {
+    case ACT_PIN:
+      setInputActive((InputChannel)action.a, action.b != 0);
+      break;
+    case ACT_COMMAND:
+      queueRoofCommand((RoofCommandType)(action.a & 0xF), (CommandSource)(action.a >> 4), action.arg);
+      break;
+    case ACT_SNOW:
+      if ((action.a != 0) != lastSnow) {
+        lastSnow = action.a != 0;
+        noteSnowSensorChange(lastSnow, micros());
+      }
+      break;
+    case ACT_SENSOR_FAULT:
+      // The counts and samples behind it are not in the trace: fail the move as recorded
+      faultRoofMovement((RoofErrorCode)action.a, action.b,
+                        action.a == ROOF_ERR_MOTOR_OVERCURRENT ? MOVE_OBSTRUCTED : MOVE_STALLED);
+      break;
+    case ACT_RESET:
+      replayReset((esp_reset_reason_t)action.a, action.b);
+      break;
+  }
+}
+
+// ============== Comparison ==============
+
+static std::vector<TimedEntry> expected;    // Compared entries of the recording after the start
+static std::vector<TimedEntry> produced;    // The same kinds of entry from the replay
+static uint32_t readIndex = 0;
+static size_t matched = 0;
+static bool diverged = false;
+static int64_t maxSkewUs = 0;
+
+static void reportDivergence(const TimedEntry* want, const TimedEntry* got) {
+  char text[96];
+  fprintf(stderr, "DIVERGENCE after %zu matching entries\n", matched);
+  if (want) {
+    describe(want->entry, text, sizeof(text));
+    fprintf(stderr, "  recorded  t=%10.3fs  %s\n", (toReplayClock(want->timeUs) - replayStartUs) / 1e6, text);
+  } else {
+    fprintf(stderr, "  recorded  (nothing more)\n");
+  }
+  if (got) {
+    describe(got->entry, text, sizeof(text));
+    fprintf(stderr, "  replayed  t=%10.3fs  %s\n", (got->timeUs - replayStartUs) / 1e6, text);
+  } else {
+    fprintf(stderr, "  replayed  (nothing)\n");
+  }
+}
+
+static void compareEntry(const TimedEntry& got) {
+  produced.push_back(got);
+  if (diverged) return;
+  if (matched >= expected.size()) {
+    diverged = true;
+    reportDivergence(nullptr, &got);
+    return;
+  }
+  const TimedEntry& want = expected[matched];
+  int64_t skewUs = (int64_t)got.timeUs - (int64_t)toReplayClock(want.timeUs);
+  bool same = got.entry.type == want.entry.type && got.entry.a == want.entry.a && got.entry.b == want.entry.b;
+  if (!same || llabs(skewUs) > (int64_t)opts.toleranceMs * 1000) {
+    diverged = true;
+    reportDivergence(&want, &got);
+    return;
+  }
+  if (llabs(skewUs) > maxSkewUs) maxSkewUs = llabs(skewUs);
+  matched++;
+}
+
+// Drain what the replayed controller has traced since the last call
+static void collectReplayEntries() {
+  if (getRoofTraceEnd() < readIndex) readIndex = 0;   // A power-on reset cleared the ring
+  uint64_t now = simNowMicros();
+  RoofTraceEntry chunk[TRACE_DOWNLOAD_CHUNK];
+  uint32_t count;
+  while ((count = copyRoofTraceEntries(readIndex, chunk, TRACE_DOWNLOAD_CHUNK)) > 0) {
+    for (uint32_t i = 0; i < count; i++) {
+      if (!isCompared(chunk[i].type)) continue;
+      uint64_t timeUs = now - (uint32_t)((uint32_t)now - chunk[i].timeUs);
+      compareEntry({timeUs, chunk[i]});
+    }
+    readIndex += count;
+  }
+}
+
+// ============== Latency ==============
+
+struct LatencySummary {
+  uint32_t samples = 0;
+  uint64_t totalUs = 0;
+  uint64_t maxUs = 0;
+
+  void add(uint64_t us) {
+    samples++;
+    totalUs += us;
+    if (us > maxUs) maxUs = us;
+  }
+};
+
+// Accepted command to its first relay edge, and input change to the next
+// relay edge it caused (within a second, with no command in between)
+static void measureLatency(const std::vector<TimedEntry>& entries, LatencySummary& command, LatencySummary& input) {
+  for (size_t i = 0; i < entries.size(); i++) {
+    const RoofTraceEntry& e = entries[i].entry;
+    bool isCommand = e.type == TRACE_COMMAND && e.b == COMMAND_ACCEPTED;
+    if (!isCommand && e.type != TRACE_INPUT) continue;
+    for (size_t j = i + 1; j < entries.size(); j++) {
+      const TimedEntry& next = entries[j];
+      uint64_t us = next.timeUs - entries[i].timeUs;
+      if (next.entry.type == TRACE_COMMAND || (!isCommand && us > 1000000)) break;
+      if (next.entry.type == TRACE_RELAY) {
+        (isCommand ? command : input).add(us);
+        break;
+      }
+    }
+  }
+}
+
+static void printLatencyRow(const char* name, const LatencySummary& rec, const LatencySummary& rep) {
+  printf("  %-22s %7u %9.1f %9.1f   %7u %9.1f %9.1f\n", name,
+         rec.samples, rec.samples ? rec.totalUs / 1000.0 / rec.samples : 0.0, rec.maxUs / 1000.0,
+         rep.samples, rep.samples ? rep.totalUs / 1000.0 / rep.samples : 0.0, rep.maxUs / 1000.0);
+}
+
+// ============== Main ==============
+
+static void usage(const char* argv0) {
+  fprintf(stderr, "Usage: %s FILE [--tick-ms N] [--tolerance-ms N] [--verbose]\n", argv0);
+}
+
+static bool parseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (strcmp(arg, "--tick-ms") == 0 && hasValue) {
+      opts.tickMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--tolerance-ms") == 0 && hasValue) {
+      opts.toleranceMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--verbose") == 0) {
+      opts.verbose = true;
+    } else if (arg[0] != '-' && !opts.path) {
+      opts.path = arg;
+    } else {
+      return false;
+    }
+  }
+  return opts.path != nullptr && opts.tickMs > 0;
+}
+
+static uint64_t hostNanos() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void advanceTo(uint64_t us) {
+  uint64_t now = simNowMicros();
+  if (us > now) simAdvanceMicros(us - now);
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+  Serial.echo = opts.verbose;
+  if (!loadTrace(opts.path)) return 2;
+
+  size_t start = 0;
+  while (start < recorded.size() && !isRestStart(recorded[start].entry)) start++;
+  if (start == recorded.size()) {
+    fprintf(stderr, "No sync entry with the roof at rest in %zu entries - nothing to replay from\n",
+            recorded.size());
+    return 2;
+  }
+  const RoofTraceEntry& sync = recorded[start].entry;
+  recordedStartUs = recorded[start].timeUs;
+  for (size_t i = start + 1; i < recorded.size(); i++) {
+    if (isCompared(recorded[i].entry.type)) expected.push_back(recorded[i]);
+  }
+  buildActions(start);
+
+  // Boot into the state the sync entry describes
+  simResetPins();
+  simSetTimeMicros(0);
+  setInputs(sync.b & TRACE_SYNC_INPUT_MASK);
+  simSetResetReason(ESP_RST_POWERON);
+  initializeRoofController();
+  initRoofPosition();
+  applySettings();
+  publishRoofSnapshot();
+  if (roofStatus != (RoofStatus)(sync.b >> TRACE_SYNC_STATUS_SHIFT)) {
+    fprintf(stderr, "Replay booted %s, the trace starts %s\n", getRoofStatusString().c_str(),
+            getRoofStatusString((RoofStatus)(sync.b >> TRACE_SYNC_STATUS_SHIFT)).c_str());
+    return 1;
+  }
+
+  // The first control step writes the replay's own starting sync entry
+  uint64_t tickUs = (uint64_t)opts.tickMs * 1000;
+  replayStartUs = simNowMicros();
+  roofControlStep();
+  processControlEvents();
+  readIndex = getRoofTraceEnd();
+
+  uint64_t endUs = toReplayClock(recorded.back().timeUs) + 2000000;
+  uint64_t nextStepUs = replayStartUs + tickUs;
+  size_t nextAction = 0;
+  uint64_t steps = 1;
+  uint64_t wallStart = hostNanos();
+
+  while (nextStepUs <= endUs || nextAction < actions.size()) {
+    // Inputs, readings, resets and STOPs (abort path) land at their own time;
+    // any other command joins the control step nearest to the one that dispatched it
+    while (nextAction < actions.size()) {
+      const Action& action = actions[nextAction];
+      uint64_t at = toReplayClock(action.atUs);
+      bool stepAligned = action.kind == ACT_COMMAND && (action.a & 0xF) != CMD_STOP && action.b == 0;
+      // (a reset comes after the last step the recording made before it)
+      if (stepAligned ? at > nextStepUs + tickUs / 2 :
+          action.kind == ACT_RESET ? at >= nextStepUs : at > nextStepUs) break;
+      if (!stepAligned) advanceTo(at);
+      if (action.kind == ACT_RESET) collectReplayEntries();
+      applyAction(action);
+      if (simControlWakePending) {
+        simControlWakePending = false;
+        processRoofAbort();
+      }
+      nextAction++;
+      if (action.kind == ACT_RESET) {
+        readIndex = getRoofTraceEnd() < readIndex ? 0 : readIndex;
+        nextStepUs = simNowMicros();   // The control task starts straight after boot
+      }
+    }
+
+    advanceTo(nextStepUs);
+    roofControlStep();
+    processControlEvents();
+    flushResumeSnapshot();
+    flushMoveHistory();
+    flushRoofEncoderSpan();
+    flushMotorCurrentEnvelope();
+    processSwitchHealth();
+    collectReplayEntries();
+    steps++;
+    nextStepUs += tickUs;
+  }
+  double wallSeconds = (hostNanos() - wallStart) / 1e9;
+  if (!diverged && matched < expected.size()) {
+    diverged = true;
+    reportDivergence(&expected[matched], nullptr);
+  }
+
+  double simSeconds = (simNowMicros() - replayStartUs) / 1e6;
+  printf("Trace               %s: %zu entries (%lu lost to wrap-around), replay from entry %zu\n",
+         opts.path, recorded.size(), (unsigned long)header.firstIndex, start);
+  if (header.flags & TRACE_FLAG_ADAPTIVE) {
+    printf("  note                adaptive timeouts were on; the replay uses the configured timeouts\n");
+  }
+  if (header.flags2 & TRACE_FLAG2_ENCODER) {
+    printf("  note                a roof encoder was fitted; its stalls are replayed from the trace, its target stops and reversals are not\n");
+  }
+  if (header.flags2 & TRACE_FLAG2_MOTOR_CURRENT) {
+    printf("  note                a motor current sensor was fitted; its overcurrent trips are replayed from the trace\n");
+  }
+  printf("Replay              %.1f s of trace in %.3f s wall (%.0fx real time), %llu control steps\n",
+         simSeconds, wallSeconds, wallSeconds > 0 ? simSeconds / wallSeconds : 0.0, (unsigned long long)steps);
+  printf("  compared entries    %zu of %zu matched, max timing skew %.1f ms (tolerance %lu ms)\n",
+         matched, expected.size(), maxSkewUs / 1000.0, (unsigned long)opts.toleranceMs);
+
+  std::vector<TimedEntry> recordedTail(recorded.begin() + start, recorded.end());
+  LatencySummary recCommand, recInput, repCommand, repInput;
+  measureLatency(recordedTail, recCommand, recInput);
+  measureLatency(produced, repCommand, repInput);
+  printf("\nLatency (ms)                      recorded                    replayed\n");
+  printf("  %-22s %7s %9s %9s   %7s %9s %9s\n", "", "samples", "mean", "max", "samples", "mean", "max");
+  printLatencyRow("command to relay", recCommand, repCommand);
+  printLatencyRow("input to relay", recInput, repInput);
+
+  printf("\nResult: %s\n", diverged ? "DIVERGED" : "MATCH");
+  return diverged ? 1 : 0;
+}
@@ -0,0 +1,1628 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Roof State Machine Load Test and Step Profiler
+ *
+ * Runs the unmodified roof_controller.cpp against virtual GPIO and virtual
+ * time, driven through the same command queue and state snapshot the network
+ * task uses on the device. Each cycle runs one scripted scenario (open, close, stop mid-travel,
+ * jammed opener, mid-travel stall, manual button press, bouncing rain sensor,
+ * rain auto-close, RS485 snow sensor; part-open targets with --encoder, an
+ * obstruction with --current) against the plant model and checks the controller ends in the expected state. Every call into
+ * the control path is timed on the host clock and reported per function and
+ * per operation state.
+ *
+ * Usage: roof_sim [--cycles N] [--seed N] [--travel-ms N] [--tick-ms N]
+ *                 [--max-p99-ns N] [--max-position-error PCT] [--adaptive]
+ *                 [--ac-seq] [--keep-warm MIN] [--encoder] [--current] [--record FILE] [--verbose]
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "sim_hal.h"
+#include <Preferences.h>
+#include "roof_plant.h"
+#include "roof_controller.h"
+#include "relay_pulse.h"
+#include "roof_telemetry.h"
+#include "roof_position.h"
+#include "control_link.h"
+#include "mqtt_handler.h"
+#include "input_sampler.h"
+#include "snow_sensor.h"
+#include "safety_monitor.h"
+#include "roof_resume.h"
+#include "roof_trace.h"
+#include "switch_health.h"
+#include "modbus_slave.h"
+#include "roof_encoder.h"
+#include "motor_current.h"
+
+extern unsigned long simMqttPublishCount;
+extern unsigned long simPositionPublishCount;
+extern unsigned long simSwitchHealthPublishCount;
+extern bool simControlWakePending;
+
+// ============== Options ==============
+
+struct SimOptions {
+  unsigned long cycles = 1000;
+  unsigned long seed = 1;
+  uint32_t travelMs = 30000;
+  uint32_t tickMs = 10;             // Matches delay(10) at the end of loop()
+  uint64_t maxP99Ns = 0;            // 0 = no latency guard
+  double maxPositionError = 10.0;   // Reported position against the plant while moving (percent)
+  bool verbose = false;
+  bool adaptive = false;            // Learned movement/limit switch timeouts
+  bool acSequencing = false;        // Advance the inverter sequence on stable AC power
+  unsigned long keepWarmMinutes = 0; // Inverter keep-warm window after each move
+  bool encoder = false;             // Quadrature encoder on the drive (PCNT position, stall and targets)
+  bool current = false;             // Current sensor on the opener supply (continuous ADC, obstruction trips)
+  const char* recordPath = nullptr; // Write the firmware trace here at the end (for roof_replay)
+};
+
+static SimOptions opts;
+
+// ============== Step Timing ==============
+
+// Log-scale histogram: 4 sub-buckets per power of two, 1 ns to ~18 min
+class StepHistogram {
+public:
+  static const int BUCKETS = 160;
+
+  void add(uint64_t ns) {
+    count_++;
+    total_ += ns;
+    if (ns < min_) min_ = ns;
+    if (ns > max_) max_ = ns;
+    buckets_[bucketFor(ns)]++;
+  }
+
+  uint64_t count() const { return count_; }
+  uint64_t min() const { return count_ ? min_ : 0; }
+  uint64_t max() const { return max_; }
+  uint64_t mean() const { return count_ ? total_ / count_ : 0; }
+
+  // Upper bound of the bucket holding the requested percentile
+  uint64_t percentile(double p) const {
+    if (count_ == 0) return 0;
+    uint64_t target = (uint64_t)(p / 100.0 * (double)count_);
+    if (target >= count_) target = count_ - 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < BUCKETS; i++) {
+      seen += buckets_[i];
+      if (seen > target) {
+        uint64_t upper = bucketUpper(i);
+        return upper < max_ ? upper : max_;
+      }
+    }
+    return max_;
+  }
+
+private:
+  uint64_t count_ = 0;
+  uint64_t total_ = 0;
+  uint64_t min_ = UINT64_MAX;
+  uint64_t max_ = 0;
+  uint64_t buckets_[BUCKETS] = {};
+
+  static int bucketFor(uint64_t ns) {
+    if (ns < 4) return (int)ns;
+    int msb = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (msb - 2)) & 0x3);
+    int idx = msb * 4 + sub;
+    return idx < BUCKETS ? idx : BUCKETS - 1;
+  }
+
+  static uint64_t bucketUpper(int idx) {
+    if (idx < 4) return (uint64_t)idx;
+    int msb = idx / 4;
+    int sub = idx % 4;
+    return ((uint64_t)(4 + sub + 1) << (msb - 2)) - 1;
+  }
+};
+
+enum TimedStep {
+  STEP_PROCESS_ROOF_COMMANDS,
+  STEP_PROCESS_ROOF_OPERATION,
+  STEP_PROCESS_RELAY_PULSES,
+  STEP_UPDATE_ROOF_STATUS,
+  STEP_UPDATE_TELESCOPE_STATUS,
+  STEP_PROCESS_SNOW_SENSOR,
+  STEP_PROCESS_RAIN_AUTO_CLOSE,
+  STEP_UPDATE_INVERTER_POWER,
+  STEP_UPDATE_ROOF_ENCODER,
+  STEP_UPDATE_MOTOR_CURRENT,
+  STEP_CHECK_MOVEMENT_TIMEOUT,
+  STEP_UPDATE_ROOF_POSITION,
+  STEP_PUBLISH_ROOF_SNAPSHOT,
+  STEP_UPDATE_RESUME_SNAPSHOT,
+  STEP_TRACE_ROOF_STATE,
+  STEP_PROCESS_ROOF_ABORT,
+  STEP_COUNT
+};
+
+static const char* const STEP_NAMES[STEP_COUNT] = {
+  "processRoofCommands",
+  "processRoofOperation",
+  "processRelayPulses",
+  "updateRoofStatus",
+  "updateTelescopeStatus",
+  "processSnowSensor",
+  "processRainAutoClose",
+  "updateInverterPowerStatus",
+  "updateRoofEncoder",
+  "updateMotorCurrent",
+  "checkMovementTimeout",
+  "updateRoofPosition",
+  "publishRoofSnapshot",
+  "updateResumeSnapshot",
+  "traceRoofState",
+  "processRoofAbort"
+};
+
+static const int OP_STATE_COUNT = OP_PREWARM_READY + 1;
+
+static const char* const OP_STATE_NAMES[OP_STATE_COUNT] = {
+  "OP_IDLE",
+  "OP_INVERTER_POWER_ON",
+  "OP_INVERTER_BUTTON_PRESS",
+  "OP_INVERTER_BUTTON_RELEASE",
+  "OP_INVERTER_DELAY2",
+  "OP_ROOF_BUTTON_PRESS",
+  "OP_ROOF_BUTTON_RELEASE",
+  "OP_STOP_BUTTON_PRESS",
+  "OP_STOP_BUTTON_RELEASE",
+  "OP_SHUTDOWN_K1_WAIT",
+  "OP_SHUTDOWN_K3_PRESS",
+  "OP_SHUTDOWN_K3_RELEASE",
+  "OP_RESUME_REVERSE_RUN",
+  "OP_RESUME_STOP_PRESS",
+  "OP_RESUME_STOP_RELEASE",
+  "OP_PREWARM_POWER_ON",
+  "OP_PREWARM_BUTTON_PRESS",
+  "OP_PREWARM_BUTTON_RELEASE",
+  "OP_PREWARM_DELAY2",
+  "OP_PREWARM_READY"
+};
+
+static StepHistogram stepTimes[STEP_COUNT];
+static StepHistogram opStateTimes[OP_STATE_COUNT];
+
+static inline uint64_t hostNanos() {
+  return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#define TIME_STEP(step, call)                   \
+  do {                                          \
+    uint64_t t0 = hostNanos();                  \
+    call;                                       \
+    stepTimes[step].add(hostNanos() - t0);      \
+  } while (0)
+
+// ============== Simulation Loop ==============
+
+static RoofPlant* plant = nullptr;
+static SimModbusSlave* snowSlave = nullptr;
+static uint64_t loopIterations = 0;
+
+// Dead-reckoned position against the plant while the roof is travelling
+struct PositionErrorStats {
+  uint64_t samples = 0;
+  double sumAbs = 0.0;
+  double maxAbs = 0.0;
+};
+static PositionErrorStats positionError;
+static PositionErrorStats encoderError;   // Encoder position against the plant, while moving
+
+static void addPositionError(PositionErrorStats& stats, double err) {
+  if (err < 0) err = -err;
+  stats.samples++;
+  stats.sumAbs += err;
+  if (err > stats.maxAbs) stats.maxAbs = err;
+}
+
+static void samplePositionError() {
+  if (!plant->moving()) return;
+  if (isRoofPositionEstimated()) {
+    addPositionError(positionError, getRoofPosition() - plant->position() * 100.0);
+  }
+  if (isRoofEncoderCalibrated()) {
+    addPositionError(encoderError, getRoofEncoderPosition() - plant->position() * 100.0);
+  }
+}
+
+// STOP request to its first K2/K3 write, on the host clock: the simulated
+// clock stands still inside a step, so the firmware's own figure reads 0
+static StepHistogram abortToRelay;
+static uint64_t abortRequestNs = 0;
+static uint64_t abortLastNs = 0;
+static uint64_t abortOverBound = 0;
+
+static void onOutputWrite(uint8_t pin, int level, uint64_t nowUs) {
+  if (abortRequestNs && (pin == ROOF_CONTROL_PIN || pin == INVERTER_BUTTON_PIN)) {
+    abortLastNs = hostNanos() - abortRequestNs;
+    abortToRelay.add(abortLastNs);
+    if (abortLastNs > ABORT_LATENCY_BOUND_US * 1000ULL) abortOverBound++;
+    abortRequestNs = 0;
+  }
+  if (plant) plant->onOutputWrite(pin, level, nowUs);
+}
+
+static int analogLevel(uint8_t pin, uint64_t nowUs) {
+  return (plant && pin == MOTOR_CURRENT_PIN) ? plant->currentSensorLevel(nowUs) : 0;
+}
+
+static uint64_t snapshotMismatches = 0;
+static uint64_t controlStepNvsWrites = 0;   // Flash writes stall the control task; they belong to the network side
+
+// One pass of the control path (mirrors roofControlStep(), timed per call),
+// then the network side drains events, then the control period elapses
+static void runLoopIteration() {
+  unsigned long nvsWrites = Preferences::writes();
+  TIME_STEP(STEP_PROCESS_ROOF_COMMANDS, processRoofCommands());
+
+  int opState = (int)roofOpState;
+  uint64_t t0 = hostNanos();
+  processRoofOperation();
+  uint64_t elapsed = hostNanos() - t0;
+  stepTimes[STEP_PROCESS_ROOF_OPERATION].add(elapsed);
+  if (opState >= 0 && opState < OP_STATE_COUNT) {
+    opStateTimes[opState].add(elapsed);
+  }
+
+  TIME_STEP(STEP_PROCESS_RELAY_PULSES, processRelayPulses());
+  TIME_STEP(STEP_UPDATE_ROOF_STATUS, updateRoofStatus());
+  TIME_STEP(STEP_UPDATE_TELESCOPE_STATUS, updateTelescopeStatus());
+  TIME_STEP(STEP_PROCESS_SNOW_SENSOR, processSnowSensor());
+  TIME_STEP(STEP_PROCESS_RAIN_AUTO_CLOSE, processRainAutoClose());
+  TIME_STEP(STEP_UPDATE_INVERTER_POWER, updateInverterPowerStatus());
+  TIME_STEP(STEP_UPDATE_ROOF_ENCODER, updateRoofEncoder());
+  TIME_STEP(STEP_UPDATE_MOTOR_CURRENT, updateMotorCurrent());
+  TIME_STEP(STEP_CHECK_MOVEMENT_TIMEOUT, checkMovementTimeout());
+  TIME_STEP(STEP_UPDATE_ROOF_POSITION, updateRoofPosition());
+  TIME_STEP(STEP_PUBLISH_ROOF_SNAPSHOT, publishRoofSnapshot());
+  TIME_STEP(STEP_UPDATE_RESUME_SNAPSHOT, updateResumeSnapshot());
+  TIME_STEP(STEP_TRACE_ROOF_STATE, traceRoofState());
+  controlStepNvsWrites += Preferences::writes() - nvsWrites;
+  samplePositionError();
+  loopIterations++;
+
+  processControlEvents();
+  flushResumeSnapshot();
+  flushMoveHistory();
+  flushRoofEncoderSpan();
+  flushMotorCurrentEnvelope();
+  processSwitchHealth();
+  if (getRoofSnapshot().status != roofStatus) snapshotMismatches++;
+
+  // delay(tickMs): the plant keeps running at 1 ms resolution meanwhile
+  for (uint32_t i = 0; i < opts.tickMs; i++) {
+    simAdvanceMicros(1000);
+    plant->step(simNowMicros());
+  }
+}
+
+template <typename Pred>
+static bool runUntil(Pred done, uint32_t maxMs) {
+  uint64_t deadline = simNowMicros() + (uint64_t)maxMs * 1000;
+  while (simNowMicros() < deadline) {
+    runLoopIteration();
+    if (done()) return true;
+  }
+  return false;
+}
+
+static void runForMs(uint32_t ms) {
+  runUntil([] { return false; }, ms);
+}
+
+// Upper bound for one complete relay sequence plus travel and settling
+static uint32_t moveBudgetMs() {
+  return inverterDelay1 + inverterDelay2 + 2000 + opts.travelMs + limitSwitchTimeout + 5000;
+}
+
+// A STOP wakes the control task, which runs the abort path before its next step
+static void runAbortWake() {
+  if (!simControlWakePending) return;
+  simControlWakePending = false;
+  TIME_STEP(STEP_PROCESS_ROOF_ABORT, processRoofAbort());
+}
+
+// Issue a command the way the network task does and wait for the arbiter
+static RoofCommandOutcome submitCommand(RoofCommandType type, uint8_t arg = 0) {
+  uint32_t id = queueRoofCommand(type, SOURCE_INTERNAL, arg);
+  if (id == 0) return COMMAND_BUSY;
+  runAbortWake();
+  RoofCommandOutcome outcome = COMMAND_PENDING;
+  for (int i = 0; i < 10; i++) {
+    runLoopIteration();
+    if (roofCommandFinished(id, outcome)) return outcome;
+  }
+  return COMMAND_TIMED_OUT;
+}
+
+static bool runCommand(RoofCommandType type) {
+  return roofCommandSucceeded(submitCommand(type));
+}
+
+static bool controllerIdle() {
+  return roofOpState == OP_IDLE;
+}
+
+// Put the roof at a known end position and let the controller re-read it
+static void recoverTo(double position) {
+  plant->reset(position);
+  runForMs(1000);
+  if (roofStatus == ROOF_ERROR) {
+    runCommand(CMD_CLEAR_ERROR);   // Through the arbiter, so a recorded trace replays it
+  } else {
+    determineInitialRoofStatus();
+  }
+  runUntil(controllerIdle, 5000);
+}
+
+// ============== Scenarios ==============
+
+enum Scenario {
+  SCEN_OPEN,
+  SCEN_CLOSE,
+  SCEN_STOP,
+  SCEN_JAM,
+  SCEN_STALL,
+  SCEN_MANUAL_PRESS,
+  SCEN_RAIN_BOUNCE,
+  SCEN_RAIN_CLOSE,
+  SCEN_SNOW_MODBUS,
+  SCEN_WARM_RESTART,
+  SCEN_PREWARM,
+  SCEN_SWITCH_CHATTER,
+  SCEN_PART_OPEN,
+  SCEN_OBSTRUCTION,
+  SCEN_COUNT
+};
+
+static const char* const SCENARIO_NAMES[SCEN_COUNT] = {
+  "open", "close", "stop mid-travel", "jammed opener", "mid-travel stall",
+  "manual K2/K3 press", "rain sensor bounce", "rain auto-close", "RS485 snow sensor", "warm restart",
+  "inverter pre-warm", "limit switch chatter", "part-open target", "obstruction"
+};
+
+struct ScenarioStats {
+  unsigned long runs = 0;
+  unsigned long failures = 0;
+};
+
+static ScenarioStats scenarioStats[SCEN_COUNT];
+static unsigned long stallWarnings = 0;
+static uint64_t stallWarningLeadMs = 0;
+static std::mt19937 rng;
+
+static bool fail(const char* scenario, const char* why) {
+  fprintf(stderr, "FAIL [%s] at t=%.3fs: %s (roof=%s, op=%s, position=%.3f)\n",
+          scenario, simNowMicros() / 1e6, why, getRoofStatusString().c_str(),
+          OP_STATE_NAMES[roofOpState], plant->position());
+  return false;
+}
+
+static bool scenarioOpen() {
+  // A warm start presses K2 inside the command step itself
+  uint32_t presses = plant->buttonPresses();
+  if (submitCommand(CMD_OPEN) != COMMAND_ACCEPTED) return fail("open", "open command refused");
+
+  // A repeated OPEN must not press K2 again (that would stop the opener)
+  if (submitCommand(CMD_OPEN) != COMMAND_COALESCED) return fail("open", "repeated open not coalesced");
+  if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+    return fail("open", "roof did not reach OPEN");
+  }
+  if (plant->buttonPresses() != presses + 1) return fail("open", "K2 pressed more than once");
+  if (opts.keepWarmMinutes > 0) {
+    // The close that follows starts inside the keep-warm window
+    if (!getInverterKeepWarmStats().active || !plant->acPresent()) return fail("open", "inverter not kept warm");
+  } else if (plant->acPresent()) {
+    return fail("open", "inverter left running");
+  }
+  return true;
+}
+
+static bool scenarioClose() {
+  uint32_t avoided = getInverterKeepWarmStats().spinUpsAvoided;
+  if (!runCommand(CMD_CLOSE)) return fail("close", "close command refused");
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+    return fail("close", "roof did not reach CLOSED");
+  }
+  if (opts.keepWarmMinutes > 0) {
+    if (getInverterKeepWarmStats().spinUpsAvoided != avoided + 1) return fail("close", "warm start not taken");
+    // Let the window run out: the inverter must go down through the normal shutdown
+    if (!runUntil([] { return !getInverterKeepWarmStats().active && controllerIdle(); },
+                  opts.keepWarmMinutes * 60000UL + 5000)) {
+      return fail("close", "keep-warm window did not expire");
+    }
+  }
+  if (plant->acPresent()) return fail("close", "inverter left running");
+  return true;
+}
+
+static bool scenarioStop() {
+  std::uniform_real_distribution<double> where(0.2, 0.8);
+  double stopAt = where(rng);
+
+  if (!runCommand(CMD_OPEN)) return fail("stop", "open command refused");
+  if (!runUntil([stopAt] { return plant->position() >= stopAt; }, moveBudgetMs())) {
+    return fail("stop", "roof never reached stop point");
+  }
+  // STOP overtakes queued work: K2 is pressed before the next control step,
+  // and a movement request queued ahead of it is pre-empted
+  uint32_t reverse = queueRoofCommand(CMD_CLOSE, SOURCE_INTERNAL);
+  abortRequestNs = hostNanos();
+  uint32_t stop = queueRoofCommand(CMD_STOP, SOURCE_INTERNAL);
+  if (stop == 0) return fail("stop", "stop command refused");
+  runAbortWake();
+  abortRequestNs = 0;
+  if (simGetOutputLevel(ROOF_CONTROL_PIN) != HIGH) return fail("stop", "abort did not press K2 ahead of the step");
+  if (!runUntil([stop] { RoofCommandOutcome o; return roofCommandFinished(stop, o); }, 100)) {
+    return fail("stop", "no stop result");
+  }
+  RoofCommandOutcome reverseOutcome = COMMAND_PENDING;
+  if (!roofCommandFinished(reverse, reverseOutcome) || reverseOutcome != COMMAND_PREEMPTED) {
+    return fail("stop", "queued close was not pre-empted by stop");
+  }
+  if (abortLastNs > ABORT_LATENCY_BOUND_US * 1000ULL) {
+    return fail("stop", "abort latency over its bound");
+  }
+  if (!runUntil([] { return !plant->moving(); }, 1000)) {
+    return fail("stop", "opener still running 1s after stop");
+  }
+  if (!runUntil(controllerIdle, 5000)) return fail("stop", "stop sequence did not finish");
+  // A clean stop keeps the inverter warm like an arrival does
+  if (opts.keepWarmMinutes == 0 && digitalRead(INVERTER_PIN) != LOW) {
+    return fail("stop", "K1 still energized after stop");
+  }
+
+  // The controller keeps reporting movement until the movement timeout latches an error
+  if (!runUntil([] { return roofStatus == ROOF_ERROR; }, movementTimeout + 5000)) {
+    return fail("stop", "stopped roof never reported ERROR");
+  }
+  if (!runUntil(controllerIdle, 5000)) return fail("stop", "timeout shutdown did not finish");
+  if (plant->acPresent()) return fail("stop", "inverter left running after the timeout");
+  recoverTo(0.0);
+  return roofStatus == ROOF_CLOSED ? true : fail("stop", "recovery to CLOSED failed");
+}
+
+static bool scenarioJam() {
+  plant->setFault(PLANT_FAULT_JAMMED);
+  if (!runCommand(CMD_OPEN)) return fail("jam", "open command refused");
+  if (!runUntil([] { return roofStatus == ROOF_ERROR; }, moveBudgetMs())) {
+    return fail("jam", "jammed opener not detected");
+  }
+  // Whichever check has the tighter bound wins: the encoder's start time, or a
+  // (learned) limit switch timeout on the closed switch never releasing
+  bool encoderFirst = opts.encoder && getEffectiveLimitSwitchTimeout(MOVE_OPEN) > ENCODER_START_MS;
+  RoofErrorCode expected = encoderFirst ? ROOF_ERR_ENCODER_STALL : ROOF_ERR_OPEN_START_FAILED;
+  if (roofError.code != expected) return fail("jam", "wrong error code recorded");
+  if (getSafetyReasons() != SAFETY_ROOF_ERROR) return fail("jam", "roof error not reported unsafe");
+  if (!runUntil(controllerIdle, 5000)) return fail("jam", "inverter shutdown did not finish");
+  if (plant->acPresent()) return fail("jam", "inverter left running");
+  recoverTo(0.0);
+  if (!isConditionSafe()) return fail("jam", "still unsafe after recovery");
+  return roofStatus == ROOF_CLOSED ? true : fail("jam", "recovery to CLOSED failed");
+}
+
+// With the encoder the stall is caught within ENCODER_STALL_MS of the drive stopping
+static bool scenarioEncoderStall() {
+  uint32_t stalls = getRoofEncoderStats().stalls;
+  if (!runUntil([] { return plant->position() > 0.1 && !plant->moving(); }, moveBudgetMs())) {
+    return fail("stall", "plant never stalled");
+  }
+  uint64_t stoppedUs = simNowMicros();
+  if (!runUntil([] { return roofStatus == ROOF_ERROR; }, ENCODER_STALL_MS + 200)) {
+    return fail("stall", "stall not detected by the encoder");
+  }
+  if (roofError.code != ROOF_ERR_ENCODER_STALL) return fail("stall", "wrong error code recorded");
+  if (getRoofEncoderStats().stalls != stalls + 1) return fail("stall", "stall not counted");
+  stallWarnings++;
+  stallWarningLeadMs += (simNowMicros() - stoppedUs) / 1000;
+  if (!runUntil(controllerIdle, 5000)) return fail("stall", "stop sequence did not finish");
+  recoverTo(0.0);
+  return roofStatus == ROOF_CLOSED ? true : fail("stall", "recovery to CLOSED failed");
+}
+
+static bool scenarioStall() {
+  plant->setFault(PLANT_FAULT_STALL_MIDWAY);
+  if (!runCommand(CMD_OPEN)) return fail("stall", "open command refused");
+  if (opts.encoder) return scenarioEncoderStall();
+
+  // With a travel profile on record the position estimator should warn before the timeout
+  bool expectWarning = getMoveStats(MOVE_OPEN, METRIC_TRAVEL).samples >= ADAPTIVE_MIN_SAMPLES;
+  uint64_t warnedUs = 0;
+  if (!runUntil([&warnedUs] {
+        if (warnedUs == 0 && getStallWarning()[0] != '\0') warnedUs = simNowMicros();
+        return roofStatus == ROOF_ERROR;
+      }, movementTimeout + moveBudgetMs())) {
+    return fail("stall", "stall not detected by movement timeout");
+  }
+  if (roofError.code != ROOF_ERR_OPEN_TIMEOUT) return fail("stall", "wrong error code recorded");
+  if (warnedUs != 0) {
+    stallWarnings++;
+    stallWarningLeadMs += (simNowMicros() - warnedUs) / 1000;
+  } else if (expectWarning) {
+    return fail("stall", "no stall warning before the movement timeout");
+  }
+  if (!runUntil(controllerIdle, 5000)) return fail("stall", "stop sequence did not finish");
+  recoverTo(0.0);
+  return roofStatus == ROOF_CLOSED ? true : fail("stall", "recovery to CLOSED failed");
+}
+
+// Web UI button presses must return without holding the control step
+static bool scenarioManualPress() {
+  uint32_t roofPress = queueRoofCommand(CMD_ROOF_BUTTON, SOURCE_INTERNAL);
+  uint32_t inverterPress = queueRoofCommand(CMD_INVERTER_BUTTON, SOURCE_INTERNAL);
+  if (roofPress == 0 || inverterPress == 0) return fail("manual", "press not queued");
+
+  uint64_t before = simNowMicros();
+  TIME_STEP(STEP_PROCESS_ROOF_COMMANDS, processRoofCommands());
+  if (simNowMicros() != before) return fail("manual", "press blocked the control step");
+  if (simGetOutputLevel(ROOF_CONTROL_PIN) != HIGH || simGetOutputLevel(INVERTER_BUTTON_PIN) != HIGH) {
+    return fail("manual", "relays not energized by the command");
+  }
+  RoofCommandOutcome outcome = COMMAND_PENDING;
+  processControlEvents();
+  if (!roofCommandFinished(inverterPress, outcome) || outcome != COMMAND_ACCEPTED) {
+    return fail("manual", "no command result");
+  }
+  if (!runUntil([] { return !isRelayPulseActive(RELAY_K2) && !isRelayPulseActive(RELAY_K3); },
+                RELAY_PRESS_MS + RELAY_SETTLE_MS + 100)) {
+    return fail("manual", "pulses did not complete");
+  }
+  // The K3 press toggled the inverter soft-power on (K1 is off, so no AC); put it back
+  if (!runCommand(CMD_INVERTER_BUTTON)) return fail("manual", "press not queued");
+  runUntil([] { return !isRelayPulseActive(RELAY_K3); }, RELAY_PRESS_MS + RELAY_SETTLE_MS + 100);
+  return roofStatus == ROOF_CLOSED ? true : fail("manual", "roof status changed");
+}
+
+// The rain input only changes state once it has held a level for its own stable time
+static bool scenarioRainBounce() {
+  uint32_t changes = getInputChannelStats(INPUT_RAIN).changes;
+
+  // Chatter shorter than the stable time must never get through
+  std::uniform_int_distribution<uint32_t> chatterMs(1, 40);
+  for (int i = 0; i < 20; i++) {
+    simSetInputLevel(RAIN_SENSOR_PIN, (i & 1) ? HIGH : LOW);
+    runForMs(chatterMs(rng));
+  }
+  simSetInputLevel(RAIN_SENSOR_PIN, LOW);
+  uint64_t heldFromUs = simNowMicros();
+  if (!runUntil([] { return rainDetected; }, RAIN_SENSOR_STABLE_TIME + 100)) {
+    return fail("rain", "rain never detected");
+  }
+  uint64_t heldMs = (simNowMicros() - heldFromUs) / 1000;
+  if (heldMs + 1 < RAIN_SENSOR_STABLE_TIME) return fail("rain", "rain reported before its stable time");
+  if (getRoofSnapshot().rainDetected != true) return fail("rain", "snapshot missed the rain state");
+
+  simSetInputLevel(RAIN_SENSOR_PIN, HIGH);
+  if (!runUntil([] { return !rainDetected; }, RAIN_SENSOR_STABLE_TIME + 100)) {
+    return fail("rain", "rain never cleared");
+  }
+  if (getInputChannelStats(INPUT_RAIN).changes != changes + 2) return fail("rain", "chatter leaked through");
+  if (roofStatus != ROOF_CLOSED) return fail("rain", "roof status changed");
+
+  // The trip found the roof closed; wait out the re-open lockout for the next scenario
+  if (!runUntil([] { return !rainReopenLocked(); }, rainReopenLockoutMs + 1000)) {
+    return fail("rain", "re-open lockout never ended");
+  }
+  return true;
+}
+
+// Rain auto-close variants, in turn: roof open; roof opening (stop, then close);
+// telescope unparked (close waits for park); shower shorter than the hold-off
+enum RainVariant { RAIN_ROOF_OPEN, RAIN_ROOF_OPENING, RAIN_UNPARKED, RAIN_HOLDOFF, RAIN_VARIANT_COUNT };
+static unsigned long rainCloseRuns = 0;
+static const unsigned long SIM_RAIN_HOLDOFF_MS = 4000;
+
+// Worst edge-to-K2 the fast path may take: sensor stable time, a control
+// period, the stop-and-reverse gap and a full inverter spin-up
+static uint32_t rainLatencyBoundUs() {
+  uint32_t spinUpMs = inverterDelay1 + RELAY_PRESS_MS + RELAY_SETTLE_MS + inverterDelay2;
+  uint32_t reverseMs = RELAY_PRESS_MS + RAIN_REVERSE_SETTLE_MS;
+  return (RAIN_SENSOR_STABLE_TIME + 2 * opts.tickMs + reverseMs + spinUpMs) * 1000UL;
+}
+
+static bool scenarioRainClose() {
+  RainVariant variant = (RainVariant)(rainCloseRuns++ % RAIN_VARIANT_COUNT);
+  RainCloseStats before = getRainCloseStats();
+
+  if (variant == RAIN_ROOF_OPENING) {
+    if (!runCommand(CMD_OPEN)) return fail("rain close", "open command refused");
+    if (!runUntil([] { return plant->position() >= 0.2; }, moveBudgetMs())) {
+      return fail("rain close", "roof never started opening");
+    }
+  } else {
+    if (!runCommand(CMD_OPEN)) return fail("rain close", "open command refused");
+    if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+      return fail("rain close", "roof did not reach OPEN");
+    }
+  }
+  if (variant == RAIN_UNPARKED) plant->setTelescopeParked(false);
+  if (variant == RAIN_HOLDOFF) rainHoldoffMs = SIM_RAIN_HOLDOFF_MS;
+
+  simSetInputLevel(RAIN_SENSOR_PIN, LOW);
+  uint32_t trips = before.trips;
+  if (!runUntil([trips] { return getRainCloseStats().trips > trips; }, RAIN_SENSOR_STABLE_TIME + 100)) {
+    return fail("rain close", "rain trip not raised");
+  }
+  if ((getSafetyReasons() & SAFETY_RAIN) == 0) return fail("rain close", "rain not reported unsafe");
+
+  if (variant == RAIN_HOLDOFF) {
+    // Shower clears before the hold-off runs out: no close, roof stays open
+    runForMs(500);
+    simSetInputLevel(RAIN_SENSOR_PIN, HIGH);
+    if (!runUntil([] { return !getRainCloseStats().pending; }, SIM_RAIN_HOLDOFF_MS)) {
+      return fail("rain close", "cleared shower still pending");
+    }
+    rainHoldoffMs = 0;
+    if (getRainCloseStats().cleared != before.cleared + 1) return fail("rain close", "cleared trip not counted");
+    if (roofStatus != ROOF_OPEN || plant->moving()) return fail("rain close", "roof moved for a cleared shower");
+    if (submitCommand(CMD_OPEN) != COMMAND_ALREADY_DONE) return fail("rain close", "open not already done");
+    if (!runUntil([] { return !rainReopenLocked(); }, rainReopenLockoutMs + 1000)) {
+      return fail("rain close", "re-open lockout never ended");
+    }
+    if (!runCommand(CMD_CLOSE)) return fail("rain close", "close command refused");
+    if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+      return fail("rain close", "roof did not reach CLOSED");
+    }
+    return true;
+  }
+
+  if (variant == RAIN_UNPARKED) {
+    // The park interlock holds the close; it starts as soon as the telescope parks
+    runForMs(3000);
+    if (plant->moving() || roofStatus != ROOF_OPEN) return fail("rain close", "closed with telescope unparked");
+    if (getRainCloseStats().interlockWaits != before.interlockWaits + 1) {
+      return fail("rain close", "interlock wait not counted");
+    }
+    plant->setTelescopeParked(true);
+  }
+
+  if (!runUntil([] { return getRainCloseStats().latencySamples > 0 && !getRainCloseStats().pending; },
+                moveBudgetMs())) {
+    return fail("rain close", "close K2 never pressed");
+  }
+  RainCloseStats after = getRainCloseStats();
+  if (after.latencySamples != before.latencySamples + 1) return fail("rain close", "latency not recorded");
+  if (variant == RAIN_ROOF_OPENING && after.stoppedOpening != before.stoppedOpening + 1) {
+    return fail("rain close", "opening roof not stopped first");
+  }
+  if (variant != RAIN_UNPARKED && after.lastEdgeToK2Us > rainLatencyBoundUs()) {
+    return fail("rain close", "edge-to-K2 latency over its bound");
+  }
+
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+    return fail("rain close", "roof did not reach CLOSED");
+  }
+  if (plant->position() > 0.0) return fail("rain close", "plant not closed");
+
+  // Opening is refused while it rains (including a K2 press that would open)
+  if (submitCommand(CMD_OPEN) != COMMAND_REJECTED_RAIN) return fail("rain close", "open allowed in the rain");
+  if (submitCommand(CMD_ROOF_BUTTON) != COMMAND_REJECTED_RAIN) return fail("rain close", "K2 press allowed in the rain");
+
+  // ...and for the lockout after the sensor dries
+  simSetInputLevel(RAIN_SENSOR_PIN, HIGH);
+  if (!runUntil([] { return !rainDetected; }, RAIN_SENSOR_STABLE_TIME + 100)) {
+    return fail("rain close", "rain never cleared");
+  }
+  if (submitCommand(CMD_OPEN) != COMMAND_REJECTED_RAIN) return fail("rain close", "open allowed in the lockout");
+  if (getSafetyReasons() != SAFETY_WEATHER_LOCKOUT) return fail("rain close", "lockout not reported unsafe");
+  if (!runUntil([] { return !rainReopenLocked(); }, rainReopenLockoutMs + 1000)) {
+    return fail("rain close", "re-open lockout never ended");
+  }
+  if (!isConditionSafe()) return fail("rain close", "still unsafe after the lockout");
+  if (!runUntil(controllerIdle, 5000)) return fail("rain close", "inverter shutdown did not finish");
+  return true;
+}
+
+// RS485 snow sensor variants, in turn: cached readings and bus timing; one
+// reply of each fault kind; sensor offline and back; snow closes an open roof
+enum SnowVariant { SNOW_READINGS, SNOW_FAULTS, SNOW_OFFLINE, SNOW_CLOSE, SNOW_VARIANT_COUNT };
+static unsigned long snowRuns = 0;
+static const uint32_t SIM_MODBUS_TURNAROUND_US = 5000;
+
+static uint32_t modbusCharUs() {
+  return (10UL * 1000000UL + SNOW_MODBUS_BAUD - 1) / SNOW_MODBUS_BAUD;
+}
+
+// The master must keep the slave's framing rules and never talk over it
+static bool snowBusClean(const char* scenario) {
+  const SimModbusSlaveStats& slave = snowSlave->stats();
+  SimUartStats uart = simUartGetStats(SnowSerial);
+  if (slave.gapViolations != 0) return fail(scenario, "request inside the T3.5 gap");
+  if (slave.charGapViolations != 0) return fail(scenario, "request characters more than T1.5 apart");
+  if (slave.badRequests != 0) return fail(scenario, "malformed request");
+  if (uart.collisions != 0) return fail(scenario, "master and slave drove the bus together");
+  // RE/DE is asserted for the 8-byte request only
+  if (uart.rtsHighUs > 8 * modbusCharUs()) return fail(scenario, "RE/DE held past the request");
+  return true;
+}
+
+static bool waitSnowResult(uint32_t ModbusMasterStats::*counter, uint32_t before) {
+  return runUntil([counter, before] { return getModbusMasterStats().*counter > before; },
+                  2 * SNOW_MODBUS_POLL_MS + MODBUS_RESPONSE_TIMEOUT_MS);
+}
+
+static bool scenarioSnowModbus() {
+  SnowVariant variant = (SnowVariant)(snowRuns++ % SNOW_VARIANT_COUNT);
+  ModbusMasterStats before = getModbusMasterStats();
+
+  if (variant == SNOW_READINGS) {
+    std::uniform_int_distribution<uint32_t> value(0, 65535);
+    uint16_t raw = (uint16_t)value(rng);
+    snowSlave->setRegister(SNOW_MODBUS_START_REGISTER + SNOW_MODBUS_VALUE_INDEX, raw);
+    if (!waitSnowResult(&ModbusMasterStats::replies, before.replies)) {
+      return fail("snow", "no reply from the snow sensor");
+    }
+    // The reply must be fresh: the poll after the change must carry it
+    if (!waitSnowResult(&ModbusMasterStats::replies, getModbusMasterStats().replies)) {
+      return fail("snow", "no second reply");
+    }
+    SnowSensorReading reading = getRoofSnapshot().snowSensor;
+    if (!reading.online) return fail("snow", "sensor not online");
+    if (reading.registers[SNOW_MODBUS_VALUE_INDEX] != raw) return fail("snow", "cached register is stale");
+    if (millis() - reading.lastReplyMs > SNOW_MODBUS_POLL_MS) return fail("snow", "reading older than a poll");
+
+    // Request, turnaround, 2 + 2N + 2 byte reply and the RX timeout, plus one control period
+    ModbusMasterStats after = getModbusMasterStats();
+    uint32_t wireUs = (8 + 5 + 2 * SNOW_MODBUS_REGISTER_COUNT + MODBUS_RX_TIMEOUT_SYMBOLS) * modbusCharUs();
+    if (after.lastRoundTripUs < wireUs + SIM_MODBUS_TURNAROUND_US) return fail("snow", "reply faster than the wire");
+    if (after.lastRoundTripUs > wireUs + SIM_MODBUS_TURNAROUND_US + opts.tickMs * 1000) {
+      return fail("snow", "reply frame end detected late");
+    }
+    return snowBusClean("snow");
+  }
+
+  if (variant == SNOW_FAULTS) {
+    struct { SimModbusFault fault; uint32_t ModbusMasterStats::*counter; const char* why; } faults[] = {
+      {MODBUS_FAULT_BAD_CRC, &ModbusMasterStats::crcErrors, "bad CRC not detected"},
+      {MODBUS_FAULT_SILENT, &ModbusMasterStats::timeouts, "missing reply not timed out"},
+      {MODBUS_FAULT_EXCEPTION, &ModbusMasterStats::exceptions, "exception reply not detected"},
+      {MODBUS_FAULT_LINE_ERROR, &ModbusMasterStats::uartErrors, "UART error not counted"},
+    };
+    for (auto& f : faults) {
+      ModbusMasterStats start = getModbusMasterStats();
+      snowSlave->setFault(f.fault);
+      if (!waitSnowResult(f.counter, start.*(f.counter))) return fail("snow", f.why);
+      // The next poll goes through again
+      if (!waitSnowResult(&ModbusMasterStats::replies, getModbusMasterStats().replies)) {
+        return fail("snow", "no good reply after a fault");
+      }
+    }
+    ModbusMasterStats after = getModbusMasterStats();
+    if (after.replies - before.replies < 4) return fail("snow", "good replies lost around the faults");
+    if (!getRoofSnapshot().snowSensor.online) return fail("snow", "single faults took the sensor offline");
+    return snowBusClean("snow");
+  }
+
+  if (variant == SNOW_OFFLINE) {
+    uint32_t offline = getSnowSensorStats().offlineEvents;
+    snowSlave->setOnline(false);
+    if (!runUntil([] { return !getRoofSnapshot().snowSensor.online; },
+                  SNOW_MODBUS_STALE_MS + SNOW_MODBUS_POLL_MS + 100)) {
+      snowSlave->setOnline(true);
+      return fail("snow", "silent sensor never went offline");
+    }
+    bool flagged = getSafetyReasons() == SAFETY_SNOW_SENSOR_OFFLINE;
+    snowSlave->setOnline(true);
+    if (getSnowSensorStats().offlineEvents != offline + 1) return fail("snow", "offline not counted");
+    if (!flagged) return fail("snow", "offline sensor not reported unsafe");
+    if (!runUntil([] { return getRoofSnapshot().snowSensor.online; }, 2 * SNOW_MODBUS_POLL_MS + 100)) {
+      return fail("snow", "sensor did not come back online");
+    }
+    if (!isConditionSafe()) return fail("snow", "still unsafe with the sensor back online");
+    return snowBusClean("snow");
+  }
+
+  // SNOW_CLOSE: the snow register trips the rain auto-close after the confirming reads
+  RainCloseStats rainBefore = getRainCloseStats();
+  if (!runCommand(CMD_OPEN)) return fail("snow close", "open command refused");
+  if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+    return fail("snow close", "roof did not reach OPEN");
+  }
+  snowSlave->setRegister(SNOW_MODBUS_START_REGISTER + SNOW_MODBUS_STATE_INDEX, 1);
+  uint64_t setUs = simNowMicros();
+  uint32_t trips = rainBefore.trips;
+  if (!runUntil([trips] { return getRainCloseStats().trips > trips; },
+                (SNOW_MODBUS_CONFIRM_READS + 1) * SNOW_MODBUS_POLL_MS + 100)) {
+    return fail("snow close", "snow trip not raised");
+  }
+  if ((simNowMicros() - setUs) / 1000 + SNOW_MODBUS_POLL_MS < SNOW_MODBUS_CONFIRM_READS * SNOW_MODBUS_POLL_MS) {
+    return fail("snow close", "snow tripped before its confirming reads");
+  }
+  if (getRainTrip(0).source != TRIP_SNOW_SENSOR) return fail("snow close", "trip not attributed to the snow sensor");
+  if ((getSafetyReasons() & SAFETY_RS485_SNOW) == 0) return fail("snow close", "snow not reported unsafe");
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+    return fail("snow close", "roof did not reach CLOSED");
+  }
+  if (submitCommand(CMD_OPEN) != COMMAND_REJECTED_RAIN) return fail("snow close", "open allowed in the snow");
+
+  snowSlave->setRegister(SNOW_MODBUS_START_REGISTER + SNOW_MODBUS_STATE_INDEX, 0);
+  if (!runUntil([] { return !getRoofSnapshot().snowSensor.snow; },
+                (SNOW_MODBUS_CONFIRM_READS + 1) * SNOW_MODBUS_POLL_MS + 100)) {
+    return fail("snow close", "snow never cleared");
+  }
+  if (submitCommand(CMD_OPEN) != COMMAND_REJECTED_RAIN) return fail("snow close", "open allowed in the lockout");
+  if (!runUntil([] { return !rainReopenLocked(); }, rainReopenLockoutMs + 1000)) {
+    return fail("snow close", "re-open lockout never ended");
+  }
+  if (!isConditionSafe()) return fail("snow close", "still unsafe after the lockout");
+  if (!runUntil(controllerIdle, 5000)) return fail("snow close", "inverter shutdown did not finish");
+  return snowBusClean("snow close");
+}
+
+// Warm restart variants, in turn: brownout mid-open; brownout mid-close;
+// watchdog reset during the inverter power-up; power-on reset mid-open (no
+// resume); brownout mid-close with RTC memory lost (NVS copy)
+enum RestartVariant {
+  RESTART_MID_OPEN, RESTART_MID_CLOSE, RESTART_SEQUENCE, RESTART_COLD, RESTART_NVS, RESTART_VARIANT_COUNT
+};
+static unsigned long restartRuns = 0;
+static unsigned long resumesReversed = 0;
+static unsigned long resumesRestarted = 0;
+static unsigned long resumesFromNvs = 0;
+static const uint32_t SIM_BOOT_MS = 300;     // Reset to the relays being driven again
+
+// Reset the chip: relays drop, the plant runs on alone through the boot, and
+// the firmware's boot path runs again with whatever RTC memory kept
+// Sampler events still queued for the controller are lost with the rest of RAM
+static void discardInputEvents() {
+  InputEvent event;
+  while (popInputEvent(event)) {}
+  takeInputEventOverflow();
+}
+
+static void warmReset(esp_reset_reason_t reason, bool loseRtc) {
+  static const uint8_t relayPins[] = {INVERTER_PIN, ROOF_CONTROL_PIN, INVERTER_BUTTON_PIN};
+  for (uint8_t pin : relayPins) digitalWrite(pin, LOW);
+  for (uint32_t i = 0; i < SIM_BOOT_MS; i++) {
+    simAdvanceMicros(1000);
+    plant->step(simNowMicros());
+  }
+
+  // RAM state a reset clears
+  roofOpState = OP_IDLE;
+  roofOpTarget = TARGET_NONE;
+  cancelRelayPulses(RELAY_K2);
+  cancelRelayPulses(RELAY_K3);
+  telemetryMoveDiscard();
+  discardInputEvents();   // The sampler timer kept running through the boot window
+  if (loseRtc) simLoseRtcMemory();
+
+  simSetResetReason(reason);
+  initializeRoofController();
+  simSetResetReason(ESP_RST_POWERON);
+  publishRoofSnapshot();
+}
+
+static bool scenarioWarmRestart() {
+  RestartVariant variant = (RestartVariant)(restartRuns++ % RESTART_VARIANT_COUNT);
+  // Keep-warm starts press K2 at once, leaving no power-up sequence to interrupt
+  if (variant == RESTART_SEQUENCE && getInverterKeepWarmStats().active) variant = RESTART_MID_OPEN;
+  bool closing = (variant == RESTART_MID_CLOSE || variant == RESTART_NVS);
+
+  if (closing) {
+    if (!runCommand(CMD_OPEN)) return fail("warm restart", "open command refused");
+    if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+      return fail("warm restart", "roof did not reach OPEN");
+    }
+  }
+  RoofCommandType command = closing ? CMD_CLOSE : CMD_OPEN;
+  RoofStatus target = closing ? ROOF_CLOSED : ROOF_OPEN;
+  if (!runCommand(command)) return fail("warm restart", "move command refused");
+
+  if (variant == RESTART_SEQUENCE) {
+    runForMs(inverterDelay1 / 2);
+    if (roofOpState != OP_INVERTER_POWER_ON) return fail("warm restart", "not in the power-up sequence");
+  } else {
+    std::uniform_real_distribution<double> where(0.3, 0.7);
+    double resetAt = where(rng);
+    if (!runUntil([closing, resetAt] {
+          return plant->moving() && (closing ? plant->position() <= resetAt : plant->position() >= resetAt);
+        }, moveBudgetMs())) {
+      return fail("warm restart", "roof never reached the reset point");
+    }
+    // Let the network task mirror the moving phase to NVS
+    runForMs(RESUME_NVS_COALESCE_MS + 2 * opts.tickMs);
+  }
+
+  uint32_t presses = plant->buttonPresses();
+  warmReset(variant == RESTART_COLD ? ESP_RST_POWERON :
+            variant == RESTART_SEQUENCE ? ESP_RST_TASK_WDT : ESP_RST_BROWNOUT,
+            variant == RESTART_NVS);
+  ResumeStats resume = getResumeStats();
+
+  if (variant == RESTART_COLD) {
+    if (resume.outcome != RESUME_COLD_BOOT) return fail("warm restart", "power-on reset resumed a move");
+    if (roofStatus != ROOF_ERROR || roofError.code != ROOF_ERR_STARTUP_UNKNOWN) {
+      return fail("warm restart", "power-on reset mid-travel did not latch unknown position");
+    }
+    recoverTo(0.0);
+    return roofStatus == ROOF_CLOSED ? true : fail("warm restart", "recovery to CLOSED failed");
+  }
+
+  ResumeOutcome expected = (variant == RESTART_SEQUENCE) ? RESUME_RESTARTED : RESUME_REVERSED;
+  if (resume.outcome != expected) return fail("warm restart", "wrong resume decision");
+  if (resume.source != (variant == RESTART_NVS ? RESUME_SOURCE_NVS : RESUME_SOURCE_RTC)) {
+    return fail("warm restart", "snapshot read from the wrong copy");
+  }
+  if (roofStatus == ROOF_ERROR) return fail("warm restart", "error latched after the reset");
+
+  bool errored = false;
+  if (!runUntil([target, &errored] {
+        errored |= (roofStatus == ROOF_ERROR);
+        return errored || (roofStatus == target && controllerIdle());
+      }, moveBudgetMs())) {
+    return fail("warm restart", "interrupted move did not finish");
+  }
+  if (errored) return fail("warm restart", "resumed move ended in ERROR");
+  // Reversal: one press runs the wrong way, one stops it, one goes to the target
+  if (plant->buttonPresses() - presses != (expected == RESUME_REVERSED ? 3u : 1u)) {
+    return fail("warm restart", "unexpected number of K2 presses");
+  }
+
+  if (expected == RESUME_REVERSED) resumesReversed++;
+  else resumesRestarted++;
+  if (variant == RESTART_NVS) resumesFromNvs++;
+
+  if (closing) return true;
+  if (!runCommand(CMD_CLOSE)) return fail("warm restart", "close command refused");
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+    return fail("warm restart", "roof did not return to CLOSED");
+  }
+  return true;
+}
+
+// Pre-warm variants, in turn: open inside the window; open during the
+// power-up; window runs out with no open. The hit is started by an Alpaca
+// connect, the first time with isConnected still at its boot default
+enum PrewarmVariant { PREWARM_HIT, PREWARM_JOIN, PREWARM_EXPIRY, PREWARM_VARIANT_COUNT };
+static unsigned long prewarmRuns = 0;
+
+static bool scenarioPrewarm() {
+  PrewarmVariant variant = (PrewarmVariant)(prewarmRuns++ % PREWARM_VARIANT_COUNT);
+  // Join and expiry need a cold inverter; a hit may take over a keep-warm window
+  if (variant != PREWARM_HIT &&
+      !runUntil([] { return !getInverterKeepWarmStats().active && controllerIdle(); },
+                opts.keepWarmMinutes * 60000UL + 5000)) {
+    return fail("prewarm", "keep-warm window did not expire");
+  }
+  InverterPrewarmStats before = getInverterPrewarmStats();
+
+  if (variant == PREWARM_HIT) {
+    inverterPrewarmOnConnect = true;
+    uint32_t id = setAlpacaConnected(true);
+    inverterPrewarmOnConnect = false;
+    if (id == 0) return fail("prewarm", "Alpaca connect did not pre-warm");
+    runAbortWake();
+    RoofCommandOutcome outcome = COMMAND_PENDING;
+    if (!runUntil([id, &outcome] { return roofCommandFinished(id, outcome); }, 100) ||
+        !roofCommandSucceeded(outcome)) {
+      return fail("prewarm", "Alpaca connect pre-warm refused");
+    }
+  } else if (!runCommand(CMD_PREWARM)) {
+    return fail("prewarm", "pre-warm command refused");
+  }
+  if (submitCommand(CMD_PREWARM) != COMMAND_COALESCED) return fail("prewarm", "repeated pre-warm not coalesced");
+  if (plant->moving() || roofStatus != ROOF_CLOSED) return fail("prewarm", "pre-warm moved the roof");
+
+  if (variant == PREWARM_JOIN) {
+    runForMs(inverterDelay1 / 2);
+    if (!isInverterPrewarmRunning()) return fail("prewarm", "not in the pre-warm power-up");
+  } else if (!runUntil([] { return getInverterPrewarmStats().active; }, moveBudgetMs())) {
+    return fail("prewarm", "pre-warm window never opened");
+  } else if (!plant->acPresent() || !controllerIdle()) {
+    return fail("prewarm", "inverter not running in the window");
+  }
+
+  if (variant == PREWARM_EXPIRY) {
+    if (!runUntil([] { return !getInverterPrewarmStats().active && controllerIdle(); },
+                  inverterPrewarmMinutes * 60000UL + 5000)) {
+      return fail("prewarm", "pre-warm window did not expire");
+    }
+    if (getInverterPrewarmStats().expiries != before.expiries + 1) return fail("prewarm", "expiry not counted");
+    if (plant->acPresent()) return fail("prewarm", "inverter left running after the window");
+    return true;
+  }
+
+  // The open takes the inverter over: K2 at once in the window, after the
+  // rest of the power-up when joined
+  uint32_t presses = plant->buttonPresses();
+  if (!runCommand(CMD_OPEN)) return fail("prewarm", "open command refused");
+  if (variant == PREWARM_HIT && plant->buttonPresses() != presses + 1) {
+    return fail("prewarm", "pre-warmed open did not press K2 at once");
+  }
+  if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+    return fail("prewarm", "roof did not reach OPEN");
+  }
+  InverterPrewarmStats after = getInverterPrewarmStats();
+  if (after.hits != before.hits + 1) return fail("prewarm", "hit not counted");
+  if (after.joined != before.joined + (variant == PREWARM_JOIN ? 1u : 0u)) {
+    return fail("prewarm", "join not counted");
+  }
+  if (after.active || after.running) return fail("prewarm", "pre-warm outlived the open");
+  if (plant->buttonPresses() != presses + 1) return fail("prewarm", "K2 pressed more than once");
+
+  if (!runCommand(CMD_CLOSE)) return fail("prewarm", "close command refused");
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); }, moveBudgetMs())) {
+    return fail("prewarm", "roof did not return to CLOSED");
+  }
+  return true;
+}
+
+// A worn closed switch chattering under the parked roof: the sampler must hold
+// the roof state, and the switch health monitor must count the burst as one
+// glitch and alert once an epoch has collected enough of them
+static bool scenarioSwitchChatter() {
+  if (roofStatus != ROOF_CLOSED) return fail("chatter", "roof not closed");
+  uint32_t glitches = getSwitchHealthTotals(SWITCH_CLOSED).glitches;
+  uint32_t changes = getInputChannelStats(INPUT_LIMIT_CLOSED).changes;
+  int released = (TRIGGERED == HIGH) ? LOW : HIGH;
+
+  const int pulses = 3;
+  for (int i = 0; i < pulses; i++) {
+    simSetInputLevel(LIMIT_SWITCH_CLOSED_PIN, released);
+    runForMs(opts.tickMs);
+    simSetInputLevel(LIMIT_SWITCH_CLOSED_PIN, TRIGGERED);
+    runForMs(opts.tickMs);
+  }
+  runForMs(SWITCH_STABLE_TIME + 100);   // The burst closes after a quiet stable time
+
+  if (getInputChannelStats(INPUT_LIMIT_CLOSED).changes != changes) return fail("chatter", "chatter leaked through");
+  if (roofStatus != ROOF_CLOSED) return fail("chatter", "roof status changed");
+  if (getSwitchHealthTotals(SWITCH_CLOSED).glitches != glitches + 1) return fail("chatter", "glitch not counted");
+  const SwitchBounceRecord& last = getLastSwitchBounce(SWITCH_CLOSED);
+  if (!last.valid || last.flipped || last.bounces != pulses) return fail("chatter", "glitch bounces miscounted");
+
+  SwitchHealthTrend trend = getSwitchHealthTrend(SWITCH_CLOSED);
+  bool glitchAlert = (trend.alertReasons & SWITCH_ALERT_GLITCHES) != 0;
+  if (glitchAlert != (trend.recentGlitches >= SWITCH_GLITCH_ALERT_COUNT)) {
+    return fail("chatter", "glitch alert out of step with the glitch count");
+  }
+  if (glitchAlert && simSwitchHealthPublishCount == 0) return fail("chatter", "alert never published");
+  return true;
+}
+
+static const int SIM_ENCODER_PIN_A = 15;
+static const int SIM_ENCODER_PIN_B = 16;
+static const int32_t SIM_ENCODER_COUNTS = 40000;   // Closed to open: over two PCNT wraps each way
+
+// MOVE_TO stops the roof between the limit switches (one more K2 press) and
+// holds it there as OPEN. From closed, 40% then 70% needs the opener reversed
+// first (its last run was opening), 20% closes straight away, and the CLOSE
+// that follows reverses again (its last run was closing)
+static bool runToTarget(int percent, uint32_t expectedPresses) {
+  char why[64];
+  uint32_t presses = plant->buttonPresses();
+  if (submitCommand(CMD_MOVE_TO, (uint8_t)percent) != COMMAND_ACCEPTED) {
+    snprintf(why, sizeof(why), "move to %d%% refused", percent);
+    return fail("part-open", why);
+  }
+  if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); },
+                moveBudgetMs() + RESUME_REVERSE_SETTLE_MS)) {
+    snprintf(why, sizeof(why), "roof did not stop at %d%%", percent);
+    return fail("part-open", why);
+  }
+  double error = plant->position() * 100.0 - percent;
+  if (error > ENCODER_TARGET_TOLERANCE || error < -ENCODER_TARGET_TOLERANCE) {
+    snprintf(why, sizeof(why), "stopped %.1f%% away from %d%%", error, percent);
+    return fail("part-open", why);
+  }
+  if (!isRoofHeldPartOpen() || !getRoofSnapshot().heldPartOpen) return fail("part-open", "roof not held part-open");
+  if (plant->buttonPresses() != presses + expectedPresses) return fail("part-open", "wrong number of K2 presses");
+  runForMs(SWITCH_STABLE_TIME + 100);
+  return roofStatus == ROOF_OPEN ? true : fail("part-open", "hold lost while standing");
+}
+
+// MQTT, Alpaca and the web UI all parse MOVE_TO through this: junk must not
+// become 0 (a full close)
+static bool targetPercentParsed() {
+  static const char* const rejected[] = {"", "abc", "x", "-5", "+5", "12a", " 5", "101", "1000", "00000"};
+  uint8_t percent = 0;
+  for (const char* text : rejected) {
+    if (parseRoofTargetPercent(text, percent)) return false;
+  }
+  return parseRoofTargetPercent("0", percent) && percent == 0 &&
+         parseRoofTargetPercent("40", percent) && percent == 40 &&
+         parseRoofTargetPercent("100", percent) && percent == 100;
+}
+
+static bool scenarioPartOpen() {
+  if (!opts.encoder) return true;
+  if (!targetPercentParsed()) return fail("part-open", "bad target percent accepted");
+  if (roofStatus != ROOF_CLOSED) return fail("part-open", "roof not closed");
+  if (!isRoofEncoderCalibrated()) {
+    // First full open measures the span
+    if (!runCommand(CMD_OPEN)) return fail("part-open", "calibration open refused");
+    if (!runUntil([] { return roofStatus == ROOF_OPEN && controllerIdle(); }, moveBudgetMs())) {
+      return fail("part-open", "calibration open did not finish");
+    }
+    if (!isRoofEncoderCalibrated()) return fail("part-open", "span not learned on a full open");
+  }
+
+  uint32_t stops = getRoofEncoderStats().targetStops;
+  bool fromClosed = roofStatus == ROOF_CLOSED;
+  if (!runToTarget(40, 2)) return false;
+  if (!runToTarget(70, fromClosed ? 4 : 2)) return false;
+  if (!runToTarget(20, 2)) return false;
+  if (submitCommand(CMD_MOVE_TO, 20) != COMMAND_ALREADY_DONE) return fail("part-open", "repeat target moved the roof");
+  if (getRoofEncoderStats().targetStops != stops + 3) return fail("part-open", "target stops miscounted");
+
+  uint32_t presses = plant->buttonPresses();
+  if (!runCommand(CMD_CLOSE)) return fail("part-open", "close command refused");
+  if (!runUntil([] { return roofStatus == ROOF_CLOSED && controllerIdle(); },
+                moveBudgetMs() + RESUME_REVERSE_SETTLE_MS)) {
+    return fail("part-open", "roof did not close from the target");
+  }
+  if (plant->buttonPresses() != presses + 3) return fail("part-open", "wrong number of K2 presses");
+  if (opts.keepWarmMinutes > 0) {
+    runUntil([] { return !getInverterKeepWarmStats().active && controllerIdle(); },
+             opts.keepWarmMinutes * 60000UL + 5000);
+  }
+  return isRoofHeldPartOpen() ? fail("part-open", "hold survived the close") : true;
+}
+
+static const int SIM_CURRENT_PIN = 1;               // ADC1 channel 0
+static const int32_t SIM_CURRENT_RUNNING_COUNTS = 230;  // About 1 A RMS on a 185 mV/A Hall sensor
+static unsigned long obstructionTrips = 0;
+static uint64_t obstructionTripMs = 0;
+
+// Once the open envelope is learned, a motor pushing against an obstruction
+// is stopped on its current within MOTOR_CURRENT_TRIP_MS (plus the RMS
+// window and a DMA frame); before that the encoder or the movement timeout
+// has to catch it
+static bool scenarioObstruction() {
+  if (!opts.current) return true;
+  bool armed = getMotorCurrentEnvelope(MOVE_OPEN).moves >= MOTOR_CURRENT_MIN_MOVES;
+  uint32_t trips = getMotorCurrentStats().trips;
+
+  plant->setFault(PLANT_FAULT_OBSTRUCTED);
+  if (!runCommand(CMD_OPEN)) return fail("obstruction", "open command refused");
+  if (!runUntil([] { return plant->blocked(); }, moveBudgetMs())) {
+    return fail("obstruction", "roof never reached the obstruction");
+  }
+  uint64_t blockedUs = simNowMicros();
+  uint32_t budgetMs = armed ? MOTOR_CURRENT_TRIP_MS + 200 : movementTimeout + moveBudgetMs();
+  if (!runUntil([] { return roofStatus == ROOF_ERROR; }, budgetMs)) {
+    return fail("obstruction", armed ? "overcurrent not detected" : "obstruction not detected");
+  }
+
+  RoofErrorCode expected = armed ? ROOF_ERR_MOTOR_OVERCURRENT :
+                           opts.encoder ? ROOF_ERR_ENCODER_STALL : ROOF_ERR_OPEN_TIMEOUT;
+  if (roofError.code != expected) return fail("obstruction", "wrong error code recorded");
+  if (armed) {
+    if (getMotorCurrentStats().trips != trips + 1) return fail("obstruction", "trip not counted");
+    obstructionTrips++;
+    obstructionTripMs += (simNowMicros() - blockedUs) / 1000;
+    if (!runUntil([] { return !plant->moving(); }, 1000)) return fail("obstruction", "motor still pushing after the trip");
+  }
+  if (!runUntil(controllerIdle, 5000)) return fail("obstruction", "stop sequence did not finish");
+  if (plant->moving()) return fail("obstruction", "motor left pushing");
+  if (armed) {
+    const MotorCurrentProfile& profile = getMotorCurrentProfile(getMotorCurrentProfileCount() - 1);
+    if (profile.outcome != MOVE_OBSTRUCTED) return fail("obstruction", "profile not stored as obstructed");
+  }
+  recoverTo(0.0);
+  return roofStatus == ROOF_CLOSED ? true : fail("obstruction", "recovery to CLOSED failed");
+}
+
+static bool runScenario(Scenario s) {
+  switch (s) {
+    case SCEN_OPEN:  return scenarioOpen();
+    case SCEN_CLOSE: return scenarioClose();
+    case SCEN_STOP:  return scenarioStop();
+    case SCEN_JAM:   return scenarioJam();
+    case SCEN_STALL: return scenarioStall();
+    case SCEN_MANUAL_PRESS: return scenarioManualPress();
+    case SCEN_RAIN_BOUNCE: return scenarioRainBounce();
+    case SCEN_RAIN_CLOSE: return scenarioRainClose();
+    case SCEN_SNOW_MODBUS: return scenarioSnowModbus();
+    case SCEN_WARM_RESTART: return scenarioWarmRestart();
+    case SCEN_PREWARM: return scenarioPrewarm();
+    case SCEN_SWITCH_CHATTER: return scenarioSwitchChatter();
+    case SCEN_PART_OPEN: return scenarioPartOpen();
+    case SCEN_OBSTRUCTION: return scenarioObstruction();
+    default:         return false;
+  }
+}
+
+// ============== Reporting ==============
+
+static void printHistogramRow(const char* name, const StepHistogram& h) {
+  printf("  %-28s %10llu %8llu %8llu %8llu %8llu %8llu\n", name,
+         (unsigned long long)h.count(), (unsigned long long)h.min(),
+         (unsigned long long)h.mean(), (unsigned long long)h.percentile(50),
+         (unsigned long long)h.percentile(99), (unsigned long long)h.max());
+}
+
+static void printReport(double wallSeconds, unsigned long totalFailures) {
+  double simSeconds = simNowMicros() / 1e6;
+
+  printf("\nScenarios\n");
+  for (int s = 0; s < SCEN_COUNT; s++) {
+    printf("  %-20s runs %7lu  failures %lu\n", SCENARIO_NAMES[s],
+           scenarioStats[s].runs, scenarioStats[s].failures);
+  }
+
+  printf("\nThroughput\n");
+  printf("  cycles              %lu in %.3f s wall (%.0f cycles/s)\n",
+         opts.cycles, wallSeconds, wallSeconds > 0 ? opts.cycles / wallSeconds : 0.0);
+  printf("  simulated time      %.1f s (%.0fx real time)\n",
+         simSeconds, wallSeconds > 0 ? simSeconds / wallSeconds : 0.0);
+  printf("  loop iterations     %llu\n", (unsigned long long)loopIterations);
+  printf("  K2 presses          %u\n", plant->buttonPresses());
+  printf("  MQTT publishes      %lu\n", simMqttPublishCount);
+  printf("  position publishes  %lu\n", simPositionPublishCount);
+  printf("  snapshot mismatches %llu\n", (unsigned long long)snapshotMismatches);
+  printf("  control step NVS    %llu writes\n", (unsigned long long)controlStepNvsWrites);
+  InputSamplerStats inputs = getInputSamplerStats();
+  printf("  input samples       %lu (%lu events, %lu dropped)\n", (unsigned long)inputs.samples,
+         (unsigned long)inputs.events, (unsigned long)inputs.overflows);
+
+  const CommandSourceStats& cmds = getCommandSourceStats(SOURCE_INTERNAL);
+  printf("\nCommands            submitted %lu, coalesced %lu, rejected %lu, pre-empted %lu\n",
+         (unsigned long)cmds.commands, (unsigned long)cmds.coalesced,
+         (unsigned long)cmds.rejected, (unsigned long)cmds.preempted);
+  printf("  abort to relay      mean %llu ns, max %llu ns (host clock, %llu samples, %llu over the %lu us bound)\n",
+         (unsigned long long)abortToRelay.mean(), (unsigned long long)abortToRelay.max(),
+         (unsigned long long)abortToRelay.count(), (unsigned long long)abortOverBound,
+         (unsigned long)ABORT_LATENCY_BOUND_US);
+
+  InverterSequenceStats seq = getInverterSequenceStats();
+  printf("\nInverter sequencing  %s\n", opts.acSequencing ? "start on AC detect" : "fixed delays");
+  if (opts.acSequencing) {
+    printf("  early advances      %lu (mean %lu ms of delay skipped), delay timeouts %lu\n",
+           (unsigned long)seq.earlyAdvances,
+           seq.earlyAdvances ? seq.totalSavedMs / seq.earlyAdvances : 0UL, (unsigned long)seq.timeouts);
+  }
+  printf("  last AC up          %lu ms after sequence start\n", seq.lastAcUpMs);
+  if (opts.keepWarmMinutes > 0) {
+    InverterKeepWarmStats warm = getInverterKeepWarmStats();
+    printf("  keep-warm           %lu min: %lu windows, %lu spin-ups avoided, %lu expired, %.1f s added on-time\n",
+           opts.keepWarmMinutes, (unsigned long)warm.windows, (unsigned long)warm.spinUpsAvoided,
+           (unsigned long)warm.expiries, warm.addedOnMs / 1000.0);
+  }
+  InverterPrewarmStats prewarm = getInverterPrewarmStats();
+  unsigned long prewarmOutcomes = prewarm.hits + prewarm.expiries + prewarm.cancelled;
+  printf("  pre-warm            %lu requests (%lu spin-ups): %lu hits (%lu joined the power-up), "
+         "%lu expired, %lu cancelled, hit ratio %.2f, %.1f s added on-time\n",
+         (unsigned long)prewarm.requests, (unsigned long)prewarm.spinUps, (unsigned long)prewarm.hits,
+         (unsigned long)prewarm.joined, (unsigned long)prewarm.expiries, (unsigned long)prewarm.cancelled,
+         prewarmOutcomes ? (double)prewarm.hits / prewarmOutcomes : 0.0, prewarm.addedOnMs / 1000.0);
+
+  RainCloseStats rain = getRainCloseStats();
+  printf("\nRain auto-close     %lu trips, %lu closes (%lu stopped opening), %lu interlock waits, "
+         "%lu cleared, %lu lockout rejects\n",
+         (unsigned long)rain.trips, (unsigned long)rain.closes, (unsigned long)rain.stoppedOpening,
+         (unsigned long)rain.interlockWaits, (unsigned long)rain.cleared, (unsigned long)rain.lockoutRejects);
+  printf("  edge to K2          mean %llu ms, max %lu ms (%lu samples, bound %lu ms without interlock wait)\n",
+         rain.latencySamples ? (unsigned long long)(rain.totalEdgeToK2Us / rain.latencySamples / 1000) : 0ULL,
+         (unsigned long)(rain.maxEdgeToK2Us / 1000), (unsigned long)rain.latencySamples,
+         (unsigned long)(rainLatencyBoundUs() / 1000));
+
+  ModbusMasterStats modbus = getModbusMasterStats();
+  SimUartStats uart = simUartGetStats(SnowSerial);
+  const SimModbusSlaveStats& slave = snowSlave->stats();
+  printf("\nRS485 snow sensor   %lu requests, %lu replies, %lu timeouts, %lu CRC errors, %lu exceptions, "
+         "%lu UART errors, %lu offline\n",
+         (unsigned long)modbus.requests, (unsigned long)modbus.replies, (unsigned long)modbus.timeouts,
+         (unsigned long)modbus.crcErrors, (unsigned long)modbus.exceptions, (unsigned long)modbus.uartErrors,
+         (unsigned long)getSnowSensorStats().offlineEvents);
+  printf("  round trip          last %lu us, max %lu us; RE/DE max %lu us; %lu collisions, %lu gap violations\n",
+         (unsigned long)modbus.lastRoundTripUs, (unsigned long)modbus.maxRoundTripUs,
+         (unsigned long)uart.rtsHighUs, (unsigned long)uart.collisions,
+         (unsigned long)(slave.gapViolations + slave.charGapViolations));
+
+  ResumeStats resume = getResumeStats();
+  printf("\nWarm restart        %lu resumed (%lu reversed mid-travel, %lu restarted, %lu from NVS)\n",
+         resumesReversed + resumesRestarted, resumesReversed, resumesRestarted, resumesFromNvs);
+  printf("  snapshot writes     RTC %lu, NVS %lu for %lu changes\n", (unsigned long)resume.rtcWrites,
+         (unsigned long)resume.nvsWrites, (unsigned long)resume.changes);
+
+  RoofTraceStats trace = getRoofTraceStats();
+  printf("\nTrace recorder      %lu entries since the last power-on (%lu retained)\n",
+         (unsigned long)trace.written, (unsigned long)trace.retained);
+
+  printf("\nLimit switch health\n");
+  for (int i = 0; i < SWITCH_COUNT; i++) {
+    LimitSwitchId id = (LimitSwitchId)i;
+    SwitchHealthTotals totals = getSwitchHealthTotals(id);
+    uint32_t maxBurstUs = 0;
+    for (uint8_t e = 0; e < getSwitchHealthEpochCount(id); e++) {
+      uint32_t epochMax = getSwitchHealthEpoch(id, e).maxBurstUs;
+      if (epochMax > maxBurstUs) maxBurstUs = epochMax;
+    }
+    printf("  %-6s              %lu transitions, mean %.2f bounces, max burst %lu us (window), %lu glitches\n",
+           getSwitchKey(id), (unsigned long)totals.transitions,
+           totals.transitions ? (double)totals.bounces / totals.transitions : 0.0,
+           (unsigned long)maxBurstUs, (unsigned long)totals.glitches);
+  }
+  printf("  NVS saves           %lu, alert publishes %lu, dropped records %lu\n",
+         (unsigned long)getSwitchHealthStats().saves, simSwitchHealthPublishCount,
+         (unsigned long)getInputSamplerStats().burstOverflows);
+
+  SafetyMonitorStats safety = getSafetyMonitorStats();
+  printf("\nSafety monitor      %lu verdict changes from %lu reason changes over %llu control steps\n",
+         (unsigned long)safety.verdictChanges, (unsigned long)safety.reasonChanges,
+         (unsigned long long)loopIterations);
+
+  printf("\nPosition estimate\n");
+  printf("  samples in motion   %llu\n", (unsigned long long)positionError.samples);
+  printf("  abs error           mean %.2f%%, max %.2f%%\n",
+         positionError.samples ? positionError.sumAbs / positionError.samples : 0.0, positionError.maxAbs);
+  if (!opts.encoder) {
+    printf("  stall warnings      %lu (mean %lu ms before the movement timeout)\n",
+           stallWarnings, stallWarnings ? (unsigned long)(stallWarningLeadMs / stallWarnings) : 0UL);
+  }
+
+  if (opts.encoder) {
+    RoofEncoderStats enc = getRoofEncoderStats();
+    printf("\nRoof encoder        span %ld counts (%lu NVS writes), %lu PCNT wraps, count %ld\n",
+           enc.span, (unsigned long)enc.spanUpdates, (unsigned long)enc.wraps, (long)enc.count);
+    printf("  abs error           mean %.2f%%, max %.2f%% (%llu samples in motion)\n",
+           encoderError.samples ? encoderError.sumAbs / encoderError.samples : 0.0, encoderError.maxAbs,
+           (unsigned long long)encoderError.samples);
+    printf("  stalls              %lu (mean %lu ms from the drive stopping)\n", (unsigned long)enc.stalls,
+           stallWarnings ? (unsigned long)(stallWarningLeadMs / stallWarnings) : 0UL);
+    printf("  target stops        %lu, last error %d%%\n", (unsigned long)enc.targetStops, enc.lastTargetError);
+  }
+
+  if (opts.current) {
+    MotorCurrentStats cur = getMotorCurrentStats();
+    printf("\nMotor current       zero %u counts, %lu samples, %lu pool overflows, %lu envelope saves\n", cur.zero,
+           (unsigned long)cur.samples, (unsigned long)cur.overflows, (unsigned long)cur.envelopeSaves);
+    static const MoveDirection envelopeDirs[] = {MOVE_OPEN, MOVE_CLOSE};
+    for (MoveDirection d : envelopeDirs) {
+      const MotorCurrentEnvelope& env = getMotorCurrentEnvelope(d);
+      printf("  %-5s envelope      %u runs, %u bins, inrush %u, steady max %u counts RMS\n",
+             d == MOVE_OPEN ? "open" : "close", env.moves, env.bins, env.bins ? env.rms[0] : 0, env.steadyMax);
+    }
+    if (getMotorCurrentProfileCount() > 0) {
+      const MotorCurrentProfile& p = getMotorCurrentProfile(getMotorCurrentProfileCount() - 1);
+      printf("  last run            %s, %s: inrush peak %u at %u ms, running %u, max %u counts RMS over %lu ms\n",
+             p.direction == MOVE_OPEN ? "open" : "close",
+             p.outcome == 0xFF ? "discarded" : getMoveOutcomeString(p.outcome), p.inrushPeak, p.inrushPeakMs,
+             p.runningRms, p.maxRms, (unsigned long)p.durationMs);
+    }
+    printf("  obstruction trips   %lu of %lu (mean %lu ms from the roof blocking), last %u over %u counts RMS\n",
+           obstructionTrips, (unsigned long)cur.trips,
+           obstructionTrips ? (unsigned long)(obstructionTripMs / obstructionTrips) : 0UL,
+           cur.lastTripRms, cur.lastTripThreshold);
+  }
+
+  printf("\nMove telemetry (ms)           samples      p50      p95      p99      max\n");
+  static const MoveDirection dirs[] = {MOVE_OPEN, MOVE_CLOSE};
+  static const MoveMetric metrics[] = {METRIC_SPIN_UP, METRIC_RELEASE, METRIC_TRAVEL};
+  static const char* const metricNames[] = {"spin-up", "release", "travel"};
+  for (MoveDirection d : dirs) {
+    for (int m = 0; m < 3; m++) {
+      MoveMetricStats st = getMoveStats(d, metrics[m]);
+      char label[32];
+      snprintf(label, sizeof(label), "%s %s", d == MOVE_OPEN ? "open" : "close", metricNames[m]);
+      printf("  %-28s %7u %8u %8u %8u %8u\n", label, st.samples, st.p50, st.p95, st.p99, st.max);
+    }
+    printf("  %-28s movement %lu ms, limit switch %lu ms\n", "effective timeouts",
+           getEffectiveMovementTimeout(d), getEffectiveLimitSwitchTimeout(d));
+  }
+
+  printf("\nStep latency (ns)                 calls      min     mean      p50      p99      max\n");
+  for (int i = 0; i < STEP_COUNT; i++) {
+    printHistogramRow(STEP_NAMES[i], stepTimes[i]);
+  }
+
+  printf("\nprocessRoofOperation by state (ns)\n");
+  for (int i = 0; i < OP_STATE_COUNT; i++) {
+    if (opStateTimes[i].count() > 0) {
+      printHistogramRow(OP_STATE_NAMES[i], opStateTimes[i]);
+    }
+  }
+
+  printf("\nResult: %s\n", totalFailures == 0 ? "PASS" : "FAIL");
+}
+
+// The same bytes GET /api/trace sends
+static bool writeTraceFile(const char* path) {
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    fprintf(stderr, "Cannot write %s\n", path);
+    return false;
+  }
+  uint32_t next = getRoofTraceStart();
+  uint32_t end = getRoofTraceEnd();
+  RoofTraceHeader header;
+  fillRoofTraceHeader(header, next);
+  fwrite(&header, sizeof(header), 1, file);
+
+  RoofTraceEntry chunk[TRACE_DOWNLOAD_CHUNK];
+  while (next != end) {
+    uint32_t count = end - next < TRACE_DOWNLOAD_CHUNK ? end - next : TRACE_DOWNLOAD_CHUNK;
+    count = copyRoofTraceEntries(next, chunk, count);
+    if (count == 0) break;
+    fwrite(chunk, sizeof(RoofTraceEntry), count, file);
+    next += count;
+  }
+  fclose(file);
+  printf("Trace: %lu entries written to %s\n", (unsigned long)(next - header.firstIndex), path);
+  return true;
+}
+
+static bool latencyGuardPassed() {
+  if (opts.maxP99Ns == 0) return true;
+  bool ok = true;
+  for (int i = 0; i < STEP_COUNT; i++) {
+    uint64_t p99 = stepTimes[i].percentile(99);
+    if (p99 > opts.maxP99Ns) {
+      fprintf(stderr, "LATENCY GUARD: %s p99 %llu ns exceeds %llu ns\n", STEP_NAMES[i],
+              (unsigned long long)p99, (unsigned long long)opts.maxP99Ns);
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+// A held or stale estimate drifts a long way from the roof without failing any scenario
+static bool positionGuardPassed() {
+  bool ok = true;
+  if (positionError.maxAbs > opts.maxPositionError) {
+    fprintf(stderr, "POSITION GUARD: estimate off by %.2f%% (bound %.2f%%)\n", positionError.maxAbs,
+            opts.maxPositionError);
+    ok = false;
+  }
+  if (encoderError.maxAbs > opts.maxPositionError) {
+    fprintf(stderr, "POSITION GUARD: encoder position off by %.2f%% (bound %.2f%%)\n", encoderError.maxAbs,
+            opts.maxPositionError);
+    ok = false;
+  }
+  return ok;
+}
+
+// ============== Main ==============
+
+static void usage(const char* argv0) {
+  fprintf(stderr,
+          "Usage: %s [--cycles N] [--seed N] [--travel-ms N] [--tick-ms N]\n"
+          "          [--max-p99-ns N] [--max-position-error PCT] [--adaptive]\n"
+          "          [--ac-seq] [--keep-warm MIN] [--encoder] [--current] [--record FILE] [--verbose]\n", argv0);
+}
+
+static bool parseOptions(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    bool hasValue = (i + 1 < argc);
+    if (strcmp(arg, "--cycles") == 0 && hasValue) {
+      opts.cycles = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--seed") == 0 && hasValue) {
+      opts.seed = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--travel-ms") == 0 && hasValue) {
+      opts.travelMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--tick-ms") == 0 && hasValue) {
+      opts.tickMs = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--max-p99-ns") == 0 && hasValue) {
+      opts.maxP99Ns = strtoull(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--max-position-error") == 0 && hasValue) {
+      opts.maxPositionError = strtod(argv[++i], nullptr);
+    } else if (strcmp(arg, "--adaptive") == 0) {
+      opts.adaptive = true;
+    } else if (strcmp(arg, "--ac-seq") == 0) {
+      opts.acSequencing = true;
+    } else if (strcmp(arg, "--keep-warm") == 0 && hasValue) {
+      opts.keepWarmMinutes = strtoul(argv[++i], nullptr, 10);
+    } else if (strcmp(arg, "--encoder") == 0) {
+      opts.encoder = true;
+    } else if (strcmp(arg, "--current") == 0) {
+      opts.current = true;
+    } else if (strcmp(arg, "--record") == 0 && hasValue) {
+      opts.recordPath = argv[++i];
+    } else if (strcmp(arg, "--verbose") == 0) {
+      opts.verbose = true;
+    } else {
+      return false;
+    }
+  }
+  return opts.tickMs > 0 && opts.travelMs > 0;
+}
+
+int main(int argc, char** argv) {
+  if (!parseOptions(argc, argv)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  Serial.echo = opts.verbose;
+  rng.seed(opts.seed);
+
+  RoofPlantConfig plantConfig;
+  plantConfig.travelMs = opts.travelMs;
+  if (opts.encoder) {
+    plantConfig.encoderCountsPerTravel = SIM_ENCODER_COUNTS;
+    ENCODER_PIN_A = SIM_ENCODER_PIN_A;   // Span left at 0: learned on the first full open
+    ENCODER_PIN_B = SIM_ENCODER_PIN_B;
+  }
+  if (opts.current) {
+    plantConfig.currentRunningCounts = SIM_CURRENT_RUNNING_COUNTS;
+    MOTOR_CURRENT_PIN = SIM_CURRENT_PIN;   // Envelope learned from the first completed moves
+  }
+  RoofPlant roofPlant(plantConfig);
+  plant = &roofPlant;
+
+  simResetPins();
+  simSetTimeMicros(0);
+  simSetOutputHook(onOutputWrite);
+  simSetAnalogSource(analogLevel);
+  roofPlant.reset(0.0);
+  roofPlant.setTelescopeParked(true);
+  simSetInputLevel(SNOW_SENSOR_DIGITAL_PIN, LOW);   // Dry weather: rain (active low) stays high
+
+  SimModbusSlave modbusSlave(SnowSerial, SNOW_MODBUS_ADDRESS);
+  modbusSlave.setTurnaroundUs(SIM_MODBUS_TURNAROUND_US);
+  snowSlave = &modbusSlave;
+
+  initializeRoofController();
+  initRoofPosition();
+  initSwitchHealth();
+  initMotorCurrent();
+  snowModbusEnabled = true;
+  snowAutoCloseEnabled = true;
+  initSnowSensor();
+  publishRoofSnapshot();
+  setAdaptiveTimeoutsEnabled(opts.adaptive);
+  inverterAcSequencing = opts.acSequencing;
+  inverterKeepWarmMinutes = opts.keepWarmMinutes;
+  inverterPrewarmMinutes = 1;
+  rainAutoCloseEnabled = true;
+  rainHoldoffMs = 0;
+  rainReopenLockoutMs = 10000;  // Short lockout so the cycles keep moving
+  runForMs(1000);
+  if (roofStatus != ROOF_CLOSED) {
+    fprintf(stderr, "Controller did not start CLOSED\n");
+    return 1;
+  }
+
+  std::vector<Scenario> order = {SCEN_OPEN, SCEN_CLOSE, SCEN_STOP, SCEN_JAM, SCEN_STALL,
+                                 SCEN_MANUAL_PRESS, SCEN_RAIN_BOUNCE, SCEN_RAIN_CLOSE, SCEN_SNOW_MODBUS,
+                                 SCEN_WARM_RESTART, SCEN_PREWARM, SCEN_SWITCH_CHATTER};
+  // The part-open scenario needs the encoder, the obstruction scenario the current sensor
+  if (opts.encoder) order.push_back(SCEN_PART_OPEN);
+  if (opts.current) order.push_back(SCEN_OBSTRUCTION);
+  unsigned long totalFailures = 0;
+
+  uint64_t wallStart = hostNanos();
+  for (unsigned long cycle = 0; cycle < opts.cycles; cycle++) {
+    Scenario s = order[cycle % order.size()];
+    scenarioStats[s].runs++;
+    if (!runScenario(s)) {
+      scenarioStats[s].failures++;
+      totalFailures++;
+      // Resynchronise so one failure does not cascade through the run
+      plant->setFault(PLANT_FAULT_NONE);
+      plant->setTelescopeParked(true);
+      simSetInputLevel(RAIN_SENSOR_PIN, HIGH);
+      snowSlave->setOnline(true);
+      snowSlave->setFault(MODBUS_FAULT_NONE, 0);
+      snowSlave->setRegister(SNOW_MODBUS_START_REGISTER + SNOW_MODBUS_STATE_INDEX, 0);
+      rainHoldoffMs = 0;
+      runUntil([] { return !rainReopenLocked(); },
+               RAIN_SENSOR_STABLE_TIME + (SNOW_MODBUS_CONFIRM_READS + 1) * SNOW_MODBUS_POLL_MS +
+               rainReopenLockoutMs + 1000);
+      if (!controllerIdle()) stopRoofMovement(false);
+      runUntil(controllerIdle, 5000);
+      recoverTo(s == SCEN_CLOSE ? 1.0 : 0.0);
+      if (s == SCEN_OPEN) recoverTo(0.0);
+    }
+  }
+  double wallSeconds = (hostNanos() - wallStart) / 1e9;
+
+  printReport(wallSeconds, totalFailures);
+  if (opts.recordPath && !writeTraceFile(opts.recordPath)) return 1;
+
+  bool ok = (totalFailures == 0) && (snapshotMismatches == 0) && (controlStepNvsWrites == 0) &&
+            latencyGuardPassed() && positionGuardPassed();
+  return ok ? 0 : 1;
+}
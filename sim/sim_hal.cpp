@@ -0,0 +1,752 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Virtual GPIO and Time Implementation
+ */
+
+#include "sim_hal.h"
+#include <esp_timer.h>
+#include <driver/pulse_cnt.h>
+#include <esp_adc/adc_continuous.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <vector>
+
+SimSerial Serial;
+
+static uint64_t simMicros = 0;
+static int pinLevel[SIM_PIN_COUNT];
+static int pinModes[SIM_PIN_COUNT];
+static void (*pinIsr[SIM_PIN_COUNT])(void);
+static int pinIsrMode[SIM_PIN_COUNT];
+static SimOutputHook outputHook = nullptr;
+
+static bool validPin(uint8_t pin) {
+  return pin < SIM_PIN_COUNT;
+}
+
+uint64_t simNowMicros() {
+  return simMicros;
+}
+
+// ---------------------------------------------------------------------------
+// esp_timer: periodic callbacks fired at their due times as the clock advances
+// ---------------------------------------------------------------------------
+
+struct SimEspTimer {
+  esp_timer_cb_t callback;
+  void* arg;
+  uint64_t periodUs;      // 0 = stopped
+  uint64_t nextUs;
+};
+
+static std::vector<SimEspTimer*> simTimers;
+
+// ---------------------------------------------------------------------------
+// UART: bytes move one character time at a time on the virtual clock
+// ---------------------------------------------------------------------------
+
+static const size_t SIM_UART_RX_FIFO = 256;
+
+struct SimUart {
+  HardwareSerial* serial;
+  SimUartPeer* peer;
+  SimUartStats stats;
+  uint64_t rtsHighSinceUs;
+};
+
+static std::vector<SimUart> simUarts;
+
+static SimUart* findUart(const HardwareSerial* serial) {
+  for (SimUart& u : simUarts) {
+    if (u.serial == serial) return &u;
+  }
+  return nullptr;
+}
+
+static SimUart& uartFor(HardwareSerial* serial) {
+  SimUart* u = findUart(serial);
+  if (u) return *u;
+  simUarts.push_back(SimUart{serial, nullptr, {}, 0});
+  return simUarts.back();
+}
+
+static void setRts(SimUart& u, int level) {
+  int pin = u.serial->rtsPin_;
+  if (u.serial->mode_ != UART_MODE_RS485_HALF_DUPLEX || !validPin(pin) || pinLevel[pin] == level) return;
+  pinLevel[pin] = level;
+  if (level == HIGH) {
+    u.rtsHighSinceUs = simMicros;
+  } else if (simMicros - u.rtsHighSinceUs > u.stats.rtsHighUs) {
+    u.stats.rtsHighUs = (uint32_t)(simMicros - u.rtsHighSinceUs);
+  }
+  if (outputHook) outputHook((uint8_t)pin, level, simMicros);
+}
+
+// Earliest pending UART event at or before target (UINT64_MAX = none)
+static uint64_t nextUartEvent(SimUart** which) {
+  uint64_t best = UINT64_MAX;
+  for (SimUart& u : simUarts) {
+    HardwareSerial* s = u.serial;
+    uint64_t t = UINT64_MAX;
+    if (!s->tx_.empty()) t = s->tx_.front().doneUs;
+    if (!s->rx_.empty() && s->rx_.front().doneUs < t) t = s->rx_.front().doneUs;
+    if (s->rxIdleEventUs_ && s->rxIdleEventUs_ < t) t = s->rxIdleEventUs_;
+    if (t < best) {
+      best = t;
+      *which = &u;
+    }
+  }
+  return best;
+}
+
+static void runUartEvent(SimUart& u) {
+  HardwareSerial* s = u.serial;
+  if (!s->tx_.empty() && s->tx_.front().doneUs <= simMicros) {
+    uint8_t value = s->tx_.front().value;
+    s->tx_.pop_front();
+    if (s->tx_.empty()) setRts(u, LOW);
+    if (u.peer) u.peer->onHostByte(value, simMicros);
+    return;
+  }
+  if (!s->rx_.empty() && s->rx_.front().doneUs <= simMicros) {
+    uint8_t value = s->rx_.front().value;
+    s->rx_.pop_front();
+    u.stats.rxBytes++;
+    if (s->rxFifo_.size() < SIM_UART_RX_FIFO) {
+      s->rxFifo_.push_back(value);
+    } else {
+      u.stats.rxDrops++;
+    }
+    s->rxIdleEventUs_ = simMicros + s->rxTimeoutSymbols_ * s->charUs_;
+    return;
+  }
+  if (s->rxIdleEventUs_ && s->rxIdleEventUs_ <= simMicros) {
+    s->rxIdleEventUs_ = 0;
+    if (s->onReceive_) s->onReceive_();
+  }
+}
+
+// Move the clock to target, running every timer and UART event that falls
+// due on the way, in time order
+static void advanceTo(uint64_t target) {
+  for (;;) {
+    SimEspTimer* due = nullptr;
+    for (SimEspTimer* t : simTimers) {
+      if (t->periodUs && t->nextUs <= target && (!due || t->nextUs < due->nextUs)) due = t;
+    }
+    SimUart* uart = nullptr;
+    uint64_t uartUs = nextUartEvent(&uart);
+    if (uartUs <= target && (!due || uartUs < due->nextUs)) {
+      if (uartUs > simMicros) simMicros = uartUs;
+      runUartEvent(*uart);
+      continue;
+    }
+    if (!due) break;
+    if (due->nextUs > simMicros) simMicros = due->nextUs;
+    due->nextUs += due->periodUs;
+    due->callback(due->arg);
+  }
+  simMicros = target;
+}
+
+void HardwareSerial::begin(unsigned long baud, uint32_t config, int8_t rxPin, int8_t txPin) {
+  baud_ = baud;
+  charUs_ = (10ULL * 1000000ULL + baud - 1) / baud;
+  started_ = true;
+  uartFor(this);
+}
+
+void HardwareSerial::end() {
+  started_ = false;
+  tx_.clear();
+  rx_.clear();
+  rxFifo_.clear();
+  rxIdleEventUs_ = 0;
+}
+
+bool HardwareSerial::setPins(int8_t rxPin, int8_t txPin, int8_t ctsPin, int8_t rtsPin) {
+  if (rtsPin >= 0) {
+    rtsPin_ = rtsPin;
+    if (validPin(rtsPin)) pinLevel[rtsPin] = LOW;
+  }
+  return true;
+}
+
+bool HardwareSerial::setMode(SerialMode mode) {
+  mode_ = mode;
+  return true;
+}
+
+bool HardwareSerial::setRxTimeout(uint8_t symbols) {
+  rxTimeoutSymbols_ = symbols;
+  return true;
+}
+
+void HardwareSerial::onReceive(OnReceiveCb function, bool onlyOnTimeout) {
+  onReceive_ = function;
+}
+
+void HardwareSerial::onReceiveError(OnReceiveErrorCb function) {
+  onReceiveError_ = function;
+}
+
+int HardwareSerial::available() {
+  return (int)rxFifo_.size();
+}
+
+int HardwareSerial::read() {
+  if (rxFifo_.empty()) return -1;
+  uint8_t value = rxFifo_.front();
+  rxFifo_.pop_front();
+  return value;
+}
+
+size_t HardwareSerial::read(uint8_t* buffer, size_t size) {
+  size_t n = 0;
+  while (n < size && !rxFifo_.empty()) {
+    buffer[n++] = (uint8_t)read();
+  }
+  return n;
+}
+
+size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
+  if (!started_ || size == 0) return 0;
+  SimUart& u = uartFor(this);
+  uint64_t start = txBusyUntilUs_ > simMicros ? txBusyUntilUs_ : simMicros;
+  if (start < rxBusyUntilUs_) u.stats.collisions++;
+  setRts(u, HIGH);
+  for (size_t i = 0; i < size; i++) {
+    start += charUs_;
+    tx_.push_back(TimedByte{start, buffer[i]});
+  }
+  txBusyUntilUs_ = start;
+  u.stats.txBytes += (uint32_t)size;
+  return size;
+}
+
+void simUartAttachPeer(HardwareSerial& serial, SimUartPeer* peer) {
+  uartFor(&serial).peer = peer;
+}
+
+void simUartSend(HardwareSerial& serial, const uint8_t* data, size_t length, uint64_t startUs) {
+  if (!serial.started_ || length == 0) return;
+  SimUart& u = uartFor(&serial);
+  uint64_t start = startUs > simMicros ? startUs : simMicros;
+  if (start < serial.rxBusyUntilUs_) start = serial.rxBusyUntilUs_;
+  if (start < serial.txBusyUntilUs_) u.stats.collisions++;
+  for (size_t i = 0; i < length; i++) {
+    start += serial.charUs_;
+    serial.rx_.push_back(HardwareSerial::TimedByte{start, data[i]});
+  }
+  serial.rxBusyUntilUs_ = start;
+}
+
+void simUartRaiseError(HardwareSerial& serial, hardwareSerial_error_t error) {
+  if (serial.onReceiveError_) serial.onReceiveError_(error);
+}
+
+SimUartStats simUartGetStats(const HardwareSerial& serial) {
+  SimUart* u = findUart(&serial);
+  return u ? u->stats : SimUartStats{};
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t* args, esp_timer_handle_t* out) {
+  SimEspTimer* t = new SimEspTimer{args->callback, args->arg, 0, 0};
+  simTimers.push_back(t);
+  *out = t;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t periodUs) {
+  if (!timer || periodUs == 0) return ESP_FAIL;
+  timer->periodUs = periodUs;
+  timer->nextUs = simMicros + periodUs;
+  return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer) {
+  if (!timer) return ESP_FAIL;
+  timer->periodUs = 0;
+  return ESP_OK;
+}
+
+int64_t esp_timer_get_time() {
+  return (int64_t)simMicros;
+}
+
+static void adcRunTo(uint64_t target);  // ADC continuous units, below
+
+void simAdvanceMicros(uint64_t us) {
+  advanceTo(simMicros + us);
+  adcRunTo(simMicros);
+}
+
+void simSetTimeMicros(uint64_t us) {
+  simMicros = us;
+}
+
+void simResetPins() {
+  for (int i = 0; i < SIM_PIN_COUNT; i++) {
+    pinLevel[i] = HIGH;
+    pinModes[i] = INPUT;
+    pinIsr[i] = nullptr;
+    pinIsrMode[i] = 0;
+  }
+}
+
+static esp_reset_reason_t resetReason = ESP_RST_POWERON;
+
+void simSetResetReason(esp_reset_reason_t reason) {
+  resetReason = reason;
+}
+
+esp_reset_reason_t esp_reset_reason() {
+  return resetReason;
+}
+
+// Bounds of the RTC_NOINIT_ATTR section, provided by the linker
+extern char __start_sim_rtc_noinit[];
+extern char __stop_sim_rtc_noinit[];
+
+void simLoseRtcMemory() {
+  memset(__start_sim_rtc_noinit, 0xA5, __stop_sim_rtc_noinit - __start_sim_rtc_noinit);
+}
+
+void simSetOutputHook(SimOutputHook hook) {
+  outputHook = hook;
+}
+
+static void pcntOnEdge(uint8_t pin, bool rising);  // PCNT units, below
+
+void simSetInputLevel(uint8_t pin, int level) {
+  if (!validPin(pin)) return;
+  int previous = pinLevel[pin];
+  pinLevel[pin] = level ? HIGH : LOW;
+  if (previous == pinLevel[pin]) return;
+  pcntOnEdge(pin, pinLevel[pin] == HIGH);
+  if (pinIsr[pin] == nullptr) return;
+
+  bool rising = (pinLevel[pin] == HIGH);
+  int mode = pinIsrMode[pin];
+  if (mode == CHANGE || (mode == RISING && rising) || (mode == FALLING && !rising)) {
+    pinIsr[pin]();
+  }
+}
+
+int simGetOutputLevel(uint8_t pin) {
+  return validPin(pin) ? pinLevel[pin] : LOW;
+}
+
+int simGetPinMode(uint8_t pin) {
+  return validPin(pin) ? pinModes[pin] : 0;
+}
+
+// ---------------------------------------------------------------------------
+// PCNT: units count the edges simSetInputLevel() puts on their pins
+// ---------------------------------------------------------------------------
+
+struct SimPcntChannel {
+  SimPcntUnit* unit;
+  int edgePin;
+  int levelPin;
+  pcnt_channel_edge_action_t posAction;
+  pcnt_channel_edge_action_t negAction;
+  pcnt_channel_level_action_t highAction;
+  pcnt_channel_level_action_t lowAction;
+};
+
+struct SimPcntUnit {
+  int lowLimit;
+  int highLimit;
+  bool accumulate;
+  bool enabled;
+  bool running;
+  int count;                  // Hardware counter, reset to 0 at either limit
+  int accumulated;            // Limit crossings folded in by the driver (accum_count)
+  std::vector<int> watchPoints;
+  pcnt_watch_cb_t onReach;
+  void* userData;
+  std::vector<SimPcntChannel*> channels;
+};
+
+static std::vector<SimPcntUnit*> simPcntUnits;
+
+static void pcntCount(SimPcntUnit* u, int step) {
+  u->count += step;
+  int value = u->count;
+  bool watched = false;
+  for (int point : u->watchPoints) {
+    if (point == value) watched = true;
+  }
+  bool atLimit = (value == u->highLimit || value == u->lowLimit);
+  if (atLimit) {
+    // The driver's limit interrupt folds the count in, only when watched
+    if (u->accumulate && watched) u->accumulated += value;
+    u->count = 0;
+  }
+  if (watched && u->onReach) {
+    pcnt_watch_event_data_t data = {value, 0};
+    u->onReach(u, &data, u->userData);
+  }
+}
+
+static void pcntOnEdge(uint8_t pin, bool rising) {
+  for (SimPcntUnit* u : simPcntUnits) {
+    if (!u->running) continue;
+    for (SimPcntChannel* ch : u->channels) {
+      if (ch->edgePin != pin) continue;
+      pcnt_channel_edge_action_t edge = rising ? ch->posAction : ch->negAction;
+      if (edge == PCNT_CHANNEL_EDGE_ACTION_HOLD) continue;
+      pcnt_channel_level_action_t level = PCNT_CHANNEL_LEVEL_ACTION_KEEP;
+      if (ch->levelPin >= 0 && validPin(ch->levelPin)) {
+        level = pinLevel[ch->levelPin] == HIGH ? ch->highAction : ch->lowAction;
+      }
+      if (level == PCNT_CHANNEL_LEVEL_ACTION_HOLD) continue;
+      int step = (edge == PCNT_CHANNEL_EDGE_ACTION_INCREASE) ? 1 : -1;
+      if (level == PCNT_CHANNEL_LEVEL_ACTION_INVERSE) step = -step;
+      pcntCount(u, step);
+    }
+  }
+}
+
+esp_err_t pcnt_new_unit(const pcnt_unit_config_t* config, pcnt_unit_handle_t* ret_unit) {
+  if (!config || !ret_unit || config->low_limit >= 0 || config->high_limit <= 0) return ESP_ERR_INVALID_ARG;
+  SimPcntUnit* u = new SimPcntUnit{config->low_limit, config->high_limit, config->flags.accum_count != 0,
+                                   false, false, 0, 0, {}, nullptr, nullptr, {}};
+  simPcntUnits.push_back(u);
+  *ret_unit = u;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_del_unit(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  if (unit->enabled || !unit->channels.empty()) return ESP_ERR_INVALID_STATE;
+  for (size_t i = 0; i < simPcntUnits.size(); i++) {
+    if (simPcntUnits[i] == unit) {
+      simPcntUnits.erase(simPcntUnits.begin() + i);
+      break;
+    }
+  }
+  delete unit;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_set_glitch_filter(pcnt_unit_handle_t unit, const pcnt_glitch_filter_config_t* config) {
+  return unit ? ESP_OK : ESP_ERR_INVALID_ARG;
+}
+
+esp_err_t pcnt_new_channel(pcnt_unit_handle_t unit, const pcnt_chan_config_t* config, pcnt_channel_handle_t* ret_chan) {
+  if (!unit || !config || !ret_chan) return ESP_ERR_INVALID_ARG;
+  if (unit->enabled) return ESP_ERR_INVALID_STATE;
+  SimPcntChannel* ch = new SimPcntChannel{unit, config->edge_gpio_num, config->level_gpio_num,
+                                          PCNT_CHANNEL_EDGE_ACTION_HOLD, PCNT_CHANNEL_EDGE_ACTION_HOLD,
+                                          PCNT_CHANNEL_LEVEL_ACTION_KEEP, PCNT_CHANNEL_LEVEL_ACTION_KEEP};
+  unit->channels.push_back(ch);
+  *ret_chan = ch;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_del_channel(pcnt_channel_handle_t chan) {
+  if (!chan) return ESP_ERR_INVALID_ARG;
+  std::vector<SimPcntChannel*>& channels = chan->unit->channels;
+  for (size_t i = 0; i < channels.size(); i++) {
+    if (channels[i] == chan) {
+      channels.erase(channels.begin() + i);
+      break;
+    }
+  }
+  delete chan;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_edge_action(pcnt_channel_handle_t chan, pcnt_channel_edge_action_t pos_act,
+                                       pcnt_channel_edge_action_t neg_act) {
+  if (!chan) return ESP_ERR_INVALID_ARG;
+  chan->posAction = pos_act;
+  chan->negAction = neg_act;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_channel_set_level_action(pcnt_channel_handle_t chan, pcnt_channel_level_action_t high_act,
+                                        pcnt_channel_level_action_t low_act) {
+  if (!chan) return ESP_ERR_INVALID_ARG;
+  chan->highAction = high_act;
+  chan->lowAction = low_act;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_add_watch_point(pcnt_unit_handle_t unit, int watch_point) {
+  if (!unit || watch_point < unit->lowLimit || watch_point > unit->highLimit) return ESP_ERR_INVALID_ARG;
+  unit->watchPoints.push_back(watch_point);
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_remove_watch_point(pcnt_unit_handle_t unit, int watch_point) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  for (size_t i = 0; i < unit->watchPoints.size(); i++) {
+    if (unit->watchPoints[i] == watch_point) {
+      unit->watchPoints.erase(unit->watchPoints.begin() + i);
+      return ESP_OK;
+    }
+  }
+  return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t pcnt_unit_register_event_callbacks(pcnt_unit_handle_t unit, const pcnt_event_callbacks_t* cbs,
+                                             void* user_data) {
+  if (!unit || !cbs) return ESP_ERR_INVALID_ARG;
+  if (unit->enabled) return ESP_ERR_INVALID_STATE;
+  unit->onReach = cbs->on_reach;
+  unit->userData = user_data;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_enable(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  if (unit->enabled) return ESP_ERR_INVALID_STATE;
+  unit->enabled = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_disable(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+  unit->enabled = false;
+  unit->running = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_start(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+  unit->running = true;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_stop(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  if (!unit->enabled) return ESP_ERR_INVALID_STATE;
+  unit->running = false;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_clear_count(pcnt_unit_handle_t unit) {
+  if (!unit) return ESP_ERR_INVALID_ARG;
+  unit->count = 0;
+  unit->accumulated = 0;
+  return ESP_OK;
+}
+
+esp_err_t pcnt_unit_get_count(pcnt_unit_handle_t unit, int* value) {
+  if (!unit || !value) return ESP_ERR_INVALID_ARG;
+  *value = unit->accumulated + unit->count;
+  return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// ADC continuous mode: conversions on the virtual clock, framed into a pool
+// ---------------------------------------------------------------------------
+
+struct SimAdcContinuous {
+  uint32_t poolBytes;
+  uint32_t frameBytes;
+  uint32_t sampleHz;
+  uint8_t channel;
+  uint8_t unit;
+  bool configured;
+  bool running;
+  uint64_t startUs;
+  uint64_t conversions;       // Since start
+  std::vector<uint8_t> frame; // Being filled
+  std::deque<uint8_t> pool;   // Complete frames waiting for adc_continuous_read()
+  adc_continuous_callback_t onConvDone;
+  adc_continuous_callback_t onPoolOvf;
+  void* userData;
+};
+
+static std::vector<SimAdcContinuous*> simAdcs;
+static SimAnalogSource analogSource = nullptr;
+
+void simSetAnalogSource(SimAnalogSource source) {
+  analogSource = source;
+}
+
+static void adcFrameDone(SimAdcContinuous* a) {
+  adc_continuous_evt_data_t data = {a->frame.data(), (uint32_t)a->frame.size()};
+  if (a->pool.size() + a->frame.size() > a->poolBytes) {
+    if (a->onPoolOvf) a->onPoolOvf(a, &data, a->userData);
+  } else {
+    a->pool.insert(a->pool.end(), a->frame.begin(), a->frame.end());
+    if (a->onConvDone) a->onConvDone(a, &data, a->userData);
+  }
+  a->frame.clear();
+}
+
+static void adcRunTo(uint64_t target) {
+  for (SimAdcContinuous* a : simAdcs) {
+    if (!a->running) continue;
+    uint8_t pin = (uint8_t)(a->unit == ADC_UNIT_1 ? a->channel + 1 : a->channel + 11);
+    for (;;) {
+      uint64_t dueUs = a->startUs + (a->conversions + 1) * 1000000ULL / a->sampleHz;
+      if (dueUs > target) break;
+      a->conversions++;
+      int level = analogSource ? analogSource(pin, dueUs) : 0;
+      adc_digi_output_data_t result = {};
+      result.type2.data = (uint32_t)(level < 0 ? 0 : (level > 4095 ? 4095 : level));
+      result.type2.channel = a->channel;
+      result.type2.unit = a->unit;
+      const uint8_t* bytes = (const uint8_t*)&result.val;
+      a->frame.insert(a->frame.end(), bytes, bytes + SOC_ADC_DIGI_RESULT_BYTES);
+      if (a->frame.size() >= a->frameBytes) adcFrameDone(a);
+    }
+  }
+}
+
+esp_err_t adc_continuous_new_handle(const adc_continuous_handle_cfg_t* hdl_config, adc_continuous_handle_t* ret_handle) {
+  if (!hdl_config || !ret_handle || hdl_config->conv_frame_size == 0 ||
+      hdl_config->conv_frame_size % SOC_ADC_DIGI_RESULT_BYTES != 0 ||
+      hdl_config->max_store_buf_size < hdl_config->conv_frame_size) {
+    return ESP_ERR_INVALID_ARG;
+  }
+  SimAdcContinuous* a = new SimAdcContinuous{hdl_config->max_store_buf_size, hdl_config->conv_frame_size, 0, 0, 0,
+                                             false, false, 0, 0, {}, {}, nullptr, nullptr, nullptr};
+  simAdcs.push_back(a);
+  *ret_handle = a;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_config(adc_continuous_handle_t handle, const adc_continuous_config_t* config) {
+  if (!handle || !config || config->pattern_num != 1 || !config->adc_pattern) return ESP_ERR_INVALID_ARG;
+  if (handle->running) return ESP_ERR_INVALID_STATE;
+  if (config->sample_freq_hz < 611 || config->sample_freq_hz > 83333) return ESP_ERR_INVALID_ARG;
+  if (config->format != ADC_DIGI_OUTPUT_FORMAT_TYPE2) return ESP_ERR_INVALID_ARG;
+  handle->sampleHz = config->sample_freq_hz;
+  handle->channel = config->adc_pattern[0].channel;
+  handle->unit = config->adc_pattern[0].unit;
+  handle->configured = true;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_register_event_callbacks(adc_continuous_handle_t handle, const adc_continuous_evt_cbs_t* cbs,
+                                                  void* user_data) {
+  if (!handle || !cbs) return ESP_ERR_INVALID_ARG;
+  if (handle->running) return ESP_ERR_INVALID_STATE;
+  handle->onConvDone = cbs->on_conv_done;
+  handle->onPoolOvf = cbs->on_pool_ovf;
+  handle->userData = user_data;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_start(adc_continuous_handle_t handle) {
+  if (!handle) return ESP_ERR_INVALID_ARG;
+  if (!handle->configured || handle->running) return ESP_ERR_INVALID_STATE;
+  handle->running = true;
+  handle->startUs = simMicros;
+  handle->conversions = 0;
+  handle->frame.clear();
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_read(adc_continuous_handle_t handle, uint8_t* buf, uint32_t length_max, uint32_t* out_length,
+                              uint32_t timeout_ms) {
+  if (!handle || !buf || !out_length) return ESP_ERR_INVALID_ARG;
+  if (!handle->running) return ESP_ERR_INVALID_STATE;
+  *out_length = 0;
+  if (handle->pool.empty()) return ESP_ERR_TIMEOUT;  // The host never waits: no other task fills the pool meanwhile
+  uint32_t length = (uint32_t)handle->pool.size();
+  if (length > length_max) length = length_max - length_max % SOC_ADC_DIGI_RESULT_BYTES;
+  std::copy(handle->pool.begin(), handle->pool.begin() + length, buf);
+  handle->pool.erase(handle->pool.begin(), handle->pool.begin() + length);
+  *out_length = length;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_stop(adc_continuous_handle_t handle) {
+  if (!handle) return ESP_ERR_INVALID_ARG;
+  if (!handle->running) return ESP_ERR_INVALID_STATE;
+  handle->running = false;
+  return ESP_OK;
+}
+
+esp_err_t adc_continuous_deinit(adc_continuous_handle_t handle) {
+  if (!handle) return ESP_ERR_INVALID_ARG;
+  if (handle->running) return ESP_ERR_INVALID_STATE;
+  for (size_t i = 0; i < simAdcs.size(); i++) {
+    if (simAdcs[i] == handle) {
+      simAdcs.erase(simAdcs.begin() + i);
+      break;
+    }
+  }
+  delete handle;
+  return ESP_OK;
+}
+
+// ESP32-S3: ADC1 on GPIO1-10, ADC2 on GPIO11-20
+esp_err_t adc_continuous_io_to_channel(int io_num, adc_unit_t* unit_id, adc_channel_t* channel) {
+  if (!unit_id || !channel) return ESP_ERR_INVALID_ARG;
+  if (io_num >= 1 && io_num <= 10) {
+    *unit_id = ADC_UNIT_1;
+    *channel = (adc_channel_t)(io_num - 1);
+  } else if (io_num >= 11 && io_num <= 20) {
+    *unit_id = ADC_UNIT_2;
+    *channel = (adc_channel_t)(io_num - 11);
+  } else {
+    return ESP_ERR_NOT_FOUND;
+  }
+  return ESP_OK;
+}
+
+// ---------------------------------------------------------------------------
+// Arduino API
+// ---------------------------------------------------------------------------
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (validPin(pin)) pinModes[pin] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val) {
+  if (!validPin(pin)) return;
+  pinLevel[pin] = val ? HIGH : LOW;
+  if (outputHook) outputHook(pin, pinLevel[pin], simMicros);
+}
+
+int digitalRead(uint8_t pin) {
+  return validPin(pin) ? pinLevel[pin] : LOW;
+}
+
+unsigned long millis() {
+  return (unsigned long)(simMicros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)simMicros;
+}
+
+EspClass ESP;
+
+uint32_t EspClass::getCycleCount() {
+  auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  return (uint32_t)((uint64_t)ns * 240 / 1000);
+}
+
+void delay(uint32_t ms) {
+  advanceTo(simMicros + (uint64_t)ms * 1000);
+}
+
+void delayMicroseconds(uint32_t us) {
+  advanceTo(simMicros + us);
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(void), int mode) {
+  if (!validPin(pin)) return;
+  pinIsr[pin] = isr;
+  pinIsrMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (!validPin(pin)) return;
+  pinIsr[pin] = nullptr;
+  pinIsrMode[pin] = 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Virtual GPIO and Time
+ *
+ * The firmware sees ordinary digitalRead/digitalWrite/millis calls. The
+ * simulator owns the clock and drives the input pins from the plant model.
+ */
+
+#ifndef SIM_HAL_H
+#define SIM_HAL_H
+
+#include <Arduino.h>
+#include "esp_system.h"
+
+const int SIM_PIN_COUNT = 49;   // ESP32-S3 GPIO0..GPIO48
+
+// Virtual clock (microseconds since simulated boot)
+uint64_t simNowMicros();
+void simAdvanceMicros(uint64_t us);
+void simSetTimeMicros(uint64_t us);
+
+// Input side: the plant drives pin levels, firing any attached interrupt
+void simSetInputLevel(uint8_t pin, int level);
+
+// Analog side: the 12-bit level an ADC conversion of a pin reads at a time
+typedef int (*SimAnalogSource)(uint8_t pin, uint64_t nowUs);
+void simSetAnalogSource(SimAnalogSource source);
+
+// Output side: level last written by the firmware
+int simGetOutputLevel(uint8_t pin);
+int simGetPinMode(uint8_t pin);
+
+// Called by the HAL whenever the firmware writes an output pin
+typedef void (*SimOutputHook)(uint8_t pin, int level, uint64_t nowUs);
+void simSetOutputHook(SimOutputHook hook);
+
+// Reset all pins to floating-high inputs with no interrupts attached
+void simResetPins();
+
+// Reported by esp_reset_reason() (ESP_RST_POWERON until set)
+void simSetResetReason(esp_reset_reason_t reason);
+
+// Fill RTC_NOINIT_ATTR variables with garbage, as after a reset that lost RTC memory
+void simLoseRtcMemory();
+
+// Far end of a simulated serial line (e.g. a Modbus slave on the RS485 bus)
+class SimUartPeer {
+public:
+  virtual ~SimUartPeer() {}
+  virtual void onHostByte(uint8_t value, uint64_t doneUs) = 0;  // A host byte finished on the wire
+};
+
+struct SimUartStats {
+  uint32_t txBytes;           // Host to peer
+  uint32_t rxBytes;           // Peer to host
+  uint32_t collisions;        // Both ends driving the line at once
+  uint32_t rxDrops;           // RX FIFO full
+  uint32_t rtsHighUs;         // Longest single RE/DE assertion (RS485 mode)
+};
+
+void simUartAttachPeer(HardwareSerial& serial, SimUartPeer* peer);
+// Peer transmits back-to-back from startUs (or when its previous bytes finish)
+void simUartSend(HardwareSerial& serial, const uint8_t* data, size_t length, uint64_t startUs);
+// Report a line error to the host's onReceiveError callback
+void simUartRaiseError(HardwareSerial& serial, hardwareSerial_error_t error);
+SimUartStats simUartGetStats(const HardwareSerial& serial);
+
+#endif // SIM_HAL_H
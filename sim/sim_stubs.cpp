@@ -0,0 +1,65 @@
+/*
+ * ESP32-S3 ASCOM Alpaca Roll-Off Roof Controller (v3)
+ * Host Simulation - Network-side symbols referenced by the roof controller
+ *
+ * The roof controller publishes to MQTT and consults the UDP park sensors.
+ * Neither exists on the host, so these stand-ins count calls and report the
+ * physical park sensor path only. There is no control task either: a wake-up
+ * is left as a flag for the simulator to run the abort path from.
+ */
+
+#include "mqtt_handler.h"
+#include "park_sensor_udp.h"
+#include "control_task.h"
+
+ParkSensorType parkSensorType = PARK_SENSOR_PHYSICAL;
+
+unsigned long simMqttPublishCount = 0;
+
+unsigned long simPositionPublishCount = 0;
+
+unsigned long simSwitchHealthPublishCount = 0;
+
+bool simControlWakePending = false;
+
+void wakeControlTask() {
+  simControlWakePending = true;
+}
+
+void publishStatusToMQTT() {
+  simMqttPublishCount++;
+}
+
+void publishPositionToMQTT(int position) {
+  simPositionPublishCount++;
+}
+
+bool publishSwitchHealthToMQTT(LimitSwitchId id) {
+  simSwitchHealthPublishCount++;
+  return true;
+}
+
+bool getUdpParkVerdict() {
+  return false;
+}
+
+String getRoofStatusString() {
+  return getRoofStatusString(roofStatus);
+}
+
+String getRoofStatusString(RoofStatus status) {
+  switch (status) {
+    case ROOF_OPEN:
+      return "Open";
+    case ROOF_CLOSED:
+      return "Closed";
+    case ROOF_OPENING:
+      return "Opening";
+    case ROOF_CLOSING:
+      return "Closing";
+    case ROOF_ERROR:
+      return "Error";
+    default:
+      return "Unknown";
+  }
+}